@@ -0,0 +1,109 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU General Public License version 2
+ * or later (GPLv2+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <signal.h>
+
+#include <crm/crm.h>
+#include <crm/cluster/internal.h>
+#include <crm/common/mainloop.h>
+
+static GMainLoop *mainloop = NULL;
+
+static pcmk__cli_option_t long_options[] = {
+    // long option, argument type, storage, short option, description, flags
+    {
+        "help", no_argument, NULL, '?',
+        "\tThis text", pcmk__option_default
+    },
+    {
+        "version", no_argument, NULL, '$',
+        "\tVersion information", pcmk__option_default
+    },
+    {
+        "verbose", no_argument, NULL, 'V',
+        "\tIncrease debug output", pcmk__option_default
+    },
+    {
+        "socket", required_argument, NULL, 's',
+        "\tPath of socket to listen on (overrides PCMK_cluster_emulation)",
+        pcmk__option_default
+    },
+    {
+        "expected", required_argument, NULL, 'e',
+        "\tNumber of nodes expected, for quorum (default: the most nodes "
+            "seen active at once)",
+        pcmk__option_default
+    },
+    { 0, 0, 0, 0 }
+};
+
+static void
+hub_shutdown(int nsig)
+{
+    g_main_loop_quit(mainloop);
+}
+
+int
+main(int argc, char **argv)
+{
+    int rc = pcmk_rc_ok;
+    int flag = 0;
+    int option_index = 0;
+    int expected = 0;
+
+    crm_log_cli_init("cts-cluster-hub");
+    pcmk__set_cli_options(NULL, "[options]", long_options,
+                          "relay cluster messages among Pacemaker daemons "
+                          "started with PCMK_cluster_emulation, so that a "
+                          "cluster of many nodes can be run on one host "
+                          "without Corosync");
+
+    while (flag >= 0) {
+        flag = pcmk__next_cli_option(argc, argv, &option_index, NULL);
+        switch (flag) {
+            case -1:
+                break;
+            case 'V':
+                crm_bump_log_level(argc, argv);
+                break;
+            case 's':
+                pcmk__set_env_option("cluster_emulation", optarg);
+                break;
+            case 'e':
+                expected = crm_parse_int(optarg, "0");
+                break;
+            case '$':
+            case '?':
+                pcmk__cli_help(flag, CRM_EX_OK);
+                break;
+            default:
+                pcmk__cli_help(flag, CRM_EX_USAGE);
+                break;
+        }
+    }
+
+    if (!pcmk__cluster_is_emulated() || (expected < 0)) {
+        pcmk__cli_help('?', CRM_EX_USAGE);
+    }
+
+    mainloop = g_main_loop_new(NULL, FALSE);
+    mainloop_add_signal(SIGTERM, hub_shutdown);
+    mainloop_add_signal(SIGINT, hub_shutdown);
+
+    rc = pcmk__cluster_emulator_run(mainloop, (unsigned int) expected);
+    if (rc != pcmk_rc_ok) {
+        fprintf(stderr, "Could not run cluster emulation: %s\n",
+                pcmk_rc_str(rc));
+    }
+
+    g_main_loop_unref(mainloop);
+    crm_exit(pcmk_rc2exitc(rc));
+}
@@ -0,0 +1,276 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU General Public License version 2
+ * or later (GPLv2+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <signal.h>
+
+#include <crm/crm.h>
+#include <crm/cib.h>
+#include <crm/cib/internal.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+#include <crm/common/xml_internal.h>
+#include <crm/common/mainloop.h>
+
+#define RECORDING_TAG "recorded-diffs"
+
+static GMainLoop *mainloop = NULL;
+static xmlNode *recording = NULL;
+static unsigned int recorded = 0;
+
+static pcmk__cli_option_t long_options[] = {
+    // long option, argument type, storage, short option, description, flags
+    {
+        "help", no_argument, NULL, '?',
+        "\tThis text", pcmk__option_default
+    },
+    {
+        "version", no_argument, NULL, '$',
+        "\tVersion information", pcmk__option_default
+    },
+    {
+        "verbose", no_argument, NULL, 'V',
+        "\tIncrease debug output", pcmk__option_default
+    },
+    {
+        "record", required_argument, NULL, 'r',
+        "\tRecord CIB diffs from the local CIB manager to this file, until "
+            "interrupted", pcmk__option_default
+    },
+    {
+        "replay", required_argument, NULL, 'p',
+        "\tClassify the changes in the diffs recorded in this file",
+        pcmk__option_default
+    },
+    {
+        "iterations", required_argument, NULL, 'i',
+        "\tHow many times to replay the recording (default: 100)",
+        pcmk__option_default
+    },
+    { 0, 0, 0, 0 }
+};
+
+static void
+record_diff(const char *event, xmlNode *msg)
+{
+    int rc = -EINVAL;
+    xmlNode *diff = get_message_xml(msg, F_CIB_UPDATE_RESULT);
+
+    crm_element_value_int(msg, F_CIB_RC, &rc);
+    if ((rc == pcmk_ok) && (diff != NULL)) {
+        add_node_copy(recording, diff);
+        recorded++;
+    }
+}
+
+static void
+stop_recording(int nsig)
+{
+    g_main_loop_quit(mainloop);
+}
+
+static void
+cib_connection_lost(gpointer user_data)
+{
+    fprintf(stderr, "Lost connection to the CIB manager\n");
+    g_main_loop_quit(mainloop);
+}
+
+static int
+record(const char *filename)
+{
+    int rc = pcmk_ok;
+    cib_t *cib = cib_new();
+
+    rc = cib->cmds->signon(cib, crm_system_name, cib_query);
+    if (rc == pcmk_ok) {
+        rc = cib->cmds->set_connection_dnotify(cib, cib_connection_lost);
+    }
+    if (rc == pcmk_ok) {
+        rc = cib->cmds->add_notify_callback(cib, T_CIB_DIFF_NOTIFY,
+                                            record_diff);
+    }
+    if (rc != pcmk_ok) {
+        fprintf(stderr, "Could not connect to the CIB manager: %s\n",
+                pcmk_strerror(rc));
+        cib_delete(cib);
+        return pcmk_legacy2rc(rc);
+    }
+
+    recording = create_xml_node(NULL, RECORDING_TAG);
+    mainloop = g_main_loop_new(NULL, FALSE);
+    mainloop_add_signal(SIGTERM, stop_recording);
+    mainloop_add_signal(SIGINT, stop_recording);
+
+    printf("Recording CIB diffs to %s (interrupt to stop)\n", filename);
+    g_main_loop_run(mainloop);
+    g_main_loop_unref(mainloop);
+
+    cib->cmds->signoff(cib);
+    cib_delete(cib);
+
+    rc = pcmk_rc_ok;
+    if (write_xml_file(recording, filename, FALSE) < 0) {
+        rc = errno;
+        fprintf(stderr, "Could not write %s: %s\n", filename, pcmk_rc_str(rc));
+    } else {
+        printf("Recorded %u diff%s\n", recorded, pcmk__plural_s(recorded));
+    }
+    free_xml(recording);
+    return rc;
+}
+
+static const char *
+path_type_text(enum pcmk__cib_path_type type)
+{
+    switch (type) {
+        case pcmk__cib_path_cib:            return "cib";
+        case pcmk__cib_path_configuration:  return "configuration";
+        case pcmk__cib_path_status:         return "status";
+        case pcmk__cib_path_tickets:        return "tickets";
+        case pcmk__cib_path_node_state:     return "node_state";
+        case pcmk__cib_path_transient:      return "transient attributes";
+        case pcmk__cib_path_lrm:            return "lrm";
+        case pcmk__cib_path_lrm_resources:  return "lrm_resources";
+        case pcmk__cib_path_lrm_resource:   return "lrm_resource";
+        case pcmk__cib_path_lrm_rsc_op:     return "lrm_rsc_op";
+        default:                            return "other";
+    }
+}
+
+/*!
+ * \internal
+ * \brief Classify every change in a recording, as the controller would
+ *
+ * \param[in]  recording  Recorded diffs
+ * \param[out] counts     Where to add count of changes of each type
+ *
+ * \return Number of changes classified
+ */
+static unsigned long long
+classify_recording(xmlNode *recording, unsigned long long *counts)
+{
+    unsigned long long changes = 0;
+
+    for (xmlNode *diff = __xml_first_child_element(recording); diff != NULL;
+         diff = __xml_next_element(diff)) {
+
+        int format = 1;
+
+        crm_element_value_int(diff, "format", &format);
+        if (format != 2) {
+            continue;
+        }
+        for (xmlNode *change = __xml_first_child_element(diff); change != NULL;
+             change = __xml_next_element(change)) {
+
+            pcmk__cib_path_t path;
+            const char *xpath = crm_element_value(change, XML_DIFF_PATH);
+
+            if (xpath == NULL) {
+                continue;
+            }
+            pcmk__parse_cib_path(xpath, &path);
+            counts[path.type]++;
+            pcmk__free_cib_path(&path);
+            changes++;
+        }
+    }
+    return changes;
+}
+
+static int
+replay(const char *filename, int iterations)
+{
+    unsigned long long counts[pcmk__cib_path_lrm_rsc_op + 1] = { 0, };
+    unsigned long long changes = 0;
+    gint64 start_us = 0;
+    gint64 elapsed_us = 0;
+    xmlNode *recording = filename2xml(filename);
+
+    if (recording == NULL) {
+        fprintf(stderr, "Could not parse %s\n", filename);
+        return pcmk_rc_unknown_format;
+    }
+
+    start_us = g_get_monotonic_time();
+    for (int i = 0; i < iterations; i++) {
+        changes += classify_recording(recording, counts);
+    }
+    elapsed_us = g_get_monotonic_time() - start_us;
+    free_xml(recording);
+
+    printf("Classified %llu change%s in %lldus (%.1fns per change)\n",
+           changes, pcmk__plural_s(changes), (long long) elapsed_us,
+           (changes == 0)? 0.0 : (elapsed_us * 1000.0 / changes));
+    for (int type = 0; type <= pcmk__cib_path_lrm_rsc_op; type++) {
+        if (counts[type] > 0) {
+            printf("  %-22s %llu\n", path_type_text(type),
+                   counts[type] / iterations);
+        }
+    }
+    return pcmk_rc_ok;
+}
+
+int
+main(int argc, char **argv)
+{
+    int rc = pcmk_rc_ok;
+    int flag = 0;
+    int option_index = 0;
+    int iterations = 100;
+    const char *record_file = NULL;
+    const char *replay_file = NULL;
+
+    crm_log_cli_init("cts-diff-replay");
+    pcmk__set_cli_options(NULL, "--record <file> | --replay <file> [options]",
+                          long_options,
+                          "record the CIB diffs of a (busy) cluster, or "
+                          "measure how quickly the controller can classify "
+                          "the changes in a recording");
+
+    while (flag >= 0) {
+        flag = pcmk__next_cli_option(argc, argv, &option_index, NULL);
+        switch (flag) {
+            case -1:
+                break;
+            case 'V':
+                crm_bump_log_level(argc, argv);
+                break;
+            case 'r':
+                record_file = optarg;
+                break;
+            case 'p':
+                replay_file = optarg;
+                break;
+            case 'i':
+                iterations = crm_parse_int(optarg, "100");
+                break;
+            case '$':
+            case '?':
+                pcmk__cli_help(flag, CRM_EX_OK);
+                break;
+            default:
+                pcmk__cli_help(flag, CRM_EX_USAGE);
+                break;
+        }
+    }
+
+    if (((record_file == NULL) == (replay_file == NULL)) || (iterations < 1)) {
+        pcmk__cli_help('?', CRM_EX_USAGE);
+    }
+
+    if (record_file != NULL) {
+        rc = record(record_file);
+    } else {
+        rc = replay(replay_file, iterations);
+    }
+    crm_exit(pcmk_rc2exitc(rc));
+}
@@ -0,0 +1,333 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU General Public License version 2
+ * or later (GPLv2+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <crm/crm.h>
+#include <crm/common/ipc.h>
+#include <crm/common/ipcs_internal.h>
+#include <crm/common/mainloop.h>
+#include <crm/common/xml.h>
+
+static GMainLoop *mainloop = NULL;
+
+static int num_clients = 200;
+static int num_events = 100;
+static int event_size = 4096;
+
+static int clients_ready = 0;
+static int clients_running = 0;
+static int clients_failed = 0;
+
+static gint64 started_us = 0;       // When the first event was queued
+static gint64 queued_us = 0;        // Time spent preparing and queuing events
+static gint64 delivered_us = 0;     // Time until every client had every event
+
+static pcmk__cli_option_t long_options[] = {
+    // long option, argument type, storage, short option, description, flags
+    {
+        "help", no_argument, NULL, '?',
+        "\tThis text", pcmk__option_default
+    },
+    {
+        "version", no_argument, NULL, '$',
+        "\tVersion information", pcmk__option_default
+    },
+    {
+        "verbose", no_argument, NULL, 'V',
+        "\tIncrease debug output", pcmk__option_default
+    },
+    {
+        "clients", required_argument, NULL, 'c',
+        "\tHow many subscribers to send each event to (default: 200)",
+        pcmk__option_default
+    },
+    {
+        "events", required_argument, NULL, 'e',
+        "\tHow many events to send (default: 100)", pcmk__option_default
+    },
+    {
+        "size", required_argument, NULL, 's',
+        "\tApproximate size of each event in bytes (default: 4096)",
+        pcmk__option_default
+    },
+    { 0, 0, 0, 0 }
+};
+
+/*!
+ * \internal
+ * \brief Connect to the benchmark's IPC server and read every event
+ *
+ * \param[in] server  Name of IPC server
+ *
+ * \return Exit status for subscriber process
+ */
+static int
+run_subscriber(const char *server)
+{
+    int received = 0;
+    struct pollfd pfd = { 0, };
+    crm_ipc_t *ipc = crm_ipc_new(server, 0);
+
+    if ((ipc == NULL) || !crm_ipc_connect(ipc)) {
+        return CRM_EX_UNAVAILABLE;
+    }
+
+    pfd.fd = crm_ipc_get_fd(ipc);
+    pfd.events = POLLIN;
+    while ((received < num_events) && crm_ipc_connected(ipc)) {
+        if ((poll(&pfd, 1, -1) < 0) && (errno != EINTR)) {
+            break;
+        }
+        while ((received < num_events) && (crm_ipc_ready(ipc) > 0)) {
+            // Parts of a multipart event return -EAGAIN until the last one
+            if (crm_ipc_read(ipc) > 0) {
+                received++;
+            }
+        }
+    }
+    crm_ipc_close(ipc);
+    crm_ipc_destroy(ipc);
+    return (received == num_events)? CRM_EX_OK : CRM_EX_ERROR;
+}
+
+static void
+subscriber_exited(mainloop_child_t *p, pid_t pid, int core, int signo,
+                  int exitcode)
+{
+    if ((signo != 0) || (exitcode != CRM_EX_OK)) {
+        clients_failed++;
+    }
+    if (--clients_running == 0) {
+        delivered_us = g_get_monotonic_time() - started_us;
+        g_main_loop_quit(mainloop);
+
+    } else if (started_us == 0) {
+        // A subscriber gave up before the events could be sent
+        g_main_loop_quit(mainloop);
+    }
+}
+
+static void
+queue_event_for_client(gpointer key, gpointer value, gpointer user_data)
+{
+    pcmk__ipc_send_iov((pcmk__client_t *) value, (struct iovec *) user_data,
+                       crm_ipc_server_event);
+}
+
+/*!
+ * \internal
+ * \brief Send every event to every subscriber, as daemons send notifications
+ *
+ * Each event is serialized once and then queued for every client.
+ */
+static gboolean
+send_events(gpointer user_data)
+{
+    xmlNode *xml = create_xml_node(NULL, "fanout-event");
+    char *payload = calloc(1, event_size + 1);
+
+    CRM_ASSERT(payload != NULL);
+    memset(payload, 'x', event_size);
+    crm_xml_add(xml, "payload", payload);
+    free(payload);
+
+    started_us = g_get_monotonic_time();
+    for (int seq = 0; seq < num_events; seq++) {
+        struct iovec *iov = NULL;
+        ssize_t bytes = 0;
+        gint64 start_us = g_get_monotonic_time();
+        int rc = pcmk_rc_ok;
+
+        crm_xml_add_int(xml, "seq", seq);
+        rc = pcmk__ipc_prepare_iov(0, xml, 0, &iov, &bytes);
+        if (rc != pcmk_rc_ok) {
+            fprintf(stderr, "Could not prepare event: %s\n", pcmk_rc_str(rc));
+            break;
+        }
+        pcmk__foreach_ipc_client(queue_event_for_client, iov);
+        pcmk_free_ipc_event(iov);
+        queued_us += g_get_monotonic_time() - start_us;
+    }
+    free_xml(xml);
+    return FALSE;
+}
+
+static int32_t
+fanout_accept(qb_ipcs_connection_t *c, uid_t uid, gid_t gid)
+{
+    return (pcmk__new_client(c, uid, gid) == NULL)? -EIO : 0;
+}
+
+static void
+fanout_created(qb_ipcs_connection_t *c)
+{
+    if (++clients_ready == num_clients) {
+        g_idle_add(send_events, NULL);
+    }
+}
+
+static int32_t
+fanout_dispatch(qb_ipcs_connection_t *c, void *data, size_t size)
+{
+    return 0; // Subscribers don't send requests
+}
+
+static int32_t
+fanout_closed(qb_ipcs_connection_t *c)
+{
+    pcmk__client_t *client = pcmk__find_client(c);
+
+    if (client != NULL) {
+        pcmk__free_client(client);
+    }
+    return 0;
+}
+
+static void
+fanout_destroy(qb_ipcs_connection_t *c)
+{
+    fanout_closed(c);
+}
+
+static struct qb_ipcs_service_handlers fanout_callbacks = {
+    .connection_accept = fanout_accept,
+    .connection_created = fanout_created,
+    .msg_process = fanout_dispatch,
+    .connection_closed = fanout_closed,
+    .connection_destroyed = fanout_destroy
+};
+
+static void
+fanout_shutdown(int nsig)
+{
+    g_main_loop_quit(mainloop);
+}
+
+static int
+run_benchmark(void)
+{
+    char *server = crm_strdup_printf("cts-ipc-fanout-%lld",
+                                     (long long) getpid());
+    qb_ipcs_service_t *ipcs = NULL;
+    const pcmk__ipc_queue_stats_t *stats = NULL;
+
+    mainloop = g_main_loop_new(NULL, FALSE);
+    mainloop_add_signal(SIGTERM, fanout_shutdown);
+    mainloop_add_signal(SIGINT, fanout_shutdown);
+
+    ipcs = mainloop_add_ipc_server(server, QB_IPC_NATIVE, &fanout_callbacks);
+    if (ipcs == NULL) {
+        fprintf(stderr, "Could not start IPC server %s\n", server);
+        free(server);
+        return ENOTCONN;
+    }
+
+    for (int i = 0; i < num_clients; i++) {
+        pid_t pid = fork();
+
+        if (pid == 0) {
+            _exit(run_subscriber(server));
+
+        } else if (pid < 0) {
+            int rc = errno;
+
+            fprintf(stderr, "Could not start subscriber: %s\n",
+                    pcmk_rc_str(rc));
+            num_clients = i;
+            break;
+        }
+        clients_running++;
+        mainloop_child_add(pid, 0, "subscriber", NULL, subscriber_exited);
+    }
+
+    if (clients_running > 0) {
+        g_main_loop_run(mainloop);
+    }
+    mainloop_del_ipc_server(ipcs);
+    g_main_loop_unref(mainloop);
+    free(server);
+
+    if ((started_us == 0) || (delivered_us == 0)) {
+        fprintf(stderr, "Stopped before every event was delivered\n");
+        return ECANCELED;
+    }
+
+    stats = pcmk__ipc_queue_stats();
+    printf("Queued %d event%s of %d bytes for %d subscriber%s in %lldus "
+           "(%.2fus per event per subscriber)\n",
+           num_events, pcmk__plural_s(num_events), event_size,
+           num_clients, pcmk__plural_s(num_clients), (long long) queued_us,
+           queued_us / (double) (num_events * num_clients));
+    printf("Delivered to every subscriber in %lldus\n",
+           (long long) delivered_us);
+    printf("Deepest subscriber queue: %u event%s (%llu bytes)\n",
+           stats->max_depth, pcmk__plural_s(stats->max_depth),
+           (unsigned long long) stats->max_bytes);
+    if (clients_failed > 0) {
+        printf("%d subscriber%s did not receive every event\n",
+               clients_failed, pcmk__plural_s(clients_failed));
+        return pcmk_rc_error;
+    }
+    return pcmk_rc_ok;
+}
+
+int
+main(int argc, char **argv)
+{
+    int rc = pcmk_rc_ok;
+    int flag = 0;
+    int option_index = 0;
+
+    crm_log_cli_init("cts-ipc-fanout");
+    pcmk__set_cli_options(NULL, "[options]", long_options,
+                          "measure how quickly an IPC server can send the "
+                          "same events to many subscribers, as the CIB "
+                          "manager and fencer do with notifications");
+
+    while (flag >= 0) {
+        flag = pcmk__next_cli_option(argc, argv, &option_index, NULL);
+        switch (flag) {
+            case -1:
+                break;
+            case 'V':
+                crm_bump_log_level(argc, argv);
+                break;
+            case 'c':
+                num_clients = crm_parse_int(optarg, "200");
+                break;
+            case 'e':
+                num_events = crm_parse_int(optarg, "100");
+                break;
+            case 's':
+                event_size = crm_parse_int(optarg, "4096");
+                break;
+            case '$':
+            case '?':
+                pcmk__cli_help(flag, CRM_EX_OK);
+                break;
+            default:
+                pcmk__cli_help(flag, CRM_EX_USAGE);
+                break;
+        }
+    }
+
+    if ((num_clients < 1) || (num_events < 1) || (event_size < 0)) {
+        pcmk__cli_help('?', CRM_EX_USAGE);
+    }
+
+    rc = run_benchmark();
+    crm_exit(pcmk_rc2exitc(rc));
+}
@@ -40,6 +40,19 @@ typedef struct cib_local_notify_s {
     gboolean sync_reply;
 } cib_local_notify_t;
 
+/* An asynchronous IPC request that a CIB reply must be tagged with */
+typedef struct cib_async_request_s {
+    char *client_id;
+    uint32_t id;        /* IPC request ID */
+    time_t expires;     /* When the client will have given up on the reply */
+} cib_async_request_t;
+
+/* "<client ID>:<call ID>" -> cib_async_request_t */
+static GHashTable *async_ipc_requests = NULL;
+
+/* Earliest expiration of any entry in async_ipc_requests (0 if none known) */
+static time_t async_next_expiry = 0;
+
 int next_client_id = 0;
 
 gboolean legacy_mode = FALSE;
@@ -99,6 +112,143 @@ cib_ipc_dispatch_ro(qb_ipcs_connection_t * c, void *data, size_t size)
     return cib_common_callback(c, data, size, FALSE);
 }
 
+static char *
+async_request_key(const char *client_id, const char *call_id)
+{
+    return crm_strdup_printf("%s:%s", client_id, call_id);
+}
+
+static void
+free_async_request(gpointer data)
+{
+    cib_async_request_t *request = data;
+
+    free(request->client_id);
+    free(request);
+}
+
+/*!
+ * \internal
+ * \brief Forget asynchronous requests whose client has given up on the reply
+ *
+ * Not every CIB request gets a reply, so without this, requests from
+ * long-lived clients would be tracked until the client disconnects.
+ */
+static void
+expire_async_requests(void)
+{
+    GHashTableIter iter;
+    cib_async_request_t *request = NULL;
+    time_t now = time(NULL);
+
+    if ((async_ipc_requests == NULL) || (async_next_expiry == 0)
+        || (now < async_next_expiry)) {
+        return;
+    }
+
+    async_next_expiry = 0;
+    g_hash_table_iter_init(&iter, async_ipc_requests);
+    while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &request)) {
+        if (request->expires <= now) {
+            crm_debug("Forgetting asynchronous IPC request %u from client %s "
+                      "after client timeout", request->id, request->client_id);
+            pcmk__client_forget_async(pcmk__find_client_by_id(request->client_id),
+                                      request->id);
+            g_hash_table_iter_remove(&iter);
+
+        } else if ((async_next_expiry == 0)
+                   || (request->expires < async_next_expiry)) {
+            async_next_expiry = request->expires;
+        }
+    }
+}
+
+/*!
+ * \internal
+ * \brief Remember the IPC ID of a client's asynchronous CIB request
+ *
+ * \param[in] client      Client that sent request
+ * \param[in] op_request  CIB request
+ * \param[in] id          ID of IPC request that carried \p op_request
+ */
+static void
+remember_async_request(pcmk__client_t *client, xmlNode *op_request,
+                       uint32_t id)
+{
+    const char *call_id = crm_element_value(op_request, F_CIB_CALLID);
+    cib_async_request_t *request = NULL;
+    int timeout = 0;
+
+    if (call_id == NULL) {
+        return;
+    }
+
+    expire_async_requests();
+
+    crm_element_value_int(op_request, F_CIB_TIMEOUT, &timeout);
+    if (timeout <= 0) {
+        timeout = MAX_IPC_DELAY;
+    }
+
+    request = calloc(1, sizeof(cib_async_request_t));
+    CRM_ASSERT(request != NULL);
+    request->client_id = strdup(client->id);
+    request->id = id;
+    request->expires = time(NULL) + timeout;
+
+    if (async_ipc_requests == NULL) {
+        async_ipc_requests = g_hash_table_new_full(crm_str_hash, g_str_equal,
+                                                   free, free_async_request);
+    }
+    g_hash_table_insert(async_ipc_requests,
+                        async_request_key(client->id, call_id), request);
+    if ((async_next_expiry == 0) || (request->expires < async_next_expiry)) {
+        async_next_expiry = request->expires;
+    }
+}
+
+/*!
+ * \internal
+ * \brief Find (and forget) the IPC ID to reply to for an asynchronous request
+ *
+ * \param[in] client_id  ID of client that sent request
+ * \param[in] call_id    CIB call ID of request
+ *
+ * \return IPC request ID if the request was sent asynchronously, otherwise 0
+ */
+static uint32_t
+take_async_request(const char *client_id, int call_id)
+{
+    uint32_t id = 0;
+    char *call = NULL;
+    char *key = NULL;
+    cib_async_request_t *request = NULL;
+
+    if ((async_ipc_requests == NULL) || (call_id <= 0)) {
+        return 0;
+    }
+
+    call = crm_itoa(call_id);
+    key = async_request_key(client_id, call);
+    request = g_hash_table_lookup(async_ipc_requests, key);
+    if (request != NULL) {
+        id = request->id;
+        g_hash_table_remove(async_ipc_requests, key);
+    }
+    free(key);
+    free(call);
+    return id;
+}
+
+static gboolean
+async_request_is_for(gpointer key, gpointer value, gpointer user_data)
+{
+    const char *client_id = user_data;
+    size_t len = strlen(client_id);
+
+    return !strncmp(key, client_id, len) && (((char *) key)[len] == ':');
+}
+
 /* Error code means? */
 static int32_t
 cib_ipc_closed(qb_ipcs_connection_t * c)
@@ -109,6 +259,10 @@ cib_ipc_closed(qb_ipcs_connection_t * c)
         return 0;
     }
     crm_trace("Connection %p", c);
+    if (async_ipc_requests != NULL) {
+        g_hash_table_foreach_remove(async_ipc_requests, async_request_is_for,
+                                    client->id);
+    }
     pcmk__free_client(client);
     return 0;
 }
@@ -182,6 +336,9 @@ cib_common_callback_worker(uint32_t id, uint32_t flags, xmlNode * op_request,
 
         } else if (safe_str_eq(type, T_CIB_REPLACE_NOTIFY)) {
             bit = cib_notify_replace;
+
+        } else if (safe_str_eq(type, T_CIB_CATCH_UP)) {
+            bit = cib_can_catch_up;
         }
 
         if (on_off) {
@@ -227,6 +384,13 @@ cib_common_callback(qb_ipcs_connection_t * c, void *data, size_t size, gboolean
         CRM_LOG_ASSERT(flags & crm_ipc_client_response);
         CRM_LOG_ASSERT(cib_client->request_id == 0);    /* This means the client has two synchronous events in-flight */
         cib_client->request_id = id;    /* Reply only to the last one */
+
+    } else if (is_set(flags, crm_ipc_client_async)
+               && is_set(flags, crm_ipc_client_response)) {
+        /* The client is waiting for a response to this particular IPC
+         * request, so the eventual reply must carry its ID
+         */
+        remember_async_request(cib_client, op_request, id);
     }
 
     if (cib_client->name == NULL) {
@@ -254,6 +418,8 @@ cib_common_callback(qb_ipcs_connection_t * c, void *data, size_t size, gboolean
 
     crm_xml_add(op_request, F_CIB_CLIENTID, cib_client->id);
     crm_xml_add(op_request, F_CIB_CLIENTNAME, cib_client->name);
+    based_stats_bytes(crm_element_value(op_request, F_CIB_OPERATION),
+                      cib_client->name, size, 0);
 
 #if ENABLE_ACL
     CRM_LOG_ASSERT(cib_client->user != NULL);
@@ -271,20 +437,84 @@ static char *ping_digest = NULL;
 static bool ping_modified_since = FALSE;
 int sync_our_cib(xmlNode * request, gboolean all);
 
+/* While our own digest for the current ping is being calculated in a worker
+ * thread, replies from peers are held here (oldest first)
+ */
+static bool ping_digest_pending = FALSE;
+static GList *deferred_ping_replies = NULL;
+
+typedef struct ping_digest_job_s {
+    uint64_t seq;   // Ping that digest is for
+    char *input;    // CIB as of the ping, serialized for digest
+    char *digest;
+} ping_digest_job_t;
+
+static void process_ping_reply(xmlNode *reply);
+
+/* Runs in a worker thread (see pcmk__offload()), so the CIB is serialized
+ * beforehand in the main loop, and only the MD5 calculation is done here
+ */
+static void
+ping_digest_work(gpointer data)
+{
+    ping_digest_job_t *job = data;
+
+    job->digest = pcmk__md5sum(job->input);
+}
+
+static void
+ping_digest_done(gpointer data)
+{
+    ping_digest_job_t *job = data;
+
+    if (job->seq == ping_seq) {
+        GList *replies = deferred_ping_replies;
+
+        ping_digest_pending = FALSE;
+        deferred_ping_replies = NULL;
+        if (ping_digest == NULL) {
+            ping_digest = job->digest;
+            job->digest = NULL;
+        }
+
+        for (GList *iter = replies; iter != NULL; iter = iter->next) {
+            process_ping_reply(iter->data);
+        }
+        g_list_free_full(replies, (GDestroyNotify) free_xml);
+    }
+
+    free(job->digest);
+    free(job->input);
+    free(job);
+}
+
 static gboolean
 cib_digester_cb(gpointer data)
 {
     if (cib_is_master) {
         char buffer[32];
         xmlNode *ping = create_xml_node(NULL, "ping");
+        ping_digest_job_t *job = NULL;
 
         ping_seq++;
         free(ping_digest);
         ping_digest = NULL;
         ping_modified_since = FALSE;
+        g_list_free_full(deferred_ping_replies, (GDestroyNotify) free_xml);
+        deferred_ping_replies = NULL;
         snprintf(buffer, 32, "%" U64T, ping_seq);
         crm_trace("Requesting peer digests (%s)", buffer);
 
+        /* Serialize the CIB now, but calculate our own digest of it in a
+         * worker thread while waiting for the replies
+         */
+        job = calloc(1, sizeof(ping_digest_job_t));
+        CRM_ASSERT(job != NULL);
+        job->seq = ping_seq;
+        job->input = pcmk__digest_input(the_cib, TRUE);
+        ping_digest_pending = TRUE;
+        pcmk__offload("ping digest", ping_digest_work, ping_digest_done, job);
+
         crm_xml_add(ping, F_TYPE, "cib");
         crm_xml_add(ping, F_CIB_OPERATION, CRM_OP_PING);
         crm_xml_add(ping, F_CIB_PING_ID, buffer);
@@ -323,9 +553,18 @@ process_ping_reply(xmlNode *reply)
     } else {
         const char *version = crm_element_value(pong, XML_ATTR_CRM_VERSION);
 
+        if ((ping_digest == NULL) && ping_digest_pending
+            && safe_str_eq(version, CRM_FEATURE_SET)) {
+            crm_trace("Deferring ping reply %s from %s until digest is ready",
+                      seq_s, host);
+            deferred_ping_replies = g_list_append(deferred_ping_replies,
+                                                  copy_xml(reply));
+            return;
+        }
+
         if(ping_digest == NULL) {
             crm_trace("Calculating new digest");
-            ping_digest = calculate_xml_versioned_digest(the_cib, FALSE, TRUE, version);
+            ping_digest = based_calculate_digest(the_cib, version);
         }
 
         crm_trace("Processing ping reply %s from %s (%s)", seq_s, host, digest);
@@ -390,6 +629,7 @@ do_local_notify(xmlNode * notify_src, const char *client_id,
         }
 
     } else {
+        rid = take_async_request(client_id, call_id);
         crm_trace("Sending event %d to %s %s",
                   call_id, client_obj->name, from_peer ? "(originator of delegated request)" : "");
     }
@@ -397,9 +637,27 @@ do_local_notify(xmlNode * notify_src, const char *client_id,
     switch (client_obj->kind) {
         case PCMK__CLIENT_IPC:
             {
-                int rc = pcmk__ipc_send_xml(client_obj, rid, notify_src,
-                                            (sync_reply? crm_ipc_flags_none
-                                             : crm_ipc_server_event));
+                struct iovec *iov = NULL;
+                ssize_t bytes = 0;
+                int rc = pcmk__ipc_prepare_iov(rid, notify_src,
+                                               crm_ipc_default_buffer_size(),
+                                               &iov, &bytes);
+
+                if (rc == pcmk_rc_ok) {
+                    based_stats_bytes(crm_element_value(notify_src,
+                                                        F_CIB_OPERATION),
+                                      client_obj->name, 0, bytes);
+                    /* Replies to asynchronous IPC requests are sent as
+                     * responses, which the IPC layer relays as events
+                     */
+                    rc = pcmk__ipc_send_iov(client_obj, iov,
+                                            crm_ipc_server_free
+                                            |((sync_reply || (rid != 0))?
+                                              crm_ipc_flags_none
+                                              : crm_ipc_server_event));
+                } else {
+                    pcmk_free_ipc_event(iov);
+                }
 
                 if (rc != pcmk_rc_ok) {
                     crm_warn("%s reply to %s failed: %s " CRM_XS " rc=%d",
@@ -681,7 +939,7 @@ parse_peer_options_v2(int call_type, xmlNode * request,
 
     gboolean is_reply = safe_str_eq(reply_to, cib_our_uname);
 
-    if(safe_str_eq(op, CIB_OP_REPLACE)) {
+    if(safe_str_eq(op, CIB_OP_REPLACE) || safe_str_eq(op, CIB_OP_SYNC_DIFF)) {
         /* sync_our_cib() sets F_CIB_ISREPLY */
         if (reply_to) {
             delegated = reply_to;
@@ -815,6 +1073,7 @@ forward_request(xmlNode * request, pcmk__client_t *cib_client, int call_options)
     const char *host = crm_element_value(request, F_CIB_HOST);
 
     crm_xml_add(request, F_CIB_DELEGATED, cib_our_uname);
+    crm_xml_add_ll(request, F_CIB_FORWARDED, g_get_monotonic_time());
 
     if (host != NULL) {
         crm_trace("Forwarding %s op to %s", op, host);
@@ -827,6 +1086,7 @@ forward_request(xmlNode * request, pcmk__client_t *cib_client, int call_options)
 
     /* Return the request to its original state */
     xml_remove_prop(request, F_CIB_DELEGATED);
+    xml_remove_prop(request, F_CIB_FORWARDED);
 
     if (call_options & cib_discard_reply) {
         crm_trace("Client not interested in reply");
@@ -1156,6 +1416,10 @@ cib_process_command(xmlNode * request, xmlNode ** reply, xmlNode ** cib_diff, gb
     gboolean config_changed = FALSE;
     gboolean manage_counters = TRUE;
 
+    gint64 started = g_get_monotonic_time();
+    gint64 notify_us = 0;
+    long long forwarded = 0;
+
     static mainloop_timer_t *digest_timer = NULL;
 
     CRM_ASSERT(cib_status == pcmk_ok);
@@ -1203,7 +1467,9 @@ cib_process_command(xmlNode * request, xmlNode ** reply, xmlNode ** cib_diff, gb
         call_options |= cib_force_diff;
         crm_trace("Global update detected");
 
-        CRM_CHECK(call_type == 3 || call_type == 4, crm_err("Call type: %d", call_type);
+        CRM_CHECK(call_type == 3 || call_type == 4
+                  || safe_str_eq(op, CIB_OP_SYNC_DIFF),
+                  crm_err("Call type: %d", call_type);
                   crm_log_xml_err(request, "bad op"));
     }
 
@@ -1265,6 +1531,10 @@ cib_process_command(xmlNode * request, xmlNode ** reply, xmlNode ** cib_diff, gb
             cib_read_config(config_hash, result_cib);
         }
 
+        if (rc == pcmk_ok) {
+            based_history_add(*cib_diff);
+        }
+
         if (crm_str_eq(CIB_OP_REPLACE, op, TRUE)) {
             if (section == NULL) {
                 send_r_notify = TRUE;
@@ -1303,6 +1573,7 @@ cib_process_command(xmlNode * request, xmlNode ** reply, xmlNode ** cib_diff, gb
         }
     }
 
+    notify_us = g_get_monotonic_time();
     if ((call_options & (cib_inhibit_notify|cib_dryrun)) == 0) {
         const char *client = crm_element_value(request, F_CIB_CLIENTNAME);
 
@@ -1315,6 +1586,7 @@ cib_process_command(xmlNode * request, xmlNode ** reply, xmlNode ** cib_diff, gb
 
         cib_replace_notify(origin, the_cib, rc, *cib_diff);
     }
+    notify_us = g_get_monotonic_time() - notify_us;
 
     xml_log_patchset(LOG_TRACE, "cib:diff", *cib_diff);
   done:
@@ -1348,6 +1620,19 @@ cib_process_command(xmlNode * request, xmlNode ** reply, xmlNode ** cib_diff, gb
         cib_op_cleanup(call_type, call_options, &input, &output);
     }
 
+    /* Requests we forwarded to the cluster carry the time they were sent, so
+     * we can tell how long they waited before coming back to be processed
+     */
+    if (safe_str_eq(crm_element_value(request, F_ORIG), cib_our_uname)
+        && (crm_element_value_ll(request, F_CIB_FORWARDED, &forwarded) == 0)) {
+        forwarded = started - forwarded;
+    } else {
+        forwarded = 0;
+    }
+    based_stats_op(op, crm_element_value(request, F_CIB_CLIENTNAME), rc,
+                   g_get_monotonic_time() - started - notify_us, notify_us,
+                   (gint64) forwarded);
+
     crm_trace("done");
     return rc;
 }
@@ -162,6 +162,9 @@ static cib_operation_t cib_server_ops[] = {
     {CIB_OP_ISMASTER,  FALSE, TRUE,  FALSE, cib_prepare_none, cib_cleanup_none,   cib_process_readwrite},
     {"cib_shutdown_req",FALSE, TRUE, FALSE, cib_prepare_sync, cib_cleanup_none,   cib_process_shutdown_req},
     {CRM_OP_PING,      FALSE, FALSE, FALSE, cib_prepare_none, cib_cleanup_output, cib_process_ping},
+    {CIB_OP_SYNC_DIFF, TRUE,  TRUE,  FALSE, cib_prepare_diff, cib_cleanup_data,   cib_process_sync_diff},
+    {CIB_OP_HISTORY,   FALSE, FALSE, FALSE, cib_prepare_data, cib_cleanup_data,   cib_process_history},
+    {CIB_OP_STATS,     FALSE, TRUE,  FALSE, cib_prepare_none, cib_cleanup_none,   cib_process_stats},
 };
 
 int
@@ -0,0 +1,255 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU General Public License version 2
+ * or later (GPLv2+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <crm/crm.h>
+#include <crm/cib/internal.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+
+#include <pacemaker-based.h>
+
+/* Maximum number of patchsets retained for delta-based peer resyncs */
+#define BASED_HISTORY_MAX 256
+
+typedef struct based_history_entry_s {
+    int source[3];      // admin_epoch, epoch, num_updates the patch applies to
+    int target[3];      // admin_epoch, epoch, num_updates the patch results in
+    xmlNode *patchset;
+} based_history_entry_t;
+
+/* Oldest patchset at the head, newest at the tail. Consecutive entries always
+ * form an unbroken chain (each entry's source is the previous entry's target).
+ */
+static GQueue *history = NULL;
+
+/* Source version ("admin_epoch.epoch.num_updates") -> link in history */
+static GHashTable *history_index = NULL;
+
+static char *
+version_key(const int version[3])
+{
+    return crm_strdup_printf("%d.%d.%d", version[0], version[1], version[2]);
+}
+
+static void
+free_history_entry(gpointer data)
+{
+    based_history_entry_t *entry = data;
+
+    free_xml(entry->patchset);
+    free(entry);
+}
+
+static inline bool
+version_eq(const int a[3], const int b[3])
+{
+    return (a[0] == b[0]) && (a[1] == b[1]) && (a[2] == b[2]);
+}
+
+static void
+drop_oldest_entry(void)
+{
+    based_history_entry_t *entry = g_queue_pop_head(history);
+    char *key = version_key(entry->source);
+
+    g_hash_table_remove(history_index, key);
+    free(key);
+    free_history_entry(entry);
+}
+
+/*!
+ * \internal
+ * \brief Drop all retained patchsets
+ */
+void
+based_history_clear(void)
+{
+    if (history != NULL) {
+        g_queue_free_full(history, free_history_entry);
+        history = NULL;
+    }
+    if (history_index != NULL) {
+        g_hash_table_destroy(history_index);
+        history_index = NULL;
+    }
+}
+
+/*!
+ * \internal
+ * \brief Retain a copy of a patchset applied to the local CIB
+ *
+ * \param[in] patchset  Patchset that was just applied (may be NULL)
+ *
+ * \note Only v2 patchsets are retained. Anything that would break the chain
+ *       of retained patchsets (such as a v1 diff or a version gap) discards
+ *       the existing history, so that a later resync can never be served an
+ *       incomplete chain.
+ */
+void
+based_history_add(xmlNode *patchset)
+{
+    int format = 1;
+    based_history_entry_t *entry = NULL;
+    based_history_entry_t *last = NULL;
+
+    if (patchset == NULL) {
+        return;
+    }
+
+    crm_element_value_int(patchset, "format", &format);
+    if (format != 2) {
+        crm_trace("Discarding patchset history: v%d diff applied", format);
+        based_history_clear();
+        return;
+    }
+
+    entry = calloc(1, sizeof(based_history_entry_t));
+    CRM_ASSERT(entry != NULL);
+    xml_patch_versions(patchset, entry->target, entry->source);
+
+    if (version_eq(entry->source, entry->target)) {
+        // Local-only change that other nodes won't have seen
+        free(entry);
+        return;
+    }
+
+    last = (history == NULL)? NULL : g_queue_peek_tail(history);
+    if ((last != NULL) && !version_eq(last->target, entry->source)) {
+        crm_debug("Discarding patchset history: %d.%d.%d does not follow "
+                  "%d.%d.%d", entry->source[0], entry->source[1],
+                  entry->source[2], last->target[0], last->target[1],
+                  last->target[2]);
+        based_history_clear();
+    }
+
+    if (history == NULL) {
+        history = g_queue_new();
+        history_index = g_hash_table_new_full(crm_str_hash, g_str_equal,
+                                              free, NULL);
+    }
+
+    entry->patchset = copy_xml(patchset);
+    g_queue_push_tail(history, entry);
+    g_hash_table_insert(history_index, version_key(entry->source),
+                        g_queue_peek_tail_link(history));
+
+    while (g_queue_get_length(history) > BASED_HISTORY_MAX) {
+        drop_oldest_entry();
+    }
+}
+
+/*!
+ * \internal
+ * \brief Build the chain of retained patchsets since a given CIB version
+ *
+ * \param[in] admin_epoch  Admin epoch of the version to start from
+ * \param[in] epoch        Epoch of the version to start from
+ * \param[in] updates      Number of updates of the version to start from
+ * \param[in] current      CIB that the chain must lead to
+ *
+ * \return Newly allocated XML containing a copy of each patchset in order
+ *         (empty if the given version is the current one), or NULL if the
+ *         retained history cannot bring the given version up to date
+ * \note The caller is responsible for freeing the result with free_xml().
+ */
+xmlNode *
+based_history_since(int admin_epoch, int epoch, int updates, xmlNode *current)
+{
+    int from[3] = { admin_epoch, epoch, updates };
+    int now[3] = { 0, 0, 0 };
+    char *key = NULL;
+    GList *iter = NULL;
+    based_history_entry_t *last = NULL;
+    xmlNode *patches = NULL;
+
+    crm_element_value_int(current, XML_ATTR_GENERATION_ADMIN, &now[0]);
+    crm_element_value_int(current, XML_ATTR_GENERATION, &now[1]);
+    crm_element_value_int(current, XML_ATTR_NUMUPDATES, &now[2]);
+
+    if (version_eq(from, now)) {
+        return create_xml_node(NULL, XML_TAG_DIFF "s");
+    }
+
+    if (history == NULL) {
+        return NULL;
+    }
+
+    last = g_queue_peek_tail(history);
+    if ((last == NULL) || !version_eq(last->target, now)) {
+        return NULL;
+    }
+
+    key = version_key(from);
+    iter = g_hash_table_lookup(history_index, key);
+    free(key);
+
+    if (iter == NULL) {
+        return NULL;
+    }
+
+    patches = create_xml_node(NULL, XML_TAG_DIFF "s");
+    for (; iter != NULL; iter = iter->next) {
+        based_history_entry_t *entry = iter->data;
+
+        add_node_copy(patches, entry->patchset);
+    }
+    return patches;
+}
+
+/*!
+ * \internal
+ * \brief Return all retained patchsets since the CIB version in \p input
+ *
+ * Clients that fall behind (or reconnect) can use this to catch up instead of
+ * re-querying the whole CIB. If the history does not reach back far enough,
+ * -ENODATA is returned and the client must fall back to a full query.
+ */
+int
+cib_process_history(const char *op, int options, const char *section, xmlNode * req,
+                    xmlNode * input, xmlNode * existing_cib, xmlNode ** result_cib,
+                    xmlNode ** answer)
+{
+    int admin_epoch = 0;
+    int epoch = 0;
+    int updates = 0;
+
+    crm_trace("Processing \"%s\" event", op);
+    *answer = NULL;
+
+#if ENABLE_ACL
+    /* Patchsets can't be filtered, so don't hand them to ACL-restricted users;
+     * they will fall back to a (filtered) full query
+     */
+    if (pcmk_acl_required(crm_element_value(req, F_CIB_USER))
+        && crm_is_true(cib_config_lookup("enable-acl"))) {
+        return -EACCES;
+    }
+#endif
+
+    if ((crm_element_value_int(input, XML_ATTR_GENERATION_ADMIN,
+                               &admin_epoch) < 0)
+        || (crm_element_value_int(input, XML_ATTR_GENERATION, &epoch) < 0)
+        || (crm_element_value_int(input, XML_ATTR_NUMUPDATES, &updates) < 0)) {
+        crm_err("No CIB version specified for %s", op);
+        return -EINVAL;
+    }
+
+    *answer = based_history_since(admin_epoch, epoch, updates, the_cib);
+    if (*answer == NULL) {
+        crm_debug("No patchset history since %d.%d.%d",
+                  admin_epoch, epoch, updates);
+        return -ENODATA;
+    }
+    return pcmk_ok;
+}
@@ -326,6 +326,7 @@ uninitializeCib(void)
     }
 
     the_cib = NULL;
+    based_history_clear();
 
     crm_debug("Deallocating the CIB.");
 
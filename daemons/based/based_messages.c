@@ -134,29 +134,58 @@ cib_process_readwrite(const char *op, int options, const char *section, xmlNode
  */
 static int sync_in_progress = 0;
 
-void
-send_sync_request(const char *host)
+/*!
+ * \internal
+ * \brief Ask one or all peers to send us their copy of the CIB
+ *
+ * \param[in] host  Peer to ask (or NULL for all peers)
+ * \param[in] full  If FALSE, advertise our CIB version and digest so that the
+ *                  peer may reply with only the patchsets we are missing
+ */
+static void
+request_sync(const char *host, gboolean full)
 {
     xmlNode *sync_me = create_xml_node(NULL, "sync-me");
 
-    crm_info("Requesting re-sync from %s", (host? host : "all peers"));
+    crm_info("Requesting %sre-sync from %s",
+             (full? "full " : ""), (host? host : "all peers"));
     sync_in_progress = 1;
 
     crm_xml_add(sync_me, F_TYPE, "cib");
     crm_xml_add(sync_me, F_CIB_OPERATION, CIB_OP_SYNC_ONE);
     crm_xml_add(sync_me, F_CIB_DELEGATED, cib_our_uname);
 
+    if (!full && (the_cib != NULL) && !cib_legacy_mode()) {
+        char *digest = based_calculate_digest(the_cib, CRM_FEATURE_SET);
+
+        crm_xml_add(sync_me, XML_ATTR_GENERATION_ADMIN,
+                    crm_element_value(the_cib, XML_ATTR_GENERATION_ADMIN));
+        crm_xml_add(sync_me, XML_ATTR_GENERATION,
+                    crm_element_value(the_cib, XML_ATTR_GENERATION));
+        crm_xml_add(sync_me, XML_ATTR_NUMUPDATES,
+                    crm_element_value(the_cib, XML_ATTR_NUMUPDATES));
+        crm_xml_add(sync_me, XML_ATTR_CRM_VERSION, CRM_FEATURE_SET);
+        crm_xml_add(sync_me, XML_ATTR_DIGEST, digest);
+        free(digest);
+    }
+
     send_cluster_message(host ? crm_get_peer(0, host) : NULL, crm_msg_cib, sync_me, FALSE);
     free_xml(sync_me);
 }
 
+void
+send_sync_request(const char *host)
+{
+    request_sync(host, FALSE);
+}
+
 int
 cib_process_ping(const char *op, int options, const char *section, xmlNode * req, xmlNode * input,
                  xmlNode * existing_cib, xmlNode ** result_cib, xmlNode ** answer)
 {
     const char *host = crm_element_value(req, F_ORIG);
     const char *seq = crm_element_value(req, F_CIB_PING_ID);
-    char *digest = calculate_xml_versioned_digest(the_cib, FALSE, TRUE, CRM_FEATURE_SET);
+    char *digest = based_calculate_digest(the_cib, CRM_FEATURE_SET);
 
     static struct qb_log_callsite *cs = NULL;
 
@@ -379,6 +408,63 @@ cib_process_replace_svr(const char *op, int options, const char *section, xmlNod
     return rc;
 }
 
+int
+cib_process_sync_diff(const char *op, int options, const char *section, xmlNode * req,
+                      xmlNode * input, xmlNode * existing_cib, xmlNode ** result_cib,
+                      xmlNode ** answer)
+{
+    int rc = pcmk_ok;
+    int applied = 0;
+    xmlNode *patch = NULL;
+    const char *host = crm_element_value(req, F_ORIG);
+    const char *digest = crm_element_value(req, XML_ATTR_DIGEST);
+    const char *version = crm_element_value(req, XML_ATTR_CRM_VERSION);
+
+    crm_trace("Processing \"%s\" event from %s", op, host);
+
+    /* Apply to an untracked copy, so the digest can be checked before the
+     * changes are accepted; cib_perform_op() will infer the combined diff
+     */
+    free_xml(*result_cib);
+    *result_cib = copy_xml(existing_cib);
+
+    for (patch = __xml_first_child_element(input);
+         (patch != NULL) && (rc == pcmk_ok);
+         patch = __xml_next_element(patch)) {
+
+        rc = xml_apply_patchset(*result_cib, patch, TRUE);
+        applied++;
+    }
+
+    if ((rc == pcmk_ok) && (digest != NULL)) {
+        char *new_digest = based_calculate_digest(*result_cib, version);
+
+        if (safe_str_neq(new_digest, digest)) {
+            crm_info("Digest mismatch after applying %d patchset%s from %s: "
+                     "expected %s, calculated %s",
+                     applied, pcmk__plural_s(applied), host, digest,
+                     new_digest);
+            rc = -pcmk_err_diff_failed;
+        }
+        free(new_digest);
+    }
+
+    if (rc == pcmk_ok) {
+        crm_info("Re-synchronized with %s using %d patchset%s",
+                 host, applied, pcmk__plural_s(applied));
+        sync_in_progress = 0;
+
+    } else {
+        crm_notice("Could not apply patchsets from %s: %s "
+                   CRM_XS " rc=%d applied=%d",
+                   host, pcmk_strerror(rc), rc, applied);
+        free_xml(*result_cib);
+        *result_cib = NULL;
+        request_sync(host, TRUE);
+    }
+    return rc;
+}
+
 static int
 delete_cib_object(xmlNode * parent, xmlNode * delete_spec)
 {
@@ -484,6 +570,90 @@ cib_process_delete_absolute(const char *op, int options, const char *section, xm
     return result;
 }
 
+/*!
+ * \internal
+ * \brief Bring a single peer up to date using retained patchsets
+ *
+ * \param[in] request  Sync request from the peer, advertising its CIB version
+ *
+ * \return pcmk_ok if patchsets were sent, -ENODATA if the peer must be sent a
+ *         full copy of the CIB instead, or -ENOTCONN if sending failed
+ */
+static int
+sync_our_cib_delta(xmlNode *request)
+{
+    int admin_epoch = 0;
+    int epoch = 0;
+    int updates = 0;
+    int count = 0;
+    int result = pcmk_ok;
+    char *digest = NULL;
+    const char *host = crm_element_value(request, F_ORIG);
+    const char *op = crm_element_value(request, F_CIB_OPERATION);
+    const char *peer_digest = crm_element_value(request, XML_ATTR_DIGEST);
+    const char *peer_version = crm_element_value(request, XML_ATTR_CRM_VERSION);
+    xmlNode *patch = NULL;
+    xmlNode *patches = NULL;
+    xmlNode *diff_request = NULL;
+
+    if ((host == NULL) || (peer_digest == NULL)
+        || (crm_element_value_int(request, XML_ATTR_GENERATION_ADMIN,
+                                  &admin_epoch) < 0)
+        || (crm_element_value_int(request, XML_ATTR_GENERATION, &epoch) < 0)
+        || (crm_element_value_int(request, XML_ATTR_NUMUPDATES,
+                                  &updates) < 0)) {
+        return -ENODATA;
+    }
+
+    patches = based_history_since(admin_epoch, epoch, updates, the_cib);
+    if (patches == NULL) {
+        crm_debug("Retained history cannot bring %s up to date from %d.%d.%d",
+                  host, admin_epoch, epoch, updates);
+        return -ENODATA;
+    }
+
+    for (patch = __xml_first_child_element(patches); patch != NULL;
+         patch = __xml_next_element(patch)) {
+        count++;
+    }
+
+    digest = based_calculate_digest(the_cib, peer_version? peer_version
+                                              : CRM_FEATURE_SET);
+    if ((count == 0) && safe_str_neq(digest, peer_digest)) {
+        // Same version but different contents, patchsets can't help
+        crm_debug("%s has our version %d.%d.%d but a different digest",
+                  host, admin_epoch, epoch, updates);
+        free(digest);
+        free_xml(patches);
+        return -ENODATA;
+    }
+
+    crm_debug("Syncing CIB to %s using %d patchset%s from %d.%d.%d",
+              host, count, pcmk__plural_s(count), admin_epoch, epoch, updates);
+
+    diff_request = cib_msg_copy(request, FALSE);
+    CRM_CHECK(diff_request != NULL, free(digest); free_xml(patches);
+              return -ENOMEM);
+
+    crm_xml_add(diff_request, F_CIB_ISREPLY, host);
+    crm_xml_add(diff_request, F_CIB_OPERATION, CIB_OP_SYNC_DIFF);
+    crm_xml_add(diff_request, "original_" F_CIB_OPERATION, op);
+    crm_xml_add(diff_request, F_CIB_GLOBAL_UPDATE, XML_BOOLEAN_TRUE);
+    crm_xml_add(diff_request, XML_ATTR_CRM_VERSION,
+                peer_version? peer_version : CRM_FEATURE_SET);
+    crm_xml_add(diff_request, XML_ATTR_DIGEST, digest);
+    add_message_xml(diff_request, F_CIB_UPDATE_DIFF, patches);
+
+    if (send_cluster_message(crm_get_peer(0, host), crm_msg_cib, diff_request,
+                             FALSE) == FALSE) {
+        result = -ENOTCONN;
+    }
+    free_xml(diff_request);
+    free_xml(patches);
+    free(digest);
+    return result;
+}
+
 int
 sync_our_cib(xmlNode * request, gboolean all)
 {
@@ -492,9 +662,19 @@ sync_our_cib(xmlNode * request, gboolean all)
     const char *host = crm_element_value(request, F_ORIG);
     const char *op = crm_element_value(request, F_CIB_OPERATION);
 
-    xmlNode *replace_request = cib_msg_copy(request, FALSE);
+    xmlNode *replace_request = NULL;
 
     CRM_CHECK(the_cib != NULL,;);
+
+    if ((all == FALSE) && !cib_legacy_mode()) {
+        result = sync_our_cib_delta(request);
+        if (result != -ENODATA) {
+            return result;
+        }
+        result = pcmk_ok;
+    }
+
+    replace_request = cib_msg_copy(request, FALSE);
     CRM_CHECK(replace_request != NULL,;);
 
     crm_debug("Syncing CIB to %s", all ? "all peers" : host);
@@ -521,7 +701,7 @@ sync_our_cib(xmlNode * request, gboolean all)
     crm_xml_add(replace_request, F_CIB_GLOBAL_UPDATE, XML_BOOLEAN_TRUE);
 
     crm_xml_add(replace_request, XML_ATTR_CRM_VERSION, CRM_FEATURE_SET);
-    digest = calculate_xml_versioned_digest(the_cib, FALSE, TRUE, CRM_FEATURE_SET);
+    digest = based_calculate_digest(the_cib, CRM_FEATURE_SET);
     crm_xml_add(replace_request, XML_ATTR_DIGEST, digest);
 
     add_message_xml(replace_request, F_CIB_CALLDATA, the_cib);
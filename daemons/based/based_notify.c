@@ -80,11 +80,27 @@ cib_notify_send_one(gpointer key, gpointer value, gpointer user_data)
     }
 
     if (do_send) {
+        uint32_t flags = crm_ipc_server_event;
+
+        /* A client that registered that it can catch up from the patchset
+         * history only needs the newest diff queued for it kept if it falls
+         * behind. Other clients may act on every diff (or not notice a gap),
+         * so theirs are always delivered.
+         */
+        if (safe_str_eq(type, T_CIB_DIFF_NOTIFY)
+            && is_set(client->options, cib_can_catch_up)) {
+            flags |= crm_ipc_server_coalesce;
+        }
+
         switch (client->kind) {
             case PCMK__CLIENT_IPC:
                 if (pcmk__ipc_send_iov(client, update->iov,
-                                       crm_ipc_server_event) != pcmk_rc_ok) {
+                                       flags) != pcmk_rc_ok) {
                     crm_warn("Notification of client %s/%s failed", client->name, client->id);
+                } else {
+                    based_stats_bytes(crm_element_value(update->msg,
+                                                        F_CIB_OPERATION),
+                                      client->name, 0, update->iov_size);
                 }
                 break;
 #ifdef HAVE_GNUTLS_GNUTLS_H
@@ -0,0 +1,319 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU General Public License version 2
+ * or later (GPLv2+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <crm/crm.h>
+#include <crm/cib/internal.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+#include <crm/common/mainloop.h>
+#include <crm/common/ipc_internal.h>
+
+#include <pacemaker-based.h>
+
+/* How often to log a summary of the statistics (in milliseconds) */
+#define BASED_STATS_LOG_INTERVAL_MS (15 * 60 * 1000)
+
+typedef struct based_stats_s {
+    unsigned long long count;       // Operations processed
+    unsigned long long failed;      // Operations that returned an error
+    unsigned long long bytes_in;    // Request bytes received over IPC
+    unsigned long long bytes_out;   // Reply and notification bytes sent
+    gint64 apply_us;                // Time spent performing operations
+    gint64 apply_max_us;
+    gint64 notify_us;               // Time spent notifying clients
+    gint64 queue_us;                // Time spent waiting on the cluster layer
+    gint64 queue_max_us;
+} based_stats_t;
+
+static GHashTable *op_stats = NULL;     // Operation name -> based_stats_t
+static GHashTable *client_stats = NULL; // Client name -> based_stats_t
+
+static unsigned long long digest_count = 0;
+static gint64 digest_us = 0;
+
+static mainloop_timer_t *stats_timer = NULL;
+
+static based_stats_t *
+stats_for(GHashTable **table, const char *name)
+{
+    based_stats_t *stats = NULL;
+
+    if (name == NULL) {
+        name = "unknown";
+    }
+    if (*table == NULL) {
+        *table = g_hash_table_new_full(crm_str_hash, g_str_equal, free, free);
+    }
+
+    stats = g_hash_table_lookup(*table, name);
+    if (stats == NULL) {
+        stats = calloc(1, sizeof(based_stats_t));
+        CRM_ASSERT(stats != NULL);
+        g_hash_table_insert(*table, strdup(name), stats);
+    }
+    return stats;
+}
+
+static void
+add_op(based_stats_t *stats, int rc, gint64 apply_us, gint64 notify_us,
+       gint64 queue_us)
+{
+    stats->count++;
+    if (rc != pcmk_ok) {
+        stats->failed++;
+    }
+    stats->apply_us += apply_us;
+    stats->apply_max_us = QB_MAX(stats->apply_max_us, apply_us);
+    stats->notify_us += notify_us;
+    stats->queue_us += queue_us;
+    stats->queue_max_us = QB_MAX(stats->queue_max_us, queue_us);
+}
+
+/*!
+ * \internal
+ * \brief Record the timing of a processed CIB operation
+ *
+ * \param[in] op         Name of operation
+ * \param[in] client     Name of client (or peer) that requested it
+ * \param[in] rc         Result of operation
+ * \param[in] apply_us   Microseconds spent performing the operation
+ * \param[in] notify_us  Microseconds spent notifying clients of the result
+ * \param[in] queue_us   Microseconds the request waited before processing
+ */
+void
+based_stats_op(const char *op, const char *client, int rc, gint64 apply_us,
+               gint64 notify_us, gint64 queue_us)
+{
+    add_op(stats_for(&op_stats, op), rc, apply_us, notify_us, queue_us);
+    add_op(stats_for(&client_stats, client), rc, apply_us, notify_us,
+           queue_us);
+}
+
+/*!
+ * \internal
+ * \brief Record bytes received from or sent to an IPC client
+ *
+ * \param[in] op         Name of operation the message relates to
+ * \param[in] client     Name of client
+ * \param[in] bytes_in   Bytes received
+ * \param[in] bytes_out  Bytes sent
+ */
+void
+based_stats_bytes(const char *op, const char *client, size_t bytes_in,
+                  size_t bytes_out)
+{
+    based_stats_t *stats = stats_for(&op_stats, op);
+
+    stats->bytes_in += bytes_in;
+    stats->bytes_out += bytes_out;
+
+    stats = stats_for(&client_stats, client);
+    stats->bytes_in += bytes_in;
+    stats->bytes_out += bytes_out;
+}
+
+/*!
+ * \internal
+ * \brief Calculate a versioned CIB digest, recording the time taken
+ *
+ * \param[in] cib      CIB to calculate digest of
+ * \param[in] version  Feature set to calculate digest for
+ *
+ * \return Newly allocated digest (caller must free)
+ */
+char *
+based_calculate_digest(xmlNode *cib, const char *version)
+{
+    gint64 start = g_get_monotonic_time();
+    char *digest = calculate_xml_versioned_digest(cib, FALSE, TRUE, version);
+
+    digest_us += g_get_monotonic_time() - start;
+    digest_count++;
+    return digest;
+}
+
+static void
+add_stats_xml(xmlNode *parent, const char *tag, const char *name,
+              based_stats_t *stats)
+{
+    xmlNode *xml = create_xml_node(parent, tag);
+
+    crm_xml_add(xml, XML_ATTR_ID, name);
+    crm_xml_add_ll(xml, "count", (long long) stats->count);
+    crm_xml_add_ll(xml, "failed", (long long) stats->failed);
+    crm_xml_add_ll(xml, "bytes-in", (long long) stats->bytes_in);
+    crm_xml_add_ll(xml, "bytes-out", (long long) stats->bytes_out);
+    crm_xml_add_ll(xml, "apply-us", (long long) stats->apply_us);
+    crm_xml_add_ll(xml, "apply-max-us", (long long) stats->apply_max_us);
+    crm_xml_add_ll(xml, "notify-us", (long long) stats->notify_us);
+    crm_xml_add_ll(xml, "queue-us", (long long) stats->queue_us);
+    crm_xml_add_ll(xml, "queue-max-us", (long long) stats->queue_max_us);
+}
+
+static void
+add_table_xml(xmlNode *parent, const char *tag, GHashTable *table)
+{
+    GHashTableIter iter;
+    const char *name = NULL;
+    based_stats_t *stats = NULL;
+
+    if (table == NULL) {
+        return;
+    }
+    g_hash_table_iter_init(&iter, table);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &name,
+                                  (gpointer *) &stats)) {
+        add_stats_xml(parent, tag, name, stats);
+    }
+}
+
+static void
+add_queue_xml(gpointer key, gpointer value, gpointer user_data)
+{
+    pcmk__client_t *client = value;
+    xmlNode *xml = create_xml_node(user_data, "client-queue");
+
+    crm_xml_add(xml, XML_ATTR_ID, client->id);
+    crm_xml_add(xml, "name", pcmk__client_name(client));
+    crm_xml_add_int(xml, "events", (client->event_queue == NULL)? 0
+                    : g_queue_get_length(client->event_queue));
+    crm_xml_add_int(xml, "backlog", client->queue_backlog);
+    crm_xml_add_ll(xml, "bytes", (long long) client->queue_bytes);
+}
+
+static void
+add_ipc_queue_stats_xml(xmlNode *parent)
+{
+    const pcmk__ipc_queue_stats_t *stats = pcmk__ipc_queue_stats();
+    xmlNode *xml = create_xml_node(parent, "ipc-queues");
+
+    crm_xml_add_ll(xml, "events", (long long) stats->events);
+    crm_xml_add_ll(xml, "bytes", (long long) stats->bytes);
+    crm_xml_add_ll(xml, "coalesced", (long long) stats->coalesced);
+    crm_xml_add_ll(xml, "evictions", (long long) stats->evictions);
+    crm_xml_add_int(xml, "max-depth", stats->max_depth);
+    crm_xml_add_ll(xml, "max-bytes", (long long) stats->max_bytes);
+}
+
+/*!
+ * \internal
+ * \brief Build an XML summary of all statistics collected so far
+ *
+ * \return Newly allocated XML (caller must free)
+ */
+xmlNode *
+based_stats_xml(void)
+{
+    xmlNode *xml = create_xml_node(NULL, "cib-stats");
+    xmlNode *child = NULL;
+
+    child = create_xml_node(xml, "digests");
+    crm_xml_add_ll(child, "count", (long long) digest_count);
+    crm_xml_add_ll(child, "total-us", (long long) digest_us);
+
+    add_table_xml(xml, "operation", op_stats);
+    add_table_xml(xml, "client", client_stats);
+    add_ipc_queue_stats_xml(xml);
+    pcmk__foreach_ipc_client(add_queue_xml, xml);
+    pcmk__mainloop_stats_xml(xml);
+    pcmk__ipc_latency_xml(xml);
+    return xml;
+}
+
+static void
+log_stats(const char *kind, GHashTable *table)
+{
+    GHashTableIter iter;
+    const char *name = NULL;
+    based_stats_t *stats = NULL;
+
+    if (table == NULL) {
+        return;
+    }
+    g_hash_table_iter_init(&iter, table);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &name,
+                                  (gpointer *) &stats)) {
+        crm_info("CIB %s %s: %llu calls (%llu failed), %llu bytes in, "
+                 "%llu bytes out, %lldms applying (max %lldms), "
+                 "%lldms notifying, %lldms queued (max %lldms)",
+                 kind, name, stats->count, stats->failed, stats->bytes_in,
+                 stats->bytes_out, (long long) (stats->apply_us / 1000),
+                 (long long) (stats->apply_max_us / 1000),
+                 (long long) (stats->notify_us / 1000),
+                 (long long) (stats->queue_us / 1000),
+                 (long long) (stats->queue_max_us / 1000));
+    }
+}
+
+static gboolean
+based_stats_log_cb(gpointer data)
+{
+    const pcmk__ipc_queue_stats_t *queues = pcmk__ipc_queue_stats();
+
+    crm_info("CIB digests: %llu calculated in %lldms",
+             digest_count, (long long) (digest_us / 1000));
+    crm_info("CIB IPC queues: %llu events (%llu bytes) queued, %llu coalesced, "
+             "%llu evictions, deepest %u events (%llu bytes)",
+             queues->events, queues->bytes, queues->coalesced,
+             queues->evictions, queues->max_depth,
+             (unsigned long long) queues->max_bytes);
+    log_stats("operation", op_stats);
+    log_stats("client", client_stats);
+    return TRUE;
+}
+
+int
+cib_process_stats(const char *op, int options, const char *section, xmlNode * req,
+                  xmlNode * input, xmlNode * existing_cib, xmlNode ** result_cib,
+                  xmlNode ** answer)
+{
+    crm_trace("Processing \"%s\" event", op);
+    *answer = based_stats_xml();
+    return pcmk_ok;
+}
+
+/*!
+ * \internal
+ * \brief Start periodically logging statistics
+ */
+void
+based_stats_init(void)
+{
+    if (stats_timer == NULL) {
+        stats_timer = mainloop_timer_add("stats", BASED_STATS_LOG_INTERVAL_MS,
+                                         TRUE, based_stats_log_cb, NULL);
+        mainloop_timer_start(stats_timer);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Stop logging statistics and free all collected data
+ */
+void
+based_stats_cleanup(void)
+{
+    if (stats_timer != NULL) {
+        mainloop_timer_del(stats_timer);
+        stats_timer = NULL;
+    }
+    if (op_stats != NULL) {
+        g_hash_table_destroy(op_stats);
+        op_stats = NULL;
+    }
+    if (client_stats != NULL) {
+        g_hash_table_destroy(client_stats);
+        client_stats = NULL;
+    }
+}
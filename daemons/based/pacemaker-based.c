@@ -103,6 +103,7 @@ main(int argc, char **argv)
     mainloop_add_signal(SIGPIPE, cib_enable_writes);
 
     cib_writer = mainloop_add_trigger(G_PRIORITY_LOW, write_cib_contents, NULL);
+    pcmk__mainloop_trigger_set_name(cib_writer, "cib-writer");
 
     while (1) {
         flag = pcmk__next_cli_option(argc, argv, &index, NULL);
@@ -228,6 +229,7 @@ cib_cleanup(void)
         g_hash_table_destroy(local_notify_queue);
     }
     pcmk__client_cleanup();
+    based_stats_cleanup();
     g_hash_table_destroy(config_hash);
     free(cib_our_uname);
 }
@@ -346,6 +348,8 @@ cib_init(void)
     if (stand_alone) {
         cib_is_master = TRUE;
     }
+
+    based_stats_init();
 }
 
 static bool
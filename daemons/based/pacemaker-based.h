@@ -40,6 +40,7 @@ enum cib_notifications {
 
     // Not a notification, but uses the same IPC bitmask
     cib_is_daemon      = 0x1000, // Whether client is another cluster daemon
+    cib_can_catch_up   = 0x2000, // Whether client can catch up on missed diffs
 };
 
 typedef struct cib_operation_s {
@@ -121,6 +122,15 @@ int cib_process_sync(const char *op, int options, const char *section,
 int cib_process_sync_one(const char *op, int options, const char *section,
                          xmlNode *req, xmlNode *input, xmlNode *existing_cib,
                          xmlNode **result_cib, xmlNode **answer);
+int cib_process_sync_diff(const char *op, int options, const char *section,
+                          xmlNode *req, xmlNode *input, xmlNode *existing_cib,
+                          xmlNode **result_cib, xmlNode **answer);
+int cib_process_history(const char *op, int options, const char *section,
+                        xmlNode *req, xmlNode *input, xmlNode *existing_cib,
+                        xmlNode **result_cib, xmlNode **answer);
+int cib_process_stats(const char *op, int options, const char *section,
+                      xmlNode *req, xmlNode *input, xmlNode *existing_cib,
+                      xmlNode **result_cib, xmlNode **answer);
 int cib_process_delete_absolute(const char *op, int options,
                                 const char *section, xmlNode *req,
                                 xmlNode *input, xmlNode *existing_cib,
@@ -131,6 +141,20 @@ int cib_process_upgrade_server(const char *op, int options, const char *section,
                                xmlNode **answer);
 void send_sync_request(const char *host);
 
+void based_history_add(xmlNode *patchset);
+void based_history_clear(void);
+xmlNode *based_history_since(int admin_epoch, int epoch, int updates,
+                             xmlNode *current);
+
+void based_stats_init(void);
+void based_stats_cleanup(void);
+void based_stats_op(const char *op, const char *client, int rc,
+                    gint64 apply_us, gint64 notify_us, gint64 queue_us);
+void based_stats_bytes(const char *op, const char *client, size_t bytes_in,
+                       size_t bytes_out);
+char *based_calculate_digest(xmlNode *cib, const char *version);
+xmlNode *based_stats_xml(void);
+
 xmlNode *cib_msg_copy(xmlNode *msg, gboolean with_data);
 xmlNode *cib_construct_reply(xmlNode *request, xmlNode *output, int rc);
 int cib_get_operation_id(const char *op, int *operation);
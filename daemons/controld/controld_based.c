@@ -56,6 +56,9 @@ do_cib_control(long long action,
 
     if (action & A_CIB_STOP) {
 
+        if (fsa_cib_conn->state != cib_disconnected) {
+            controld_flush_rsc_updates();
+        }
         if (fsa_cib_conn->state != cib_disconnected && last_resource_update != 0) {
             crm_info("Waiting for resource update %d to complete", last_resource_update);
             crmd_fsa_stall(FALSE);
@@ -109,6 +112,10 @@ do_cib_control(long long action,
             crm_err("Could not set CIB notification callback (update)");
 
         } else {
+            /* The controller is always local to the CIB manager, so it can keep
+             * many asynchronous calls in flight
+             */
+            cib_native_set_async_ipc(fsa_cib_conn, true);
             set_bit(fsa_input_register, R_CIB_CONNECTED);
             cib_retries = 0;
         }
@@ -255,6 +262,7 @@ controld_delete_node_state(const char *uname, enum controld_section_e section,
         int call_id;
 
         options |= cib_quorum_override|cib_xpath|cib_multiple;
+        controld_flush_rsc_updates(); // Don't let a batched result undo this
         call_id = fsa_cib_conn->cmds->remove(fsa_cib_conn, xpath, NULL, options);
         crm_info("Deleting %s (via CIB call %d) " CRM_XS " xpath=%s",
                  desc, call_id, xpath);
@@ -300,7 +308,8 @@ controld_delete_resource_history(const char *rsc_id, const char *node,
         return ENOTCONN;
     }
 
-    // Ask CIB to delete the entry
+    // Ask CIB to delete the entry (after any batched results for it)
+    controld_flush_rsc_updates();
     xpath = crm_strdup_printf(XPATH_RESOURCE_HISTORY, node, rsc_id);
     rc = cib_internal_op(fsa_cib_conn, CIB_OP_DELETE, NULL, xpath, NULL,
                          NULL, call_options|cib_xpath, user_name);
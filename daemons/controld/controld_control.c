@@ -243,6 +243,7 @@ crmd_exit(crm_exit_t exit_code)
     controld_free_fsa_timers();
     te_cleanup_stonith_history_sync(NULL, TRUE);
     controld_free_sched_timer();
+    controld_free_rsc_update_batch();
 
     free(fsa_our_dc_version); fsa_our_dc_version = NULL;
     free(fsa_our_uname); fsa_our_uname = NULL;
@@ -344,6 +345,9 @@ do_startup(long long action,
     fsa_source = mainloop_add_trigger(G_PRIORITY_HIGH, crm_fsa_trigger, NULL);
     config_read = mainloop_add_trigger(G_PRIORITY_HIGH, crm_read_options, NULL);
     transition_trigger = mainloop_add_trigger(G_PRIORITY_LOW, te_graph_trigger, NULL);
+    pcmk__mainloop_trigger_set_name(fsa_source, "fsa");
+    pcmk__mainloop_trigger_set_name(config_read, "config-read");
+    pcmk__mainloop_trigger_set_name(transition_trigger, "transition");
 
     crm_debug("Creating CIB manager and executor objects");
     fsa_cib_conn = cib_new();
@@ -563,6 +567,31 @@ static pcmk__cluster_option_t crmd_opts[] = {
         "Maximum number of jobs that can be scheduled per node "
             "(defaults to 2x cores)"
     },
+    {
+        "node-action-class-limits", NULL, "string", NULL,
+        NULL, NULL,
+        "Maximum number of jobs for particular resource agent classes that "
+            "can be scheduled per node",
+        "A comma-separated list of CLASS=LIMIT or CLASS:PROVIDER=LIMIT, for "
+            "example \"systemd=2,ocf:heartbeat=8\". Actions for agents "
+            "matching an entry (the most specific one, if more than one "
+            "matches) are limited by that entry as well as by "
+            "node-action-limit, so that slow agents cannot take all of a "
+            "node's jobs and starve fast ones. These limits are reduced in "
+            "proportion when a node is throttled due to load."
+    },
+    {
+        "resource-update-window", NULL, "time", NULL,
+        "0", pcmk__valid_interval_spec,
+        "How long a node should collect resource action results before "
+            "recording them in the CIB",
+        "Zero records each result as soon as it is known. Otherwise, results "
+            "that complete within this time of each other (for example, "
+            "probes after a node starts) are recorded together in a single "
+            "CIB update, reducing CIB load on large clusters at the cost of "
+            "delaying each result by up to this long. A small value such as "
+            "\"200ms\" is recommended if this is desired."
+    },
     { XML_CONFIG_ATTR_FENCE_REACTION, NULL, "string", NULL, "stop", NULL,
         "How a cluster node should react if notified of its own fencing",
         "A cluster node may receive notification of its own fencing if fencing "
@@ -705,6 +734,9 @@ config_query_callback(xmlNode * msg, int call_id, int rc, xmlNode * output, void
 
     value = crmd_pref(config_hash, "node-action-limit"); /* Also checks migration-limit */
     throttle_update_job_max(value);
+    te_set_class_limits(crmd_pref(config_hash, "node-action-class-limits"));
+    controld_set_rsc_update_window(crmd_pref(config_hash,
+                                             "resource-update-window"));
 
     value = crmd_pref(config_hash, "load-threshold");
     if(value) {
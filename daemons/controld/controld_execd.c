@@ -83,6 +83,170 @@ copy_meta_keys(gpointer key, gpointer value, gpointer user_data)
     }
 }
 
+/* Parameter sets referenced by resource history, keyed by their contents.
+ * Resources configured alike, and successive operations on one resource, tend
+ * to have identical parameters, so each distinct set is stored only once.
+ */
+static GHashTable *history_params = NULL; // params table -> reference count
+
+static guint
+params_hash(gconstpointer key)
+{
+    GHashTableIter iter;
+    gpointer name = NULL;
+    gpointer value = NULL;
+    guint hash = 0;
+
+    g_hash_table_iter_init(&iter, (GHashTable *) key);
+    while (g_hash_table_iter_next(&iter, &name, &value)) {
+        // Summing keeps the result independent of iteration order
+        hash += (g_str_hash(name) * 33) + (value? g_str_hash(value) : 0);
+    }
+    return hash;
+}
+
+static gboolean
+params_equal(gconstpointer a, gconstpointer b)
+{
+    GHashTableIter iter;
+    gpointer name = NULL;
+    gpointer value = NULL;
+
+    if (g_hash_table_size((GHashTable *) a)
+        != g_hash_table_size((GHashTable *) b)) {
+        return FALSE;
+    }
+
+    g_hash_table_iter_init(&iter, (GHashTable *) a);
+    while (g_hash_table_iter_next(&iter, &name, &value)) {
+        gpointer other = NULL;
+
+        if (!g_hash_table_lookup_extended((GHashTable *) b, name, NULL, &other)
+            || safe_str_neq(value, other)) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/*!
+ * \internal
+ * \brief Get a shared copy of an operation's parameters for resource history
+ *
+ * \param[in] params         Parameters to copy
+ * \param[in] instance_only  If TRUE, copy only instance (not meta) parameters
+ *
+ * \return Shared parameter table (release with history_params_unref())
+ */
+static GHashTable *
+history_params_ref(GHashTable *params, gboolean instance_only)
+{
+    GHashTableIter iter;
+    gpointer name = NULL;
+    gpointer value = NULL;
+    gpointer shared = NULL;
+    gpointer refs = NULL;
+    GHashTable *copy = NULL;
+
+    /* Parameter names come from a small set (agent parameters and meta-
+     * attributes), so intern them rather than storing them per table.
+     */
+    copy = g_hash_table_new_full(crm_str_hash, g_str_equal, NULL, free);
+    g_hash_table_iter_init(&iter, params);
+    while (g_hash_table_iter_next(&iter, &name, &value)) {
+        if (!instance_only || (strstr(name, CRM_META "_") == NULL)) {
+            g_hash_table_insert(copy, (gpointer) g_intern_string(name),
+                                (value? strdup(value) : NULL));
+        }
+    }
+
+    if (history_params == NULL) {
+        history_params = g_hash_table_new_full(params_hash, params_equal,
+                                               (GDestroyNotify) g_hash_table_destroy,
+                                               free);
+    }
+
+    if (g_hash_table_lookup_extended(history_params, copy, &shared, &refs)) {
+        g_hash_table_destroy(copy);
+        (*(int *) refs)++;
+        return shared;
+    }
+
+    refs = calloc(1, sizeof(int));
+    CRM_ASSERT(refs != NULL);
+    *(int *) refs = 1;
+    g_hash_table_insert(history_params, copy, refs);
+    return copy;
+}
+
+/*!
+ * \internal
+ * \brief Release a shared parameter table obtained for resource history
+ *
+ * \param[in] params  Table returned by history_params_ref() (or NULL)
+ */
+static void
+history_params_unref(GHashTable *params)
+{
+    gpointer refs = NULL;
+
+    if (params == NULL) {
+        return;
+    }
+    CRM_CHECK((history_params != NULL)
+              && g_hash_table_lookup_extended(history_params, params, NULL,
+                                              &refs),
+              return);
+
+    if (--(*(int *) refs) == 0) {
+        g_hash_table_remove(history_params, params);
+        if (g_hash_table_size(history_params) == 0) {
+            g_hash_table_destroy(history_params);
+            history_params = NULL;
+        }
+    }
+}
+
+/*!
+ * \internal
+ * \brief Copy an operation result for resource history
+ *
+ * \param[in] op  Operation result to copy
+ *
+ * \return Newly allocated copy (free with history_free_event())
+ * \note History never reports an operation's output, so it is not kept, and
+ *       the parameters are shared with any other history entry that has the
+ *       same ones.
+ */
+static lrmd_event_data_t *
+history_copy_event(lrmd_event_data_t *op)
+{
+    lrmd_event_data_t *copy = NULL;
+    GHashTable *params = op->params;
+    const char *output = op->output;
+
+    op->params = NULL;
+    op->output = NULL;
+    copy = lrmd_copy_event(op);
+    op->params = params;
+    op->output = output;
+
+    if (params != NULL) {
+        copy->params = history_params_ref(params, FALSE);
+    }
+    return copy;
+}
+
+static void
+history_free_event(lrmd_event_data_t *event)
+{
+    if (event != NULL) {
+        history_params_unref(event->params);
+        event->params = NULL;
+        lrmd_free_event(event);
+    }
+}
+
 /*!
  * \internal
  * \brief Remove a recurring operation from a resource's history
@@ -105,7 +269,7 @@ history_remove_recurring_op(rsc_history_t *history, const lrmd_event_data_t *op)
             && safe_str_eq(op->op_type, existing->op_type)) {
 
             history->recurring_op_list = g_list_delete_link(history->recurring_op_list, iter);
-            lrmd_free_event(existing);
+            history_free_event(existing);
             return TRUE;
         }
     }
@@ -124,7 +288,7 @@ history_free_recurring_ops(rsc_history_t *history)
     GList *iter;
 
     for (iter = history->recurring_op_list; iter != NULL; iter = iter->next) {
-        lrmd_free_event(iter->data);
+        history_free_event(iter->data);
     }
     g_list_free(history->recurring_op_list);
     history->recurring_op_list = NULL;
@@ -141,17 +305,14 @@ history_free(gpointer data)
 {
     rsc_history_t *history = (rsc_history_t*)data;
 
-    if (history->stop_params) {
-        g_hash_table_destroy(history->stop_params);
-    }
+    history_params_unref(history->stop_params);
 
-    /* Don't need to free history->rsc.id because it's set to history->id */
-    free(history->rsc.type);
-    free(history->rsc.standard);
-    free(history->rsc.provider);
+    /* Don't need to free history->rsc.id because it's set to history->id, and
+     * the agent strings are interned
+     */
 
-    lrmd_free_event(history->failed);
-    lrmd_free_event(history->last);
+    history_free_event(history->failed);
+    history_free_event(history->last);
     free(history->id);
     history_free_recurring_ops(history);
     free(history);
@@ -182,14 +343,11 @@ update_history_cache(lrm_state_t * lrm_state, lrmd_rsc_info_t * rsc, lrmd_event_
         entry->id = strdup(op->rsc_id);
         g_hash_table_insert(lrm_state->resource_history, entry->id, entry);
 
+        // Many resources share an agent, so intern its strings
         entry->rsc.id = entry->id;
-        entry->rsc.type = strdup(rsc->type);
-        entry->rsc.standard = strdup(rsc->standard);
-        if (rsc->provider) {
-            entry->rsc.provider = strdup(rsc->provider);
-        } else {
-            entry->rsc.provider = NULL;
-        }
+        entry->rsc.type = (char *) g_intern_string(rsc->type);
+        entry->rsc.standard = (char *) g_intern_string(rsc->standard);
+        entry->rsc.provider = (char *) g_intern_string(rsc->provider);
 
     } else if (entry == NULL) {
         crm_info("Resource %s no longer exists, not updating cache", op->rsc_id);
@@ -214,28 +372,20 @@ update_history_cache(lrm_state_t * lrm_state, lrmd_rsc_info_t * rsc, lrmd_event_
         /* Store failed monitors here, otherwise the block below will cause them
          * to be forgotten when a stop happens.
          */
-        if (entry->failed) {
-            lrmd_free_event(entry->failed);
-        }
-        entry->failed = lrmd_copy_event(op);
+        history_free_event(entry->failed);
+        entry->failed = history_copy_event(op);
 
     } else if (op->interval_ms == 0) {
-        if (entry->last) {
-            lrmd_free_event(entry->last);
-        }
-        entry->last = lrmd_copy_event(op);
+        history_free_event(entry->last);
+        entry->last = history_copy_event(op);
 
         if (op->params &&
             (safe_str_eq(CRMD_ACTION_START, op->op_type) ||
              safe_str_eq("reload", op->op_type) ||
              safe_str_eq(CRMD_ACTION_STATUS, op->op_type))) {
 
-            if (entry->stop_params) {
-                g_hash_table_destroy(entry->stop_params);
-            }
-            entry->stop_params = crm_str_table_new();
-
-            g_hash_table_foreach(op->params, copy_instance_keys, entry->stop_params);
+            history_params_unref(entry->stop_params);
+            entry->stop_params = history_params_ref(op->params, TRUE);
         }
     }
 
@@ -245,7 +395,8 @@ update_history_cache(lrm_state_t * lrm_state, lrmd_rsc_info_t * rsc, lrmd_event_
 
         crm_trace("Adding recurring op: " CRM_OP_FMT,
                   op->rsc_id, op->op_type, op->interval_ms);
-        entry->recurring_op_list = g_list_prepend(entry->recurring_op_list, lrmd_copy_event(op));
+        entry->recurring_op_list = g_list_prepend(entry->recurring_op_list,
+                                                  history_copy_event(op));
 
     } else if (entry->recurring_op_list && safe_str_eq(op->op_type, RSC_STATUS) == FALSE) {
         crm_trace("Dropping %d recurring ops because of: " CRM_OP_FMT,
@@ -1004,6 +1155,7 @@ erase_lrm_history_by_op(lrm_state_t *lrm_state, lrmd_event_data_t *op)
     crm_debug("Erasing resource operation history for " CRM_OP_FMT " (call=%d)",
               op->rsc_id, op->op_type, op->interval_ms, op->call_id);
 
+    controld_flush_rsc_updates(); // Don't let a batched result undo this
     fsa_cib_conn->cmds->remove(fsa_cib_conn, XML_CIB_TAG_STATUS, xml_top,
                                cib_quorum_override);
 
@@ -1065,6 +1217,7 @@ erase_lrm_history_by_id(lrm_state_t *lrm_state, const char *rsc_id,
 
     crm_debug("Erasing resource operation history for %s on %s (call=%d)",
               key, rsc_id, call_id);
+    controld_flush_rsc_updates(); // Don't let a batched result undo this
     fsa_cib_conn->cmds->remove(fsa_cib_conn, op_xpath, NULL,
                                cib_quorum_override | cib_xpath);
     free(op_xpath);
@@ -1124,7 +1277,7 @@ lrm_clear_last_failure(const char *rsc_id, const char *node_name,
                                                    rsc_id);
 
         if (last_failed_matches_op(entry, operation, interval_ms)) {
-            lrmd_free_event(entry->failed);
+            history_free_event(entry->failed);
             entry->failed = NULL;
         }
     }
@@ -2389,6 +2542,220 @@ should_preserve_lock(lrmd_event_data_t *op)
     return false;
 }
 
+/* Resource history updates collected for a single CIB write, when a batching
+ * window is configured
+ */
+static struct rsc_update_batch_s {
+    guint window_ms;        // How long to collect updates (0 to not batch)
+    xmlNode *status;        // Status section update being collected
+    GHashTable *resources;  // "<node-uuid> <rsc-id>" -> lrm_resource in status
+    int num_ops;            // Number of results collected
+    mainloop_timer_t *timer;
+} rsc_batch = { 0, NULL, NULL, 0, NULL };
+
+static gboolean
+rsc_update_batch_timeout(gpointer data)
+{
+    controld_flush_rsc_updates();
+    return FALSE;
+}
+
+/*!
+ * \internal
+ * \brief Set how long to collect resource history updates for one CIB write
+ *
+ * \param[in] value  Value of resource-update-window cluster option
+ */
+void
+controld_set_rsc_update_window(const char *value)
+{
+    guint window_ms = crm_parse_interval_spec(value);
+
+    if (window_ms != rsc_batch.window_ms) {
+        crm_info("Batching resource history updates for %ums", window_ms);
+        rsc_batch.window_ms = window_ms;
+        if (window_ms == 0) {
+            controld_flush_rsc_updates();
+        } else if (rsc_batch.timer != NULL) {
+            mainloop_timer_set_period(rsc_batch.timer, window_ms);
+        }
+    }
+}
+
+/*!
+ * \internal
+ * \brief Write any batched resource history updates to the CIB now
+ *
+ * \note This must be called before any other CIB request that depends on the
+ *       results being recorded, or that could be undone by them.
+ */
+void
+controld_flush_rsc_updates(void)
+{
+    int rc = pcmk_ok;
+
+    if (rsc_batch.status == NULL) {
+        return;
+    }
+    mainloop_timer_stop(rsc_batch.timer);
+
+    crm_log_xml_trace(rsc_batch.status, __FUNCTION__);
+    fsa_cib_update(XML_CIB_TAG_STATUS, rsc_batch.status, crmd_cib_smart_opt(),
+                   rc, NULL);
+    if (rc > 0) {
+        last_resource_update = rc;
+    }
+    crm_debug("Sent %d batched resource state update%s as CIB update %d",
+              rsc_batch.num_ops, pcmk__plural_s(rsc_batch.num_ops), rc);
+    fsa_register_cib_callback(rc, FALSE, NULL, cib_rsc_callback);
+
+    free_xml(rsc_batch.status);
+    rsc_batch.status = NULL;
+    g_hash_table_remove_all(rsc_batch.resources);
+    rsc_batch.num_ops = 0;
+}
+
+/*!
+ * \internal
+ * \brief Discard any batched resource history updates and free batch memory
+ */
+void
+controld_free_rsc_update_batch(void)
+{
+    if (rsc_batch.timer != NULL) {
+        mainloop_timer_del(rsc_batch.timer);
+        rsc_batch.timer = NULL;
+    }
+    if (rsc_batch.resources != NULL) {
+        g_hash_table_destroy(rsc_batch.resources);
+        rsc_batch.resources = NULL;
+    }
+    free_xml(rsc_batch.status);
+    rsc_batch.status = NULL;
+    rsc_batch.num_ops = 0;
+}
+
+// Get a node_state update's lrm_resources element
+static xmlNode *
+update_lrm_resources(xmlNode *node_state)
+{
+    return first_named_child(first_named_child(node_state, XML_CIB_TAG_LRM),
+                             XML_LRM_TAG_RESOURCES);
+}
+
+/*!
+ * \internal
+ * \brief Check whether an update would overwrite a batched operation result
+ *
+ * \param[in] batched  Batched lrm_resource update
+ * \param[in] xml_rsc  New lrm_resource update for same resource
+ *
+ * \return true if \p xml_rsc has an lrm_rsc_op with the same ID as a
+ *         completed (not pending) one in \p batched, otherwise false
+ */
+static bool
+overwrites_batched_result(xmlNode *batched, xmlNode *xml_rsc)
+{
+    for (xmlNode *xml_op = first_named_child(xml_rsc, XML_LRM_TAG_RSC_OP);
+         xml_op != NULL; xml_op = crm_next_same_xml(xml_op)) {
+
+        xmlNode *existing = find_entity(batched, XML_LRM_TAG_RSC_OP,
+                                        ID(xml_op));
+        int status = PCMK_LRM_OP_PENDING;
+
+        if (existing != NULL) {
+            crm_element_value_int(existing, XML_LRM_ATTR_OPSTATUS, &status);
+            if (status != PCMK_LRM_OP_PENDING) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/*!
+ * \internal
+ * \brief Add a resource history update to the current batch
+ *
+ * \param[in] update  Status section update for a single operation result
+ * \param[in] uuid    UUID of node that operation ran on
+ * \param[in] rsc_id  ID of resource that operation ran for
+ */
+static void
+batch_rsc_update(xmlNode *update, const char *uuid, const char *rsc_id)
+{
+    xmlNode *node_state = first_named_child(update, XML_CIB_TAG_STATE);
+    xmlNode *xml_rsc = first_named_child(update_lrm_resources(node_state),
+                                         XML_LRM_TAG_RESOURCE);
+    char *key = crm_strdup_printf("%s %s", uuid, rsc_id);
+    xmlNode *batched = NULL;
+
+    if (rsc_batch.status != NULL) {
+        batched = g_hash_table_lookup(rsc_batch.resources, key);
+    }
+
+    /* The transition engine learns of results only from CIB changes, so a
+     * result must reach the CIB before a later one for the same history entry
+     * replaces it.
+     */
+    if ((batched != NULL) && overwrites_batched_result(batched, xml_rsc)) {
+        controld_flush_rsc_updates();
+        batched = NULL;
+    }
+
+    if (rsc_batch.status == NULL) {
+        rsc_batch.status = create_xml_node(NULL, XML_CIB_TAG_STATUS);
+        if (rsc_batch.resources == NULL) {
+            rsc_batch.resources = g_hash_table_new_full(crm_str_hash,
+                                                        g_str_equal, free,
+                                                        NULL);
+        }
+        if (rsc_batch.timer == NULL) {
+            rsc_batch.timer = mainloop_timer_add("rsc_update_batch",
+                                                 rsc_batch.window_ms, FALSE,
+                                                 rsc_update_batch_timeout,
+                                                 NULL);
+        }
+        mainloop_timer_start(rsc_batch.timer);
+    }
+
+    if (batched == NULL) {
+        xmlNode *batched_node = find_entity(rsc_batch.status,
+                                            XML_CIB_TAG_STATE, uuid);
+
+        if (batched_node == NULL) {
+            batched_node = add_node_copy(rsc_batch.status, node_state);
+            batched = first_named_child(update_lrm_resources(batched_node),
+                                        XML_LRM_TAG_RESOURCE);
+        } else {
+            batched = add_node_copy(update_lrm_resources(batched_node),
+                                    xml_rsc);
+        }
+        g_hash_table_insert(rsc_batch.resources, key, batched);
+        key = NULL;
+
+    } else {
+        // Later values take precedence, as they would with separate updates
+        for (xmlAttrPtr xIter = xml_rsc->properties; xIter != NULL;
+             xIter = xIter->next) {
+            const char *name = (const char *) xIter->name;
+
+            crm_xml_add(batched, name, crm_element_value(xml_rsc, name));
+        }
+        for (xmlNode *xml_op = first_named_child(xml_rsc, XML_LRM_TAG_RSC_OP);
+             xml_op != NULL; xml_op = crm_next_same_xml(xml_op)) {
+
+            free_xml(find_entity(batched, XML_LRM_TAG_RSC_OP, ID(xml_op)));
+            add_node_copy(batched, xml_op);
+        }
+    }
+
+    rsc_batch.num_ops++;
+    crm_trace("Batched resource state update for %s (%d pending)",
+              rsc_id, rsc_batch.num_ops);
+    free(key);
+}
+
 static int
 do_update_resource(const char *node_name, lrmd_rsc_info_t *rsc,
                    lrmd_event_data_t *op, time_t lock_time)
@@ -2473,6 +2840,11 @@ do_update_resource(const char *node_name, lrmd_rsc_info_t *rsc,
 
     crm_log_xml_trace(update, __FUNCTION__);
 
+    if (rsc_batch.window_ms > 0) {
+        batch_rsc_update(update, uuid, op->rsc_id);
+        goto cleanup;
+    }
+
     /* make it an asynchronous call and be done with it
      *
      * Best case:
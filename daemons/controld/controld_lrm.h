@@ -17,6 +17,9 @@ void lrm_clear_last_failure(const char *rsc_id, const char *node_name,
                             const char *operation, guint interval_ms);
 void lrm_op_callback(lrmd_event_data_t * op);
 lrmd_t *crmd_local_lrmd_conn(void);
+void controld_set_rsc_update_window(const char *value);
+void controld_flush_rsc_updates(void);
+void controld_free_rsc_update_batch(void);
 
 typedef struct resource_history_s {
     char *id;
@@ -1068,6 +1068,10 @@ handle_response(xmlNode *stored_msg)
         if (msg_ref == NULL) {
             crm_err("%s - Ignoring calculation with no reference", op);
 
+        } else if (crm_is_true(crm_element_value(stored_msg,
+                                                 F_CRM_TGRAPH_RESEND))) {
+            controld_sched_resend(msg_ref);
+
         } else if (safe_str_eq(msg_ref, fsa_pe_ref)) {
             ha_msg_input_t fsa_input;
 
@@ -1075,6 +1079,9 @@ handle_response(xmlNode *stored_msg)
             fsa_input.msg = stored_msg;
             register_fsa_input_later(C_IPC_MESSAGE, I_PE_SUCCESS, &fsa_input);
 
+        } else if (controld_sched_save_speculative(msg_ref, stored_msg)) {
+            crm_trace("%s calculation %s is speculative", op, msg_ref);
+
         } else {
             crm_info("%s calculation %s is obsolete", op, msg_ref);
         }
@@ -21,6 +21,239 @@
 
 static mainloop_io_t *pe_subsystem = NULL;
 
+/* While DC, the controller keeps its own copy of the CIB, kept current by
+ * applying the diffs that te_update_diff() receives, so that the scheduler can
+ * be invoked without first querying the CIB manager.
+ *
+ * When a transition is aborted, a speculative scheduler request is sent right
+ * away from the copy, so the calculation can proceed while in-flight actions
+ * complete. When the FSA later invokes the scheduler, the speculative result
+ * is used if the scheduler input has not changed in the meantime, and is
+ * otherwise discarded.
+ *
+ * Since each calculation also saves a scheduler input file, at most one
+ * speculative request is outstanding at any time, and new ones are sent no
+ * more often than every SCHED_SPECULATE_INTERVAL_S seconds. Aborts that arrive
+ * while a request is outstanding are coalesced into a single new request once
+ * its reply arrives.
+ */
+static xmlNode *sched_cib = NULL;
+
+static struct speculation_s {
+    char *ref;          // Reference of speculative scheduler request
+    char *input_key;    // Identifies scheduler input the request was sent with
+    xmlNode *reply;     // Scheduler reply, if received before it was wanted
+    time_t sent;        // When last speculative request was sent
+    bool again;         // Whether input changed while request was outstanding
+} speculation = { NULL, NULL, NULL, 0, false };
+
+// Minimum time between speculative scheduler requests
+#define SCHED_SPECULATE_INTERVAL_S 5
+
+/* The scheduler keeps the last input it was sent by the controller, so after
+ * the first request, only a patchset from the previous input is sent, along
+ * with the reference of the request it applies to. If the scheduler can't use
+ * the patchset, it asks for the full input instead.
+ *
+ * The patchset is built by applying the CIB diffs that the controller's CIB
+ * copy received since the previous input to that input, with change tracking
+ * enabled, rather than by comparing the whole CIB. If the diffs can't be used
+ * (for example, because the copy was replaced by a query result since), the
+ * full input is sent.
+ */
+static struct sched_base_s {
+    char *ref;          // Reference of last request sent to scheduler
+    xmlNode *input;     // Full input of that request
+    GList *diffs;       // CIB diffs applied to sched_cib since (newest first)
+    int num_diffs;      // Number of entries in diffs
+    bool diffs_valid;   // Whether diffs lead from input to sched_cib
+} sched_base = { NULL, NULL, NULL, 0, false };
+
+// How often to include a digest in input patchsets, to validate them
+#define SCHED_DIGEST_INTERVAL_S 60
+
+// Send the full input rather than keep more CIB diffs than this
+#define SCHED_MAX_DIFFS 100
+
+static void
+forget_sched_diffs(void)
+{
+    g_list_free_full(sched_base.diffs, (GDestroyNotify) free_xml);
+    sched_base.diffs = NULL;
+    sched_base.num_diffs = 0;
+    sched_base.diffs_valid = false;
+}
+
+static void
+forget_sched_base(void)
+{
+    free(sched_base.ref);
+    sched_base.ref = NULL;
+    free_xml(sched_base.input);
+    sched_base.input = NULL;
+    forget_sched_diffs();
+}
+
+/*!
+ * \internal
+ * \brief Remember a CIB diff applied to sched_cib, to patch the scheduler input
+ *
+ * \param[in] diff  CIB diff just applied to sched_cib
+ */
+static void
+keep_sched_diff(xmlNode *diff)
+{
+    int format = 1;
+
+    if (!sched_base.diffs_valid) {
+        return;
+    }
+
+    /* Only v2 patchsets can be applied with change tracking, and moves aren't
+     * tracked
+     */
+    crm_element_value_int(diff, "format", &format);
+    if ((format != 2) || (sched_base.num_diffs >= SCHED_MAX_DIFFS)) {
+        forget_sched_diffs();
+        return;
+    }
+    for (xmlNode *change = __xml_first_child_element(diff); change != NULL;
+         change = __xml_next_element(change)) {
+        if (safe_str_eq(crm_element_value(change, XML_DIFF_OP), "move")) {
+            forget_sched_diffs();
+            return;
+        }
+    }
+
+    sched_base.diffs = g_list_prepend(sched_base.diffs, copy_xml(diff));
+    sched_base.num_diffs++;
+}
+
+static void
+clear_speculation(void)
+{
+    free(speculation.ref);
+    speculation.ref = NULL;
+    free(speculation.input_key);
+    speculation.input_key = NULL;
+    free_xml(speculation.reply);
+    speculation.reply = NULL;
+    speculation.again = false;
+}
+
+/*!
+ * \internal
+ * \brief Discard the controller's CIB copy and any speculative calculation
+ */
+void
+controld_free_sched_cib(void)
+{
+    if (sched_cib != NULL) {
+        crm_trace("Discarding scheduler's copy of the CIB");
+        free_xml(sched_cib);
+        sched_cib = NULL;
+    }
+    forget_sched_diffs();
+    clear_speculation();
+}
+
+/*!
+ * \internal
+ * \brief Compare the version of a CIB with that of the controller's CIB copy
+ *
+ * \param[in] cib  CIB to check (sched_cib must not be NULL)
+ *
+ * \return Negative, zero, or positive if \p cib is older than, the same
+ *         version as, or newer than the copy
+ */
+static int
+compare_to_sched_cib(xmlNode *cib)
+{
+    int have[] = { 0, 0, 0 };
+    int other[] = { 0, 0, 0 };
+
+    crm_element_value_int(sched_cib, XML_ATTR_GENERATION_ADMIN, &have[0]);
+    crm_element_value_int(sched_cib, XML_ATTR_GENERATION, &have[1]);
+    crm_element_value_int(sched_cib, XML_ATTR_NUMUPDATES, &have[2]);
+    crm_element_value_int(cib, XML_ATTR_GENERATION_ADMIN, &other[0]);
+    crm_element_value_int(cib, XML_ATTR_GENERATION, &other[1]);
+    crm_element_value_int(cib, XML_ATTR_NUMUPDATES, &other[2]);
+    for (int lpc = 0; lpc < DIMOF(have); lpc++) {
+        if (other[lpc] != have[lpc]) {
+            return (other[lpc] > have[lpc])? 1 : -1;
+        }
+    }
+    return 0;
+}
+
+/*!
+ * \internal
+ * \brief Check whether a CIB is newer than the controller's CIB copy
+ *
+ * \param[in] cib  CIB to check
+ *
+ * \return true if there is no copy or \p cib has a higher version than it,
+ *         otherwise false
+ */
+static bool
+newer_than_sched_cib(xmlNode *cib)
+{
+    return (sched_cib == NULL) || (compare_to_sched_cib(cib) > 0);
+}
+
+/*!
+ * \internal
+ * \brief Apply a CIB diff to the controller's CIB copy (if any)
+ *
+ * \param[in] diff  CIB diff from a CIB manager notification
+ */
+void
+controld_update_sched_cib(xmlNode *diff)
+{
+    int rc = pcmk_ok;
+    int add[] = { 0, 0, 0 };
+    int del[] = { 0, 0, 0 };
+    int have[] = { 0, 0, 0 };
+
+    if ((sched_cib == NULL) || (diff == NULL)) {
+        return;
+    }
+    if (AM_I_DC == FALSE) {
+        controld_free_sched_cib();
+        return;
+    }
+
+    /* The copy may have been taken from a query result that already included
+     * this change
+     */
+    xml_patch_versions(diff, add, del);
+    crm_element_value_int(sched_cib, XML_ATTR_GENERATION_ADMIN, &have[0]);
+    crm_element_value_int(sched_cib, XML_ATTR_GENERATION, &have[1]);
+    crm_element_value_int(sched_cib, XML_ATTR_NUMUPDATES, &have[2]);
+    for (int lpc = 0; lpc < DIMOF(have); lpc++) {
+        if (add[lpc] != have[lpc]) {
+            if (add[lpc] < have[lpc]) {
+                crm_trace("Scheduler's copy of the CIB already has %d.%d.%d",
+                          add[0], add[1], add[2]);
+                forget_sched_diffs();
+                return;
+            }
+            break;
+        }
+    }
+
+    rc = xml_apply_patchset(sched_cib, diff, TRUE);
+    if (rc != pcmk_ok) {
+        crm_debug("Discarding scheduler's copy of the CIB: Could not apply "
+                  "%d.%d.%d -> %d.%d.%d: %s " CRM_XS " rc=%d",
+                  del[0], del[1], del[2], add[0], add[1], add[2],
+                  pcmk_strerror(rc), rc);
+        controld_free_sched_cib();
+        return;
+    }
+    keep_sched_diff(diff);
+}
+
 /*!
  * \internal
  * \brief Close any scheduler connection and free associated memory
@@ -29,6 +262,8 @@ void
 pe_subsystem_free(void)
 {
     clear_bit(fsa_input_register, R_PE_REQUIRED);
+    controld_free_sched_cib();
+    forget_sched_base();
     if (pe_subsystem) {
         controld_expect_sched_reply(NULL);
         mainloop_del_ipc_client(pe_subsystem);
@@ -83,6 +318,8 @@ pe_ipc_destroy(gpointer user_data)
 {
     // If we aren't connected to the scheduler, we can't expect a reply
     controld_expect_sched_reply(NULL);
+    clear_speculation();
+    forget_sched_base();
 
     if (is_set(fsa_input_register, R_PE_REQUIRED)) {
         int rc = pcmk_ok;
@@ -189,6 +426,8 @@ pe_subsystem_send(xmlNode *cmd)
 
 static void do_pe_invoke_callback(xmlNode *msg, int call_id, int rc,
                                   xmlNode *output, void *user_data);
+static bool invoke_from_copy(void);
+static xmlNode *send_sched_request(xmlNode *cib, pid_t watchdog);
 
 /*	 A_PE_START, A_PE_STOP, O_PE_RESTART	*/
 void
@@ -259,17 +498,13 @@ controld_stop_sched_timer()
  * \internal
  * \brief Set the scheduler request currently being waited on
  *
- * \param[in] msg  Request to expect reply to (or NULL for none)
+ * \param[in] ref  Reference of request to expect reply to, or NULL for none
+ *                 (this function takes ownership)
  */
-void
-controld_expect_sched_reply(xmlNode *msg)
+static void
+expect_sched_ref(char *ref)
 {
-    char *ref = NULL;
-
-    if (msg) {
-        ref = crm_element_value_copy(msg, XML_ATTR_REFERENCE);
-        CRM_ASSERT(ref != NULL);
-
+    if (ref) {
         if (controld_sched_timer == NULL) {
             controld_sched_timer = mainloop_timer_add("scheduler_reply_timer",
                                                       SCHED_TIMEOUT_MS, FALSE,
@@ -284,6 +519,24 @@ controld_expect_sched_reply(xmlNode *msg)
     fsa_pe_ref = ref;
 }
 
+/*!
+ * \internal
+ * \brief Set the scheduler request currently being waited on
+ *
+ * \param[in] msg  Request to expect reply to (or NULL for none)
+ */
+void
+controld_expect_sched_reply(xmlNode *msg)
+{
+    char *ref = NULL;
+
+    if (msg) {
+        ref = crm_element_value_copy(msg, XML_ATTR_REFERENCE);
+        CRM_ASSERT(ref != NULL);
+    }
+    expect_sched_ref(ref);
+}
+
 /*!
  * \internal
  * \brief Free the scheduler reply timer
@@ -336,6 +589,10 @@ do_pe_invoke(long long action,
         return;
     }
 
+    if (invoke_from_copy()) {
+        return;
+    }
+
     fsa_pe_query = fsa_cib_conn->cmds->query(fsa_cib_conn, NULL, NULL, cib_scope_local);
 
     crm_debug("Query %d: Requesting the current CIB: %s", fsa_pe_query,
@@ -439,30 +696,455 @@ do_pe_invoke_callback(xmlNode * msg, int call_id, int rc, xmlNode * output, void
 
     CRM_LOG_ASSERT(output != NULL);
 
+    /* Seed the controller's own CIB copy, to be kept current by diffs. Diffs
+     * that arrived while the query was outstanding may already have brought
+     * the copy past the query result.
+     */
+    if (newer_than_sched_cib(output)) {
+        free_xml(sched_cib);
+        sched_cib = copy_xml(output);
+        forget_sched_diffs();
+    }
+    clear_speculation();
+
+    cmd = send_sched_request(copy_xml(output), watchdog);
+    if (cmd != NULL) {
+        controld_expect_sched_reply(cmd);
+        crm_debug("Invoking the scheduler: query=%d, ref=%s, seq=%llu, quorate=%d",
+                  fsa_pe_query, fsa_pe_ref, crm_peer_seq, fsa_has_quorum);
+        free_xml(cmd);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Identify the scheduler input that a CIB would result in
+ *
+ * \param[in] cib       CIB (without DC-specific values added)
+ * \param[in] watchdog  Result of pcmk_locate_sbd()
+ *
+ * \return Newly allocated string that differs if the scheduler input would
+ */
+static char *
+sched_input_key(xmlNode *cib, pid_t watchdog)
+{
+    return crm_strdup_printf("%s.%s.%s quorate=%d panic=%d watchdog=%d",
+                             crm_element_value(cib, XML_ATTR_GENERATION_ADMIN),
+                             crm_element_value(cib, XML_ATTR_GENERATION),
+                             crm_element_value(cib, XML_ATTR_NUMUPDATES),
+                             fsa_has_quorum,
+                             (ever_had_quorum && !crm_have_quorum),
+                             (watchdog != 0));
+}
+
+/*!
+ * \internal
+ * \brief Add values known only to the DC to a scheduler input
+ *
+ * \param[in,out] cib       Scheduler input
+ * \param[in]     watchdog  Result of pcmk_locate_sbd()
+ */
+static void
+add_dc_values(xmlNode *cib, pid_t watchdog)
+{
+    crm_xml_add(cib, XML_ATTR_DC_UUID, fsa_our_uuid);
+    crm_xml_add_int(cib, XML_ATTR_HAVE_QUORUM, fsa_has_quorum);
+
+    force_local_option(cib, XML_ATTR_HAVE_WATCHDOG, watchdog?"true":"false");
+
+    if (ever_had_quorum && crm_have_quorum == FALSE) {
+        crm_xml_add_int(cib, XML_ATTR_QUORUM_PANIC, 1);
+
+    } else if (crm_element_value(cib, XML_ATTR_QUORUM_PANIC) != NULL) {
+        // A patched previous input may still have it
+        xml_remove_prop(cib, XML_ATTR_QUORUM_PANIC);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Create a v2 patchset that changes nothing
+ *
+ * \param[in] cib  CIB with version to use as both source and target
+ *
+ * \return Newly allocated patchset
+ */
+static xmlNode *
+empty_patchset(xmlNode *cib)
+{
+    const char *vfields[] = {
+        XML_ATTR_GENERATION_ADMIN,
+        XML_ATTR_GENERATION,
+        XML_ATTR_NUMUPDATES,
+    };
+    xmlNode *patchset = create_xml_node(NULL, XML_TAG_DIFF);
+    xmlNode *version = create_xml_node(patchset, XML_DIFF_VERSION);
+    xmlNode *source = create_xml_node(version, XML_DIFF_VSOURCE);
+    xmlNode *target = create_xml_node(version, XML_DIFF_VTARGET);
+
+    crm_xml_add_int(patchset, "format", 2);
+    for (int lpc = 0; lpc < DIMOF(vfields); lpc++) {
+        crm_xml_add(source, vfields[lpc], crm_element_value(cib, vfields[lpc]));
+        crm_xml_add(target, vfields[lpc], crm_element_value(cib, vfields[lpc]));
+    }
+    return patchset;
+}
+
+/*!
+ * \internal
+ * \brief Bring the last scheduler input up to date, and get the changes
+ *
+ * Apply the CIB diffs received since the last input was sent to it, along
+ * with the current DC-specific values, tracking the changes made.
+ *
+ * \param[in] watchdog  Result of pcmk_locate_sbd()
+ *
+ * \return Newly allocated patchset from the last input to the updated one
+ *         (which is left in sched_base.input), or NULL if the full input must
+ *         be sent (in which case sched_base has been forgotten)
+ */
+static xmlNode *
+sched_input_patchset(pid_t watchdog)
+{
+    static time_t next_digest = 0;
+
+    int rc = pcmk_ok;
+    time_t now = time(NULL);
+    xmlNode *source = NULL;
+    xmlNode *patchset = NULL;
+    xmlNode *input = sched_base.input;
+    const char *vfields[] = {
+        XML_ATTR_GENERATION_ADMIN,
+        XML_ATTR_GENERATION,
+        XML_ATTR_NUMUPDATES,
+        XML_ATTR_CRM_VERSION,
+    };
+
+    if ((input == NULL) || !sched_base.diffs_valid || (sched_cib == NULL)) {
+        forget_sched_base();
+        return NULL;
+    }
+
+    // The patchset needs the version being patched from
+    source = create_xml_node(NULL, XML_TAG_CIB);
+    for (int lpc = 0; lpc < DIMOF(vfields); lpc++) {
+        crm_xml_add(source, vfields[lpc], crm_element_value(input, vfields[lpc]));
+    }
+
+    xml_track_changes(input, NULL, NULL, FALSE);
+    sched_base.diffs = g_list_reverse(sched_base.diffs);
+    for (GList *iter = sched_base.diffs; (iter != NULL) && (rc == pcmk_ok);
+         iter = iter->next) {
+        rc = xml_apply_patchset(input, iter->data, TRUE);
+    }
+    if ((rc != pcmk_ok) || (compare_to_sched_cib(input) != 0)) {
+        crm_debug("Sending full scheduler input: Could not apply %d CIB "
+                  "diff%s to previous input: %s " CRM_XS " rc=%d",
+                  sched_base.num_diffs, pcmk__plural_s(sched_base.num_diffs),
+                  pcmk_strerror(rc), rc);
+        free_xml(source);
+        forget_sched_base();
+        return NULL;
+    }
+    add_dc_values(input, watchdog);
+
+    patchset = xml_create_patchset(2, source, input, NULL, FALSE);
+    xml_accept_changes(input);
+    if (patchset == NULL) {
+        // Nothing changed, but the scheduler still needs a (new) request
+        patchset = empty_patchset(input);
+    }
+
+    // Like the CIB manager, validate patchsets at most once a minute
+    if (now >= next_digest) {
+        next_digest = now + SCHED_DIGEST_INTERVAL_S;
+        patchset_process_digest(patchset, source, input, TRUE);
+    }
+    free_xml(source);
+    return patchset;
+}
+
+/*!
+ * \internal
+ * \brief Ask for the transition graph format configured for this node
+ *
+ * \param[in,out] cmd  Scheduler calculation request
+ */
+static void
+request_graph_format(xmlNode *cmd)
+{
+    const char *format = pcmk__env_option("graph_format");
+
+    if (safe_str_eq(format, "compact")) {
+        crm_xml_add(cmd, F_CRM_TGRAPH_FORMAT, format);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Send a calculation request to the scheduler
+ *
+ * \param[in] cib       CIB to calculate from (this function takes ownership,
+ *                      and DC-specific values will be added to it)
+ * \param[in] watchdog  Result of pcmk_locate_sbd()
+ *
+ * \return Newly allocated copy of request sent, or NULL on error
+ */
+static xmlNode *
+send_sched_request(xmlNode *cib, pid_t watchdog)
+{
+    int rc = pcmk_ok;
+    bool diffs_valid = false;
+    xmlNode *cmd = NULL;
+    xmlNode *patchset = NULL;
+
     /* Refresh the remote node cache and the known node cache when the
      * scheduler is invoked */
-    crm_peer_caches_refresh(output);
+    crm_peer_caches_refresh(cib);
+
+    // Whether CIB diffs received from now on will lead from this input
+    diffs_valid = (sched_cib != NULL) && (compare_to_sched_cib(cib) == 0);
+
+    /* If the input is the current CIB copy, the last input patched with the
+     * diffs since is the same, so use that instead
+     */
+    patchset = diffs_valid? sched_input_patchset(watchdog) : NULL;
+    if (patchset != NULL) {
+        free_xml(cib);
+        cib = sched_base.input;
+        sched_base.input = NULL;
+        cmd = create_request(CRM_OP_PECALC, patchset, NULL, CRM_SYSTEM_PENGINE,
+                             CRM_SYSTEM_DC, NULL);
+        crm_xml_add(cmd, F_CRM_TGRAPH_BASE, sched_base.ref);
+        free_xml(patchset);
+    } else {
+        add_dc_values(cib, watchdog);
+        cmd = create_request(CRM_OP_PECALC, cib, NULL, CRM_SYSTEM_PENGINE,
+                             CRM_SYSTEM_DC, NULL);
+    }
+    request_graph_format(cmd);
 
-    crm_xml_add(output, XML_ATTR_DC_UUID, fsa_our_uuid);
-    crm_xml_add_int(output, XML_ATTR_HAVE_QUORUM, fsa_has_quorum);
+    rc = pe_subsystem_send(cmd);
+    if (rc < 0) {
+        crm_err("Could not contact the scheduler: %s " CRM_XS " rc=%d",
+                pcmk_strerror(rc), rc);
+        register_fsa_error_adv(C_FSA_INTERNAL, I_ERROR, NULL, NULL, __FUNCTION__);
+        forget_sched_base();
+        free_xml(cib);
+        free_xml(cmd);
+        return NULL;
+    }
 
-    force_local_option(output, XML_ATTR_HAVE_WATCHDOG, watchdog?"true":"false");
+    crm_trace("Sent scheduler input %s as %s",
+              crm_element_value(cmd, XML_ATTR_REFERENCE),
+              ((patchset == NULL)? "full CIB" : "patchset"));
+    forget_sched_base();
+    sched_base.ref = crm_element_value_copy(cmd, XML_ATTR_REFERENCE);
+    sched_base.input = cib;
+    sched_base.diffs_valid = diffs_valid;
+    return cmd;
+}
 
-    if (ever_had_quorum && crm_have_quorum == FALSE) {
-        crm_xml_add_int(output, XML_ATTR_QUORUM_PANIC, 1);
+/*!
+ * \internal
+ * \brief Resend the full input of a request the scheduler couldn't use
+ *
+ * \param[in] ref  Reference of request that scheduler asked to be resent
+ */
+void
+controld_sched_resend(const char *ref)
+{
+    int rc = pcmk_ok;
+    xmlNode *cmd = NULL;
+
+    if ((ref == NULL) || safe_str_neq(ref, sched_base.ref)) {
+        // A later request was already sent, which will be resent if needed
+        crm_debug("Not resending superseded scheduler input %s", crm_str(ref));
+        return;
     }
 
-    cmd = create_request(CRM_OP_PECALC, output, NULL, CRM_SYSTEM_PENGINE, CRM_SYSTEM_DC, NULL);
+    if (safe_str_neq(ref, fsa_pe_ref) && safe_str_neq(ref, speculation.ref)) {
+        crm_debug("Not resending obsolete scheduler input %s", ref);
+        forget_sched_base(); // The scheduler no longer has it
+        return;
+    }
+
+    crm_info("Resending full scheduler input %s", ref);
+    cmd = create_request(CRM_OP_PECALC, sched_base.input, NULL,
+                         CRM_SYSTEM_PENGINE, CRM_SYSTEM_DC, NULL);
+    crm_xml_add(cmd, XML_ATTR_REFERENCE, ref);
+    request_graph_format(cmd);
 
     rc = pe_subsystem_send(cmd);
     if (rc < 0) {
         crm_err("Could not contact the scheduler: %s " CRM_XS " rc=%d",
                 pcmk_strerror(rc), rc);
         register_fsa_error_adv(C_FSA_INTERNAL, I_ERROR, NULL, NULL, __FUNCTION__);
-    } else {
+        forget_sched_base();
+    }
+    free_xml(cmd);
+}
+
+/*!
+ * \internal
+ * \brief Whether the controller's CIB copy can be used as scheduler input
+ *
+ * \return true if CIB copy is available and no CIB updates are pending
+ */
+static bool
+sched_cib_usable(void)
+{
+    return (sched_cib != NULL) && AM_I_DC
+           && is_set(fsa_input_register, R_PE_CONNECTED)
+           && (num_cib_op_callbacks() == 0);
+}
+
+/*!
+ * \internal
+ * \brief Invoke the scheduler using the controller's CIB copy, if possible
+ *
+ * If a speculative calculation was started from the same input, use that,
+ * otherwise send a new request.
+ *
+ * \return true if the scheduler was invoked, otherwise false (in which case
+ *         the caller should query the CIB)
+ */
+static bool
+invoke_from_copy(void)
+{
+    pid_t watchdog = 0;
+    char *key = NULL;
+    xmlNode *cmd = NULL;
+
+    if (!sched_cib_usable()) {
+        return false;
+    }
+
+    // Ignore the result of any CIB query still outstanding
+    fsa_pe_query = 0;
+
+    watchdog = pcmk_locate_sbd();
+    key = sched_input_key(sched_cib, watchdog);
+
+    if ((speculation.ref != NULL) && safe_str_eq(key, speculation.input_key)) {
+        crm_debug("Using speculative scheduler calculation %s (%s) for %s",
+                  speculation.ref,
+                  ((speculation.reply == NULL)? "pending" : "complete"), key);
+        expect_sched_ref(speculation.ref);
+        speculation.ref = NULL;
+
+        if (speculation.reply != NULL) {
+            ha_msg_input_t fsa_input;
+
+            controld_stop_sched_timer();
+            fsa_input.msg = speculation.reply;
+            register_fsa_input_later(C_IPC_MESSAGE, I_PE_SUCCESS, &fsa_input);
+        }
+        clear_speculation();
+        free(key);
+        return true;
+    }
+
+    clear_speculation();
+    free(key);
+
+    cmd = send_sched_request(copy_xml(sched_cib), watchdog);
+    if (cmd != NULL) {
         controld_expect_sched_reply(cmd);
-        crm_debug("Invoking the scheduler: query=%d, ref=%s, seq=%llu, quorate=%d",
-                  fsa_pe_query, fsa_pe_ref, crm_peer_seq, fsa_has_quorum);
+        crm_debug("Invoking the scheduler from the controller's CIB copy: "
+                  "ref=%s, seq=%llu, quorate=%d",
+                  fsa_pe_ref, crm_peer_seq, fsa_has_quorum);
+        free_xml(cmd);
     }
+    return true;
+}
+
+/*!
+ * \internal
+ * \brief Start a scheduler calculation before the FSA asks for one
+ *
+ * This is intended to be called when a transition is aborted, so that the
+ * scheduler can work while in-flight actions complete. The result will be
+ * used only if the scheduler input has not changed by the time the FSA
+ * invokes the scheduler.
+ */
+void
+controld_sched_speculate(void)
+{
+    pid_t watchdog = 0;
+    char *key = NULL;
+    xmlNode *cmd = NULL;
+    time_t now = time(NULL);
+
+    if (!sched_cib_usable()) {
+        return;
+    }
+
+    watchdog = pcmk_locate_sbd();
+    key = sched_input_key(sched_cib, watchdog);
+    if (safe_str_eq(key, speculation.input_key)) {
+        crm_trace("Speculative scheduler calculation %s already covers %s",
+                  speculation.ref, key);
+        free(key);
+        return;
+    }
+
+    if ((speculation.ref != NULL) && (speculation.reply == NULL)) {
+        crm_trace("Deferring speculative scheduler calculation for %s "
+                  "until %s completes", key, speculation.ref);
+        speculation.again = true;
+        free(key);
+        return;
+    }
+
+    if ((speculation.sent > 0) && (now >= speculation.sent)
+        && ((now - speculation.sent) < SCHED_SPECULATE_INTERVAL_S)) {
+        crm_trace("Not speculatively invoking the scheduler for %s: "
+                  "last request was sent only %llds ago",
+                  key, (long long) (now - speculation.sent));
+        free(key);
+        return;
+    }
+
+    clear_speculation();
+    cmd = send_sched_request(copy_xml(sched_cib), watchdog);
+    if (cmd == NULL) {
+        free(key);
+        return;
+    }
+
+    speculation.ref = crm_element_value_copy(cmd, XML_ATTR_REFERENCE);
+    speculation.input_key = key;
+    speculation.sent = now;
+    crm_debug("Speculatively invoking the scheduler: ref=%s, input=%s",
+              speculation.ref, key);
     free_xml(cmd);
 }
+
+/*!
+ * \internal
+ * \brief Save a scheduler reply if it is for the speculative request
+ *
+ * \param[in] ref    Reference of reply
+ * \param[in] reply  Scheduler reply
+ *
+ * \return true if reply was saved, otherwise false
+ */
+bool
+controld_sched_save_speculative(const char *ref, xmlNode *reply)
+{
+    if ((speculation.ref == NULL) || safe_str_neq(ref, speculation.ref)) {
+        return false;
+    }
+    crm_debug("Saving speculative scheduler result %s until it is wanted",
+              ref);
+    free_xml(speculation.reply);
+    speculation.reply = copy_xml(reply);
+
+    // Follow up with one request covering any aborts received in the meantime
+    if (speculation.again) {
+        speculation.again = false;
+        controld_sched_speculate();
+    }
+    return true;
+}
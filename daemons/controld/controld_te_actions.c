@@ -10,6 +10,7 @@
 #include <crm_internal.h>
 
 #include <sys/param.h>
+#include <limits.h>
 #include <crm/crm.h>
 #include <crm/cib.h>
 #include <crm/lrmd.h>               // lrmd_event_data_t, lrmd_free_event()
@@ -24,6 +25,13 @@ char *te_uuid = NULL;
 GHashTable *te_targets = NULL;
 void send_rsc_command(crm_action_t * action);
 static void te_update_job_count(crm_action_t * action, int offset);
+static void te_action_dispatched(crm_action_t *action);
+
+// Agent "class" or "class:provider" -> maximum jobs per node (as pointer)
+static GHashTable *class_limits = NULL;
+
+#define TE_LIMIT_NODE       "node-action-limit"
+#define TE_LIMIT_MIGRATION  "migration-limit"
 
 static void
 te_start_action_timer(crm_graph_t * graph, crm_action_t * action)
@@ -319,6 +327,7 @@ te_rsc_command(crm_graph_t * graph, crm_action_t * action)
     crm_notice("Initiating %s operation %s%s on %s%s "CRM_XS" action %d",
                task, task_uuid, (is_local? " locally" : ""), on_node,
                (no_wait? " without waiting" : ""), action->id);
+    te_action_dispatched(action);
 
     cmd = create_request(CRM_OP_INVOKE_LRM, rsc_op, router_node,
                          CRM_SYSTEM_LRMD, CRM_SYSTEM_TENGINE, NULL);
@@ -384,16 +393,280 @@ struct te_peer_s
         char *name;
         int jobs;
         int migrate_jobs;
+        GHashTable *class_jobs; // Limit key -> jobs of that class (as pointer)
+};
+
+// Time that actions spent deferred by one job limit in the current transition
+struct te_wait_s
+{
+        unsigned int actions;
+        gint64 total_us;
+        gint64 max_us;
+};
+
+// Deferred action ID -> struct te_deferral_s
+static GHashTable *te_deferrals = NULL;
+
+// Limit name -> struct te_wait_s
+static GHashTable *te_waits = NULL;
+
+/* Dispatched action ID -> class limit key it was counted against, so that it
+ * is uncounted from the same class even if node-action-class-limits changes
+ * while it is in flight
+ */
+static GHashTable *te_job_classes = NULL;
+
+struct te_deferral_s
+{
+        gint64 since_us;
+        char *limit;
 };
 
 static void te_peer_free(gpointer p)
 {
     struct te_peer_s *peer = p;
 
+    if (peer->class_jobs != NULL) {
+        g_hash_table_destroy(peer->class_jobs);
+    }
     free(peer->name);
     free(peer);
 }
 
+static void
+te_deferral_free(gpointer p)
+{
+    struct te_deferral_s *deferral = p;
+
+    free(deferral->limit);
+    free(deferral);
+}
+
+static struct te_peer_s *
+te_peer_get(const char *target)
+{
+    struct te_peer_s *r = g_hash_table_lookup(te_targets, target);
+
+    if(r == NULL) {
+        r = calloc(1, sizeof(struct te_peer_s));
+        r->name = strdup(target);
+        g_hash_table_insert(te_targets, r->name, r);
+    }
+    return r;
+}
+
+/*!
+ * \internal
+ * \brief Set per-node job limits for particular resource agent classes
+ *
+ * \param[in] value  Value of node-action-class-limits cluster option: a
+ *                   comma-separated list of CLASS=LIMIT or
+ *                   CLASS:PROVIDER=LIMIT
+ */
+void
+te_set_class_limits(const char *value)
+{
+    char **entries = NULL;
+
+    if (class_limits != NULL) {
+        g_hash_table_destroy(class_limits);
+        class_limits = NULL;
+    }
+    if (value == NULL) {
+        return;
+    }
+
+    entries = g_strsplit_set(value, ", ", 0);
+    for (int lpc = 0; entries[lpc] != NULL; lpc++) {
+        char *equals = strchr(entries[lpc], '=');
+        long long limit = -1;
+
+        if (entries[lpc][0] == '\0') {
+            continue;
+        }
+        if ((equals != NULL) && (equals != entries[lpc])) {
+            *equals = '\0';
+            limit = crm_parse_ll(equals + 1, NULL);
+        }
+        if ((limit <= 0) || (limit > INT_MAX)) {
+            crm_warn("Ignoring invalid entry '%s%s%s' in node-action-class-limits",
+                     entries[lpc], ((equals == NULL)? "" : "="),
+                     ((equals == NULL)? "" : equals + 1));
+            continue;
+        }
+        if (class_limits == NULL) {
+            class_limits = g_hash_table_new_full(crm_str_hash, g_str_equal,
+                                                 free, NULL);
+        }
+        crm_debug("Limiting %s actions to %lld per node", entries[lpc], limit);
+        g_hash_table_replace(class_limits, strdup(entries[lpc]),
+                             GINT_TO_POINTER((int) limit));
+    }
+    g_strfreev(entries);
+}
+
+/*!
+ * \internal
+ * \brief Find the agent class job limit (if any) that applies to an action
+ *
+ * \param[in]  action  Resource action to check
+ * \param[out] limit   If not NULL, where to store the configured limit
+ *
+ * \return Key of applicable limit (the more specific CLASS:PROVIDER if both
+ *         are configured), or NULL if the action is subject to the node limit
+ */
+static const char *
+te_action_class_limit(crm_action_t *action, int *limit)
+{
+    xmlNode *rsc = NULL;
+    const char *standard = NULL;
+    const char *provider = NULL;
+    gpointer key = NULL;
+    gpointer value = NULL;
+
+    if (class_limits == NULL) {
+        return NULL;
+    }
+    rsc = find_xml_node(action->xml, XML_CIB_TAG_RESOURCE, FALSE);
+    if (rsc == NULL) {
+        return NULL;
+    }
+    standard = crm_element_value(rsc, XML_AGENT_ATTR_CLASS);
+    if (standard == NULL) {
+        return NULL;
+    }
+
+    provider = crm_element_value(rsc, XML_AGENT_ATTR_PROVIDER);
+    if (provider != NULL) {
+        char *full = crm_strdup_printf("%s:%s", standard, provider);
+        bool found = g_hash_table_lookup_extended(class_limits, full, &key,
+                                                  &value);
+
+        free(full);
+        if (found) {
+            goto done;
+        }
+    }
+    if (!g_hash_table_lookup_extended(class_limits, standard, &key, &value)) {
+        return NULL;
+    }
+
+done:
+    if (limit != NULL) {
+        *limit = GPOINTER_TO_INT(value);
+    }
+    return (const char *) key;
+}
+
+static int
+te_class_jobs(struct te_peer_s *r, const char *class_key)
+{
+    if (r->class_jobs == NULL) {
+        return 0;
+    }
+    return GPOINTER_TO_INT(g_hash_table_lookup(r->class_jobs, class_key));
+}
+
+/*!
+ * \internal
+ * \brief Remember when an action was first deferred by a job limit
+ *
+ * \param[in] action  Action being deferred
+ * \param[in] limit   Name of limit deferring it
+ */
+static void
+te_action_deferred(crm_action_t *action, const char *limit)
+{
+    struct te_deferral_s *deferral = NULL;
+
+    if (te_deferrals == NULL) {
+        te_deferrals = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                             NULL, te_deferral_free);
+    }
+    deferral = g_hash_table_lookup(te_deferrals, GINT_TO_POINTER(action->id));
+    if (deferral == NULL) {
+        deferral = calloc(1, sizeof(struct te_deferral_s));
+        CRM_ASSERT(deferral != NULL);
+        deferral->since_us = g_get_monotonic_time();
+        g_hash_table_insert(te_deferrals, GINT_TO_POINTER(action->id),
+                            deferral);
+    }
+
+    // Attribute the wait to whichever limit held the action back last
+    if (safe_str_neq(deferral->limit, limit)) {
+        free(deferral->limit);
+        deferral->limit = strdup(limit);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Account for how long an action waited on job limits (if at all)
+ *
+ * \param[in] action  Action being sent for execution
+ */
+static void
+te_action_dispatched(crm_action_t *action)
+{
+    struct te_deferral_s *deferral = NULL;
+    struct te_wait_s *wait = NULL;
+    gint64 waited_us = 0;
+
+    if (te_deferrals == NULL) {
+        return;
+    }
+    deferral = g_hash_table_lookup(te_deferrals, GINT_TO_POINTER(action->id));
+    if (deferral == NULL) {
+        return;
+    }
+
+    if (te_waits == NULL) {
+        te_waits = g_hash_table_new_full(crm_str_hash, g_str_equal, free,
+                                         free);
+    }
+    wait = g_hash_table_lookup(te_waits, deferral->limit);
+    if (wait == NULL) {
+        wait = calloc(1, sizeof(struct te_wait_s));
+        CRM_ASSERT(wait != NULL);
+        g_hash_table_insert(te_waits, strdup(deferral->limit), wait);
+    }
+
+    waited_us = g_get_monotonic_time() - deferral->since_us;
+    wait->actions++;
+    wait->total_us += waited_us;
+    wait->max_us = QB_MAX(wait->max_us, waited_us);
+    g_hash_table_remove(te_deferrals, GINT_TO_POINTER(action->id));
+}
+
+/*!
+ * \internal
+ * \brief Log how long actions in a transition waited on job limits
+ *
+ * \param[in] graph  Transition that completed
+ */
+static void
+te_log_waits(crm_graph_t *graph)
+{
+    GHashTableIter iter;
+    const char *limit = NULL;
+    struct te_wait_s *wait = NULL;
+
+    if (te_waits == NULL) {
+        return;
+    }
+    g_hash_table_iter_init(&iter, te_waits);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &limit,
+                                  (gpointer *) &wait)) {
+        crm_info("Transition %d: %u action%s waited %lldms in total "
+                 "(at most %lldms) on %s",
+                 graph->id, wait->actions, pcmk__plural_s(wait->actions),
+                 (long long) (wait->total_us / 1000),
+                 (long long) (wait->max_us / 1000), limit);
+    }
+    g_hash_table_destroy(te_waits);
+    te_waits = NULL;
+}
+
 void te_reset_job_counts(void)
 {
     GHashTableIter iter;
@@ -407,11 +680,23 @@ void te_reset_job_counts(void)
     while (g_hash_table_iter_next(&iter, NULL, (gpointer *) & peer)) {
         peer->jobs = 0;
         peer->migrate_jobs = 0;
+        if (peer->class_jobs != NULL) {
+            g_hash_table_remove_all(peer->class_jobs);
+        }
+    }
+
+    // Action IDs are specific to a transition
+    if (te_deferrals != NULL) {
+        g_hash_table_remove_all(te_deferrals);
+    }
+    if (te_job_classes != NULL) {
+        g_hash_table_remove_all(te_job_classes);
     }
 }
 
 static void
-te_update_job_count_on(const char *target, int offset, bool migrate)
+te_update_job_count_on(const char *target, int offset, bool migrate,
+                       const char *class_key)
 {
     struct te_peer_s *r = NULL;
 
@@ -419,18 +704,63 @@ te_update_job_count_on(const char *target, int offset, bool migrate)
         return;
     }
 
-    r = g_hash_table_lookup(te_targets, target);
-    if(r == NULL) {
-        r = calloc(1, sizeof(struct te_peer_s));
-        r->name = strdup(target);
-        g_hash_table_insert(te_targets, r->name, r);
-    }
+    r = te_peer_get(target);
 
+    // Every job counts against the node, and also its class limit (if any)
     r->jobs += offset;
+    crm_trace("jobs[%s] = %d", target, r->jobs);
+
+    if (class_key != NULL) {
+        int jobs = te_class_jobs(r, class_key) + offset;
+
+        if (r->class_jobs == NULL) {
+            r->class_jobs = g_hash_table_new_full(crm_str_hash, g_str_equal,
+                                                  free, NULL);
+        }
+        g_hash_table_replace(r->class_jobs, strdup(class_key),
+                             GINT_TO_POINTER(jobs));
+        crm_trace("jobs[%s][%s] = %d", target, class_key, jobs);
+    }
     if(migrate) {
         r->migrate_jobs += offset;
     }
-    crm_trace("jobs[%s] = %d", target, r->jobs);
+}
+
+/*!
+ * \internal
+ * \brief Get the class limit key (if any) an action's job counts against
+ *
+ * \param[in] action  Resource action being counted or uncounted
+ * \param[in] offset  Whether the action is being counted (positive) or
+ *                    uncounted (negative)
+ *
+ * \return Key looked up and remembered when counting, or remembered key when
+ *         uncounting, or NULL if the action counts against the node limit
+ */
+static const char *
+te_job_class(crm_action_t *action, int offset)
+{
+    const char *class_key = NULL;
+
+    if (offset < 0) {
+        if (te_job_classes == NULL) {
+            return NULL;
+        }
+        return g_hash_table_lookup(te_job_classes,
+                                   GINT_TO_POINTER(action->id));
+    }
+
+    class_key = te_action_class_limit(action, NULL);
+    if (class_key != NULL) {
+        if (te_job_classes == NULL) {
+            te_job_classes = g_hash_table_new_full(g_direct_hash,
+                                                   g_direct_equal, NULL,
+                                                   free);
+        }
+        g_hash_table_replace(te_job_classes, GINT_TO_POINTER(action->id),
+                             strdup(class_key));
+    }
+    return class_key;
 }
 
 static void
@@ -438,12 +768,15 @@ te_update_job_count(crm_action_t * action, int offset)
 {
     const char *task = crm_element_value(action->xml, XML_LRM_ATTR_TASK);
     const char *target = crm_element_value(action->xml, XML_LRM_ATTR_TARGET);
+    const char *class_key = NULL;
 
     if (action->type != action_type_rsc || target == NULL) {
         /* No limit on these */
         return;
     }
 
+    class_key = te_job_class(action, offset);
+
     /* if we have a router node, this means the action is performing
      * on a remote node. For now, we count all actions occurring on a
      * remote node against the job list on the cluster node hosting
@@ -456,23 +789,31 @@ te_update_job_count(crm_action_t * action, int offset)
         const char *t1 = crm_meta_value(action->params, XML_LRM_ATTR_MIGRATE_SOURCE);
         const char *t2 = crm_meta_value(action->params, XML_LRM_ATTR_MIGRATE_TARGET);
 
-        te_update_job_count_on(t1, offset, TRUE);
-        te_update_job_count_on(t2, offset, TRUE);
-        return;
-    } else if (target == NULL) {
-        target = crm_element_value(action->xml, XML_LRM_ATTR_TARGET);
+        te_update_job_count_on(t1, offset, TRUE, class_key);
+        te_update_job_count_on(t2, offset, TRUE, class_key);
+
+    } else {
+        if (target == NULL) {
+            target = crm_element_value(action->xml, XML_LRM_ATTR_TARGET);
+        }
+        te_update_job_count_on(target, offset, FALSE, class_key);
     }
 
-    te_update_job_count_on(target, offset, FALSE);
+    if ((offset < 0) && (class_key != NULL)) {
+        // class_key belongs to the table, so this must come last
+        g_hash_table_remove(te_job_classes, GINT_TO_POINTER(action->id));
+    }
 }
 
 static gboolean
 te_should_perform_action_on(crm_graph_t * graph, crm_action_t * action, const char *target)
 {
     int limit = 0;
+    int jobs = 0;
     struct te_peer_s *r = NULL;
     const char *task = crm_element_value(action->xml, XML_LRM_ATTR_TASK);
     const char *id = crm_element_value(action->xml, XML_LRM_ATTR_TASK_KEY);
+    const char *class_key = NULL;
 
     if(target == NULL) {
         /* No limit on these */
@@ -482,29 +823,41 @@ te_should_perform_action_on(crm_graph_t * graph, crm_action_t * action, const ch
         return FALSE;
     }
 
-    r = g_hash_table_lookup(te_targets, target);
-    limit = throttle_get_job_limit(target);
+    r = te_peer_get(target);
 
-    if(r == NULL) {
-        r = calloc(1, sizeof(struct te_peer_s));
-        r->name = strdup(target);
-        g_hash_table_insert(te_targets, r->name, r);
+    /* A class limit applies in addition to the node limit, so a node never runs
+     * more jobs in total than node-action-limit allows
+     */
+    limit = throttle_get_job_limit(target);
+    jobs = r->jobs;
+    if (limit > jobs) {
+        int class_limit = 0;
+
+        class_key = te_action_class_limit(action, &class_limit);
+        if (class_key != NULL) {
+            limit = throttle_scale_job_limit(target, class_limit);
+            jobs = te_class_jobs(r, class_key);
+        }
     }
 
-    if(limit <= r->jobs) {
-        crm_trace("Peer %s is over their job limit of %d (%d): deferring %s",
-                  target, limit, r->jobs, id);
+    if(limit <= jobs) {
+        crm_trace("Peer %s is over their %s job limit of %d (%d): deferring %s",
+                  target, ((class_key == NULL)? "node" : class_key), limit,
+                  jobs, id);
+        te_action_deferred(action,
+                           (class_key == NULL)? TE_LIMIT_NODE : class_key);
         return FALSE;
 
     } else if(graph->migration_limit > 0 && r->migrate_jobs >= graph->migration_limit) {
         if (safe_str_eq(task, CRMD_ACTION_MIGRATE) || safe_str_eq(task, CRMD_ACTION_MIGRATED)) {
             crm_trace("Peer %s is over their migration job limit of %d (%d): deferring %s",
                       target, graph->migration_limit, r->migrate_jobs, id);
+            te_action_deferred(action, TE_LIMIT_MIGRATION);
             return FALSE;
         }
     }
 
-    crm_trace("Peer %s has not hit their limit yet. current jobs = %d limit= %d limit", target, r->jobs, limit);
+    crm_trace("Peer %s has not hit their limit yet. current jobs = %d limit= %d limit", target, jobs, limit);
 
     return TRUE;
 }
@@ -628,6 +981,7 @@ notify_crmd(crm_graph_t * graph)
     }
 
     crm_debug("Transition %d status: %s - %s", graph->id, type, crm_str(graph->abort_reason));
+    te_log_waits(graph);
 
     graph->abort_reason = NULL;
     graph->completion_action = tg_done;
@@ -13,6 +13,7 @@
 
 #include <crm/crm.h>
 #include <crm/common/xml.h>
+#include <crm/common/xml_internal.h>
 #include <crm/msg_xml.h>
 #include <crm/cluster.h>        /* For ONLINESTATUS etc */
 
@@ -39,6 +40,31 @@ shutdown_lock_cleared(xmlNode *lrm_resource)
            && (shutdown_lock == 0);
 }
 
+/*!
+ * \internal
+ * \brief Check whether a node attribute is informational only
+ *
+ * Some node attributes are published just so they can be seen (for example,
+ * with crm_mon -A), and changing them does not need a new transition.
+ *
+ * \param[in] attr  Node attribute (nvpair) being added or modified
+ *
+ * \return true if \p attr is informational, otherwise false
+ */
+static bool
+informational_attr(xmlNode *attr)
+{
+    const char *name = NULL;
+
+    if ((attr == NULL)
+        || safe_str_neq((const char *) attr->name, XML_CIB_TAG_NVPAIR)) {
+        return false;
+    }
+    name = crm_element_value(attr, XML_NVPAIR_ATTR_NAME);
+    return safe_str_eq(name, THROTTLE_ATTR_INPUT)
+           || safe_str_eq(name, THROTTLE_ATTR_JOBS);
+}
+
 static void
 te_update_diff_v1(const char *event, xmlNode *diff)
 {
@@ -94,7 +120,7 @@ te_update_diff_v1(const char *event, xmlNode *diff)
             value = crm_element_value(attr, XML_NVPAIR_ATTR_VALUE);
         }
 
-        if (crm_is_true(value) == FALSE) {
+        if ((crm_is_true(value) == FALSE) && !informational_attr(attr)) {
             abort_transition(INFINITY, tg_restart, "Transient attribute: update", attr);
             crm_log_xml_trace(attr, "Abort");
             goto bail;
@@ -274,55 +300,10 @@ process_resource_updates(const char *node, xmlNode *xml, xmlNode *change,
     }
 }
 
-#define NODE_PATT "/lrm[@id="
-static char *get_node_from_xpath(const char *xpath) 
-{
-    char *nodeid = NULL;
-    char *tmp = strstr(xpath, NODE_PATT);
-
-    if(tmp) {
-        tmp += strlen(NODE_PATT);
-        tmp += 1;
-
-        nodeid = strdup(tmp);
-        tmp = strstr(nodeid, "\'");
-        CRM_ASSERT(tmp);
-        tmp[0] = 0;
-    }
-    return nodeid;
-}
-
-static char *extract_node_uuid(const char *xpath) 
-{
-    char *mutable_path = strdup(xpath);
-    char *node_uuid = NULL;
-    char *search = NULL;
-    char *match = NULL;
-
-    match = strstr(mutable_path, "node_state[@id=\'");
-    if (match == NULL) {
-        free(mutable_path);
-        return NULL;
-    }
-    match += strlen("node_state[@id=\'");
-
-    search = strchr(match, '\'');
-    if (search == NULL) {
-        free(mutable_path);
-        return NULL;
-    }
-    search[0] = 0;
-
-    node_uuid = strdup(match);
-    free(mutable_path);
-    return node_uuid;
-}
-
 static void
-abort_unless_down(const char *xpath, const char *op, xmlNode *change,
-                  const char *reason)
+abort_unless_down(const pcmk__cib_path_t *path, const char *op,
+                  xmlNode *change, const char *reason)
 {
-    char *node_uuid = NULL;
     crm_action_t *down = NULL;
 
     if(safe_str_neq(op, "delete")) {
@@ -330,67 +311,60 @@ abort_unless_down(const char *xpath, const char *op, xmlNode *change,
         return;
     }
 
-    node_uuid = extract_node_uuid(xpath);
-    if(node_uuid == NULL) {
-        crm_err("Could not extract node ID from %s", xpath);
+    if (path->node == NULL) {
+        crm_err("Could not extract node ID from %s",
+                crm_element_value(change, XML_DIFF_PATH));
         abort_transition(INFINITY, tg_restart, reason, change);
         return;
     }
 
-    down = match_down_event(node_uuid);
+    down = match_down_event(path->node);
     if (down == NULL) {
-        crm_trace("Not expecting %s to be down (%s)", node_uuid, xpath);
+        crm_trace("Not expecting %s to be down", path->node);
         abort_transition(INFINITY, tg_restart, reason, change);
     } else {
-        crm_trace("Expecting changes to %s (%s)", node_uuid, xpath);
+        crm_trace("Expecting changes to %s", path->node);
     }
-    free(node_uuid);
 }
 
 static void
-process_op_deletion(const char *xpath, xmlNode *change)
+process_op_deletion(const pcmk__cib_path_t *path, xmlNode *change)
 {
-    char *mutable_key = strdup(xpath);
-    char *key;
-    char *node_uuid;
-
-    // Extract the part of xpath between last pair of single quotes
-    key = strrchr(mutable_key, '\'');
-    if (key != NULL) {
-        *key = '\0';
-        key = strrchr(mutable_key, '\'');
-    }
-    if (key == NULL) {
+    if (path->op == NULL) {
         crm_warn("Ignoring malformed CIB update (resource deletion of %s)",
-                 xpath);
-        free(mutable_key);
+                 crm_element_value(change, XML_DIFF_PATH));
         return;
     }
-    ++key;
 
-    node_uuid = extract_node_uuid(xpath);
-    if (confirm_cancel_action(key, node_uuid) == FALSE) {
+    if (confirm_cancel_action(path->op, path->node) == FALSE) {
         abort_transition(INFINITY, tg_restart, "Resource operation removal",
                          change);
     }
-    free(mutable_key);
-    free(node_uuid);
 }
 
 static void
-process_delete_diff(const char *xpath, const char *op, xmlNode *change)
+process_delete_diff(const pcmk__cib_path_t *path, const char *op,
+                    xmlNode *change)
 {
-    if (strstr(xpath, "/" XML_LRM_TAG_RSC_OP "[")) {
-        process_op_deletion(xpath, change);
+    switch (path->type) {
+        case pcmk__cib_path_lrm_rsc_op:
+            process_op_deletion(path, change);
+            break;
 
-    } else if (strstr(xpath, "/" XML_CIB_TAG_LRM "[")) {
-        abort_unless_down(xpath, op, change, "Resource state removal");
+        case pcmk__cib_path_lrm:
+        case pcmk__cib_path_lrm_resources:
+        case pcmk__cib_path_lrm_resource:
+            abort_unless_down(path, op, change, "Resource state removal");
+            break;
 
-    } else if (strstr(xpath, "/" XML_CIB_TAG_STATE "[")) {
-        abort_unless_down(xpath, op, change, "Node state removal");
+        case pcmk__cib_path_node_state:
+            abort_unless_down(path, op, change, "Node state removal");
+            break;
 
-    } else {
-        crm_trace("Ignoring delete of %s", xpath);
+        default:
+            crm_trace("Ignoring delete of %s",
+                      crm_element_value(change, XML_DIFF_PATH));
+            break;
     }
 }
 
@@ -429,117 +403,142 @@ process_cib_diff(xmlNode *cib, xmlNode *change, const char *op,
     }
 }
 
-static void
-te_update_diff_v2(xmlNode *diff)
+/*!
+ * \internal
+ * \brief Check whether one change in a v2 patchset requires an abort
+ *
+ * The change's XPath is parsed once, to find both what kind of element it
+ * refers to, and the node, resource, and operation IDs involved.
+ *
+ * \param[in] change  Change element from patchset
+ *
+ * \return false if no further changes in the patchset need to be checked,
+ *         otherwise true
+ */
+static bool
+process_v2_change(xmlNode *change)
 {
-    crm_log_xml_trace(diff, "Patch:Raw");
+    bool more = true;
+    xmlNode *match = NULL;
+    const char *name = NULL;
+    pcmk__cib_path_t path;
+    const char *xpath = crm_element_value(change, XML_DIFF_PATH);
 
-    for (xmlNode *change = __xml_first_child(diff); change != NULL;
-         change = __xml_next(change)) {
+    // Possible ops: create, modify, delete, move
+    const char *op = crm_element_value(change, XML_DIFF_OP);
 
-        xmlNode *match = NULL;
-        const char *name = NULL;
-        const char *xpath = crm_element_value(change, XML_DIFF_PATH);
+    // Ignore uninteresting updates
+    if (op == NULL) {
+        return true;
 
-        // Possible ops: create, modify, delete, move
-        const char *op = crm_element_value(change, XML_DIFF_OP);
+    } else if (xpath == NULL) {
+        crm_trace("Ignoring %s change for version field", op);
+        return true;
 
-        // Ignore uninteresting updates
-        if (op == NULL) {
-            continue;
+    } else if (strcmp(op, "move") == 0) {
+        crm_trace("Ignoring move change at %s", xpath);
+        return true;
+    }
 
-        } else if (xpath == NULL) {
-            crm_trace("Ignoring %s change for version field", op);
-            continue;
+    // Find the result of create/modify ops
+    if (strcmp(op, "create") == 0) {
+        match = change->children;
 
-        } else if (strcmp(op, "move") == 0) {
-            crm_trace("Ignoring move change at %s", xpath);
-            continue;
+    } else if (strcmp(op, "modify") == 0) {
+        match = first_named_child(change, XML_DIFF_RESULT);
+        if(match) {
+            match = match->children;
         }
 
-        // Find the result of create/modify ops
-        if (strcmp(op, "create") == 0) {
-            match = change->children;
-
-        } else if (strcmp(op, "modify") == 0) {
-            match = first_named_child(change, XML_DIFF_RESULT);
-            if(match) {
-                match = match->children;
-            }
+    } else if (strcmp(op, "delete") != 0) {
+        crm_warn("Ignoring malformed CIB update (%s operation on %s is unrecognized)",
+                 op, xpath);
+        return true;
+    }
 
-        } else if (strcmp(op, "delete") != 0) {
-            crm_warn("Ignoring malformed CIB update (%s operation on %s is unrecognized)",
-                     op, xpath);
-            continue;
+    if (match) {
+        if (match->type == XML_COMMENT_NODE) {
+            crm_trace("Ignoring %s operation for comment at %s", op, xpath);
+            return true;
         }
+        name = (const char *)match->name;
+    }
 
-        if (match) {
-            if (match->type == XML_COMMENT_NODE) {
-                crm_trace("Ignoring %s operation for comment at %s", op, xpath);
-                continue;
-            }
-            name = (const char *)match->name;
-        }
+    crm_trace("Handling %s operation for %s%s%s",
+              op, (xpath? xpath : "CIB"),
+              (name? " matched by " : ""), (name? name : ""));
 
-        crm_trace("Handling %s operation for %s%s%s",
-                  op, (xpath? xpath : "CIB"),
-                  (name? " matched by " : ""), (name? name : ""));
+    // Anything unparseable is handled according to the result name only
+    pcmk__parse_cib_path(xpath, &path);
 
-        if (strstr(xpath, "/" XML_TAG_CIB "/" XML_CIB_TAG_CONFIGURATION)) {
-            abort_transition(INFINITY, tg_restart, "Configuration change",
-                             change);
-            break; // Won't be packaged with operation results we may be waiting for
+    if (path.type == pcmk__cib_path_configuration) {
+        abort_transition(INFINITY, tg_restart, "Configuration change",
+                         change);
+        more = false; // Won't be packaged with operation results we may be waiting for
 
-        } else if (strstr(xpath, "/" XML_CIB_TAG_TICKETS)
-                   || safe_str_eq(name, XML_CIB_TAG_TICKETS)) {
-            abort_transition(INFINITY, tg_restart, "Ticket attribute change", change);
-            break; // Won't be packaged with operation results we may be waiting for
+    } else if ((path.type == pcmk__cib_path_tickets)
+               || safe_str_eq(name, XML_CIB_TAG_TICKETS)) {
+        abort_transition(INFINITY, tg_restart, "Ticket attribute change", change);
+        more = false; // Won't be packaged with operation results we may be waiting for
 
-        } else if (strstr(xpath, "/" XML_TAG_TRANSIENT_NODEATTRS "[")
-                   || safe_str_eq(name, XML_TAG_TRANSIENT_NODEATTRS)) {
-            abort_unless_down(xpath, op, change, "Transient attribute change");
-            break; // Won't be packaged with operation results we may be waiting for
+    } else if (((path.type == pcmk__cib_path_transient)
+                || safe_str_eq(name, XML_TAG_TRANSIENT_NODEATTRS))
+               && informational_attr(match)) {
+        crm_trace("Ignoring %s of informational node attribute %s",
+                  op, crm_element_value(match, XML_NVPAIR_ATTR_NAME));
 
-        } else if (strcmp(op, "delete") == 0) {
-            process_delete_diff(xpath, op, change);
+    } else if ((path.type == pcmk__cib_path_transient)
+               || safe_str_eq(name, XML_TAG_TRANSIENT_NODEATTRS)) {
+        abort_unless_down(&path, op, change, "Transient attribute change");
+        more = false; // Won't be packaged with operation results we may be waiting for
 
-        } else if (name == NULL) {
-            crm_warn("Ignoring malformed CIB update (%s at %s has no result)",
-                     op, xpath);
+    } else if (strcmp(op, "delete") == 0) {
+        process_delete_diff(&path, op, change);
 
-        } else if (strcmp(name, XML_TAG_CIB) == 0) {
-            process_cib_diff(match, change, op, xpath);
+    } else if (name == NULL) {
+        crm_warn("Ignoring malformed CIB update (%s at %s has no result)",
+                 op, xpath);
 
-        } else if (strcmp(name, XML_CIB_TAG_STATUS) == 0) {
-            process_status_diff(match, change, op, xpath);
+    } else if (strcmp(name, XML_TAG_CIB) == 0) {
+        process_cib_diff(match, change, op, xpath);
 
-        } else if (strcmp(name, XML_CIB_TAG_STATE) == 0) {
-            process_node_state_diff(match, change, op, xpath);
+    } else if (strcmp(name, XML_CIB_TAG_STATUS) == 0) {
+        process_status_diff(match, change, op, xpath);
 
-        } else if (strcmp(name, XML_CIB_TAG_LRM) == 0) {
-            process_resource_updates(ID(match), match, change, op, xpath);
+    } else if (strcmp(name, XML_CIB_TAG_STATE) == 0) {
+        process_node_state_diff(match, change, op, xpath);
 
-        } else if (strcmp(name, XML_LRM_TAG_RESOURCES) == 0) {
-            char *local_node = get_node_from_xpath(xpath);
+    } else if (strcmp(name, XML_CIB_TAG_LRM) == 0) {
+        process_resource_updates(ID(match), match, change, op, xpath);
 
-            process_resource_updates(local_node, match, change, op, xpath);
-            free(local_node);
+    } else if (strcmp(name, XML_LRM_TAG_RESOURCES) == 0) {
+        process_resource_updates(path.node, match, change, op, xpath);
 
-        } else if (strcmp(name, XML_LRM_TAG_RESOURCE) == 0) {
-            char *local_node = get_node_from_xpath(xpath);
+    } else if (strcmp(name, XML_LRM_TAG_RESOURCE) == 0) {
+        process_lrm_resource_diff(match, path.node);
 
-            process_lrm_resource_diff(match, local_node);
-            free(local_node);
+    } else if (strcmp(name, XML_LRM_TAG_RSC_OP) == 0) {
+        process_graph_event(match, path.node);
 
-        } else if (strcmp(name, XML_LRM_TAG_RSC_OP) == 0) {
-            char *local_node = get_node_from_xpath(xpath);
+    } else {
+        crm_warn("Ignoring malformed CIB update (%s at %s has unrecognized result %s)",
+                 op, xpath, name);
+    }
 
-            process_graph_event(match, local_node);
-            free(local_node);
+    pcmk__free_cib_path(&path);
+    return more;
+}
 
-        } else {
-            crm_warn("Ignoring malformed CIB update (%s at %s has unrecognized result %s)",
-                     op, xpath, name);
+static void
+te_update_diff_v2(xmlNode *diff)
+{
+    crm_log_xml_trace(diff, "Patch:Raw");
+
+    for (xmlNode *change = __xml_first_child(diff); change != NULL;
+         change = __xml_next(change)) {
+
+        if (!process_v2_change(change)) {
+            break;
         }
     }
 }
@@ -564,18 +563,22 @@ te_update_diff(const char *event, xmlNode * msg)
     } else if (rc < pcmk_ok) {
         crm_trace("Filter rc=%d (%s)", rc, pcmk_strerror(rc));
         return;
+    }
+
+    // Keep the scheduler's CIB copy current, even if no abort is needed
+    diff = get_message_xml(msg, F_CIB_UPDATE_RESULT);
+    controld_update_sched_cib(diff);
 
-    } else if (transition_graph->complete
-               && fsa_state != S_IDLE
-               && fsa_state != S_TRANSITION_ENGINE
-               && fsa_state != S_POLICY_ENGINE) {
+    if (transition_graph->complete
+        && fsa_state != S_IDLE
+        && fsa_state != S_TRANSITION_ENGINE
+        && fsa_state != S_POLICY_ENGINE) {
         crm_trace("Filter state=%s, complete=%d", fsa_state2string(fsa_state),
                   transition_graph->complete);
         return;
     }
 
     op = crm_element_value(msg, F_CIB_OPERATION);
-    diff = get_message_xml(msg, F_CIB_UPDATE_RESULT);
 
     xml_patch_versions(diff, p_add, p_del);
     crm_debug("Processing (%s) diff: %d.%d.%d -> %d.%d.%d (%s)", op,
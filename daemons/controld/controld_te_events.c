@@ -199,56 +199,35 @@ update_failcount(xmlNode * event, const char *event_node_uuid, int rc,
 crm_action_t *
 controld_get_action(int id)
 {
-    for (GList *item = transition_graph->synapses; item; item = item->next) {
-        synapse_t *synapse = (synapse_t *) item->data;
-
-        for (GList *item2 = synapse->actions; item2; item2 = item2->next) {
-            crm_action_t *action = (crm_action_t *) item2->data;
-
-            if (action->id == id) {
-                return action;
-            }
-        }
-    }
-    return NULL;
+    return pcmk__find_graph_action(transition_graph, id);
 }
 
 crm_action_t *
 get_cancel_action(const char *id, const char *node)
 {
-    GListPtr gIter = NULL;
-    GListPtr gIter2 = NULL;
-
-    gIter = transition_graph->synapses;
-    for (; gIter != NULL; gIter = gIter->next) {
-        synapse_t *synapse = (synapse_t *) gIter->data;
-
-        gIter2 = synapse->actions;
-        for (; gIter2 != NULL; gIter2 = gIter2->next) {
-            const char *task = NULL;
-            const char *target = NULL;
-            crm_action_t *action = (crm_action_t *) gIter2->data;
-
-            task = crm_element_value(action->xml, XML_LRM_ATTR_TASK);
-            if (safe_str_neq(CRMD_ACTION_CANCEL, task)) {
-                continue;
-            }
+    GQueue *cancels = NULL;
 
-            task = crm_element_value(action->xml, XML_LRM_ATTR_TASK_KEY);
-            if (safe_str_neq(task, id)) {
-                crm_trace("Wrong key %s for %s on %s", task, id, node);
-                continue;
-            }
+    if (id == NULL) {
+        return NULL;
+    }
 
-            target = crm_element_value(action->xml, XML_LRM_ATTR_TARGET_UUID);
-            if (node && safe_str_neq(target, node)) {
-                crm_trace("Wrong node %s for %s on %s", target, id, node);
-                continue;
-            }
+    // Cancel actions are indexed by the key of the operation they cancel
+    cancels = g_hash_table_lookup(transition_graph->cancels, id);
+    if (cancels == NULL) {
+        return NULL;
+    }
+    for (GList *iter = cancels->head; iter != NULL; iter = iter->next) {
+        crm_action_t *action = (crm_action_t *) iter->data;
+        const char *target = crm_element_value(action->xml,
+                                               XML_LRM_ATTR_TARGET_UUID);
 
-            crm_trace("Found %s on %s", id, node);
-            return action;
+        if (node && safe_str_neq(target, node)) {
+            crm_trace("Wrong node %s for %s on %s", target, id, node);
+            continue;
         }
+
+        crm_trace("Found %s on %s", id, node);
+        return action;
     }
 
     return NULL;
@@ -275,10 +254,6 @@ confirm_cancel_action(const char *id, const char *node_id)
     return TRUE;
 }
 
-/* downed nodes are listed like: <downed> <node id="UUID1" /> ... </downed> */
-#define XPATH_DOWNED "//" XML_GRAPH_TAG_DOWNED \
-                     "/" XML_CIB_TAG_NODE "[@" XML_ATTR_UUID "='%s']"
-
 /*!
  * \brief Find a transition event that would have made a specified node down
  *
@@ -290,35 +265,25 @@ crm_action_t *
 match_down_event(const char *target)
 {
     crm_action_t *match = NULL;
-    xmlXPathObjectPtr xpath_ret = NULL;
-    GListPtr gIter, gIter2;
-
-    char *xpath = crm_strdup_printf(XPATH_DOWNED, target);
-
-    for (gIter = transition_graph->synapses;
-         gIter != NULL && match == NULL;
-         gIter = gIter->next) {
-
-        for (gIter2 = ((synapse_t*)gIter->data)->actions;
-             gIter2 != NULL && match == NULL;
-             gIter2 = gIter2->next) {
+    GQueue *downers = NULL;
 
-            match = (crm_action_t*)gIter2->data;
-            if (match->executed) {
-                xpath_ret = xpath_search(match->xml, xpath);
-                if (numXpathResults(xpath_ret) < 1) {
-                    match = NULL;
-                }
-                freeXpathObject(xpath_ret);
-            } else {
-                // Only actions that were actually started can match
-                match = NULL;
-            }
+    /* Actions are indexed by the nodes listed in their downed section, like
+     * <downed> <node id="UUID1" /> ... </downed>
+     */
+    if (target != NULL) {
+        downers = g_hash_table_lookup(transition_graph->downed, target);
+    }
+    for (GList *iter = (downers == NULL)? NULL : downers->head;
+         iter != NULL; iter = iter->next) {
+        crm_action_t *action = (crm_action_t *) iter->data;
+
+        // Only actions that were actually started can match
+        if (action->executed) {
+            match = action;
+            break;
         }
     }
 
-    free(xpath);
-
     if (match != NULL) {
         crm_debug("Shutdown action %d (%s) found for node %s", match->id,
                   crm_element_value(match->xml, XML_LRM_ATTR_TASK_KEY), target);
@@ -287,8 +287,17 @@ abort_transition_graph(int abort_priority, enum transition_action abort_action,
         } else {
             register_fsa_input(C_FSA_INTERNAL, I_PE_CALC, NULL);
         }
-        return;
+
+    } else {
+        mainloop_set_trigger(transition_trigger);
     }
 
-    mainloop_set_trigger(transition_trigger);
+    /* Start calculating the new transition while this one winds down, unless
+     * this transition will be followed by a stop or shutdown instead
+     */
+    if ((abort_action == tg_restart)
+        && (transition_graph->complete
+            || (transition_graph->completion_action == tg_restart))) {
+        controld_sched_speculate();
+    }
 }
@@ -35,6 +35,7 @@ enum throttle_state_e {
 
 struct throttle_record_s {
     int max;
+    int jobs;   // Job limit calculated by node itself (0 if not provided)
     enum throttle_state_e mode;
     char *node;
 };
@@ -42,10 +43,27 @@ struct throttle_record_s {
 static int throttle_job_max = 0;
 static float throttle_load_target = 0.0;
 
+// Whether to use pressure stall information instead of the load average
+static bool throttle_use_pressure = false;
+
 #define THROTTLE_FACTOR_LOW    1.2
 #define THROTTLE_FACTOR_MEDIUM 1.6
 #define THROTTLE_FACTOR_HIGH   2.0
 
+/* Percentages of time stalled on a resource (over the last 10 seconds) at and
+ * above which the job limit starts being reduced, and is reduced to one job
+ */
+#define THROTTLE_PRESSURE_LOW  10.0
+#define THROTTLE_PRESSURE_HIGH 40.0
+
+// Minimum time between updates of those attributes (in seconds)
+#define THROTTLE_PUBLISH_INTERVAL 60
+
+/* The published job limit is rounded down to a multiple of this fraction of
+ * the maximum, so it doesn't change with every small change in pressure
+ */
+#define THROTTLE_PUBLISH_STEPS 8
+
 static GHashTable *throttle_records = NULL;
 static mainloop_timer_t *throttle_timer = NULL;
 
@@ -294,6 +312,77 @@ throttle_handle_load(float load, const char *desc, int cores)
 
     return throttle_check_thresholds(load, desc, thresholds);
 }
+
+/*!
+ * \internal
+ * \brief Get how much Pacemaker's cgroup has recently been held back
+ *
+ * \param[out] load  Where to store percentage of time since last call that
+ *                   the cgroup was throttled by its CPU limit
+ *
+ * \return true if \p load was set, otherwise false
+ */
+static bool
+throttle_cgroup_load(float *load)
+{
+    static gint64 last_call = 0;
+    static unsigned long long last_throttled = 0;
+
+    unsigned long long usage = 0;
+    unsigned long long throttled = 0;
+    gint64 now = g_get_monotonic_time();
+
+    *load = 0.0;
+    if (pcmk__procfs_cgroup_cpu_stat(&usage, &throttled) != pcmk_rc_ok) {
+        last_call = 0;
+        return false;
+    }
+
+    if ((last_call > 0) && (last_call < now) && (last_throttled <= throttled)) {
+        *load = (throttled - last_throttled); /* Cast to a float before division */
+        *load *= 100.0;
+        *load /= (now - last_call);
+        crm_debug("cgroup CPU throttling: %f%% (%lluus in %lldus)", *load,
+                  throttled - last_throttled, (long long) (now - last_call));
+    }
+    last_call = now;
+    last_throttled = throttled;
+    return true;
+}
+
+/*!
+ * \internal
+ * \brief Get the most significant source of resource pressure
+ *
+ * \param[out] input  Where to store name of most significant input
+ *
+ * \return Highest stall or throttling percentage among all inputs
+ */
+static float
+throttle_pressure(const char **input)
+{
+    const char *resources[] = { "cpu", "io", "memory" };
+    float pressure = 0.0;
+    float value = 0.0;
+
+    *input = NULL;
+    for (int lpc = 0; lpc < DIMOF(resources); lpc++) {
+        char *path = crm_strdup_printf("/proc/pressure/%s", resources[lpc]);
+
+        if ((pcmk__procfs_pressure(path, &value) == pcmk_rc_ok)
+            && ((*input == NULL) || (value > pressure))) {
+            pressure = value;
+            *input = resources[lpc];
+        }
+        free(path);
+    }
+    if (throttle_cgroup_load(&value)
+        && ((*input == NULL) || (value > pressure))) {
+        pressure = value;
+        *input = "cgroup-cpu";
+    }
+    return pressure;
+}
 #endif
 
 static enum throttle_state_e
@@ -337,7 +426,7 @@ throttle_mode(void)
         mode = throttle_check_thresholds(load, "CIB load", thresholds);
     }
 
-    if(throttle_load_target <= 0) {
+    if(throttle_load_target <= 0 || throttle_use_pressure) {
         /* If we ever make this a valid value, the cluster will at least behave as expected */
         return mode;
     }
@@ -355,20 +444,158 @@ throttle_mode(void)
     return mode;
 }
 
+static int
+throttle_mode_jobs(enum throttle_state_e mode, int max, const char *node)
+{
+    switch(mode) {
+        case throttle_extreme:
+        case throttle_high:
+            return 1; /* At least one job must always be allowed */
+        case throttle_med:
+            return QB_MAX(1, max / 4);
+        case throttle_low:
+            return QB_MAX(1, max / 2);
+        case throttle_none:
+            return QB_MAX(1, max);
+        default:
+            crm_err("Unknown throttle mode %.4x on %s", mode, node);
+            return 1;
+    }
+}
+
+/*!
+ * \internal
+ * \brief Show what is throttling the local node, via node attributes
+ *
+ * The attributes are transient, so crm_mon can show them, but the DC does not
+ * abort its transition when they change (see informational_attr() in
+ * controld_te_callbacks.c).
+ * The job limit is rounded down to a step of the maximum, and neither
+ * attribute is updated more often than THROTTLE_PUBLISH_INTERVAL.
+ *
+ * \param[in] input  Name of input limiting jobs ("none" if not limited)
+ * \param[in] jobs   Current local job limit
+ */
 static void
-throttle_send_command(enum throttle_state_e mode)
+throttle_publish(const char *input, int jobs)
+{
+    static char *last_input = NULL;
+    static int last_jobs = -1;
+    static time_t last_published = 0;
+
+    int step = QB_MAX(1, throttle_job_max / THROTTLE_PUBLISH_STEPS);
+    time_t now = time(NULL);
+
+    if (fsa_our_uname == NULL) {
+        return;
+    }
+
+    jobs = QB_MAX(1, jobs - (jobs % step));
+    if ((safe_str_eq(input, last_input) && (jobs == last_jobs))
+        || (now < last_published + THROTTLE_PUBLISH_INTERVAL)) {
+        return;
+    }
+    last_published = now;
+
+    if (safe_str_neq(input, last_input)) {
+        free(last_input);
+        last_input = strdup(input);
+        update_attrd(fsa_our_uname, THROTTLE_ATTR_INPUT, input, NULL, FALSE);
+    }
+    if (jobs != last_jobs) {
+        char *value = crm_itoa(jobs);
+
+        last_jobs = jobs;
+        update_attrd(fsa_our_uname, THROTTLE_ATTR_JOBS, value, NULL, FALSE);
+        free(value);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Calculate local job limit from resource pressure
+ *
+ * Rather than choosing among discrete throttle modes, scale the job limit
+ * linearly from the maximum (at or below low pressure) down to a single job
+ * (at or above high pressure). The CIB manager's own CPU usage, which pressure
+ * does not reflect, still limits jobs as in load average mode.
+ *
+ * \param[in,out] mode  Throttle mode based on CIB manager load; on return,
+ *                      the equivalent mode for peers that use only the mode
+ *
+ * \return Local job limit
+ */
+static int
+throttle_pressure_jobs(enum throttle_state_e *mode)
+{
+    int jobs = throttle_job_max;
+    int cib_jobs = throttle_mode_jobs(*mode, throttle_job_max, fsa_our_uname);
+    const char *input = "none";
+
+#if SUPPORT_PROCFS
+    if (throttle_load_target > 0) {
+        const char *source = NULL;
+        float pressure = throttle_pressure(&source);
+
+        if (pressure >= THROTTLE_PRESSURE_HIGH) {
+            jobs = 1;
+        } else if (pressure > THROTTLE_PRESSURE_LOW) {
+            float scale = (THROTTLE_PRESSURE_HIGH - pressure)
+                          / (THROTTLE_PRESSURE_HIGH - THROTTLE_PRESSURE_LOW);
+
+            jobs = 1 + (int) ((throttle_job_max - 1) * scale + 0.5);
+        }
+        if (jobs < throttle_job_max) {
+            input = source;
+        }
+        crm_debug("Highest pressure is %f%% (%s)",
+                  pressure, ((source == NULL)? "unavailable" : source));
+    }
+#endif
+    jobs = QB_MAX(1, jobs);
+    if (cib_jobs < jobs) {
+        jobs = cib_jobs;
+        input = "cib";
+    }
+    throttle_publish(input, jobs);
+
+    if (jobs >= throttle_job_max) {
+        *mode = throttle_none;
+    } else if (jobs >= throttle_job_max / 2) {
+        *mode = throttle_low;
+    } else if (jobs >= throttle_job_max / 4) {
+        *mode = throttle_med;
+    } else {
+        *mode = throttle_high;
+    }
+    return jobs;
+}
+
+static void
+throttle_send_command(enum throttle_state_e mode, int jobs)
 {
     xmlNode *xml = NULL;
     static enum throttle_state_e last = -1;
+    static int last_jobs = 0;
 
-    if(mode != last) {
-        crm_info("New throttle mode: %s load (was %s)",
-                 load2str(mode), load2str(last));
+    if ((mode != last) || (jobs != last_jobs)) {
+        if (jobs > 0) {
+            crm_info("New throttle mode: %s load with job limit %d (was %s, %d)",
+                     load2str(mode), jobs, load2str(last), last_jobs);
+        } else {
+            crm_info("New throttle mode: %s load (was %s)",
+                     load2str(mode), load2str(last));
+        }
         last = mode;
+        last_jobs = jobs;
 
         xml = create_request(CRM_OP_THROTTLE, NULL, NULL, CRM_SYSTEM_CRMD, CRM_SYSTEM_CRMD, NULL);
         crm_xml_add_int(xml, F_CRM_THROTTLE_MODE, mode);
         crm_xml_add_int(xml, F_CRM_THROTTLE_MAX, throttle_job_max);
+        if (jobs > 0) {
+            // Older peers ignore this and use the equivalent mode instead
+            crm_xml_add_int(xml, F_CRM_THROTTLE_JOBS, jobs);
+        }
 
         send_cluster_message(NULL, crm_msg_crmd, xml, TRUE);
         free_xml(xml);
@@ -378,7 +605,13 @@ throttle_send_command(enum throttle_state_e mode)
 static gboolean
 throttle_timer_cb(gpointer data)
 {
-    throttle_send_command(throttle_mode());
+    enum throttle_state_e mode = throttle_mode();
+    int jobs = 0;
+
+    if (throttle_use_pressure) {
+        jobs = throttle_pressure_jobs(&mode);
+    }
+    throttle_send_command(mode, jobs);
     return TRUE;
 }
 
@@ -422,9 +655,41 @@ throttle_update_job_max(const char *preference)
     }
 }
 
+/*!
+ * \internal
+ * \brief Choose whether to throttle based on load average or pressure
+ */
+static void
+throttle_choose_input(void)
+{
+    const char *input = pcmk__env_option("throttle_input");
+
+    throttle_use_pressure = false;
+    if ((input == NULL) || !strcasecmp(input, "load")) {
+        return;
+
+    } else if (strcasecmp(input, "pressure")) {
+        crm_warn("Ignoring invalid value '%s' for PCMK_throttle_input "
+                 "(must be 'load' or 'pressure')", input);
+        return;
+    }
+
+#if SUPPORT_PROCFS
+    if (access("/proc/pressure/cpu", R_OK) == 0) {
+        crm_info("Throttling based on pressure stall information");
+        throttle_use_pressure = true;
+        return;
+    }
+#endif
+    crm_warn("Throttling based on load average because pressure stall "
+             "information is unavailable " CRM_XS " PCMK_throttle_input=%s",
+             input);
+}
+
 void
 throttle_init(void)
 {
+    throttle_choose_input();
     if(throttle_records == NULL) {
         throttle_records = g_hash_table_new_full(
             crm_str_hash, g_str_equal, NULL, throttle_record_free);
@@ -492,7 +757,6 @@ throttle_get_total_job_limit(int l)
 int
 throttle_get_job_limit(const char *node)
 {
-    int jobs = 1;
     struct throttle_record_s *r = NULL;
 
     r = g_hash_table_lookup(throttle_records, node);
@@ -506,25 +770,33 @@ throttle_get_job_limit(const char *node)
         g_hash_table_insert(throttle_records, r->node, r);
     }
 
-    switch(r->mode) {
-        case throttle_extreme:
-        case throttle_high:
-            jobs = 1; /* At least one job must always be allowed */
-            break;
-        case throttle_med:
-            jobs = QB_MAX(1, r->max / 4);
-            break;
-        case throttle_low:
-            jobs = QB_MAX(1, r->max / 2);
-            break;
-        case throttle_none:
-            jobs = QB_MAX(1, r->max);
-            break;
-        default:
-            crm_err("Unknown throttle mode %.4x on %s", r->mode, node);
-            break;
+    if (r->jobs > 0) {
+        // Node calculated its own limit from resource pressure
+        return r->jobs;
     }
-    return jobs;
+    return throttle_mode_jobs(r->mode, r->max, node);
+}
+
+/*!
+ * \internal
+ * \brief Reduce a job limit in proportion to a node's current throttling
+ *
+ * \param[in] node   Node to check
+ * \param[in] limit  Job limit when the node is not throttled
+ *
+ * \return \p limit scaled by the node's current job limit relative to its
+ *         maximum (at least 1)
+ */
+int
+throttle_scale_job_limit(const char *node, int limit)
+{
+    int jobs = throttle_get_job_limit(node); // Ensures record exists
+    struct throttle_record_s *r = g_hash_table_lookup(throttle_records, node);
+
+    if ((r->max <= 0) || (jobs >= r->max)) {
+        return limit;
+    }
+    return QB_MAX(1, (int) (((long long) limit * jobs) / r->max));
 }
 
 void
@@ -532,11 +804,13 @@ throttle_update(xmlNode *xml)
 {
     int max = 0;
     int mode = 0;
+    int jobs = 0;
     struct throttle_record_s *r = NULL;
     const char *from = crm_element_value(xml, F_CRM_HOST_FROM);
 
     crm_element_value_int(xml, F_CRM_THROTTLE_MODE, &mode);
     crm_element_value_int(xml, F_CRM_THROTTLE_MAX, &max);
+    crm_element_value_int(xml, F_CRM_THROTTLE_JOBS, &jobs);
 
     r = g_hash_table_lookup(throttle_records, from);
 
@@ -547,6 +821,7 @@ throttle_update(xmlNode *xml)
     }
 
     r->max = max;
+    r->jobs = QB_MAX(jobs, 0);
     r->mode = (enum throttle_state_e) mode;
 
     crm_debug("Node %s has %s load and supports at most %d jobs; new job limit %d",
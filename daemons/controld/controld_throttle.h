@@ -16,6 +16,9 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
  */
 
+// Node attributes showing what is throttling a node (in pressure mode)
+#define THROTTLE_ATTR_INPUT "throttle-input"
+#define THROTTLE_ATTR_JOBS  "throttle-job-limit"
 
 void throttle_init(void);
 void throttle_fini(void);
@@ -24,4 +27,5 @@ void throttle_set_load_target(float target);
 void throttle_update(xmlNode *xml);
 void throttle_update_job_max(const char *preference);
 int throttle_get_job_limit(const char *node);
+int throttle_scale_job_limit(const char *node, int limit);
 int throttle_get_total_job_limit(int l);
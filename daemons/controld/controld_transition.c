@@ -53,6 +53,9 @@ do_te_control(long long action,
                                                     te_update_diff);
         }
 
+        // Without diffs, the scheduler's CIB copy can't be kept current
+        controld_free_sched_cib();
+
         clear_bit(fsa_input_register, R_TE_CONNECTED);
         crm_info("Transitioner is now inactive");
     }
@@ -145,8 +148,11 @@ do_te_invoke(long long action,
         const char *ref = crm_element_value(input->msg, XML_ATTR_REFERENCE);
         const char *graph_file = crm_element_value(input->msg, F_CRM_TGRAPH);
         const char *graph_input = crm_element_value(input->msg, F_CRM_TGRAPH_INPUT);
+        const char *compact = crm_element_value(input->msg,
+                                                F_CRM_TGRAPH_COMPACT);
+        crm_graph_t *graph = NULL;
 
-        if (graph_file == NULL && input->xml == NULL) {
+        if ((graph_file == NULL) && (compact == NULL) && (input->xml == NULL)) {
             crm_log_xml_err(input->msg, "Bad command");
             register_fsa_error(C_FSA_INTERNAL, I_FAIL, NULL);
             return;
@@ -163,32 +169,56 @@ do_te_invoke(long long action,
             abort_transition(INFINITY, tg_restart, "Transition Redundant", NULL);
         }
 
-        graph_data = input->xml;
-
-        if (graph_data == NULL && graph_file != NULL) {
-            graph_data = filename2xml(graph_file);
-        }
-
         if (is_timer_started(transition_timer)) {
             crm_debug("The transitioner wait for a transition timer");
             return;
         }
 
-        CRM_CHECK(graph_data != NULL,
-                  crm_err("Input raised by %s is invalid", msg_data->origin);
-                  crm_log_xml_err(input->msg, "Bad command");
-                  return);
-
+        if (compact != NULL) {
+            // Graph XML holds only the graph-wide attributes in this case
+            graph = pcmk__unpack_compact_graph(compact, graph_input,
+                                               &graph_data);
+            if (graph == NULL) {
+                crm_err("Compact graph raised by %s is invalid",
+                        msg_data->origin);
+                crm_log_xml_err(input->msg, "Bad command");
+                register_fsa_error(C_FSA_INTERNAL, I_FAIL, NULL);
+                return;
+            }
+
+        } else {
+            graph_data = input->xml;
+
+            if (graph_data == NULL && graph_file != NULL) {
+                graph_data = filename2xml(graph_file);
+            }
+
+            CRM_CHECK(graph_data != NULL,
+                      crm_err("Input raised by %s is invalid", msg_data->origin);
+                      crm_log_xml_err(input->msg, "Bad command");
+                      register_fsa_error(C_FSA_INTERNAL, I_FAIL, NULL);
+                      return);
+
+            graph = unpack_graph(graph_data, graph_input);
+            if (graph == NULL) {
+                CRM_CHECK(graph != NULL,);
+                if (graph_data != input->xml) {
+                    free_xml(graph_data);
+                }
+                register_fsa_error(C_FSA_INTERNAL, I_FAIL, NULL);
+                return;
+            }
+        }
+
+        // Replace the old graph only once the new one is known to be good
         destroy_graph(transition_graph);
-        transition_graph = unpack_graph(graph_data, graph_input);
-        if (transition_graph == NULL) {
-            CRM_CHECK(transition_graph != NULL,);
-            transition_graph = create_blank_graph();
-            return;
-        }
+        transition_graph = graph;
         crm_info("Processing graph %d (ref=%s) derived from %s", transition_graph->id, ref,
                  graph_input);
 
+        // Fire actions heading long chains first when job limits apply
+        pcmk__sort_graph_critical_path(transition_graph);
+
         te_reset_job_counts();
         value = crm_element_value(graph_data, "failed-stop-offset");
         if (value) {
@@ -61,5 +61,6 @@ extern char *failed_start_offset;
 
 void te_action_confirmed(crm_action_t *action, crm_graph_t *graph);
 void te_reset_job_counts(void);
+void te_set_class_limits(const char *value);
 
 #endif
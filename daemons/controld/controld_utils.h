@@ -61,6 +61,11 @@ void pe_subsystem_free(void);
 void controld_stop_sched_timer(void);
 void controld_free_sched_timer(void);
 void controld_expect_sched_reply(xmlNode *msg);
+void controld_free_sched_cib(void);
+void controld_update_sched_cib(xmlNode *diff);
+void controld_sched_speculate(void);
+bool controld_sched_save_speculative(const char *ref, xmlNode *reply);
+void controld_sched_resend(const char *ref);
 
 void fsa_dump_actions(long long action, const char *text);
 void fsa_dump_inputs(int log_level, const char *text, long long input_register);
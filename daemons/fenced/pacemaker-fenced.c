@@ -283,19 +283,24 @@ get_stonith_flag(const char *name)
     return st_callback_unknown;
 }
 
+struct stonith_notification_s {
+    xmlNode *msg;
+    struct iovec *iov;  // Serialized msg, prepared when first needed
+};
+
 static void
 stonith_notify_client(gpointer key, gpointer value, gpointer user_data)
 {
 
-    xmlNode *update_msg = user_data;
+    struct stonith_notification_s *update = user_data;
     pcmk__client_t *client = value;
     const char *type = NULL;
 
     CRM_CHECK(client != NULL, return);
-    CRM_CHECK(update_msg != NULL, return);
+    CRM_CHECK(update != NULL, return);
 
-    type = crm_element_value(update_msg, F_SUBTYPE);
-    CRM_CHECK(type != NULL, crm_log_xml_err(update_msg, "notify"); return);
+    type = crm_element_value(update->msg, F_SUBTYPE);
+    CRM_CHECK(type != NULL, crm_log_xml_err(update->msg, "notify"); return);
 
     if (client->ipcs == NULL) {
         crm_trace("Skipping client with NULL channel");
@@ -303,8 +308,21 @@ stonith_notify_client(gpointer key, gpointer value, gpointer user_data)
     }
 
     if (client->options & get_stonith_flag(type)) {
-        int rc = pcmk__ipc_send_xml(client, 0, update_msg,
+        int rc = pcmk_rc_ok;
+
+        /* Serialize the notification once, and let every client's queue
+         * share it
+         */
+        if (update->iov == NULL) {
+            ssize_t bytes = 0;
+
+            rc = pcmk__ipc_prepare_iov(0, update->msg, 0, &(update->iov),
+                                       &bytes);
+        }
+        if (rc == pcmk_rc_ok) {
+            rc = pcmk__ipc_send_iov(client, update->iov,
                                     crm_ipc_server_event|crm_ipc_server_error);
+        }
 
         if (rc != pcmk_rc_ok) {
             crm_warn("%s notification of client %s failed: %s "
@@ -351,6 +369,7 @@ do_stonith_notify(int options, const char *type, int result, xmlNode * data)
 {
     /* TODO: Standardize the contents of data */
     xmlNode *update_msg = create_xml_node(NULL, "notify");
+    struct stonith_notification_s update;
 
     CRM_CHECK(type != NULL,;);
 
@@ -364,7 +383,10 @@ do_stonith_notify(int options, const char *type, int result, xmlNode * data)
     }
 
     crm_trace("Notifying clients");
-    pcmk__foreach_ipc_client(stonith_notify_client, update_msg);
+    update.msg = update_msg;
+    update.iov = NULL;
+    pcmk__foreach_ipc_client(stonith_notify_client, &update);
+    pcmk_free_ipc_event(update.iov);
     free_xml(update_msg);
     crm_trace("Notify complete");
 }
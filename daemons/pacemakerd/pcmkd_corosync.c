@@ -106,6 +106,13 @@ cluster_connect_cfg(uint32_t * nodeid)
         .destroy = cfg_connection_destroy,
     };
 
+    if (pcmk__cluster_is_emulated()) {
+        // There is no corosync to shut down with us
+        *nodeid = get_local_nodeid(0);
+        crm_debug("Our emulated nodeid: %d", *nodeid);
+        return (*nodeid != 0);
+    }
+
     cs_repeat(retries, 30, rc = corosync_cfg_initialize(&cfg_handle, &cfg_callbacks));
 
     if (rc != CS_OK) {
@@ -184,6 +191,13 @@ mcp_read_config(void)
     pid_t found_pid = 0;
     int rv;
 
+    if (pcmk__cluster_is_emulated()) {
+        crm_info("Using cluster layer emulation instead of Corosync");
+        pcmk__set_env_option("cluster_type", "corosync");
+        pcmk__set_env_option("quorum_type", "corosync");
+        return TRUE;
+    }
+
     // There can be only one possibility
     do {
         rc = cmap_initialize(&local_handle);
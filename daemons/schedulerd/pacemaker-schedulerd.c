@@ -50,6 +50,120 @@ series_t series[] = {
 
 void pengine_shutdown(int nsig);
 
+/* The last input each client sent is kept, so that the client can send later
+ * inputs as a patchset against it
+ */
+static struct last_input_s {
+    char *client_id;    // Client that sent input
+    char *ref;          // Reference of request input was sent with
+    xmlNode *input;     // Full input (as received, before any processing)
+} last_input = { NULL, NULL, NULL };
+
+static void
+forget_last_input(void)
+{
+    free(last_input.client_id);
+    last_input.client_id = NULL;
+    free(last_input.ref);
+    last_input.ref = NULL;
+    free_xml(last_input.input);
+    last_input.input = NULL;
+}
+
+/*!
+ * \internal
+ * \brief Get the full scheduler input for a calculation request
+ *
+ * \param[in] msg       Request
+ * \param[in] xml_data  Request data (full CIB, or patchset from a previous
+ *                      input if the request specifies one)
+ * \param[in] sender    Client that sent request
+ *
+ * \return Newly allocated full input, or NULL if it could not be determined
+ */
+static xmlNode *
+request_input(xmlNode *msg, xmlNode *xml_data, pcmk__client_t *sender)
+{
+    int rc = pcmk_ok;
+    int add[] = { 0, 0, 0 };
+    int del[] = { 0, 0, 0 };
+    int have[] = { 0, 0, 0 };
+    const char *ref = crm_element_value(msg, F_CRM_REFERENCE);
+    const char *base = crm_element_value(msg, F_CRM_TGRAPH_BASE);
+
+    if (xml_data == NULL) {
+        return NULL;
+
+    } else if (base == NULL) {
+        forget_last_input();
+        last_input.client_id = strdup(sender->id);
+        last_input.ref = (ref? strdup(ref) : NULL);
+        last_input.input = copy_xml(xml_data);
+        return copy_xml(xml_data);
+    }
+
+    if ((last_input.input == NULL)
+        || safe_str_neq(sender->id, last_input.client_id)
+        || safe_str_neq(base, last_input.ref)) {
+        crm_info("Cannot use input patchset for %s: Input %s is not available",
+                 crm_str(ref), base);
+        forget_last_input();
+        return NULL;
+    }
+
+    /* Only check that the patchset starts from the retained version, because
+     * the versions are unchanged if only values added by the DC changed
+     */
+    xml_patch_versions(xml_data, add, del);
+    crm_element_value_int(last_input.input, XML_ATTR_GENERATION_ADMIN,
+                          &have[0]);
+    crm_element_value_int(last_input.input, XML_ATTR_GENERATION, &have[1]);
+    crm_element_value_int(last_input.input, XML_ATTR_NUMUPDATES, &have[2]);
+    if ((have[0] != del[0]) || (have[1] != del[1]) || (have[2] != del[2])) {
+        crm_info("Cannot use input patchset for %s: It applies to %d.%d.%d "
+                 "not %d.%d.%d", crm_str(ref), del[0], del[1], del[2],
+                 have[0], have[1], have[2]);
+        forget_last_input();
+        return NULL;
+    }
+
+    rc = xml_apply_patchset(last_input.input, xml_data, FALSE);
+    if (rc != pcmk_ok) {
+        crm_warn("Cannot use input patchset for %s: %s " CRM_XS " rc=%d",
+                 crm_str(ref), pcmk_strerror(rc), rc);
+        forget_last_input();
+        return NULL;
+    }
+
+    crm_trace("Applied input patchset for %s (%d.%d.%d -> %d.%d.%d)",
+              crm_str(ref), del[0], del[1], del[2], add[0], add[1], add[2]);
+    free(last_input.ref);
+    last_input.ref = (ref? strdup(ref) : NULL);
+    return copy_xml(last_input.input);
+}
+
+/*!
+ * \internal
+ * \brief Ask a client to resend a request with the full input
+ *
+ * \param[in] msg     Request
+ * \param[in] sender  Client that sent request
+ */
+static void
+request_full_input(xmlNode *msg, pcmk__client_t *sender)
+{
+    xmlNode *reply = create_reply(msg, NULL);
+
+    CRM_ASSERT(reply != NULL);
+    crm_xml_add(reply, F_CRM_TGRAPH_RESEND, XML_BOOLEAN_TRUE);
+    if (pcmk__ipc_send_xml(sender, 0, reply,
+                           crm_ipc_server_event) != pcmk_rc_ok) {
+        crm_err("Could not ask %s to resend scheduler input",
+                pcmk__client_name(sender));
+    }
+    free_xml(reply);
+}
+
 static gboolean
 process_pe_message(xmlNode *msg, xmlNode *xml_data, pcmk__client_t *sender)
 {
@@ -82,11 +196,19 @@ process_pe_message(xmlNode *msg, xmlNode *xml_data, pcmk__client_t *sender)
         char *digest = NULL;
         const char *value = NULL;
         time_t execution_date = time(NULL);
+        xmlNode *input = NULL;
         xmlNode *converted = NULL;
         xmlNode *reply = NULL;
         gboolean is_repoke = FALSE;
         gboolean process = TRUE;
 
+        input = request_input(msg, xml_data, sender);
+        if (input == NULL) {
+            request_full_input(msg, sender);
+            return TRUE;
+        }
+        xml_data = input;
+
         crm_config_error = FALSE;
         crm_config_warning = FALSE;
 
@@ -147,8 +269,18 @@ process_pe_message(xmlNode *msg, xmlNode *xml_data, pcmk__client_t *sender)
                   series[series_id].name, series_wrap, seq, value);
 
         sched_data_set->input = NULL;
-        reply = create_reply(msg, sched_data_set->graph);
-        CRM_ASSERT(reply != NULL);
+        if (safe_str_eq(crm_element_value(msg, F_CRM_TGRAPH_FORMAT),
+                        "compact")) {
+            char *compact = pcmk__graph_compact_encode(sched_data_set->graph);
+
+            reply = create_reply(msg, NULL);
+            CRM_ASSERT(reply != NULL);
+            crm_xml_add(reply, F_CRM_TGRAPH_COMPACT, compact);
+            g_free(compact);
+        } else {
+            reply = create_reply(msg, sched_data_set->graph);
+            CRM_ASSERT(reply != NULL);
+        }
 
         if (is_repoke == FALSE) {
             free(filename);
@@ -180,6 +312,7 @@ process_pe_message(xmlNode *msg, xmlNode *xml_data, pcmk__client_t *sender)
 
             free(graph_file);
             free_xml(first_named_child(reply, F_CRM_DATA));
+            xml_remove_prop(reply, F_CRM_TGRAPH_COMPACT);
             CRM_ASSERT(pcmk__ipc_send_xml(sender, 0, reply,
                                           crm_ipc_server_event) == pcmk_rc_ok);
         }
@@ -199,6 +332,7 @@ process_pe_message(xmlNode *msg, xmlNode *xml_data, pcmk__client_t *sender)
         }
 
         free_xml(converted);
+        free_xml(input);
     }
 
     return TRUE;
@@ -217,20 +351,104 @@ pe_ipc_accept(qb_ipcs_connection_t * c, uid_t uid, gid_t gid)
 gboolean process_pe_message(xmlNode *msg, xmlNode *xml_data,
                             pcmk__client_t *sender);
 
+/* Compressed requests (typically those with a large CIB) are decompressed in a
+ * worker thread, so requests wait here to be processed in the order received
+ */
+typedef struct pe_request_s {
+    char *client_id;        // Client that sent request
+    pcmk__ipc_raw_t *raw;   // Request text
+    int rc;                 // Result of decompression
+    bool ready;             // Whether request can be processed
+} pe_request_t;
+
+static GQueue *pending_requests = NULL;
+
+static void
+free_request(pe_request_t *request)
+{
+    free(request->client_id);
+    pcmk__free_ipc_raw(request->raw);
+    free(request);
+}
+
+static void
+process_pending_requests(void)
+{
+    pe_request_t *request = NULL;
+
+    while (((request = g_queue_peek_head(pending_requests)) != NULL)
+           && request->ready) {
+
+        pcmk__client_t *c = pcmk__find_client_by_id(request->client_id);
+
+        g_queue_pop_head(pending_requests);
+        if (c == NULL) {
+            crm_info("Discarding request from disconnected client %s",
+                     request->client_id);
+
+        } else if (request->rc != pcmk_rc_ok) {
+            crm_err("Discarding request from %s: Could not decompress it: %s "
+                    CRM_XS " rc=%d", pcmk__client_name(c),
+                    pcmk_rc_str(request->rc), request->rc);
+
+        } else {
+            xmlNode *msg = pcmk__ipc_raw2xml(request->raw);
+
+            if (msg != NULL) {
+                process_pe_message(msg, get_message_xml(msg, F_CRM_DATA), c);
+                free_xml(msg);
+            }
+        }
+        free_request(request);
+    }
+}
+
+// Runs in a worker thread (see pcmk__offload())
+static void
+decompress_request(gpointer data)
+{
+    pe_request_t *request = data;
+
+    request->rc = pcmk__ipc_raw_decompress(request->raw);
+}
+
+static void
+request_decompressed(gpointer data)
+{
+    ((pe_request_t *) data)->ready = true;
+    process_pending_requests();
+}
+
 static int32_t
 pe_ipc_dispatch(qb_ipcs_connection_t * qbc, void *data, size_t size)
 {
     uint32_t id = 0;
     uint32_t flags = 0;
     pcmk__client_t *c = pcmk__find_client(qbc);
-    xmlNode *msg = pcmk__client_data2xml(c, data, &id, &flags);
+    pcmk__ipc_raw_t *raw = pcmk__client_data2raw(c, data, &id, &flags);
+    pe_request_t *request = NULL;
 
     pcmk__ipc_send_ack(c, id, flags, "ack");
-    if (msg != NULL) {
-        xmlNode *data_xml = get_message_xml(msg, F_CRM_DATA);
+    if (raw == NULL) {
+        return 0;
+    }
+
+    request = calloc(1, sizeof(pe_request_t));
+    CRM_ASSERT(request != NULL);
+    request->client_id = strdup(c->id);
+    request->raw = raw;
 
-        process_pe_message(msg, data_xml, c);
-        free_xml(msg);
+    if (pending_requests == NULL) {
+        pending_requests = g_queue_new();
+    }
+    g_queue_push_tail(pending_requests, request);
+
+    if (raw->size_compressed > 0) {
+        pcmk__offload("scheduler input decompression", decompress_request,
+                      request_decompressed, request);
+    } else {
+        request->ready = true;
+        process_pending_requests();
     }
     return 0;
 }
@@ -245,6 +463,9 @@ pe_ipc_closed(qb_ipcs_connection_t * c)
         return 0;
     }
     crm_trace("Connection %p", c);
+    if (safe_str_eq(client->id, last_input.client_id)) {
+        forget_last_input();
+    }
     pcmk__free_client(client);
     return 0;
 }
@@ -28,6 +28,9 @@
 #  define CIB_OP_APPLY_DIFF "cib_apply_diff"
 #  define CIB_OP_UPGRADE    "cib_upgrade"
 #  define CIB_OP_DELETE_ALT	"cib_delete_alt"
+#  define CIB_OP_SYNC_DIFF	"cib_sync_diff"
+#  define CIB_OP_HISTORY	"cib_history"
+#  define CIB_OP_STATS	"cib_stats"
 
 #  define F_CIB_CLIENTID  "cib_clientid"
 #  define F_CIB_CALLOPTS  "cib_callopt"
@@ -57,6 +60,7 @@
 #  define F_CIB_LOCAL_NOTIFY_ID	"cib_local_notify_id"
 #  define F_CIB_PING_ID         "cib_ping_id"
 #  define F_CIB_SCHEMA_MAX      "cib_schema_max"
+#  define F_CIB_FORWARDED       "cib_forwarded"
 
 #  define T_CIB			"cib"
 #  define T_CIB_NOTIFY		"cib_notify"
@@ -66,6 +70,12 @@
 #  define T_CIB_UPDATE_CONFIRM	"cib_update_confirmation"
 #  define T_CIB_REPLACE_NOTIFY	"cib_refresh_notify"
 
+/* Not a notification: registering for this tells the CIB manager that the
+ * client recovers from missed diff notifications via cib_catch_up(), so
+ * superseded diffs may be dropped when it falls behind
+ */
+#  define T_CIB_CATCH_UP	"cib_catch_up"
+
 #  define CIB_CHANNEL_RO		"cib_ro"
 #  define CIB_CHANNEL_RW		"cib_rw"
 #  define CIB_CHANNEL_SHM		"cib_shm"
@@ -120,6 +130,7 @@ xmlNode *cib_create_op(int call_id, const char *token, const char *op, const cha
 void cib_native_callback(cib_t * cib, xmlNode * msg, int call_id, int rc);
 void cib_native_notify(gpointer data, gpointer user_data);
 int cib_native_register_notification(cib_t * cib, const char *callback, int enabled);
+void cib_native_set_async_ipc(cib_t *cib, bool enable);
 gboolean cib_client_register_callback(cib_t * cib, int call_id, int timeout, gboolean only_success,
                                       void *user_data, const char *callback_name,
                                       void (*callback) (xmlNode *, int, int, xmlNode *, void *));
@@ -198,6 +209,8 @@ int cib_internal_op(cib_t * cib, const char *op, const char *host,
                     const char *section, xmlNode * data,
                     xmlNode ** output_data, int call_options, const char *user_name);
 
+int cib_catch_up(cib_t *cib, xmlNode *xml, int call_options);
+
 
 int cib_file_read_and_verify(const char *filename, const char *sigfile,
                              xmlNode **root);
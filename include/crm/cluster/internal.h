@@ -312,6 +312,9 @@ enum cluster_type_e find_corosync_variant(void);
 void terminate_cs_connection(crm_cluster_t * cluster);
 gboolean init_cs_connection(crm_cluster_t * cluster);
 gboolean init_cs_connection_once(crm_cluster_t * cluster);
+
+bool pcmk__cluster_is_emulated(void);
+int pcmk__cluster_emulator_run(GMainLoop *mainloop, unsigned int expected);
 #  endif
 
 crm_node_t *crm_update_peer_proc(const char *source, crm_node_t * peer,
@@ -17,6 +17,7 @@
 #include <sys/types.h>  // uid_t, gid_t, pid_t
 
 #include <crm/common/logging.h>
+#include <crm/common/mainloop.h>  // crm_trigger_t
 
 
 #if SUPPORT_CIBSECRETS
@@ -50,16 +51,29 @@ const char *pcmk__get_tmpdir(void);
 void pcmk__close_fds_in_child(bool);
 
 
+/* internal main loop utilities (from mainloop.c) */
+
+void pcmk__mainloop_trigger_set_name(crm_trigger_t *trigger, const char *name);
+void pcmk__mainloop_stats_log(void);
+xmlNode *pcmk__mainloop_stats_xml(xmlNode *parent);
+void pcmk__offload(const char *name, void (*work)(gpointer data),
+                   void (*done)(gpointer data), gpointer data);
+
+
 /* internal procfs utilities (from procfs.c) */
 
 pid_t pcmk__procfs_pid_of(const char *name);
 unsigned int pcmk__procfs_num_cores(void);
+int pcmk__procfs_pressure(const char *path, float *avg10);
+int pcmk__procfs_cgroup_cpu_stat(unsigned long long *usage_us,
+                                 unsigned long long *throttled_us);
 
 
 /* internal XML schema functions (from xml.c) */
 
 void crm_schema_init(void);
 void crm_schema_cleanup(void);
+gboolean pcmk__validate_cib_without_status(xmlNode *cib, gboolean to_logs);
 
 
 /* internal functions related to process IDs (from pid.c) */
@@ -101,6 +115,7 @@ void filter_action_parameters(xmlNode *param_set, const char *version);
 // miscellaneous utilities (from utils.c)
 
 const char *pcmk_message_name(const char *name);
+char *pcmk__md5sum(const char *buffer);
 
 
 /* internal generic string functions (from strings.c) */
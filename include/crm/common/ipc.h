@@ -41,14 +41,18 @@ enum crm_ipc_flags
     crm_ipc_flags_none      = 0x00000000,
 
     crm_ipc_compressed      = 0x00000001, /* Message has been compressed */
+    crm_ipc_multipart       = 0x00000002, /* Message is one part of a larger one */
+    crm_ipc_multipart_end   = 0x00000004, /* Message is the last such part */
 
     crm_ipc_proxied         = 0x00000100, /* _ALL_ replies to proxied connections need to be sent as events */
     crm_ipc_client_response = 0x00000200, /* A Response is expected in reply */
+    crm_ipc_client_async    = 0x00000400, /* Send the response as an event tagged with the request ID */
 
     // These are options only for pcmk__ipc_send_iov()
     crm_ipc_server_event    = 0x00010000, /* Send an Event instead of a Response */
     crm_ipc_server_free     = 0x00020000, /* Free the iovec after sending */
     crm_ipc_proxied_relay_response = 0x00040000, /* all replies to proxied connections are sent as events, this flag preserves whether the event should be treated as an actual event, or a response.*/
+    crm_ipc_server_coalesce = 0x00080000, /* Event may be dropped if a later such event is queued while the client is falling behind */
 
     crm_ipc_server_info     = 0x00100000, /* Log failures as LOG_INFO */
     crm_ipc_server_error    = 0x00200000, /* Log failures as LOG_ERR */
@@ -10,9 +10,12 @@
 #ifndef PCMK__IPC_INTERNAL_H
 #define PCMK__IPC_INTERNAL_H
 
+#include <stdbool.h>
 #include <sys/types.h>
+#include <glib.h>
 
 #include <crm_config.h>  /* US_AUTH_GETPEEREID */
+#include <crm/common/ipc.h>
 
 
 /* denotes "non yieldable PID" on FreeBSD, or actual PID1 in scenarios that
@@ -69,4 +72,41 @@
 int pcmk__ipc_is_authentic_process_active(const char *name, uid_t refuid,
                                           gid_t refgid, pid_t *gotpid);
 
+/*!
+ * \internal
+ * \brief Callback for the response to an asynchronous IPC request
+ *
+ * \param[in] client      IPC connection the request was sent on
+ * \param[in] request_id  ID of request
+ * \param[in] rc          Standard Pacemaker return code
+ * \param[in] reply       Response (NULL unless \p rc is pcmk_rc_ok)
+ * \param[in] user_data   Data given when request was sent
+ */
+typedef void (*pcmk__ipc_reply_fn_t)(crm_ipc_t *client, uint32_t request_id,
+                                     int rc, xmlNode *reply, void *user_data);
+
+int pcmk__ipc_send_async(crm_ipc_t *client, xmlNode *message, uint32_t flags,
+                         int ms_timeout, pcmk__ipc_reply_fn_t callback,
+                         void *user_data, uint32_t *request_id);
+bool pcmk__ipc_dispatch_async_reply(crm_ipc_t *client);
+guint pcmk__ipc_async_pending(crm_ipc_t *client);
+
+#define PCMK__IPC_LATENCY_BUCKETS 16
+
+/* Latency of synchronous requests to an IPC server, as seen by its clients */
+typedef struct pcmk__ipc_latency_s {
+    unsigned long long count;       // Requests that expected a reply
+    unsigned long long failed;      // Requests that got no reply
+    unsigned long long total_us;
+    unsigned long long max_us;
+
+    /* buckets[i] counts requests that took less than 2^i milliseconds and at
+     * least 2^(i-1); the last bucket also counts anything slower
+     */
+    unsigned long long buckets[PCMK__IPC_LATENCY_BUCKETS];
+} pcmk__ipc_latency_t;
+
+xmlNode *pcmk__ipc_latency_xml(xmlNode *parent);
+void pcmk__ipc_latency_cleanup(int log_level);
+
 #endif
@@ -80,6 +80,10 @@ struct pcmk__client_s {
     int event_timer;
     GQueue *event_queue;
 
+    int response_timer;
+    GQueue *response_queue;     /* Responses that didn't fit in IPC buffer yet */
+    GHashTable *async_requests; /* IDs of requests to respond to with events */
+
     /* Depending on the value of kind, only some of the following
      * will be populated/valid
      */
@@ -90,9 +94,26 @@ struct pcmk__client_s {
     struct pcmk__remote_s *remote;        /* TCP/TLS */
 
     unsigned int queue_backlog; /* IPC queue length after last flush */
+    unsigned int queue_messages; /* Messages in IPC queue (a message sent in
+                                  * parts counts once)
+                                  */
     unsigned int queue_max;     /* Evict client whose queue grows this big */
+    size_t queue_bytes;         /* Size of messages in IPC queue */
+    size_t queue_max_bytes;     /* Evict client whose queue grows this big */
 };
 
+/* Event queue activity of all IPC clients of this daemon */
+typedef struct pcmk__ipc_queue_stats_s {
+    unsigned long long events;      // Events queued (counting parts as one)
+    unsigned long long bytes;       // Bytes queued
+    unsigned long long coalesced;   // Events dropped in favor of a newer one
+    unsigned long long evictions;   // Clients evicted for their backlog
+    unsigned int max_depth;         // Most events queued for one client
+    size_t max_bytes;               // Most bytes queued for one client
+} pcmk__ipc_queue_stats_t;
+
+const pcmk__ipc_queue_stats_t *pcmk__ipc_queue_stats(void);
+
 guint pcmk__ipc_client_count(void);
 void pcmk__foreach_ipc_client(GHFunc func, gpointer user_data);
 void pcmk__foreach_ipc_client_remove(GHRFunc func, gpointer user_data);
@@ -123,6 +144,20 @@ int pcmk__ipc_send_xml(pcmk__client_t *c, uint32_t request, xmlNode *message,
 int pcmk__ipc_send_iov(pcmk__client_t *c, struct iovec *iov, uint32_t flags);
 xmlNode *pcmk__client_data2xml(pcmk__client_t *c, void *data,
                                uint32_t *id, uint32_t *flags);
+void pcmk__client_forget_async(pcmk__client_t *c, uint32_t id);
+
+// Message text received from a client but not yet parsed
+typedef struct pcmk__ipc_raw_s {
+    char *text;                     // Compressed if size_compressed > 0
+    unsigned int size_compressed;
+    unsigned int size_uncompressed;
+} pcmk__ipc_raw_t;
+
+pcmk__ipc_raw_t *pcmk__client_data2raw(pcmk__client_t *c, void *data,
+                                       uint32_t *id, uint32_t *flags);
+int pcmk__ipc_raw_decompress(pcmk__ipc_raw_t *raw);
+xmlNode *pcmk__ipc_raw2xml(pcmk__ipc_raw_t *raw);
+void pcmk__free_ipc_raw(pcmk__ipc_raw_t *raw);
 
 int pcmk__client_pid(qb_ipcs_connection_t *c);
 
@@ -163,4 +163,31 @@ pcmk__xml_artefact_root(enum pcmk__xml_artefact_ns ns);
 char *pcmk__xml_artefact_path(enum pcmk__xml_artefact_ns ns,
                               const char *filespec);
 
+//! Deepest CIB element of interest that an XPath may refer to
+enum pcmk__cib_path_type {
+    pcmk__cib_path_other,           //!< Not a recognized CIB path
+    pcmk__cib_path_cib,             //!< CIB root or unrecognized child
+    pcmk__cib_path_configuration,   //!< Configuration section or below
+    pcmk__cib_path_status,          //!< Status section
+    pcmk__cib_path_tickets,         //!< Ticket state or below
+    pcmk__cib_path_node_state,      //!< Node state
+    pcmk__cib_path_transient,       //!< Transient node attributes or below
+    pcmk__cib_path_lrm,             //!< Resource history for a node
+    pcmk__cib_path_lrm_resources,   //!< Resource history list
+    pcmk__cib_path_lrm_resource,    //!< History of one resource
+    pcmk__cib_path_lrm_rsc_op,      //!< Operation history entry or below
+};
+
+//! Result of parsing a CIB XPath (see pcmk__parse_cib_path())
+typedef struct pcmk__cib_path_s {
+    enum pcmk__cib_path_type type;
+    const char *node;   //!< ID of node_state (or lrm) element, if any
+    const char *rsc;    //!< ID of lrm_resource element, if any
+    const char *op;     //!< ID of lrm_rsc_op element, if any
+    char *buf;          //!< Storage for IDs (for internal use only)
+} pcmk__cib_path_t;
+
+int pcmk__parse_cib_path(const char *xpath, pcmk__cib_path_t *path);
+void pcmk__free_cib_path(pcmk__cib_path_t *path);
+
 #endif
@@ -67,9 +67,14 @@ extern "C" {
 #  define F_CRM_ELECTION_OWNER		"election-owner"
 #  define F_CRM_TGRAPH			"crm-tgraph-file"
 #  define F_CRM_TGRAPH_INPUT		"crm-tgraph-in"
+#  define F_CRM_TGRAPH_BASE		"crm-tgraph-base"
+#  define F_CRM_TGRAPH_RESEND		"crm-tgraph-resend"
+#  define F_CRM_TGRAPH_FORMAT		"crm-tgraph-format"
+#  define F_CRM_TGRAPH_COMPACT		"crm-tgraph-compact"
 
 #  define F_CRM_THROTTLE_MODE		"crm-limit-mode"
 #  define F_CRM_THROTTLE_MAX		"crm-limit-max"
+#  define F_CRM_THROTTLE_JOBS		"crm-limit-jobs"
 
 /*---- Common tags/attrs */
 #  define XML_DIFF_MARKER		"__crm_diff_marker__"
@@ -201,6 +201,7 @@ void crm_xml_dump(xmlNode * data, int options, char **buffer, int *offset, int *
 void crm_buffer_add_char(char **buffer, int *offset, int *max, char c);
 
 bool pcmk__verify_digest(xmlNode *input, const char *expected);
+char *pcmk__digest_input(xmlNode *input, bool do_filter);
 
 /* IPC Proxy Backend Shared Functions */
 typedef struct remote_proxy_s {
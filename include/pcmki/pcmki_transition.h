@@ -31,6 +31,7 @@ typedef struct crm_graph_s crm_graph_t;
 typedef struct synapse_s {
     int id;
     int priority;
+    int depth;                  /* critical path depth, if calculated */
 
     gboolean ready;
     gboolean failed;
@@ -101,6 +102,23 @@ struct crm_graph_s {
     GListPtr synapses;          /* synapse_t* */
 
     int migration_limit;
+
+    /* Indexes built by unpack_graph(), so that events can be matched to
+     * actions without searching the whole graph
+     */
+    GHashTable *actions;        /* action ID -> crm_action_t* */
+    GHashTable *dependents;     /* action ID -> GQueue of synapse_t* using it
+                                 * as an input */
+    GHashTable *cancels;        /* task key -> GQueue of cancel crm_action_t* */
+    GHashTable *downed;         /* node UUID -> GQueue of crm_action_t* that
+                                 * make the node down */
+
+    /* Synapses not yet confirmed (in the same order as synapses), and the
+     * number of confirmed (and confirmed but failed) synapses removed from it
+     */
+    GList *active_synapses;
+    int pruned;
+    int pruned_failed;
 };
 
 typedef struct crm_graph_functions_s {
@@ -124,6 +142,17 @@ enum transition_status {
 void set_default_graph_functions(void);
 void set_graph_functions(crm_graph_functions_t * fns);
 crm_graph_t *unpack_graph(xmlNode * xml_graph, const char *reference);
+void pcmk__sort_graph_critical_path(crm_graph_t *graph);
+synapse_t *pcmk__new_synapse(crm_graph_t *graph, int id, int priority);
+crm_action_t *pcmk__add_synapse_action(crm_graph_t *graph, synapse_t *synapse,
+                                       xmlNode *xml);
+crm_action_t *pcmk__add_synapse_input(crm_graph_t *graph, synapse_t *synapse,
+                                      xmlNode *xml);
+char *pcmk__graph_compact_encode(xmlNode *xml_graph);
+crm_graph_t *pcmk__unpack_compact_graph(const char *encoded,
+                                        const char *reference,
+                                        xmlNode **graph_attrs);
+crm_action_t *pcmk__find_graph_action(crm_graph_t *graph, int id);
 int run_graph(crm_graph_t * graph);
 gboolean update_graph(crm_graph_t * graph, crm_action_t * action);
 void destroy_graph(crm_graph_t * graph);
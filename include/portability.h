@@ -82,6 +82,33 @@ g_list_free_full(GList * list, GDestroyNotify free_func)
 }
 #  endif
 
+#  if !GLIB_CHECK_VERSION(2,28,0)
+#    include <time.h>
+/* Since: 2.28 */
+static inline gint64
+g_get_monotonic_time(void)
+{
+    struct timespec ts;
+
+#    ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#    else
+    clock_gettime(CLOCK_REALTIME, &ts);
+#    endif
+    return (((gint64) ts.tv_sec) * 1000000) + (ts.tv_nsec / 1000);
+}
+#  endif
+
+#  if !GLIB_CHECK_VERSION(2,32,0)
+/* Since: 2.32 */
+static inline void
+g_queue_free_full(GQueue * queue, GDestroyNotify free_func)
+{
+    g_queue_foreach(queue, (GFunc) free_func, NULL);
+    g_queue_free(queue);
+}
+#  endif
+
 #  if SUPPORT_DBUS
 #    ifndef HAVE_DBUSBASICVALUE
 #      include <stdint.h>
@@ -29,12 +29,14 @@
 
 #include <crm/msg_xml.h>
 #include <crm/common/mainloop.h>
+#include <crm/common/ipc_internal.h>
 
 typedef struct cib_native_opaque_s {
     char *token;
     crm_ipc_t *ipc;
     void (*dnotify_fn) (gpointer user_data);
     mainloop_io_t *source;
+    bool async_ipc;     // Whether non-synchronous calls use pcmk__ipc_send_async()
 
 } cib_native_opaque_t;
 
@@ -144,7 +146,8 @@ cib_native_dispatch(cib_t * cib)
     native = cib->variant_opaque;
     while (crm_ipc_ready(native->ipc)) {
 
-        if (crm_ipc_read(native->ipc) > 0) {
+        if ((crm_ipc_read(native->ipc) > 0)
+            && !pcmk__ipc_dispatch_async_reply(native->ipc)) {
             const char *msg = crm_ipc_buffer(native->ipc);
 
             cib_native_dispatch_internal(msg, strlen(msg), cib);
@@ -331,6 +334,82 @@ cib_native_perform_op(cib_t * cib, const char *op, const char *host, const char
                                           data, output_data, call_options, NULL);
 }
 
+static void
+cib_native_async_reply(crm_ipc_t *ipc, uint32_t request_id, int rc,
+                       xmlNode *reply, void *user_data)
+{
+    if (rc != pcmk_rc_ok) {
+        /* The CIB call's own timeout (if any) will report the failure */
+        crm_trace("No reply to CIB IPC request %u: %s",
+                  request_id, pcmk_rc_str(rc));
+        return;
+    }
+    crm_log_xml_explicit(reply, "cib-reply");
+    cib_native_callback((cib_t *) user_data, reply, 0, 0);
+}
+
+/*!
+ * \internal
+ * \brief Send an asynchronous CIB request
+ *
+ * Any number of asynchronous requests may be in flight at once. Each reply is
+ * matched to its IPC request and passed to cib_native_callback(), which calls
+ * any callback registered for the call ID.
+ *
+ * \param[in] cib     CIB connection
+ * \param[in] op_msg  CIB request
+ *
+ * \return Legacy Pacemaker return code
+ */
+static int
+cib_native_send_async(cib_t *cib, xmlNode *op_msg)
+{
+    cib_native_opaque_t *native = cib->variant_opaque;
+    int rc = pcmk_rc_ok;
+
+    /* Let the CIB manager know how long to keep track of the request, in case
+     * it never replies
+     */
+    crm_xml_add_int(op_msg, F_CIB_TIMEOUT, cib->call_timeout);
+    rc = pcmk__ipc_send_async(native->ipc, op_msg, crm_ipc_flags_none,
+                              cib->call_timeout * 1000,
+                              cib_native_async_reply, cib, NULL);
+    if (rc != pcmk_rc_ok) {
+        crm_err("Couldn't send asynchronous CIB request: %s " CRM_XS " rc=%d",
+                pcmk_rc_str(rc), rc);
+        return -ECOMM;
+    }
+    crm_trace("Async call %d sent (%u in flight)",
+              cib->call_id, pcmk__ipc_async_pending(native->ipc));
+    return cib->call_id;
+}
+
+/*!
+ * \internal
+ * \brief Choose whether a CIB connection sends asynchronous calls without
+ *        waiting for the IPC acknowledgement
+ *
+ * By default, each asynchronous call waits for the CIB manager to acknowledge
+ * it, so only one IPC request is ever outstanding. That is required when the
+ * connection may be relayed by a Pacemaker Remote proxy, which tracks a single
+ * request ID per client. Local clients that issue many calls can enable this
+ * to keep any number of them in flight.
+ *
+ * \param[in] cib     CIB connection
+ * \param[in] enable  Whether to send asynchronous calls without waiting
+ */
+void
+cib_native_set_async_ipc(cib_t *cib, bool enable)
+{
+    cib_native_opaque_t *native = NULL;
+
+    if ((cib == NULL) || (cib->variant != cib_native)) {
+        return;
+    }
+    native = cib->variant_opaque;
+    native->async_ipc = enable;
+}
+
 int
 cib_native_perform_op_delegate(cib_t * cib, const char *op, const char *host, const char *section,
                                xmlNode * data, xmlNode ** output_data, int call_options,
@@ -380,6 +459,13 @@ cib_native_perform_op_delegate(cib_t * cib, const char *op, const char *host, co
         return -EPROTO;
     }
 
+    if (native->async_ipc && !(call_options & cib_sync_call)) {
+        crm_trace("Sending asynchronous %s message to the CIB manager", op);
+        rc = cib_native_send_async(cib, op_msg);
+        free_xml(op_msg);
+        return rc;
+    }
+
     crm_trace("Sending %s message to the CIB manager (timeout=%ds)", op, cib->call_timeout);
     rc = crm_ipc_send(native->ipc, op_msg, ipc_flags, cib->call_timeout * 1000, &op_reply);
     free_xml(op_msg);
@@ -201,6 +201,45 @@ cib_acl_enabled(xmlNode *xml, const char *user)
     return rc;
 }
 
+/*!
+ * \internal
+ * \brief Check whether a patchset changes nothing outside the status section
+ *
+ * \param[in] patchset  Patchset to check
+ *
+ * \return TRUE if \p patchset is in v2 format and all its changes are
+ *         within the status section, otherwise FALSE
+ */
+static gboolean
+patchset_only_changes_status(xmlNode *patchset)
+{
+    int format = 1;
+    const char *status_path = "/" XML_TAG_CIB "/" XML_CIB_TAG_STATUS;
+    size_t status_len = strlen(status_path);
+
+    crm_element_value_int(patchset, "format", &format);
+    if (format != 2) {
+        return FALSE;
+    }
+
+    for (xmlNode *change = __xml_first_child_element(patchset); change != NULL;
+         change = __xml_next_element(change)) {
+        const char *path = NULL;
+
+        if (strcmp((const char *) change->name, XML_DIFF_CHANGE) != 0) {
+            continue; // e.g. version
+        }
+
+        path = crm_element_value(change, XML_DIFF_PATH);
+        if ((path == NULL) || (strncmp(path, status_path, status_len) != 0)
+            || ((path[status_len] != '\0') && (path[status_len] != '/')
+                && (path[status_len] != '['))) {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
 int
 cib_perform_op(const char *op, int call_options, cib_op_t * fn, gboolean is_query,
                const char *section, xmlNode * req, xmlNode * input,
@@ -419,6 +458,14 @@ cib_perform_op(const char *op, int call_options, cib_op_t * fn, gboolean is_quer
          * b) we don't validate any of its contents at the moment anyway
          */
         check_schema = FALSE;
+
+    } else if (check_schema && local_diff && patchset_only_changes_status(local_diff)) {
+        /* Same reasoning for operations without a section that turned out to
+         * change only the status section (the schema itself can't have
+         * changed, since that would be a change to the cib element)
+         */
+        crm_trace("Skipping validation of status-only changes");
+        check_schema = FALSE;
     }
 
     /* === scratch must not be modified after this point ===
@@ -461,7 +508,8 @@ cib_perform_op(const char *op, int call_options, cib_op_t * fn, gboolean is_quer
     }
 
     crm_trace("Perform validation: %s", (check_schema? "true" : "false"));
-    if ((rc == pcmk_ok) && check_schema && !validate_xml(scratch, NULL, TRUE)) {
+    if ((rc == pcmk_ok) && check_schema
+        && !pcmk__validate_cib_without_status(scratch, TRUE)) {
         const char *current_schema = crm_element_value(scratch,
                                                        XML_ATTR_VALIDATION);
 
@@ -721,6 +769,65 @@ cib_apply_patch_event(xmlNode * event, xmlNode * input, xmlNode ** output, int l
     return rc;
 }
 
+/*!
+ * \internal
+ * \brief Bring a local copy of the CIB up to date from the manager's history
+ *
+ * Ask the CIB manager for the patchsets it has retained since the version of
+ * \p xml, and apply them in order. This is much cheaper than re-querying the
+ * whole CIB after missing some diff notifications.
+ *
+ * \param[in]     cib           Active CIB connection
+ * \param[in,out] xml           Local copy of the CIB to update
+ * \param[in]     call_options  Extra call options (cib_sync_call is implied)
+ *
+ * \return Standard Pacemaker return code (legacy)
+ * \note On failure, \p xml may have been partially updated and should be
+ *       replaced by a full query.
+ */
+int
+cib_catch_up(cib_t *cib, xmlNode *xml, int call_options)
+{
+    int rc = pcmk_ok;
+    int applied = 0;
+    xmlNode *version = NULL;
+    xmlNode *patches = NULL;
+    xmlNode *patch = NULL;
+    const char *vfields[] = {
+        XML_ATTR_GENERATION_ADMIN,
+        XML_ATTR_GENERATION,
+        XML_ATTR_NUMUPDATES,
+    };
+
+    CRM_CHECK((cib != NULL) && (xml != NULL), return -EINVAL);
+
+    version = create_xml_node(NULL, XML_DIFF_VERSION);
+    for (int lpc = 0; lpc < DIMOF(vfields); lpc++) {
+        crm_xml_add(version, vfields[lpc], crm_element_value(xml, vfields[lpc]));
+    }
+
+    rc = cib_internal_op(cib, CIB_OP_HISTORY, NULL, NULL, version, &patches,
+                         call_options|cib_sync_call, NULL);
+    free_xml(version);
+
+    if ((rc == pcmk_ok) && (patches == NULL)) {
+        rc = -ENODATA;
+    }
+
+    for (patch = __xml_first_child_element(patches);
+         (patch != NULL) && (rc == pcmk_ok);
+         patch = __xml_next_element(patch)) {
+
+        rc = xml_apply_patchset(xml, patch, TRUE);
+        applied++;
+    }
+
+    crm_debug("Applied %d retained patchset%s: %s " CRM_XS " rc=%d",
+              applied, pcmk__plural_s(applied), pcmk_strerror(rc), rc);
+    free_xml(patches);
+    return rc;
+}
+
 /* v2 and v2 patch formats */
 #define XPATH_CONFIG_CHANGE \
     "//" XML_CIB_TAG_CRMCONFIG " | " \
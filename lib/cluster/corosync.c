@@ -30,14 +30,64 @@
 #include <corosync/hdb.h>
 #include <corosync/cfg.h>
 #include <corosync/cmap.h>
+#include <corosync/cpg.h>
 #include <corosync/quorum.h>
 
 #include <crm/msg_xml.h>
 
 #include <crm/common/ipc_internal.h>  /* PCMK__SPECIAL_PID* */
 
+#include "crmcluster_private.h"
+
 quorum_handle_t pcmk_quorum_handle = 0;
 
+static const pcmk__cluster_backend_t corosync_backend = {
+    .name = "corosync",
+    .authenticate = true,
+    .has_cmap = true,
+
+    .cpg_initialize = cpg_initialize,
+    .cpg_fd_get = cpg_fd_get,
+    .cpg_local_get = cpg_local_get,
+    .cpg_join = cpg_join,
+    .cpg_leave = cpg_leave,
+    .cpg_dispatch = cpg_dispatch,
+    .cpg_mcast_joined = cpg_mcast_joined,
+    .cpg_flow_control_state_get = cpg_flow_control_state_get,
+    .cpg_finalize = cpg_finalize,
+
+    .quorum_initialize = quorum_initialize,
+    .quorum_fd_get = quorum_fd_get,
+    .quorum_getquorate = quorum_getquorate,
+    .quorum_trackstart = quorum_trackstart,
+    .quorum_dispatch = quorum_dispatch,
+    .quorum_finalize = quorum_finalize,
+
+    .node_name = NULL,
+};
+
+/*!
+ * \internal
+ * \brief Get the implementation of the corosync APIs to use
+ *
+ * \return Corosync itself, unless PCMK_cluster_emulation is set
+ */
+const pcmk__cluster_backend_t *
+pcmk__cluster_backend(void)
+{
+    static const pcmk__cluster_backend_t *backend = NULL;
+
+    if (backend == NULL) {
+        if (pcmk__cluster_is_emulated()) {
+            backend = pcmk__emulated_backend();
+            crm_notice("Using cluster layer emulation instead of Corosync");
+        } else {
+            backend = &corosync_backend;
+        }
+    }
+    return backend;
+}
+
 gboolean(*quorum_app_callback) (unsigned long long seq, gboolean quorate) = NULL;
 
 char *
@@ -71,6 +121,10 @@ corosync_node_name(uint64_t /*cmap_handle_t */ cmap_handle, uint32_t nodeid)
     pid_t found_pid = 0;
     int rv;
 
+    if (pcmk__cluster_backend()->node_name != NULL) {
+        return pcmk__cluster_backend()->node_name(nodeid);
+    }
+
     if (nodeid == 0) {
         nodeid = get_local_nodeid(0);
     }
@@ -173,9 +227,10 @@ bail:
 void
 terminate_cs_connection(crm_cluster_t *cluster)
 {
+    const pcmk__cluster_backend_t *backend = pcmk__cluster_backend();
     cluster_disconnect_cpg(cluster);
     if (pcmk_quorum_handle) {
-        quorum_finalize(pcmk_quorum_handle);
+        backend->quorum_finalize(pcmk_quorum_handle);
         pcmk_quorum_handle = 0;
     }
     crm_notice("Disconnected from Corosync");
@@ -184,9 +239,10 @@ terminate_cs_connection(crm_cluster_t *cluster)
 static int
 pcmk_quorum_dispatch(gpointer user_data)
 {
+    const pcmk__cluster_backend_t *backend = pcmk__cluster_backend();
     int rc = 0;
 
-    rc = quorum_dispatch(pcmk_quorum_handle, CS_DISPATCH_ALL);
+    rc = backend->quorum_dispatch(pcmk_quorum_handle, CS_DISPATCH_ALL);
     if (rc < 0) {
         crm_err("Connection to the Quorum API failed: %d", rc);
         pcmk_quorum_handle = 0;
@@ -271,6 +327,7 @@ gboolean
 cluster_connect_quorum(gboolean(*dispatch) (unsigned long long, gboolean),
                        void (*destroy) (gpointer))
 {
+    const pcmk__cluster_backend_t *backend = pcmk__cluster_backend();
     cs_error_t rc;
     int fd = 0;
     int quorate = 0;
@@ -286,7 +343,8 @@ cluster_connect_quorum(gboolean(*dispatch) (unsigned long long, gboolean),
 
     crm_debug("Configuring Pacemaker to obtain quorum from Corosync");
 
-    rc = quorum_initialize(&pcmk_quorum_handle, &quorum_callbacks, &quorum_type);
+    rc = backend->quorum_initialize(&pcmk_quorum_handle, &quorum_callbacks,
+                                    &quorum_type);
     if (rc != CS_OK) {
         crm_err("Could not connect to the Quorum API: %s (%d)",
                 cs_strerror(rc), rc);
@@ -297,7 +355,7 @@ cluster_connect_quorum(gboolean(*dispatch) (unsigned long long, gboolean),
         goto bail;
     }
 
-    rc = quorum_fd_get(pcmk_quorum_handle, &fd);
+    rc = backend->quorum_fd_get(pcmk_quorum_handle, &fd);
     if (rc != CS_OK) {
         crm_err("Could not obtain the Quorum API connection: %s (%d)",
                 strerror(rc), rc);
@@ -305,8 +363,12 @@ cluster_connect_quorum(gboolean(*dispatch) (unsigned long long, gboolean),
     }
 
     /* Quorum provider run as root (in given user namespace, anyway)? */
-    if (!(rv = crm_ipc_is_authentic_process(fd, (uid_t) 0,(gid_t) 0, &found_pid,
-                                            &found_uid, &found_gid))) {
+    if (!backend->authenticate) {
+        crm_trace("Not authenticating Quorum provider for %s", backend->name);
+
+    } else if (!(rv = crm_ipc_is_authentic_process(fd, (uid_t) 0,
+                                                   (gid_t) 0, &found_pid,
+                                                   &found_uid, &found_gid))) {
         crm_err("Quorum provider is not authentic:"
                 " process %lld (uid: %lld, gid: %lld)",
                 (long long) PCMK__SPECIAL_PID_AS_0(found_pid),
@@ -320,7 +382,7 @@ cluster_connect_quorum(gboolean(*dispatch) (unsigned long long, gboolean),
         goto bail;
     }
 
-    rc = quorum_getquorate(pcmk_quorum_handle, &quorate);
+    rc = backend->quorum_getquorate(pcmk_quorum_handle, &quorate);
     if (rc != CS_OK) {
         crm_err("Could not obtain the current Quorum API state: %d", rc);
         goto bail;
@@ -334,7 +396,8 @@ cluster_connect_quorum(gboolean(*dispatch) (unsigned long long, gboolean),
     quorum_app_callback = dispatch;
     crm_have_quorum = quorate;
 
-    rc = quorum_trackstart(pcmk_quorum_handle, CS_TRACK_CHANGES | CS_TRACK_CURRENT);
+    rc = backend->quorum_trackstart(pcmk_quorum_handle,
+                                    CS_TRACK_CHANGES | CS_TRACK_CURRENT);
     if (rc != CS_OK) {
         crm_err("Could not setup Quorum API notifications: %d", rc);
         goto bail;
@@ -346,7 +409,7 @@ cluster_connect_quorum(gboolean(*dispatch) (unsigned long long, gboolean),
 
   bail:
     if (rc != CS_OK) {
-        quorum_finalize(pcmk_quorum_handle);
+        backend->quorum_finalize(pcmk_quorum_handle);
         return FALSE;
     }
     return TRUE;
@@ -486,6 +549,10 @@ find_corosync_variant(void)
     int rc = CS_OK;
     cmap_handle_t handle;
 
+    if (pcmk__cluster_is_emulated()) {
+        return pcmk_cluster_corosync;
+    }
+
     rc = cmap_initialize(&handle);
 
     switch(rc) {
@@ -540,6 +607,12 @@ corosync_initialize_nodelist(void *cluster, gboolean force_member, xmlNode * xml
     pid_t found_pid = 0;
     int rv;
 
+    if (!pcmk__cluster_backend()->has_cmap) {
+        crm_trace("No node list available from %s",
+                  pcmk__cluster_backend()->name);
+        return FALSE;
+    }
+
     do {
         rc = cmap_initialize(&cmap_handle);
         if (rc != CS_OK) {
@@ -647,6 +720,10 @@ corosync_cluster_name(void)
     pid_t found_pid = 0;
     int rv;
 
+    if (!pcmk__cluster_backend()->has_cmap) {
+        return NULL;
+    }
+
     rc = cmap_initialize(&handle);
     if (rc != CS_OK) {
         crm_info("Failed to initialize the cmap API: %s (%d)",
@@ -707,6 +784,11 @@ corosync_cmap_has_config(const char *prefix)
         return found;
     }
 
+    if (!pcmk__cluster_backend()->has_cmap) {
+        found = 0;
+        return found;
+    }
+
     do {
         rc = cmap_initialize(&cmap_handle);
         if (rc != CS_OK) {
@@ -31,6 +31,8 @@
 
 #include <crm/common/ipc_internal.h>  /* PCMK__SPECIAL_PID* */
 
+#include "crmcluster_private.h"
+
 cpg_handle_t pcmk_cpg_handle = 0; /* TODO: Remove, use cluster.cpg_handle */
 
 static bool cpg_evicted = FALSE;
@@ -47,15 +49,40 @@ gboolean(*pcmk_cpg_dispatch_fn) (int kind, const char *from, const char *data) =
         }                                               \
     } while(counter < max)
 
+/* Messages waiting to be sent (struct iovec *), oldest first */
+static GQueue *cs_message_queue = NULL;
+static guint cs_message_timer = 0;
+
+/* Delay before retrying a flush after corosync pushed back (doubled for each
+ * consecutive stall, and reset once a send succeeds)
+ */
+static guint cs_flush_delay_ms = 0;
+
+/* Statistics reported at disconnect (and while the queue is backed up) */
+static struct cs_queue_stats_s {
+    unsigned long long sent;        // Pacemaker messages sent
+    unsigned long long multicasts;  // cpg_mcast_joined() calls that succeeded
+    unsigned long long batched;     // Messages sent as part of a batch
+    unsigned long long retries;     // Flushes deferred by corosync
+    unsigned long long throttled;   // ... of which due to flow control
+    guint max_depth;                // Deepest the queue has been
+} cs_stats = { 0, };
+
 void
 cluster_disconnect_cpg(crm_cluster_t *cluster)
 {
+    const pcmk__cluster_backend_t *backend = pcmk__cluster_backend();
     pcmk_cpg_handle = 0;
     if (cluster->cpg_handle) {
         crm_trace("Disconnecting CPG");
-        cpg_leave(cluster->cpg_handle, &cluster->group);
-        cpg_finalize(cluster->cpg_handle);
+        backend->cpg_leave(cluster->cpg_handle, &cluster->group);
+        backend->cpg_finalize(cluster->cpg_handle);
         cluster->cpg_handle = 0;
+        crm_info("CPG queue statistics: %llu messages sent in %llu multicasts "
+                 "(%llu batched), %llu deferred flushes (%llu for flow "
+                 "control), maximum depth %u",
+                 cs_stats.sent, cs_stats.multicasts, cs_stats.batched,
+                 cs_stats.retries, cs_stats.throttled, cs_stats.max_depth);
 
     } else {
         crm_info("No CPG connection");
@@ -64,6 +91,7 @@ cluster_disconnect_cpg(crm_cluster_t *cluster)
 
 uint32_t get_local_nodeid(cpg_handle_t handle)
 {
+    const pcmk__cluster_backend_t *backend = pcmk__cluster_backend();
     cs_error_t rc = CS_OK;
     int retries = 0;
     static uint32_t local_nodeid = 0;
@@ -81,14 +109,14 @@ uint32_t get_local_nodeid(cpg_handle_t handle)
 
     if(handle == 0) {
         crm_trace("Creating connection");
-        cs_repeat(retries, 5, rc = cpg_initialize(&local_handle, &cb));
+        cs_repeat(retries, 5, rc = backend->cpg_initialize(&local_handle, &cb));
         if (rc != CS_OK) {
             crm_err("Could not connect to the CPG API: %s (%d)",
                     cs_strerror(rc), rc);
             return 0;
         }
 
-        rc = cpg_fd_get(local_handle, &fd);
+        rc = backend->cpg_fd_get(local_handle, &fd);
         if (rc != CS_OK) {
             crm_err("Could not obtain the CPG API connection: %s (%d)",
                     cs_strerror(rc), rc);
@@ -96,8 +124,12 @@ uint32_t get_local_nodeid(cpg_handle_t handle)
         }
 
         /* CPG provider run as root (in given user namespace, anyway)? */
-        if (!(rv = crm_ipc_is_authentic_process(fd, (uid_t) 0,(gid_t) 0, &found_pid,
-                                                &found_uid, &found_gid))) {
+        if (!backend->authenticate) {
+            crm_trace("Not authenticating CPG provider for %s", backend->name);
+
+        } else if (!(rv = crm_ipc_is_authentic_process(fd, (uid_t) 0,
+                                                       (gid_t) 0, &found_pid,
+                                                       &found_uid, &found_gid))) {
             crm_err("CPG provider is not authentic:"
                     " process %lld (uid: %lld, gid: %lld)",
                     (long long) PCMK__SPECIAL_PID_AS_0(found_pid),
@@ -113,7 +145,8 @@ uint32_t get_local_nodeid(cpg_handle_t handle)
     if (rc == CS_OK) {
         retries = 0;
         crm_trace("Performing lookup");
-        cs_repeat(retries, 5, rc = cpg_local_get(local_handle, &local_nodeid));
+        cs_repeat(retries, 5,
+                  rc = backend->cpg_local_get(local_handle, &local_nodeid));
     }
 
     if (rc != CS_OK) {
@@ -123,15 +156,31 @@ uint32_t get_local_nodeid(cpg_handle_t handle)
 bail:
     if(handle == 0) {
         crm_trace("Closing connection");
-        cpg_finalize(local_handle);
+        backend->cpg_finalize(local_handle);
     }
     crm_debug("Local nodeid is %u", local_nodeid);
     return local_nodeid;
 }
 
 
-GListPtr cs_message_queue = NULL;
-int cs_message_timer = 0;
+/* Batching: if enabled (via PCMK_cpg_batch), consecutive small queued messages
+ * are sent in a single multicast. A batch is an AIS_Message whose header ID is
+ * CS_BATCH_ID and whose data is the packed messages, each starting on an
+ * 8-byte boundary. Receiving batches is always supported, but peers running
+ * older versions drop them, so sending them must be enabled explicitly.
+ */
+#define CS_BATCH_ID         0x42435043  // Distinct from any crm_ais_msg_class
+#define CS_BATCH_ALIGN(len) (((len) + 7) & ~((size_t) 7))
+#define CS_BATCH_MSG_MAX    4096        // Only batch messages up to this size
+#define CS_BATCH_BYTES_MAX  65536       // Maximum size of a batch
+#define CS_BATCH_COUNT_MAX  64          // Maximum messages per batch
+
+static const char cs_batch_pad[8] = { 0, };
+
+static void (*cs_deliver_fn)(cpg_handle_t handle,
+                             const struct cpg_name *groupName,
+                             uint32_t nodeid, uint32_t pid,
+                             void *msg, size_t msg_len) = NULL;
 
 static ssize_t crm_cs_flush(gpointer data);
 
@@ -143,13 +192,145 @@ crm_cs_flush_cb(gpointer data)
     return FALSE;
 }
 
+static bool
+cs_batching_enabled(void)
+{
+    static int enabled = -1;
+
+    if (enabled < 0) {
+        enabled = pcmk__env_option_enabled(crm_system_name, "cpg_batch");
+        if (enabled) {
+            crm_info("Batching of small CPG messages is enabled");
+        }
+    }
+    return enabled;
+}
+
+static void
+free_cs_message(gpointer data)
+{
+    struct iovec *iov = data;
+
+    free(iov->iov_base);
+    free(iov);
+}
+
+/*!
+ * \internal
+ * \brief Check whether corosync is currently applying flow control
+ *
+ * \param[in] handle  CPG connection to check
+ *
+ * \return true if sending now would likely fail with CS_ERR_TRY_AGAIN
+ */
+static bool
+cs_flow_controlled(cpg_handle_t handle)
+{
+    const pcmk__cluster_backend_t *backend = pcmk__cluster_backend();
+    cpg_flow_control_state_t state = CPG_FLOW_CONTROL_DISABLED;
+
+    return (backend->cpg_flow_control_state_get(handle, &state) == CS_OK)
+           && (state == CPG_FLOW_CONTROL_ENABLED);
+}
+
+/*!
+ * \internal
+ * \brief Multicast as many queued messages as fit in one batch
+ *
+ * \param[in]  handle  CPG connection to send with
+ * \param[out] count   Where to store number of messages sent
+ *
+ * \return Result of cpg_mcast_joined()
+ */
+static cs_error_t
+cs_send_batch(cpg_handle_t handle, int *count)
+{
+    const pcmk__cluster_backend_t *backend = pcmk__cluster_backend();
+    static AIS_Message *batch = NULL;
+    static const char *local_name = NULL;
+
+    struct iovec iov[1 + (2 * CS_BATCH_COUNT_MAX)];
+    int n_iov = 1;
+    size_t total = CS_BATCH_ALIGN(sizeof(AIS_Message));
+    cs_error_t rc = CS_OK;
+    int n = 0;
+
+    for (GList *iter = cs_message_queue->head;
+         (iter != NULL) && (n < CS_BATCH_COUNT_MAX); iter = iter->next) {
+
+        struct iovec *msg_iov = iter->data;
+        size_t padded = CS_BATCH_ALIGN(msg_iov->iov_len);
+
+        if ((msg_iov->iov_len > CS_BATCH_MSG_MAX)
+            || ((total + padded) > CS_BATCH_BYTES_MAX)) {
+            break;
+        }
+        iov[n_iov++] = *msg_iov;
+        if (padded > msg_iov->iov_len) {
+            iov[n_iov].iov_base = (void *) cs_batch_pad;
+            iov[n_iov++].iov_len = padded - msg_iov->iov_len;
+        }
+        total += padded;
+        n++;
+    }
+
+    if (n < 2) {
+        // Nothing to gain, so send the message as-is
+        *count = 0;
+        rc = backend->cpg_mcast_joined(handle, CPG_TYPE_AGREED,
+                                       g_queue_peek_head(cs_message_queue),
+                                       1);
+        if (rc == CS_OK) {
+            *count = 1;
+        }
+        return rc;
+    }
+
+    if (batch == NULL) {
+        batch = calloc(1, CS_BATCH_ALIGN(sizeof(AIS_Message)));
+        CRM_ASSERT(batch != NULL);
+        local_name = get_local_node_name();
+
+        batch->header.id = CS_BATCH_ID;
+        batch->header.error = CS_OK;
+        batch->sender.type = text2msg_type(crm_system_name);
+        batch->sender.pid = getpid();
+        if (local_name != NULL) {
+            batch->sender.size = QB_MIN(strlen(local_name), MAX_NAME - 1);
+            memcpy(batch->sender.uname, local_name, batch->sender.size);
+        }
+    }
+    batch->id++;
+    batch->header.size = total;
+    batch->size = total - CS_BATCH_ALIGN(sizeof(AIS_Message));
+
+    iov[0].iov_base = batch;
+    iov[0].iov_len = CS_BATCH_ALIGN(sizeof(AIS_Message));
+
+    rc = backend->cpg_mcast_joined(handle, CPG_TYPE_AGREED, iov, n_iov);
+    if (rc == CS_OK) {
+        crm_trace("Sent %d CPG messages in batch %u (%llu bytes)",
+                  n, batch->id, (unsigned long long) total);
+        cs_stats.batched += n;
+        *count = n;
+    } else {
+        *count = 0;
+    }
+    return rc;
+}
+
 #define CS_SEND_MAX 200
+#define CS_FLUSH_DELAY_MIN_MS 10
+#define CS_FLUSH_DELAY_MAX_MS 1000
+
 static ssize_t
 crm_cs_flush(gpointer data)
 {
+    const pcmk__cluster_backend_t *backend = pcmk__cluster_backend();
     int sent = 0;
     ssize_t rc = 0;
-    int queue_len = 0;
+    guint queue_len = 0;
+    bool throttled = false;
     static unsigned int last_sent = 0;
     cpg_handle_t *handle = (cpg_handle_t *)data;
 
@@ -158,57 +339,95 @@ crm_cs_flush(gpointer data)
         return pcmk_ok;
     }
 
-    queue_len = g_list_length(cs_message_queue);
+    queue_len = g_queue_get_length(cs_message_queue);
+    cs_stats.max_depth = QB_MAX(cs_stats.max_depth, queue_len);
     if ((queue_len % 1000) == 0 && queue_len > 1) {
-        crm_err("CPG queue has grown to %d", queue_len);
+        crm_err("CPG queue has grown to %u (%llu deferred flushes so far)",
+                queue_len, cs_stats.retries);
 
     } else if (queue_len == CS_SEND_MAX) {
-        crm_warn("CPG queue has grown to %d", queue_len);
+        crm_warn("CPG queue has grown to %u (%llu deferred flushes so far)",
+                 queue_len, cs_stats.retries);
     }
 
     if (cs_message_timer) {
         /* There is already a timer, wait until it goes off */
-        crm_trace("Timer active %d", cs_message_timer);
+        crm_trace("Timer active %u", cs_message_timer);
         return pcmk_ok;
     }
 
-    while (cs_message_queue && sent < CS_SEND_MAX) {
-        struct iovec *iov = cs_message_queue->data;
+    /* Don't add to corosync's backlog while it is throttling us; wait and
+     * (if enabled) send what has accumulated in fewer, larger multicasts
+     */
+    if (cs_flow_controlled(*handle)) {
+        throttled = true;
+        cs_stats.throttled++;
+        rc = CS_ERR_TRY_AGAIN;
+    }
+
+    while (!throttled && !g_queue_is_empty(cs_message_queue)
+           && sent < CS_SEND_MAX) {
+        int count = 0;
 
         errno = 0;
-        rc = cpg_mcast_joined(*handle, CPG_TYPE_AGREED, iov, 1);
+        if (cs_batching_enabled()) {
+            rc = cs_send_batch(*handle, &count);
+        } else {
+            struct iovec *iov = g_queue_peek_head(cs_message_queue);
+
+            rc = backend->cpg_mcast_joined(*handle, CPG_TYPE_AGREED, iov, 1);
+            if (rc == CS_OK) {
+                crm_trace("CPG message sent, size=%llu",
+                          (unsigned long long) iov->iov_len);
+                count = 1;
+            }
+        }
 
         if (rc != CS_OK) {
             break;
         }
 
-        sent++;
-        last_sent++;
-        crm_trace("CPG message sent, size=%llu",
-                  (unsigned long long) iov->iov_len);
-
-        cs_message_queue = g_list_remove(cs_message_queue, iov);
-        free(iov->iov_base);
-        free(iov);
+        cs_stats.multicasts++;
+        cs_stats.sent += count;
+        sent += count;
+        last_sent += count;
+        for (; count > 0; count--) {
+            free_cs_message(g_queue_pop_head(cs_message_queue));
+        }
     }
 
     queue_len -= sent;
-    if (sent > 1 || cs_message_queue) {
-        crm_info("Sent %d CPG messages  (%d remaining, last=%u): %s (%lld)",
+    if (sent > 1 || !g_queue_is_empty(cs_message_queue)) {
+        crm_info("Sent %d CPG messages  (%u remaining, last=%u): %s (%lld)",
                  sent, queue_len, last_sent, ais_error2text(rc),
                  (long long) rc);
     } else {
-        crm_trace("Sent %d CPG messages  (%d remaining, last=%u): %s (%lld)",
+        crm_trace("Sent %d CPG messages  (%u remaining, last=%u): %s (%lld)",
                   sent, queue_len, last_sent, ais_error2text(rc),
                   (long long) rc);
     }
 
-    if (cs_message_queue) {
-        uint32_t delay_ms = 100;
-        if(rc != CS_OK) {
-            /* Proportionally more if sending failed but cap at 1s */
-            delay_ms = QB_MIN(1000, CS_SEND_MAX + (10 * queue_len));
+    if (rc == CS_OK) {
+        cs_flush_delay_ms = 0;
+    } else {
+        /* Back off exponentially while corosync keeps pushing back, so a storm
+         * of updates doesn't turn into a storm of retries
+         */
+        cs_stats.retries++;
+        cs_flush_delay_ms = QB_MIN(CS_FLUSH_DELAY_MAX_MS,
+                                   QB_MAX(CS_FLUSH_DELAY_MIN_MS,
+                                          cs_flush_delay_ms * 2));
+    }
+
+    if (!g_queue_is_empty(cs_message_queue)) {
+        uint32_t delay_ms = cs_flush_delay_ms;
+
+        if (delay_ms == 0) {
+            // Hit CS_SEND_MAX, so give other sources a turn before continuing
+            delay_ms = CS_FLUSH_DELAY_MIN_MS;
         }
+        crm_trace("Retrying CPG flush in %ums%s", delay_ms,
+                  (throttled? " (flow control enabled)" : ""));
         cs_message_timer = g_timeout_add(delay_ms, crm_cs_flush_cb, data);
     }
 
@@ -220,21 +439,69 @@ send_cpg_iov(struct iovec * iov)
 {
     static unsigned int queued = 0;
 
+    if (cs_message_queue == NULL) {
+        cs_message_queue = g_queue_new();
+    }
+
     queued++;
     crm_trace("Queueing CPG message %u (%llu bytes)",
               queued, (unsigned long long) iov->iov_len);
-    cs_message_queue = g_list_append(cs_message_queue, iov);
+    g_queue_push_tail(cs_message_queue, iov);
     crm_cs_flush(&pcmk_cpg_handle);
     return TRUE;
 }
 
+/*!
+ * \internal
+ * \brief Pass each message in a received CPG multicast to the daemon
+ *
+ * Batches are unpacked here, so daemons' delivery callbacks only ever see
+ * individual messages.
+ */
+static void
+pcmk_cpg_deliver(cpg_handle_t handle, const struct cpg_name *groupName,
+                 uint32_t nodeid, uint32_t pid, void *msg, size_t msg_len)
+{
+    AIS_Message *batch = msg;
+    size_t offset = CS_BATCH_ALIGN(sizeof(AIS_Message));
+
+    if ((msg_len < sizeof(AIS_Message)) || (batch->header.id != CS_BATCH_ID)) {
+        cs_deliver_fn(handle, groupName, nodeid, pid, msg, msg_len);
+        return;
+    }
+
+    if (batch->header.size != msg_len) {
+        crm_err("Ignoring CPG batch %u from node %u with invalid size "
+                CRM_XS " claimed=%d received=%llu", batch->id, nodeid,
+                batch->header.size, (unsigned long long) msg_len);
+        return;
+    }
+
+    while ((offset + sizeof(AIS_Message)) <= msg_len) {
+        AIS_Message *inner = (AIS_Message *) ((char *) msg + offset);
+
+        if ((inner->header.size < (int) sizeof(AIS_Message))
+            || (inner->header.size > (msg_len - offset))) {
+            crm_err("Ignoring remainder of CPG batch %u from node %u: "
+                    "message at offset %llu has invalid size %d",
+                    batch->id, nodeid, (unsigned long long) offset,
+                    inner->header.size);
+            return;
+        }
+        cs_deliver_fn(handle, groupName, nodeid, pid, inner,
+                      inner->header.size);
+        offset += CS_BATCH_ALIGN(inner->header.size);
+    }
+}
+
 static int
 pcmk_cpg_dispatch(gpointer user_data)
 {
+    const pcmk__cluster_backend_t *backend = pcmk__cluster_backend();
     int rc = 0;
     crm_cluster_t *cluster = (crm_cluster_t*) user_data;
 
-    rc = cpg_dispatch(cluster->cpg_handle, CS_DISPATCH_ONE);
+    rc = backend->cpg_dispatch(cluster->cpg_handle, CS_DISPATCH_ONE);
     if (rc != CS_OK) {
         crm_err("Connection to the CPG API failed: %s (%d)", ais_error2text(rc), rc);
         cluster->cpg_handle = 0;
@@ -536,6 +803,7 @@ pcmk_cpg_membership(cpg_handle_t handle,
 gboolean
 cluster_connect_cpg(crm_cluster_t *cluster)
 {
+    const pcmk__cluster_backend_t *backend = pcmk__cluster_backend();
     cs_error_t rc;
     int fd = -1;
     int retries = 0;
@@ -556,10 +824,15 @@ cluster_connect_cpg(crm_cluster_t *cluster)
     cpg_callbacks_t cpg_callbacks = {
         .cpg_deliver_fn = cluster->cpg.cpg_deliver_fn,
         .cpg_confchg_fn = cluster->cpg.cpg_confchg_fn,
-        /* .cpg_deliver_fn = pcmk_cpg_deliver, */
         /* .cpg_confchg_fn = pcmk_cpg_membership, */
     };
 
+    if (cluster->cpg.cpg_deliver_fn != NULL) {
+        // Unpack any batched messages before the daemon sees them
+        cs_deliver_fn = cluster->cpg.cpg_deliver_fn;
+        cpg_callbacks.cpg_deliver_fn = pcmk_cpg_deliver;
+    }
+
     cpg_evicted = FALSE;
     cluster->group.length = 0;
     cluster->group.value[0] = 0;
@@ -569,14 +842,15 @@ cluster_connect_cpg(crm_cluster_t *cluster)
     cluster->group.value[127] = 0;
     cluster->group.length = 1 + QB_MIN(127, strlen(cluster->group.value));
 
-    cs_repeat(retries, 30, rc = cpg_initialize(&handle, &cpg_callbacks));
+    cs_repeat(retries, 30,
+              rc = backend->cpg_initialize(&handle, &cpg_callbacks));
     if (rc != CS_OK) {
         crm_err("Could not connect to the CPG API: %s (%d)",
                 cs_strerror(rc), rc);
         goto bail;
     }
 
-    rc = cpg_fd_get(handle, &fd);
+    rc = backend->cpg_fd_get(handle, &fd);
     if (rc != CS_OK) {
         crm_err("Could not obtain the CPG API connection: %s (%d)",
                 cs_strerror(rc), rc);
@@ -584,8 +858,12 @@ cluster_connect_cpg(crm_cluster_t *cluster)
     }
 
     /* CPG provider run as root (in given user namespace, anyway)? */
-    if (!(rv = crm_ipc_is_authentic_process(fd, (uid_t) 0,(gid_t) 0, &found_pid,
-                                            &found_uid, &found_gid))) {
+    if (!backend->authenticate) {
+        crm_trace("Not authenticating CPG provider for %s", backend->name);
+
+    } else if (!(rv = crm_ipc_is_authentic_process(fd, (uid_t) 0,
+                                                   (gid_t) 0, &found_pid,
+                                                   &found_uid, &found_gid))) {
         crm_err("CPG provider is not authentic:"
                 " process %lld (uid: %lld, gid: %lld)",
                 (long long) PCMK__SPECIAL_PID_AS_0(found_pid),
@@ -608,7 +886,7 @@ cluster_connect_cpg(crm_cluster_t *cluster)
     cluster->nodeid = id;
 
     retries = 0;
-    cs_repeat(retries, 30, rc = cpg_join(handle, &cluster->group));
+    cs_repeat(retries, 30, rc = backend->cpg_join(handle, &cluster->group));
     if (rc != CS_OK) {
         crm_err("Could not join the CPG group '%s': %d", message_name, rc);
         goto bail;
@@ -620,7 +898,7 @@ cluster_connect_cpg(crm_cluster_t *cluster)
 
   bail:
     if (rc != CS_OK) {
-        cpg_finalize(handle);
+        backend->cpg_finalize(handle);
         return FALSE;
     }
 
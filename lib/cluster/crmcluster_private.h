@@ -0,0 +1,69 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU Lesser General Public License
+ * version 2.1 or later (LGPLv2.1+) WITHOUT ANY WARRANTY.
+ */
+
+#ifndef CRMCLUSTER_PRIVATE__H
+#  define CRMCLUSTER_PRIVATE__H
+
+/* This header is for the sole use of libcrmcluster, so that functions can be
+ * declared with G_GNUC_INTERNAL for efficiency.
+ */
+
+#  include <stdbool.h>
+#  include <glib.h>
+
+#  include <corosync/corotypes.h>
+#  include <corosync/cpg.h>
+#  include <corosync/quorum.h>
+
+/* The corosync APIs that libcrmcluster uses, so that something other than
+ * corosync itself (such as the emulation in emulated.c) can provide them.
+ * Each member has the same semantics as the corosync function of that name.
+ */
+typedef struct pcmk__cluster_backend_s {
+    const char *name;
+
+    bool authenticate;  // Whether to check that the provider runs as root
+    bool has_cmap;      // Whether configuration can be read from cmap
+
+    cs_error_t (*cpg_initialize)(cpg_handle_t *handle,
+                                 cpg_callbacks_t *callbacks);
+    cs_error_t (*cpg_fd_get)(cpg_handle_t handle, int *fd);
+    cs_error_t (*cpg_local_get)(cpg_handle_t handle, unsigned int *nodeid);
+    cs_error_t (*cpg_join)(cpg_handle_t handle, const struct cpg_name *group);
+    cs_error_t (*cpg_leave)(cpg_handle_t handle, const struct cpg_name *group);
+    cs_error_t (*cpg_dispatch)(cpg_handle_t handle, cs_dispatch_flags_t type);
+    cs_error_t (*cpg_mcast_joined)(cpg_handle_t handle,
+                                   cpg_guarantee_t guarantee,
+                                   const struct iovec *iovec,
+                                   unsigned int iov_len);
+    cs_error_t (*cpg_flow_control_state_get)(cpg_handle_t handle,
+                                             cpg_flow_control_state_t *state);
+    cs_error_t (*cpg_finalize)(cpg_handle_t handle);
+
+    cs_error_t (*quorum_initialize)(quorum_handle_t *handle,
+                                    quorum_callbacks_t *callbacks,
+                                    uint32_t *quorum_type);
+    cs_error_t (*quorum_fd_get)(quorum_handle_t handle, int *fd);
+    cs_error_t (*quorum_getquorate)(quorum_handle_t handle, int *quorate);
+    cs_error_t (*quorum_trackstart)(quorum_handle_t handle, unsigned int flags);
+    cs_error_t (*quorum_dispatch)(quorum_handle_t handle,
+                                  cs_dispatch_flags_t type);
+    cs_error_t (*quorum_finalize)(quorum_handle_t handle);
+
+    // Node name for a node ID (0 for local node), or NULL to look it up in cmap
+    char *(*node_name)(uint32_t nodeid);
+} pcmk__cluster_backend_t;
+
+G_GNUC_INTERNAL
+const pcmk__cluster_backend_t *pcmk__cluster_backend(void);
+
+G_GNUC_INTERNAL
+const pcmk__cluster_backend_t *pcmk__emulated_backend(void);
+
+#endif  // CRMCLUSTER_PRIVATE__H
@@ -0,0 +1,1129 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU Lesser General Public License
+ * version 2.1 or later (LGPLv2.1+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <crm/crm.h>
+#include <crm/cluster/internal.h>
+#include <crm/common/mainloop.h>
+
+#include "crmcluster_private.h"
+
+/*
+ * Cluster layer emulation
+ *
+ * If PCMK_cluster_emulation is set to the path of a Unix socket, libcrmcluster
+ * connects to a hub listening there (see pcmk__cluster_emulator_run()) instead
+ * of to corosync. The hub relays every message through a single event loop,
+ * giving the same total order as CPG_TYPE_AGREED; tracks the membership of
+ * each process group; and derives quorum from the set of nodes that have at
+ * least one process in a group.
+ *
+ * Each emulated node takes its identity from PCMK_emulated_nodeid and
+ * PCMK_emulated_node_name, so many nodes can be run on a single host.
+ */
+
+#define EMU_CONNECT_TIMEOUT_MS 5000
+
+enum emu_frame_type {
+    emu_frame_join      = 1,    // Process joins a group (to hub)
+    emu_frame_leave     = 2,    // Process leaves its group (to hub)
+    emu_frame_mcast     = 3,    // Message for the sender's group (to hub)
+    emu_frame_deliver   = 4,    // Message from a group member (from hub)
+    emu_frame_confchg   = 5,    // Group membership changed (from hub)
+    emu_frame_track     = 6,    // Request quorum notifications (to hub)
+    emu_frame_quorum    = 7,    // Quorum or node membership changed (from hub)
+};
+
+typedef struct emu_frame_s {
+    uint32_t type;      // enum emu_frame_type
+    uint32_t size;      // Bytes of payload following the frame header
+    uint32_t nodeid;    // Node that originated the frame
+    uint32_t pid;       // Process that originated the frame
+} __attribute__ ((packed)) emu_frame_t;
+
+// Payload of join and track frames
+typedef struct emu_hello_s {
+    char group[CPG_MAX_NAME_LENGTH];
+    char uname[MAX_NAME];
+} __attribute__ ((packed)) emu_hello_t;
+
+// Member of a group or node in a quorum view
+typedef struct emu_member_s {
+    uint32_t nodeid;
+    uint32_t pid;
+    uint32_t reason;    // cpg_reason_t (for group membership changes)
+    char uname[MAX_NAME];
+} __attribute__ ((packed)) emu_member_t;
+
+/* A confchg payload is an emu_counts_t (members, left, joined) followed by
+ * that many emu_member_t; a quorum payload is an emu_counts_t (ring ID high
+ * and low words, quorate, and member count) followed by the members.
+ */
+typedef struct emu_counts_s {
+    uint32_t count[4];
+} __attribute__ ((packed)) emu_counts_t;
+
+/*
+ * Shared helpers
+ */
+
+bool
+pcmk__cluster_is_emulated(void)
+{
+    return pcmk__env_option("cluster_emulation") != NULL;
+}
+
+static int
+emu_socket(struct sockaddr_un *addr)
+{
+    const char *path = pcmk__env_option("cluster_emulation");
+    int fd = -1;
+
+    memset(addr, 0, sizeof(struct sockaddr_un));
+    addr->sun_family = AF_UNIX;
+    if ((path == NULL) || (strlen(path) >= sizeof(addr->sun_path))) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strncpy(addr->sun_path, path, sizeof(addr->sun_path) - 1);
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd >= 0) {
+        (void) fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+    return fd;
+}
+
+static int
+write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t rc = send(fd, data, len, MSG_NOSIGNAL);
+
+        if (rc < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        data += rc;
+        len -= rc;
+    }
+    return pcmk_rc_ok;
+}
+
+static char *
+new_frame(uint32_t type, uint32_t nodeid, uint32_t pid,
+          const struct iovec *iov, unsigned int n_iov, size_t *len)
+{
+    size_t size = 0;
+    char *buffer = NULL;
+    emu_frame_t *frame = NULL;
+
+    for (unsigned int lpc = 0; lpc < n_iov; lpc++) {
+        size += iov[lpc].iov_len;
+    }
+
+    buffer = malloc(sizeof(emu_frame_t) + size);
+    CRM_ASSERT(buffer != NULL);
+
+    frame = (emu_frame_t *) buffer;
+    frame->type = type;
+    frame->size = size;
+    frame->nodeid = nodeid;
+    frame->pid = pid;
+
+    size = sizeof(emu_frame_t);
+    for (unsigned int lpc = 0; lpc < n_iov; lpc++) {
+        memcpy(buffer + size, iov[lpc].iov_base, iov[lpc].iov_len);
+        size += iov[lpc].iov_len;
+    }
+    *len = size;
+    return buffer;
+}
+
+/*!
+ * \internal
+ * \brief Get the next complete frame from an input buffer
+ *
+ * \param[in] input  Bytes received so far
+ * \param[in] used   Bytes of \p input already consumed
+ *
+ * \return Newly allocated copy of the next frame (suitably aligned for the
+ *         caller to modify), or NULL if a complete frame is not available yet
+ */
+static emu_frame_t *
+next_frame(GByteArray *input, guint *used)
+{
+    emu_frame_t header;
+    emu_frame_t *frame = NULL;
+    size_t len = 0;
+
+    if ((input->len - *used) < sizeof(emu_frame_t)) {
+        return NULL;
+    }
+    memcpy(&header, input->data + *used, sizeof(emu_frame_t));
+    len = sizeof(emu_frame_t) + header.size;
+    if ((input->len - *used) < len) {
+        return NULL;
+    }
+
+    frame = malloc(len);
+    CRM_ASSERT(frame != NULL);
+    memcpy(frame, input->data + *used, len);
+    *used += len;
+    return frame;
+}
+
+static inline void *
+frame_payload(emu_frame_t *frame)
+{
+    return ((char *) frame) + sizeof(emu_frame_t);
+}
+
+/*
+ * Client side (the corosync API stand-in used by daemons)
+ */
+
+typedef struct emu_conn_s {
+    int fd;
+    uint32_t nodeid;
+    char *uname;
+    GByteArray *input;
+
+    // CPG connections
+    cpg_callbacks_t cpg_callbacks;
+    struct cpg_name group;
+    bool joined;
+
+    // Quorum connections
+    quorum_callbacks_t quorum_callbacks;
+    bool quorum_known;
+    bool tracking;
+    int quorate;
+} emu_conn_t;
+
+// Node ID -> name, for every node the hub has told us about
+static GHashTable *emu_node_names = NULL;
+
+static inline emu_conn_t *
+emu_conn(uint64_t handle)
+{
+    return (emu_conn_t *) (uintptr_t) handle;
+}
+
+static uint32_t
+emu_local_nodeid(void)
+{
+    const char *value = pcmk__env_option("emulated_nodeid");
+    long long nodeid = crm_parse_ll(value, "0");
+
+    if ((nodeid <= 0) || (nodeid > UINT32_MAX)) {
+        crm_err("PCMK_emulated_nodeid must be set to a positive integer "
+                "when PCMK_cluster_emulation is used");
+        return 0;
+    }
+    return (uint32_t) nodeid;
+}
+
+static void
+remember_node_names(const emu_member_t *members, uint32_t count)
+{
+    if (emu_node_names == NULL) {
+        emu_node_names = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                               NULL, free);
+    }
+    for (uint32_t lpc = 0; lpc < count; lpc++) {
+        if (members[lpc].uname[0] != '\0') {
+            g_hash_table_replace(emu_node_names,
+                                 GUINT_TO_POINTER(members[lpc].nodeid),
+                                 strndup(members[lpc].uname, MAX_NAME - 1));
+        }
+    }
+}
+
+static char *
+emu_node_name(uint32_t nodeid)
+{
+    const char *name = NULL;
+
+    if ((nodeid == 0) || (nodeid == emu_local_nodeid())) {
+        name = pcmk__env_option("emulated_node_name");
+        if (name == NULL) {
+            crm_err("PCMK_emulated_node_name must be set when "
+                    "PCMK_cluster_emulation is used");
+        }
+
+    } else if (emu_node_names != NULL) {
+        name = g_hash_table_lookup(emu_node_names, GUINT_TO_POINTER(nodeid));
+    }
+    return (name == NULL)? NULL : strdup(name);
+}
+
+static cs_error_t
+emu_send(emu_conn_t *conn, uint32_t type, const struct iovec *iov,
+         unsigned int n_iov)
+{
+    size_t len = 0;
+    char *frame = new_frame(type, conn->nodeid, (uint32_t) getpid(), iov,
+                            n_iov, &len);
+    int rc = write_all(conn->fd, frame, len);
+
+    free(frame);
+    if (rc != pcmk_rc_ok) {
+        crm_err("Could not send to cluster emulation hub: %s", pcmk_rc_str(rc));
+        return CS_ERR_LIBRARY;
+    }
+    return CS_OK;
+}
+
+static cs_error_t
+emu_hello(emu_conn_t *conn, uint32_t type, const struct cpg_name *group)
+{
+    emu_hello_t hello;
+    struct iovec iov = { &hello, sizeof(hello) };
+
+    memset(&hello, 0, sizeof(hello));
+    if (group != NULL) {
+        memcpy(hello.group, group->value,
+               QB_MIN(group->length, CPG_MAX_NAME_LENGTH - 1));
+    }
+    if (conn->uname != NULL) {
+        strncpy(hello.uname, conn->uname, MAX_NAME - 1);
+    }
+    return emu_send(conn, type, &iov, 1);
+}
+
+static cs_error_t
+emu_connect(emu_conn_t **result)
+{
+    struct sockaddr_un addr;
+    emu_conn_t *conn = NULL;
+    uint32_t nodeid = emu_local_nodeid();
+    int fd = -1;
+
+    if (nodeid == 0) {
+        return CS_ERR_INVALID_PARAM;
+    }
+
+    fd = emu_socket(&addr);
+    if (fd < 0) {
+        crm_err("Could not create cluster emulation socket: %s",
+                strerror(errno));
+        return CS_ERR_LIBRARY;
+    }
+
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        int rc = errno;
+
+        close(fd);
+        crm_info("Could not connect to cluster emulation hub at %s: %s",
+                 addr.sun_path, strerror(rc));
+        // The hub might just not be up yet
+        return ((rc == ENOENT) || (rc == ECONNREFUSED))?
+               CS_ERR_TRY_AGAIN : CS_ERR_LIBRARY;
+    }
+
+    conn = calloc(1, sizeof(emu_conn_t));
+    CRM_ASSERT(conn != NULL);
+    conn->fd = fd;
+    conn->nodeid = nodeid;
+    conn->uname = emu_node_name(0);
+    conn->input = g_byte_array_new();
+    *result = conn;
+    return CS_OK;
+}
+
+static void
+emu_free(emu_conn_t *conn)
+{
+    if (conn->fd >= 0) {
+        close(conn->fd);
+    }
+    g_byte_array_free(conn->input, TRUE);
+    free(conn->uname);
+    free(conn);
+}
+
+static void
+emu_confchg(emu_conn_t *conn, emu_frame_t *frame)
+{
+    emu_counts_t *counts = frame_payload(frame);
+    emu_member_t *members = (emu_member_t *) (counts + 1);
+    uint32_t total = counts->count[0] + counts->count[1] + counts->count[2];
+    struct cpg_address *addrs = NULL;
+
+    if (frame->size != (sizeof(emu_counts_t) + total * sizeof(emu_member_t))) {
+        crm_err("Ignoring malformed group change from cluster emulation hub");
+        return;
+    }
+
+    remember_node_names(members, total);
+
+    addrs = calloc(QB_MAX(total, 1), sizeof(struct cpg_address));
+    CRM_ASSERT(addrs != NULL);
+    for (uint32_t lpc = 0; lpc < total; lpc++) {
+        addrs[lpc].nodeid = members[lpc].nodeid;
+        addrs[lpc].pid = members[lpc].pid;
+        addrs[lpc].reason = members[lpc].reason;
+    }
+
+    if (conn->cpg_callbacks.cpg_confchg_fn != NULL) {
+        conn->cpg_callbacks.cpg_confchg_fn((uintptr_t) conn, &conn->group,
+                                           addrs, counts->count[0],
+                                           addrs + counts->count[0],
+                                           counts->count[1],
+                                           addrs + counts->count[0]
+                                                 + counts->count[1],
+                                           counts->count[2]);
+    }
+    free(addrs);
+}
+
+static void
+emu_quorum(emu_conn_t *conn, emu_frame_t *frame)
+{
+    emu_counts_t *counts = frame_payload(frame);
+    emu_member_t *members = (emu_member_t *) (counts + 1);
+    uint64_t ring_id = 0;
+    uint32_t *view = NULL;
+
+    if (frame->size != (sizeof(emu_counts_t)
+                        + counts->count[3] * sizeof(emu_member_t))) {
+        crm_err("Ignoring malformed quorum change from cluster emulation hub");
+        return;
+    }
+
+    remember_node_names(members, counts->count[3]);
+    conn->quorate = (counts->count[2] != 0);
+    conn->quorum_known = true;
+
+    if (!conn->tracking || (conn->quorum_callbacks.quorum_notify_fn == NULL)) {
+        return;
+    }
+
+    ring_id = (((uint64_t) counts->count[0]) << 32) | counts->count[1];
+    view = calloc(QB_MAX(counts->count[3], 1), sizeof(uint32_t));
+    CRM_ASSERT(view != NULL);
+    for (uint32_t lpc = 0; lpc < counts->count[3]; lpc++) {
+        view[lpc] = members[lpc].nodeid;
+    }
+    conn->quorum_callbacks.quorum_notify_fn((uintptr_t) conn, conn->quorate,
+                                            ring_id, counts->count[3], view);
+    free(view);
+}
+
+/*!
+ * \internal
+ * \brief Read whatever the hub has sent and process all complete frames
+ *
+ * \param[in] conn   Connection to hub
+ * \param[in] block  Whether to wait for at least one frame
+ *
+ * \return CS_OK on success, otherwise CS_ERR_BAD_HANDLE (hub went away)
+ */
+static cs_error_t
+emu_dispatch(emu_conn_t *conn, bool block)
+{
+    guint used = 0;
+    emu_frame_t *frame = NULL;
+    bool got_frame = false;
+
+    do {
+        char buffer[8192];
+        ssize_t rc = 0;
+
+        if (block) {
+            struct pollfd pfd = { conn->fd, POLLIN, 0 };
+
+            if (poll(&pfd, 1, EMU_CONNECT_TIMEOUT_MS) == 0) {
+                crm_err("Cluster emulation hub did not respond");
+                return CS_ERR_TIMEOUT;
+            }
+        }
+
+        rc = recv(conn->fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (rc > 0) {
+            g_byte_array_append(conn->input, (guint8 *) buffer, rc);
+
+        } else if ((rc == 0)
+                   || ((errno != EAGAIN) && (errno != EWOULDBLOCK)
+                       && (errno != EINTR))) {
+            crm_err("Lost connection to cluster emulation hub");
+            return CS_ERR_BAD_HANDLE;
+        }
+
+        while ((frame = next_frame(conn->input, &used)) != NULL) {
+            got_frame = true;
+            switch (frame->type) {
+                case emu_frame_deliver:
+                    if (conn->cpg_callbacks.cpg_deliver_fn != NULL) {
+                        conn->cpg_callbacks.cpg_deliver_fn((uintptr_t) conn,
+                                                           &conn->group,
+                                                           frame->nodeid,
+                                                           frame->pid,
+                                                           frame_payload(frame),
+                                                           frame->size);
+                    }
+                    break;
+                case emu_frame_confchg:
+                    emu_confchg(conn, frame);
+                    break;
+                case emu_frame_quorum:
+                    emu_quorum(conn, frame);
+                    break;
+                default:
+                    crm_warn("Ignoring unknown frame type %u from cluster "
+                             "emulation hub", frame->type);
+                    break;
+            }
+            free(frame);
+        }
+        if (used > 0) {
+            g_byte_array_remove_range(conn->input, 0, used);
+            used = 0;
+        }
+    } while (block && !got_frame);
+
+    return CS_OK;
+}
+
+static cs_error_t
+emu_cpg_initialize(cpg_handle_t *handle, cpg_callbacks_t *callbacks)
+{
+    emu_conn_t *conn = NULL;
+    cs_error_t rc = emu_connect(&conn);
+
+    if (rc == CS_OK) {
+        conn->cpg_callbacks = *callbacks;
+        *handle = (uintptr_t) conn;
+    }
+    return rc;
+}
+
+static cs_error_t
+emu_fd_get(uint64_t handle, int *fd)
+{
+    *fd = emu_conn(handle)->fd;
+    return CS_OK;
+}
+
+static cs_error_t
+emu_cpg_local_get(cpg_handle_t handle, unsigned int *nodeid)
+{
+    *nodeid = emu_conn(handle)->nodeid;
+    return CS_OK;
+}
+
+static cs_error_t
+emu_cpg_join(cpg_handle_t handle, const struct cpg_name *group)
+{
+    emu_conn_t *conn = emu_conn(handle);
+    cs_error_t rc = CS_OK;
+
+    if (conn->joined) {
+        return CS_ERR_EXIST;
+    }
+    rc = emu_hello(conn, emu_frame_join, group);
+    if (rc == CS_OK) {
+        conn->group = *group;
+        conn->joined = true;
+    }
+    return rc;
+}
+
+static cs_error_t
+emu_cpg_leave(cpg_handle_t handle, const struct cpg_name *group)
+{
+    emu_conn_t *conn = emu_conn(handle);
+
+    if (!conn->joined) {
+        return CS_ERR_NOT_EXIST;
+    }
+    conn->joined = false;
+    return emu_send(conn, emu_frame_leave, NULL, 0);
+}
+
+static cs_error_t
+emu_cpg_dispatch(cpg_handle_t handle, cs_dispatch_flags_t type)
+{
+    return emu_dispatch(emu_conn(handle), false);
+}
+
+static cs_error_t
+emu_cpg_mcast_joined(cpg_handle_t handle, cpg_guarantee_t guarantee,
+                     const struct iovec *iovec, unsigned int iov_len)
+{
+    emu_conn_t *conn = emu_conn(handle);
+
+    if (!conn->joined) {
+        return CS_ERR_NOT_EXIST;
+    }
+    return emu_send(conn, emu_frame_mcast, iovec, iov_len);
+}
+
+static cs_error_t
+emu_cpg_flow_control_state_get(cpg_handle_t handle,
+                               cpg_flow_control_state_t *state)
+{
+    // The hub buffers without limit, so it never pushes back
+    *state = CPG_FLOW_CONTROL_DISABLED;
+    return CS_OK;
+}
+
+static cs_error_t
+emu_finalize(uint64_t handle)
+{
+    emu_free(emu_conn(handle));
+    return CS_OK;
+}
+
+static cs_error_t
+emu_quorum_initialize(quorum_handle_t *handle, quorum_callbacks_t *callbacks,
+                      uint32_t *quorum_type)
+{
+    emu_conn_t *conn = NULL;
+    cs_error_t rc = emu_connect(&conn);
+
+    if (rc != CS_OK) {
+        return rc;
+    }
+    conn->quorum_callbacks = *callbacks;
+
+    // Get the current state, so quorum_getquorate() can answer
+    rc = emu_hello(conn, emu_frame_track, NULL);
+    while ((rc == CS_OK) && !conn->quorum_known) {
+        rc = emu_dispatch(conn, true);
+    }
+    if (rc != CS_OK) {
+        emu_free(conn);
+        return rc;
+    }
+
+    *quorum_type = QUORUM_SET;
+    *handle = (uintptr_t) conn;
+    return CS_OK;
+}
+
+static cs_error_t
+emu_quorum_getquorate(quorum_handle_t handle, int *quorate)
+{
+    *quorate = emu_conn(handle)->quorate;
+    return CS_OK;
+}
+
+static cs_error_t
+emu_quorum_trackstart(quorum_handle_t handle, unsigned int flags)
+{
+    emu_conn_t *conn = emu_conn(handle);
+
+    conn->tracking = true;
+
+    // The hub replies with the current view, which is then dispatched
+    return emu_hello(conn, emu_frame_track, NULL);
+}
+
+static cs_error_t
+emu_quorum_dispatch(quorum_handle_t handle, cs_dispatch_flags_t type)
+{
+    return emu_dispatch(emu_conn(handle), false);
+}
+
+static const pcmk__cluster_backend_t emulated_backend = {
+    .name = "emulation",
+    .authenticate = false,
+    .has_cmap = false,
+
+    .cpg_initialize = emu_cpg_initialize,
+    .cpg_fd_get = emu_fd_get,
+    .cpg_local_get = emu_cpg_local_get,
+    .cpg_join = emu_cpg_join,
+    .cpg_leave = emu_cpg_leave,
+    .cpg_dispatch = emu_cpg_dispatch,
+    .cpg_mcast_joined = emu_cpg_mcast_joined,
+    .cpg_flow_control_state_get = emu_cpg_flow_control_state_get,
+    .cpg_finalize = emu_finalize,
+
+    .quorum_initialize = emu_quorum_initialize,
+    .quorum_fd_get = emu_fd_get,
+    .quorum_getquorate = emu_quorum_getquorate,
+    .quorum_trackstart = emu_quorum_trackstart,
+    .quorum_dispatch = emu_quorum_dispatch,
+    .quorum_finalize = emu_finalize,
+
+    .node_name = emu_node_name,
+};
+
+const pcmk__cluster_backend_t *
+pcmk__emulated_backend(void)
+{
+    return &emulated_backend;
+}
+
+/*
+ * Hub side
+ */
+
+typedef struct emu_peer_s {
+    int fd;
+    uint32_t nodeid;
+    uint32_t pid;
+    char uname[MAX_NAME];
+    char *group;        // Group joined (or NULL)
+    bool tracking;      // Whether peer wants quorum notifications
+    GByteArray *input;
+    GByteArray *output;
+    guint output_watch;
+} emu_peer_t;
+
+static GList *hub_peers = NULL;
+static uint64_t hub_ring_id = 0;
+static unsigned int hub_expected = 0;   // 0 means most nodes seen so far
+static unsigned int hub_most_nodes = 0;
+static GHashTable *hub_nodes = NULL;    // Node IDs in current quorum view
+
+static void hub_flush(emu_peer_t *peer);
+
+static gboolean
+hub_output_cb(GIOChannel *source, GIOCondition condition, gpointer data)
+{
+    emu_peer_t *peer = data;
+
+    peer->output_watch = 0;
+    hub_flush(peer);
+    return FALSE;
+}
+
+static void
+hub_flush(emu_peer_t *peer)
+{
+    while (peer->output->len > 0) {
+        ssize_t rc = send(peer->fd, peer->output->data, peer->output->len,
+                          MSG_NOSIGNAL|MSG_DONTWAIT);
+
+        if (rc > 0) {
+            g_byte_array_remove_range(peer->output, 0, rc);
+
+        } else if ((rc < 0) && (errno == EINTR)) {
+            continue;
+
+        } else if ((rc < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+            if (peer->output_watch == 0) {
+                GIOChannel *channel = g_io_channel_unix_new(peer->fd);
+
+                peer->output_watch = g_io_add_watch(channel, G_IO_OUT,
+                                                    hub_output_cb, peer);
+                g_io_channel_unref(channel);
+            }
+            return;
+
+        } else {
+            // The input side will notice the disconnection
+            g_byte_array_set_size(peer->output, 0);
+            return;
+        }
+    }
+}
+
+static void
+hub_queue(emu_peer_t *peer, const char *frame, size_t len)
+{
+    bool idle = (peer->output->len == 0);
+
+    g_byte_array_append(peer->output, (const guint8 *) frame, len);
+    if (idle) {
+        hub_flush(peer);
+    }
+}
+
+static void
+set_member(emu_member_t *member, const emu_peer_t *peer, cpg_reason_t reason)
+{
+    memset(member, 0, sizeof(emu_member_t));
+    member->nodeid = peer->nodeid;
+    member->pid = peer->pid;
+    member->reason = reason;
+    memcpy(member->uname, peer->uname, MAX_NAME);
+}
+
+/*!
+ * \internal
+ * \brief Tell all members of a group about a membership change
+ *
+ * \param[in] group    Group whose membership changed
+ * \param[in] changed  Process that joined or left
+ * \param[in] reason   Why the membership changed
+ */
+static void
+hub_confchg(const char *group, const emu_peer_t *changed, cpg_reason_t reason)
+{
+    emu_counts_t counts;
+    GArray *members = g_array_new(FALSE, TRUE, sizeof(emu_member_t));
+    emu_member_t member;
+    struct iovec iov[2];
+    char *frame = NULL;
+    size_t len = 0;
+    bool joined = (reason == CPG_REASON_JOIN);
+
+    memset(&counts, 0, sizeof(counts));
+    for (GList *iter = hub_peers; iter != NULL; iter = iter->next) {
+        emu_peer_t *peer = iter->data;
+
+        if (safe_str_eq(peer->group, group)) {
+            set_member(&member, peer, CPG_REASON_JOIN);
+            g_array_append_val(members, member);
+            counts.count[0]++;
+        }
+    }
+    set_member(&member, changed, reason);
+    g_array_append_val(members, member);
+    counts.count[joined? 2 : 1] = 1;
+
+    iov[0].iov_base = &counts;
+    iov[0].iov_len = sizeof(counts);
+    iov[1].iov_base = members->data;
+    iov[1].iov_len = members->len * sizeof(emu_member_t);
+    frame = new_frame(emu_frame_confchg, 0, 0, iov, 2, &len);
+
+    for (GList *iter = hub_peers; iter != NULL; iter = iter->next) {
+        emu_peer_t *peer = iter->data;
+
+        if (safe_str_eq(peer->group, group)) {
+            hub_queue(peer, frame, len);
+        }
+    }
+    free(frame);
+    g_array_free(members, TRUE);
+}
+
+static char *
+hub_quorum_frame(size_t *len)
+{
+    emu_counts_t counts;
+    GArray *members = g_array_new(FALSE, TRUE, sizeof(emu_member_t));
+    unsigned int expected = hub_expected? hub_expected : hub_most_nodes;
+    struct iovec iov[2];
+    char *frame = NULL;
+
+    for (GList *iter = hub_peers; iter != NULL; iter = iter->next) {
+        emu_peer_t *peer = iter->data;
+        bool seen = false;
+
+        if (peer->group == NULL) {
+            continue;
+        }
+        for (guint lpc = 0; lpc < members->len; lpc++) {
+            if (g_array_index(members, emu_member_t, lpc).nodeid
+                == peer->nodeid) {
+                seen = true;
+                break;
+            }
+        }
+        if (!seen) {
+            emu_member_t member;
+
+            set_member(&member, peer, 0);
+            member.pid = 0;
+            g_array_append_val(members, member);
+        }
+    }
+
+    counts.count[0] = (uint32_t) (hub_ring_id >> 32);
+    counts.count[1] = (uint32_t) (hub_ring_id & 0xffffffff);
+    counts.count[2] = (members->len > (expected / 2));
+    counts.count[3] = members->len;
+
+    iov[0].iov_base = &counts;
+    iov[0].iov_len = sizeof(counts);
+    iov[1].iov_base = members->data;
+    iov[1].iov_len = members->len * sizeof(emu_member_t);
+    frame = new_frame(emu_frame_quorum, 0, 0, iov, 2, len);
+    g_array_free(members, TRUE);
+    return frame;
+}
+
+/*!
+ * \internal
+ * \brief Start a new membership if the set of active nodes changed
+ */
+static void
+hub_check_nodes(void)
+{
+    GHashTable *nodes = g_hash_table_new(g_direct_hash, g_direct_equal);
+    bool changed = false;
+    char *frame = NULL;
+    size_t len = 0;
+
+    for (GList *iter = hub_peers; iter != NULL; iter = iter->next) {
+        emu_peer_t *peer = iter->data;
+
+        if (peer->group != NULL) {
+            g_hash_table_insert(nodes, GUINT_TO_POINTER(peer->nodeid),
+                                GUINT_TO_POINTER(peer->nodeid));
+        }
+    }
+
+    if ((hub_nodes == NULL)
+        || (g_hash_table_size(nodes) != g_hash_table_size(hub_nodes))) {
+        changed = true;
+    } else {
+        GHashTableIter iter;
+        gpointer nodeid = NULL;
+
+        g_hash_table_iter_init(&iter, nodes);
+        while (g_hash_table_iter_next(&iter, &nodeid, NULL)) {
+            if (g_hash_table_lookup(hub_nodes, nodeid) == NULL) {
+                changed = true;
+                break;
+            }
+        }
+    }
+
+    if (hub_nodes != NULL) {
+        g_hash_table_destroy(hub_nodes);
+    }
+    hub_nodes = nodes;
+    if (!changed) {
+        return;
+    }
+
+    hub_ring_id++;
+    hub_most_nodes = QB_MAX(hub_most_nodes, g_hash_table_size(nodes));
+    crm_notice("Emulated membership %llu has %u node%s",
+               (unsigned long long) hub_ring_id, g_hash_table_size(nodes),
+               pcmk__plural_s(g_hash_table_size(nodes)));
+
+    frame = hub_quorum_frame(&len);
+    for (GList *iter = hub_peers; iter != NULL; iter = iter->next) {
+        emu_peer_t *peer = iter->data;
+
+        if (peer->tracking) {
+            hub_queue(peer, frame, len);
+        }
+    }
+    free(frame);
+}
+
+static void
+hub_leave(emu_peer_t *peer, cpg_reason_t reason)
+{
+    char *group = peer->group;
+
+    if (group == NULL) {
+        return;
+    }
+    peer->group = NULL;
+    crm_info("Node %u process %u left group %s",
+             peer->nodeid, peer->pid, group);
+    hub_confchg(group, peer, reason);
+    free(group);
+    hub_check_nodes();
+}
+
+static void
+hub_hello(emu_peer_t *peer, emu_frame_t *frame)
+{
+    emu_hello_t *hello = frame_payload(frame);
+
+    if (frame->size != sizeof(emu_hello_t)) {
+        crm_warn("Ignoring malformed request from node %u", frame->nodeid);
+        return;
+    }
+    peer->nodeid = frame->nodeid;
+    peer->pid = frame->pid;
+    memcpy(peer->uname, hello->uname, MAX_NAME);
+    peer->uname[MAX_NAME - 1] = '\0';
+
+    if (frame->type == emu_frame_track) {
+        char *reply = NULL;
+        size_t len = 0;
+
+        peer->tracking = true;
+        reply = hub_quorum_frame(&len);
+        hub_queue(peer, reply, len);
+        free(reply);
+
+    } else if (peer->group == NULL) {
+        peer->group = strndup(hello->group, CPG_MAX_NAME_LENGTH - 1);
+        crm_info("Node %u (%s) process %u joined group %s",
+                 peer->nodeid, peer->uname, peer->pid, peer->group);
+        hub_confchg(peer->group, peer, CPG_REASON_JOIN);
+        hub_check_nodes();
+    }
+}
+
+static void
+hub_mcast(emu_peer_t *sender, emu_frame_t *frame)
+{
+    size_t len = sizeof(emu_frame_t) + frame->size;
+
+    if (sender->group == NULL) {
+        return;
+    }
+
+    // Relay the message as-is, with the sender's real identity
+    frame->type = emu_frame_deliver;
+    frame->nodeid = sender->nodeid;
+    frame->pid = sender->pid;
+
+    for (GList *iter = hub_peers; iter != NULL; iter = iter->next) {
+        emu_peer_t *peer = iter->data;
+
+        if (safe_str_eq(peer->group, sender->group)) {
+            hub_queue(peer, (const char *) frame, len);
+        }
+    }
+}
+
+static int
+hub_peer_dispatch(gpointer user_data)
+{
+    emu_peer_t *peer = user_data;
+    char buffer[65536];
+    ssize_t rc = 0;
+    guint used = 0;
+    emu_frame_t *frame = NULL;
+
+    rc = recv(peer->fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+    if (rc == 0) {
+        return -1;
+    } else if (rc < 0) {
+        return ((errno == EAGAIN) || (errno == EWOULDBLOCK)
+                || (errno == EINTR))? 0 : -1;
+    }
+    g_byte_array_append(peer->input, (guint8 *) buffer, rc);
+
+    while ((frame = next_frame(peer->input, &used)) != NULL) {
+        switch (frame->type) {
+            case emu_frame_join:
+            case emu_frame_track:
+                hub_hello(peer, frame);
+                break;
+            case emu_frame_leave:
+                hub_leave(peer, CPG_REASON_LEAVE);
+                break;
+            case emu_frame_mcast:
+                hub_mcast(peer, frame);
+                break;
+            default:
+                crm_warn("Ignoring unknown frame type %u from node %u",
+                         frame->type, peer->nodeid);
+                break;
+        }
+        free(frame);
+    }
+    if (used > 0) {
+        g_byte_array_remove_range(peer->input, 0, used);
+    }
+    return 0;
+}
+
+static void
+hub_peer_destroy(gpointer user_data)
+{
+    emu_peer_t *peer = user_data;
+
+    hub_peers = g_list_remove(hub_peers, peer);
+    hub_leave(peer, CPG_REASON_PROCDOWN);
+    if (peer->output_watch != 0) {
+        g_source_remove(peer->output_watch);
+    }
+    close(peer->fd);
+    g_byte_array_free(peer->input, TRUE);
+    g_byte_array_free(peer->output, TRUE);
+    free(peer);
+}
+
+static int
+hub_accept(gpointer user_data)
+{
+    static struct mainloop_fd_callbacks peer_callbacks = {
+        .dispatch = hub_peer_dispatch,
+        .destroy = hub_peer_destroy,
+    };
+
+    int listener = GPOINTER_TO_INT(user_data);
+    int fd = accept(listener, NULL, NULL);
+    emu_peer_t *peer = NULL;
+
+    if (fd < 0) {
+        crm_warn("Could not accept cluster emulation connection: %s",
+                 strerror(errno));
+        return 0;
+    }
+    (void) fcntl(fd, F_SETFD, FD_CLOEXEC);
+    (void) fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    peer = calloc(1, sizeof(emu_peer_t));
+    CRM_ASSERT(peer != NULL);
+    peer->fd = fd;
+    peer->input = g_byte_array_new();
+    peer->output = g_byte_array_new();
+    hub_peers = g_list_append(hub_peers, peer);
+
+    mainloop_add_fd("emulated-peer", G_PRIORITY_DEFAULT, fd, peer,
+                    &peer_callbacks);
+    return 0;
+}
+
+/*!
+ * \internal
+ * \brief Run a cluster emulation hub until the main loop exits
+ *
+ * \param[in] mainloop  Main loop to run
+ * \param[in] expected  Nodes expected in the cluster, for quorum calculation
+ *                      (or 0 to use the most nodes seen active at once)
+ *
+ * \return Standard Pacemaker return code
+ * \note The hub listens on the socket named by PCMK_cluster_emulation, which
+ *       must not already exist.
+ */
+int
+pcmk__cluster_emulator_run(GMainLoop *mainloop, unsigned int expected)
+{
+    static struct mainloop_fd_callbacks listener_callbacks = {
+        .dispatch = hub_accept,
+    };
+
+    struct sockaddr_un addr;
+    int fd = emu_socket(&addr);
+    int rc = pcmk_rc_ok;
+
+    if (fd < 0) {
+        return errno;
+    }
+    if ((bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+        || (listen(fd, SOMAXCONN) < 0)) {
+        rc = errno;
+        crm_err("Could not listen on %s: %s", addr.sun_path, pcmk_rc_str(rc));
+        close(fd);
+        return rc;
+    }
+
+    hub_expected = expected;
+    crm_notice("Emulating cluster layer on %s", addr.sun_path);
+    mainloop_add_fd("emulated-hub", G_PRIORITY_HIGH, fd, GINT_TO_POINTER(fd),
+                    &listener_callbacks);
+    g_main_loop_run(mainloop);
+
+    unlink(addr.sun_path);
+    close(fd);
+    return rc;
+}
@@ -52,10 +52,101 @@ GHashTable *crm_remote_peer_cache = NULL;
 
 GHashTable *crm_known_peer_cache = NULL;
 
+/* Secondary indexes into the peer cache, so that finding a node by ID or name
+ * doesn't require a walk through every entry. Each index maps to a list of
+ * entries rather than a single one, because the cache can briefly hold
+ * conflicting entries (see crm_find_peer()). The indexes are updated wherever
+ * an entry's ID or name is set, and by the cache's value destructor, so they
+ * stay correct however an entry is removed.
+ */
+static GHashTable *peers_by_id = NULL;      // Node ID -> GList of crm_node_t *
+static GHashTable *peers_by_name = NULL;    // Name (any case) -> GList
+static GHashTable *peer_cache_keys = NULL;  // crm_node_t * -> peer cache key
+
+// Likewise for the known peer cache, by UUID and by name (both in any case)
+static GHashTable *known_by_uuid = NULL;
+static GHashTable *known_by_name = NULL;
+
 unsigned long long crm_peer_seq = 0;
 gboolean crm_have_quorum = FALSE;
 static gboolean crm_autoreap  = TRUE;
 
+/*!
+ * \internal
+ * \brief Add a node to a peer cache index
+ *
+ * \param[in] index     Index to add node to
+ * \param[in] key       Index key (node ID or name) to add node under
+ * \param[in] copy_key  Whether index owns a copy of key (for string keys)
+ * \param[in] node      Node to add
+ */
+static void
+index_add(GHashTable *index, gconstpointer key, bool copy_key,
+          crm_node_t *node)
+{
+    GList *list = g_hash_table_lookup(index, key);
+
+    if (list == NULL) {
+        g_hash_table_insert(index, (copy_key? strdup(key) : (gpointer) key),
+                            g_list_append(NULL, node));
+
+    } else if (g_list_find(list, node) == NULL) {
+        // Appending to a non-empty list doesn't change its head
+        list = g_list_append(list, node);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Remove a node from a peer cache index
+ *
+ * \param[in] index  Index to remove node from
+ * \param[in] key    Index key (node ID or name) that node is under
+ * \param[in] node   Node to remove
+ */
+static void
+index_remove(GHashTable *index, gconstpointer key, crm_node_t *node)
+{
+    gpointer index_key = NULL;
+    GList *list = NULL;
+    GList *updated = NULL;
+
+    if ((index == NULL)
+        || !g_hash_table_lookup_extended(index, key, &index_key,
+                                         (gpointer *) &list)) {
+        return;
+    }
+
+    updated = g_list_remove(list, node);
+    if (updated == NULL) {
+        g_hash_table_remove(index, key);
+
+    } else if (updated != list) {
+        // Head changed, so re-insert without freeing the existing key
+        g_hash_table_steal(index, key);
+        g_hash_table_insert(index, index_key, updated);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Get the first node in a peer cache index with a given key
+ *
+ * \param[in] index  Index to search
+ * \param[in] key    Index key (node ID or name) to search for
+ *
+ * \return Earliest-added node with \p key if any, otherwise NULL
+ */
+static crm_node_t *
+index_first(GHashTable *index, gconstpointer key)
+{
+    GList *list = (index == NULL)? NULL : g_hash_table_lookup(index, key);
+
+    return (list == NULL)? NULL : list->data;
+}
+
+static void remove_peer(crm_node_t *node);
+
 int
 crm_remote_peer_cache_size(void)
 {
@@ -333,7 +424,38 @@ reap_crm_member(uint32_t id, const char *name)
 
     search.id = id;
     search.uname = name ? strdup(name) : NULL;
-    matches = g_hash_table_foreach_remove(crm_peer_cache, crm_reap_dead_member, &search);
+
+    if ((id == 0) && (name == NULL)) {
+        /* Every inactive node without a name matches, whatever its ID. Those
+         * aren't in the name index, and there is no ID to look up, so walk
+         * the whole cache.
+         */
+        matches = g_hash_table_foreach_remove(crm_peer_cache,
+                                              crm_reap_dead_member, &search);
+
+    } else {
+        GList *candidates = NULL;
+
+        if (id > 0) {
+            candidates = g_hash_table_lookup(peers_by_id, GUINT_TO_POINTER(id));
+        } else {
+            candidates = g_hash_table_lookup(peers_by_name, name);
+        }
+
+        /* Removing an entry modifies the index list, so work from a copy. The
+         * name index is case-insensitive, but reaping by name is not, so each
+         * candidate is still checked in full.
+         */
+        candidates = g_list_copy(candidates);
+        for (GList *iter = candidates; iter != NULL; iter = iter->next) {
+            if (crm_reap_dead_member(NULL, iter->data, &search)) {
+                remove_peer(iter->data);
+                matches++;
+            }
+        }
+        g_list_free(candidates);
+    }
+
     if(matches) {
         crm_notice("Purged %d peer%s with id=%u%s%s from the membership cache",
                    matches, pcmk__plural_s(matches), search.id,
@@ -386,11 +508,62 @@ destroy_crm_node(gpointer data)
     free(node);
 }
 
+// Value destructor for crm_peer_cache
+static void
+destroy_cluster_peer(gpointer data)
+{
+    crm_node_t *node = data;
+
+    g_hash_table_remove(peer_cache_keys, node);
+    if (node->id > 0) {
+        index_remove(peers_by_id, GUINT_TO_POINTER(node->id), node);
+    }
+    if (node->uname != NULL) {
+        index_remove(peers_by_name, node->uname, node);
+    }
+    destroy_crm_node(node);
+}
+
+// Value destructor for crm_known_peer_cache
+static void
+destroy_known_peer(gpointer data)
+{
+    crm_node_t *node = data;
+
+    if (node->uuid != NULL) {
+        index_remove(known_by_uuid, node->uuid, node);
+    }
+    if (node->uname != NULL) {
+        index_remove(known_by_name, node->uname, node);
+    }
+    destroy_crm_node(node);
+}
+
+/*!
+ * \internal
+ * \brief Remove a node from the peer cache (freeing it)
+ *
+ * \param[in] node  Peer cache entry to remove
+ */
+static void
+remove_peer(crm_node_t *node)
+{
+    gpointer key = g_hash_table_lookup(peer_cache_keys, node);
+
+    if (key != NULL) {
+        g_hash_table_remove(crm_peer_cache, key);
+    }
+}
+
 void
 crm_peer_init(void)
 {
     if (crm_peer_cache == NULL) {
-        crm_peer_cache = g_hash_table_new_full(crm_strcase_hash, crm_strcase_equal, free, destroy_crm_node);
+        crm_peer_cache = g_hash_table_new_full(crm_strcase_hash, crm_strcase_equal, free, destroy_cluster_peer);
+        peers_by_id = g_hash_table_new(g_direct_hash, g_direct_equal);
+        peers_by_name = g_hash_table_new_full(crm_strcase_hash,
+                                              crm_strcase_equal, free, NULL);
+        peer_cache_keys = g_hash_table_new(g_direct_hash, g_direct_equal);
     }
 
     if (crm_remote_peer_cache == NULL) {
@@ -398,7 +571,11 @@ crm_peer_init(void)
     }
 
     if (crm_known_peer_cache == NULL) {
-        crm_known_peer_cache = g_hash_table_new_full(crm_strcase_hash, crm_strcase_equal, free, destroy_crm_node);
+        crm_known_peer_cache = g_hash_table_new_full(crm_strcase_hash, crm_strcase_equal, free, destroy_known_peer);
+        known_by_uuid = g_hash_table_new_full(crm_strcase_hash,
+                                              crm_strcase_equal, free, NULL);
+        known_by_name = g_hash_table_new_full(crm_strcase_hash,
+                                              crm_strcase_equal, free, NULL);
     }
 }
 
@@ -409,6 +586,14 @@ crm_peer_destroy(void)
         crm_trace("Destroying peer cache with %d members", g_hash_table_size(crm_peer_cache));
         g_hash_table_destroy(crm_peer_cache);
         crm_peer_cache = NULL;
+
+        // Destroying the cache emptied the indexes
+        g_hash_table_destroy(peers_by_id);
+        peers_by_id = NULL;
+        g_hash_table_destroy(peers_by_name);
+        peers_by_name = NULL;
+        g_hash_table_destroy(peer_cache_keys);
+        peer_cache_keys = NULL;
     }
 
     if (crm_remote_peer_cache != NULL) {
@@ -421,6 +606,10 @@ crm_peer_destroy(void)
         crm_trace("Destroying known peer cache with %d members", g_hash_table_size(crm_known_peer_cache));
         g_hash_table_destroy(crm_known_peer_cache);
         crm_known_peer_cache = NULL;
+        g_hash_table_destroy(known_by_uuid);
+        known_by_uuid = NULL;
+        g_hash_table_destroy(known_by_name);
+        known_by_name = NULL;
     }
 
 }
@@ -472,14 +661,6 @@ static void crm_dump_peer_hash(int level, const char *caller)
     }
 }
 
-static gboolean crm_hash_find_by_data(gpointer key, gpointer value, gpointer user_data)
-{
-    if(value == user_data) {
-        return TRUE;
-    }
-    return FALSE;
-}
-
 crm_node_t *
 crm_find_peer_full(unsigned int id, const char *uname, int flags)
 {
@@ -521,7 +702,6 @@ crm_get_peer_full(unsigned int id, const char *uname, int flags)
 crm_node_t *
 crm_find_peer(unsigned int id, const char *uname)
 {
-    GHashTableIter iter;
     crm_node_t *node = NULL;
     crm_node_t *by_id = NULL;
     crm_node_t *by_name = NULL;
@@ -531,24 +711,16 @@ crm_find_peer(unsigned int id, const char *uname)
     crm_peer_init();
 
     if (uname != NULL) {
-        g_hash_table_iter_init(&iter, crm_peer_cache);
-        while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &node)) {
-            if(node->uname && strcasecmp(node->uname, uname) == 0) {
-                crm_trace("Name match: %s = %p", node->uname, node);
-                by_name = node;
-                break;
-            }
+        by_name = index_first(peers_by_name, uname);
+        if (by_name != NULL) {
+            crm_trace("Name match: %s = %p", by_name->uname, by_name);
         }
     }
 
     if (id > 0) {
-        g_hash_table_iter_init(&iter, crm_peer_cache);
-        while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &node)) {
-            if(node->id == id) {
-                crm_trace("ID match: %u = %p", node->id, node);
-                by_id = node;
-                break;
-            }
+        by_id = index_first(peers_by_id, GUINT_TO_POINTER(id));
+        if (by_id != NULL) {
+            crm_trace("ID match: %u = %p", by_id->id, by_id);
         }
     }
 
@@ -582,7 +754,7 @@ crm_find_peer(unsigned int id, const char *uname)
     } else if(uname && by_id->uname) {
         if(safe_str_eq(uname, by_id->uname)) {
             crm_notice("Node '%s' has changed its ID from %u to %u", by_id->uname, by_name->id, by_id->id);
-            g_hash_table_foreach_remove(crm_peer_cache, crm_hash_find_by_data, by_name);
+            remove_peer(by_name);
 
         } else {
             crm_warn("Node '%s' and '%s' share the same cluster nodeid: %u %s", by_id->uname, by_name->uname, id, uname);
@@ -603,7 +775,7 @@ crm_find_peer(unsigned int id, const char *uname)
         crm_dump_peer_hash(LOG_DEBUG, __FUNCTION__);
 
         crm_info("Merging %p into %p", by_name, by_id);
-        g_hash_table_foreach_remove(crm_peer_cache, crm_hash_find_by_data, by_name);
+        remove_peer(by_name);
     }
 
     return node;
@@ -614,8 +786,7 @@ static guint
 crm_remove_conflicting_peer(crm_node_t *node)
 {
     int matches = 0;
-    GHashTableIter iter;
-    crm_node_t *existing_node = NULL;
+    GList *candidates = NULL;
 
     if (node->id == 0 || node->uname == NULL) {
         return 0;
@@ -625,12 +796,12 @@ crm_remove_conflicting_peer(crm_node_t *node)
         return 0;
     }
 
-    g_hash_table_iter_init(&iter, crm_peer_cache);
-    while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &existing_node)) {
-        if (existing_node->id > 0
-            && existing_node->id != node->id
-            && existing_node->uname != NULL
-            && strcasecmp(existing_node->uname, node->uname) == 0) {
+    // Removing an entry modifies the index list, so work from a copy
+    candidates = g_list_copy(g_hash_table_lookup(peers_by_name, node->uname));
+    for (GList *iter = candidates; iter != NULL; iter = iter->next) {
+        crm_node_t *existing_node = iter->data;
+
+        if (existing_node->id > 0 && existing_node->id != node->id) {
 
             if (crm_is_peer_active(existing_node)) {
                 continue;
@@ -639,10 +810,11 @@ crm_remove_conflicting_peer(crm_node_t *node)
             crm_warn("Removing cached offline node %u/%s which has conflicting uname with %u",
                      existing_node->id, existing_node->uname, node->id);
 
-            g_hash_table_iter_remove(&iter);
+            remove_peer(existing_node);
             matches++;
         }
     }
+    g_list_free(candidates);
 
     return matches;
 }
@@ -687,6 +859,7 @@ crm_get_peer(unsigned int id, const char *uname)
         crm_info("Created entry %s/%p for node %s/%u (%d total)",
                  uniqueid, node, uname, id, 1 + g_hash_table_size(crm_peer_cache));
         g_hash_table_replace(crm_peer_cache, uniqueid, node);
+        g_hash_table_insert(peer_cache_keys, node, uniqueid);
     }
 
     if(id > 0 && uname && (node->id == 0 || node->uname == NULL)) {
@@ -695,6 +868,7 @@ crm_get_peer(unsigned int id, const char *uname)
 
     if(id > 0 && node->id == 0) {
         node->id = id;
+        index_add(peers_by_id, GUINT_TO_POINTER(id), FALSE, node);
     }
 
     if (uname && (node->uname == NULL)) {
@@ -731,6 +905,8 @@ crm_get_peer(unsigned int id, const char *uname)
 void
 crm_update_peer_uname(crm_node_t *node, const char *uname)
 {
+    bool indexed = false;
+
     CRM_CHECK(uname != NULL,
               crm_err("Bug: can't update node name without name"); return);
     CRM_CHECK(node != NULL,
@@ -750,10 +926,20 @@ crm_update_peer_uname(crm_node_t *node, const char *uname)
         }
     }
 
+    indexed = (peer_cache_keys != NULL)
+              && (g_hash_table_lookup(peer_cache_keys, node) != NULL);
+    if (indexed && (node->uname != NULL)) {
+        index_remove(peers_by_name, node->uname, node);
+    }
+
     free(node->uname);
     node->uname = strdup(uname);
     CRM_ASSERT(node->uname != NULL);
 
+    if (indexed) {
+        index_add(peers_by_name, node->uname, TRUE, node);
+    }
+
     if (crm_status_callback) {
         crm_status_callback(crm_status_uname, node, NULL);
     }
@@ -1015,30 +1201,21 @@ crm_terminate_member_no_mainloop(int nodeid, const char *uname, int *connection)
 static crm_node_t *
 crm_find_known_peer(const char *id, const char *uname)
 {
-    GHashTableIter iter;
     crm_node_t *node = NULL;
     crm_node_t *by_id = NULL;
     crm_node_t *by_name = NULL;
 
     if (uname) {
-        g_hash_table_iter_init(&iter, crm_known_peer_cache);
-        while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &node)) {
-            if (node->uname && strcasecmp(node->uname, uname) == 0) {
-                crm_trace("Name match: %s = %p", node->uname, node);
-                by_name = node;
-                break;
-            }
+        by_name = index_first(known_by_name, uname);
+        if (by_name != NULL) {
+            crm_trace("Name match: %s = %p", by_name->uname, by_name);
         }
     }
 
     if (id) {
-        g_hash_table_iter_init(&iter, crm_known_peer_cache);
-        while (g_hash_table_iter_next(&iter, NULL, (gpointer *) &node)) {
-            if(strcasecmp(node->uuid, id) == 0) {
-                crm_trace("ID match: %s= %p", id, node);
-                by_id = node;
-                break;
-            }
+        by_id = index_first(known_by_uuid, id);
+        if (by_id != NULL) {
+            crm_trace("ID match: %s= %p", id, by_id);
         }
     }
 
@@ -1113,12 +1290,16 @@ known_peer_cache_refresh_helper(xmlNode *xml_node, void *user_data)
         CRM_ASSERT(node->uuid != NULL);
 
         g_hash_table_replace(crm_known_peer_cache, uniqueid, node);
+        index_add(known_by_uuid, node->uuid, TRUE, node);
+        index_add(known_by_name, node->uname, TRUE, node);
 
     } else if (is_set(node->flags, crm_node_dirty)) {
         if (safe_str_neq(uname, node->uname)) {
+            index_remove(known_by_name, node->uname, node);
             free(node->uname);
             node->uname = strdup(uname);
             CRM_ASSERT(node->uname != NULL);
+            index_add(known_by_name, node->uname, TRUE, node);
         }
 
         /* Node is in cache and hasn't been updated already, so mark it clean */
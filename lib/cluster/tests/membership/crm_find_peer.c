@@ -0,0 +1,167 @@
+#include <glib.h>
+#include <stdlib.h>
+
+#include <crm_internal.h>
+#include <crm/cluster/internal.h>
+
+#define CHURN_NODES 500
+
+static char *
+node_name(const char *prefix, int i)
+{
+    return crm_strdup_printf("%s-%d", prefix, i);
+}
+
+static void
+remote_churn(void) {
+    crm_peer_init();
+
+    for (int i = 0; i < CHURN_NODES; i++) {
+        char *name = node_name("remote", i);
+
+        g_assert(crm_remote_peer_get(name) != NULL);
+        free(name);
+    }
+    g_assert_cmpint(crm_remote_peer_cache_size(), ==, CHURN_NODES);
+
+    for (int i = 0; i < CHURN_NODES; i += 2) {
+        char *name = node_name("remote", i);
+
+        crm_remote_peer_cache_remove(name);
+        free(name);
+    }
+    g_assert_cmpint(crm_remote_peer_cache_size(), ==, CHURN_NODES / 2);
+
+    for (int i = 0; i < CHURN_NODES; i++) {
+        char *name = node_name("remote", i);
+        crm_node_t *node = crm_find_peer_full(0, name, CRM_GET_PEER_ANY);
+
+        if (i % 2) {
+            g_assert(node != NULL);
+            g_assert_cmpstr(node->uname, ==, name);
+            g_assert(is_set(node->flags, crm_remote_node));
+        } else {
+            g_assert(node == NULL);
+        }
+        free(name);
+    }
+
+    crm_peer_destroy();
+}
+
+static void
+cluster_churn(void) {
+    crm_peer_init();
+
+    for (int i = 1; i <= CHURN_NODES; i++) {
+        char *name = node_name("node", i);
+
+        g_assert(crm_get_peer(i, name) != NULL);
+        free(name);
+    }
+    g_assert_cmpint(g_hash_table_size(crm_peer_cache), ==, CHURN_NODES);
+
+    // Lookups by ID, by name in any case, and by both must agree
+    for (int i = 1; i <= CHURN_NODES; i++) {
+        char *name = node_name("NODE", i);
+        crm_node_t *node = crm_find_peer(i, NULL);
+
+        g_assert(node != NULL);
+        g_assert_cmpint(node->id, ==, i);
+        g_assert(crm_find_peer(0, name) == node);
+        g_assert(crm_find_peer(i, name) == node);
+        free(name);
+    }
+
+    // Renamed nodes can be found only by their new name
+    for (int i = 1; i <= CHURN_NODES; i += 2) {
+        char *name = node_name("renamed", i);
+
+        crm_update_peer_uname(crm_find_peer(i, NULL), name);
+        free(name);
+    }
+    for (int i = 1; i <= CHURN_NODES; i += 2) {
+        char *old_name = node_name("node", i);
+        char *new_name = node_name("renamed", i);
+
+        g_assert(crm_find_peer(0, old_name) == NULL);
+        g_assert(crm_find_peer(0, new_name) == crm_find_peer(i, NULL));
+        free(old_name);
+        free(new_name);
+    }
+
+    // Reap every third node by ID, and every fifth remaining node by name
+    for (int i = 3; i <= CHURN_NODES; i += 3) {
+        g_assert_cmpint(reap_crm_member(i, NULL), ==, 1);
+    }
+    for (int i = 5; i <= CHURN_NODES; i += 5) {
+        crm_node_t *node = crm_find_peer(i, NULL);
+
+        if (node != NULL) {
+            char *name = strdup(node->uname);
+
+            g_assert_cmpint(reap_crm_member(0, name), ==, 1);
+            free(name);
+        }
+    }
+
+    for (int i = 1; i <= CHURN_NODES; i++) {
+        char *name = node_name((i % 2)? "renamed" : "node", i);
+        crm_node_t *node = crm_find_peer(i, NULL);
+
+        if ((i % 3 == 0) || (i % 5 == 0)) {
+            g_assert(node == NULL);
+            g_assert(crm_find_peer(0, name) == NULL);
+        } else {
+            g_assert(node != NULL);
+            g_assert(crm_find_peer(0, name) == node);
+        }
+        free(name);
+    }
+
+    // Reaped names can be reused by new nodes
+    for (int i = 3; i <= CHURN_NODES; i += 3) {
+        char *name = node_name((i % 2)? "renamed" : "node", i);
+        crm_node_t *node = crm_get_peer(CHURN_NODES + i, name);
+
+        g_assert(crm_find_peer(0, name) == node);
+        g_assert(crm_find_peer(CHURN_NODES + i, NULL) == node);
+        free(name);
+    }
+
+    crm_peer_destroy();
+}
+
+static void
+id_learned_later(void) {
+    crm_node_t *node = NULL;
+
+    crm_peer_init();
+
+    node = crm_get_peer(0, "lonely");
+    g_assert(node != NULL);
+    g_assert(crm_find_peer(42, NULL) == NULL);
+
+    g_assert(crm_get_peer(42, "lonely") == node);
+    g_assert(crm_find_peer(42, NULL) == node);
+    g_assert_cmpint(g_hash_table_size(crm_peer_cache), ==, 1);
+
+    crm_peer_destroy();
+}
+
+int main(int argc, char **argv) {
+    /* Use the cluster layer emulation, so nothing tries to contact Corosync
+     * (the socket is never connected to)
+     */
+    setenv("PCMK_cluster_type", "corosync", 1);
+    setenv("PCMK_cluster_emulation", "/nonexistent", 1);
+
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/cluster/membership/find_peer/remote_churn", remote_churn);
+    g_test_add_func("/cluster/membership/find_peer/cluster_churn", cluster_churn);
+    g_test_add_func("/cluster/membership/find_peer/id_learned_later",
+                    id_learned_later);
+
+    return g_test_run();
+}
@@ -28,14 +28,30 @@
 typedef struct xml_acl_s {
         enum xml_private_flags mode;
         char *xpath;
+        xmlXPathCompExprPtr compiled;   // xpath compiled on first use
+        int refs;                       // cache and documents share ACLs
 } xml_acl_t;
 
+/* Username -> list of ACLs unpacked for that user. Entries are valid only for
+ * the CIB configuration version acl_cache_version ("<admin_epoch>:<epoch>"),
+ * since any change to the ACLs section bumps the epoch, so the whole cache is
+ * dropped whenever ACLs are requested for another version.
+ */
+static GHashTable *acl_cache = NULL;
+static char *acl_cache_version = NULL;
+
 static void
 __xml_acl_free(void *data)
 {
     if (data) {
         xml_acl_t *acl = data;
 
+        if (--acl->refs > 0) {
+            return;
+        }
+        if (acl->compiled) {
+            xmlXPathFreeCompExpr(acl->compiled);
+        }
         free(acl->xpath);
         free(acl);
     }
@@ -47,6 +63,63 @@ pcmk__free_acls(GList *acls)
     g_list_free_full(acls, __xml_acl_free);
 }
 
+/*!
+ * \internal
+ * \brief Free all cached ACLs
+ */
+void
+pcmk__free_acl_cache(void)
+{
+    if (acl_cache) {
+        g_hash_table_destroy(acl_cache);
+        acl_cache = NULL;
+    }
+    free(acl_cache_version);
+    acl_cache_version = NULL;
+}
+
+static GList *
+acl_ref_list(GList *acls)
+{
+    GList *copy = g_list_copy(acls);
+
+    for (GList *iter = copy; iter != NULL; iter = iter->next) {
+        ((xml_acl_t *) iter->data)->refs++;
+    }
+    return copy;
+}
+
+/*!
+ * \internal
+ * \brief Search XML using an ACL's xpath, compiling it if needed
+ *
+ * \param[in] acl  ACL whose xpath should be used
+ * \param[in] xml  XML whose document should be searched
+ *
+ * \return XPath search result (caller must free with freeXpathObject())
+ */
+static xmlXPathObjectPtr
+acl_xpath_search(xml_acl_t *acl, xmlNode *xml)
+{
+    xmlXPathContextPtr xpathCtx = NULL;
+    xmlXPathObjectPtr xpathObj = NULL;
+
+    if (acl->compiled == NULL) {
+        acl->compiled = xmlXPathCompile((pcmkXmlStr) acl->xpath);
+        if (acl->compiled == NULL) {
+            crm_warn("Ignoring ACL with invalid xpath: %s", acl->xpath);
+            return NULL;
+        }
+    }
+
+    xpathCtx = xmlXPathNewContext(xml->doc);
+    CRM_ASSERT(xpathCtx != NULL);
+
+    xpathObj = xmlXPathCompiledEval(acl->compiled, xpathCtx);
+    xmlXPathFreeContext(xpathCtx);
+    return xpathObj;
+}
+
 static GList *
 __xml_acl_create(xmlNode *xml, GList *acls, enum xml_private_flags mode)
 {
@@ -76,6 +149,7 @@ __xml_acl_create(xmlNode *xml, GList *acls, enum xml_private_flags mode)
     acl = calloc(1, sizeof (xml_acl_t));
     CRM_ASSERT(acl != NULL);
 
+    acl->refs = 1;
     acl->mode = mode;
     if (xpath) {
         acl->xpath = strdup(xpath);
@@ -238,6 +312,38 @@ __xml_acl_to_text(enum xml_private_flags flags)
     return "none";
 }
 
+/*!
+ * \internal
+ * \brief Check whether an ACL should be applied to an XML element it matched
+ *
+ * \param[in] acl    ACL that matched
+ * \param[in] match  XML element that was matched
+ * \param[in] flags  ACL flags already applied to \p match
+ *
+ * \return TRUE if the ACL's mode should be added to \p match's flags
+ */
+static bool
+acl_applies(xml_acl_t *acl, xmlNode *match, uint32_t flags)
+{
+#ifdef SUSE_ACL_COMPAT
+    if (is_not_set(flags, acl->mode)
+        && (is_set(flags, xpf_acl_read)
+            || is_set(flags, xpf_acl_write)
+            || is_set(flags, xpf_acl_deny))) {
+        char *path = xml_get_path(match);
+
+        crm_config_warn("Configuration element %s is matched by "
+                        "multiple ACL rules, only the first applies "
+                        "('%s' wins over '%s')",
+                        path, __xml_acl_to_text(flags),
+                        __xml_acl_to_text(acl->mode));
+        free(path);
+        return FALSE;
+    }
+#endif
+    return TRUE;
+}
+
 void
 pcmk__apply_acl(xmlNode *xml)
 {
@@ -255,33 +361,22 @@ pcmk__apply_acl(xmlNode *xml)
         int max = 0, lpc = 0;
         xml_acl_t *acl = aIter->data;
 
-        xpathObj = xpath_search(xml, acl->xpath);
+        xpathObj = acl_xpath_search(acl, xml);
         max = numXpathResults(xpathObj);
 
         for (lpc = 0; lpc < max; lpc++) {
             xmlNode *match = getXpathResult(xpathObj, lpc);
-            char *path = xml_get_path(match);
-
-            p = match->_private;
-            crm_trace("Applying %s ACL to %s matched by %s",
-                      __xml_acl_to_text(acl->mode), path, acl->xpath);
 
-#ifdef SUSE_ACL_COMPAT
-            if (is_not_set(p->flags, acl->mode)
-                && (is_set(p->flags, xpf_acl_read)
-                    || is_set(p->flags, xpf_acl_write)
-                    || is_set(p->flags, xpf_acl_deny))) {
-                crm_config_warn("Configuration element %s is matched by "
-                                "multiple ACL rules, only the first applies "
-                                "('%s' wins over '%s')",
-                                path, __xml_acl_to_text(p->flags),
-                                __xml_acl_to_text(acl->mode));
-                free(path);
+            if (match == NULL) {
                 continue;
             }
-#endif
-            p->flags |= acl->mode;
-            free(path);
+            p = match->_private;
+            if (acl_applies(acl, match, p->flags)) {
+                crm_trace("Applying %s ACL to <%s> matched by %s",
+                          __xml_acl_to_text(acl->mode),
+                          crm_element_name(match), acl->xpath);
+                p->flags |= acl->mode;
+            }
         }
         crm_trace("Applied %s ACL %s (%d match%s)",
                   __xml_acl_to_text(acl->mode), acl->xpath, max,
@@ -301,6 +396,113 @@ pcmk__apply_acl(xmlNode *xml)
 
 }
 
+/*!
+ * \internal
+ * \brief Find the ACLs section of a CIB
+ *
+ * \param[in] source  XML with ACL definitions
+ *
+ * \return ACLs section if found, otherwise NULL
+ */
+static xmlNode *
+find_acls(xmlNode *source)
+{
+    if (safe_str_eq(crm_element_name(source), XML_TAG_CIB)) {
+        // Avoid an xpath search of the entire CIB in the common case
+        return first_named_child(first_named_child(source,
+                                                   XML_CIB_TAG_CONFIGURATION),
+                                 XML_CIB_TAG_ACLS);
+    }
+    return get_xpath_object("//" XML_CIB_TAG_ACLS, source, LOG_NEVER);
+}
+
+/*!
+ * \internal
+ * \brief Unpack the ACLs that apply to a given user
+ *
+ * \param[in] acls  ACLs section
+ * \param[in] user  Username whose ACLs are needed
+ *
+ * \return Newly allocated list of ACLs for \p user
+ */
+static GList *
+unpack_user_acls(xmlNode *acls, const char *user)
+{
+    GList *user_acls = NULL;
+
+    for (xmlNode *child = __xml_first_child_element(acls); child;
+         child = __xml_next_element(child)) {
+        const char *tag = crm_element_name(child);
+
+        if (!strcmp(tag, XML_ACL_TAG_USER)
+            || !strcmp(tag, XML_ACL_TAG_USERv1)) {
+            const char *id = crm_element_value(child, XML_ATTR_ID);
+
+            if (id && strcmp(id, user) == 0) {
+                crm_debug("Unpacking ACLs for user '%s'", id);
+                user_acls = __xml_acl_parse_entry(acls, child, user_acls);
+            }
+        }
+    }
+    return user_acls;
+}
+
+/*!
+ * \internal
+ * \brief Get the ACLs that apply to a given user, using the cache if possible
+ *
+ * ACLs are cached only when \p source is a CIB with a configuration version,
+ * because that is what tells whether the ACLs section may have changed.
+ *
+ * \param[in] source  XML with ACL definitions
+ * \param[in] user    Username whose ACLs are needed
+ *
+ * \return List of ACLs for \p user (free with pcmk__free_acls())
+ */
+static GList *
+acls_for_user(xmlNode *source, const char *user)
+{
+    xmlNode *acls = find_acls(source);
+    const char *admin_epoch = NULL;
+    const char *epoch = NULL;
+    char *version = NULL;
+    gpointer cached = NULL;
+    GList *user_acls = NULL;
+
+    if (safe_str_eq(crm_element_name(source), XML_TAG_CIB)) {
+        admin_epoch = crm_element_value(source, XML_ATTR_GENERATION_ADMIN);
+        epoch = crm_element_value(source, XML_ATTR_GENERATION);
+    }
+    if ((admin_epoch == NULL) || (epoch == NULL)) {
+        return (acls == NULL)? NULL : unpack_user_acls(acls, user);
+    }
+
+    version = crm_strdup_printf("%s:%s", admin_epoch, epoch);
+    if ((acl_cache != NULL) && strcmp(version, acl_cache_version)) {
+        crm_debug("Discarding cached ACLs for configuration %s "
+                  "(now %s)", acl_cache_version, version);
+        pcmk__free_acl_cache();
+    }
+    if (acl_cache == NULL) {
+        acl_cache = g_hash_table_new_full(crm_str_hash, g_str_equal, free,
+                                          (GDestroyNotify) pcmk__free_acls);
+        acl_cache_version = version;
+    } else {
+        free(version);
+    }
+
+    if (g_hash_table_lookup_extended(acl_cache, user, NULL, &cached)) {
+        crm_trace("Using cached ACLs for user '%s'", user);
+        return acl_ref_list(cached);
+    }
+
+    if (acls) {
+        user_acls = unpack_user_acls(acls, user);
+    }
+    g_hash_table_insert(acl_cache, strdup(user), user_acls);
+    return acl_ref_list(user_acls);
+}
+
 /*!
  * \internal
  * \brief Unpack ACLs for a given user
@@ -326,30 +528,9 @@ pcmk__unpack_acl(xmlNode *source, xmlNode *target, const char *user)
                   user);
 
     } else if (p->acls == NULL) {
-        xmlNode *acls = get_xpath_object("//" XML_CIB_TAG_ACLS,
-                                         source, LOG_NEVER);
-
         free(p->user);
         p->user = strdup(user);
-
-        if (acls) {
-            xmlNode *child = NULL;
-
-            for (child = __xml_first_child_element(acls); child;
-                 child = __xml_next_element(child)) {
-                const char *tag = crm_element_name(child);
-
-                if (!strcmp(tag, XML_ACL_TAG_USER)
-                    || !strcmp(tag, XML_ACL_TAG_USERv1)) {
-                    const char *id = crm_element_value(child, XML_ATTR_ID);
-
-                    if (id && strcmp(id, user) == 0) {
-                        crm_debug("Unpacking ACLs for user '%s'", id);
-                        p->acls = __xml_acl_parse_entry(acls, child, p->acls);
-                    }
-                }
-            }
-        }
+        p->acls = acls_for_user(source, user);
     }
 #endif
 }
@@ -379,47 +560,64 @@ __xml_acl_mode_test(enum xml_private_flags allowed,
     return FALSE;
 }
 
-/* rc = TRUE if orig_cib has been filtered
- * That means '*result' rather than 'xml' should be exploited afterwards
+/*!
+ * \internal
+ * \brief Copy the parts of an XML element readable via ACLs
+ *
+ * \param[in,out] doc       Document that copy should belong to
+ * \param[in,out] parent    Element to add copy to (or NULL for document root)
+ * \param[in]     xml       Element to copy
+ * \param[in]     modes     ACL flags applied to each matched element
+ * \param[in]     readable  Whether \p xml's parent is readable
+ *
+ * \return Copy of \p xml, or NULL if nothing in it is readable
+ * \note Unreadable elements are copied with only their ID, and only if they
+ *       have readable descendants; denied subtrees are never copied.
  */
-static bool
-__xml_purge_attributes(xmlNode *xml)
+static xmlNode *
+acl_filter_node(xmlDoc *doc, xmlNode *parent, xmlNode *xml, GHashTable *modes,
+                bool readable)
 {
-    xmlNode *child = NULL;
-    xmlAttr *xIter = NULL;
+    uint32_t mode = GPOINTER_TO_UINT(g_hash_table_lookup(modes, xml));
     bool readable_children = FALSE;
-    xml_private_t *p = xml->_private;
+    xmlNode *copy = NULL;
 
-    if (__xml_acl_mode_test(p->flags, xpf_acl_read)) {
-        crm_trace("%s[@id=%s] is readable", crm_element_name(xml), ID(xml));
-        return TRUE;
+    if (is_set(mode, xpf_acl_deny)) {
+        readable = FALSE;
+    } else if (__xml_acl_mode_test(mode, xpf_acl_read)) {
+        readable = TRUE;
     }
 
-    xIter = xml->properties;
-    while (xIter != NULL) {
-        xmlAttr *tmp = xIter;
-        const char *prop_name = (const char *)xIter->name;
-
-        xIter = xIter->next;
-        if (strcmp(prop_name, XML_ATTR_ID) == 0) {
-            continue;
+    if (xml->type != XML_ELEMENT_NODE) {
+        if (readable) {
+            copy = xmlDocCopyNode(xml, doc, 1);
+            xmlAddChild(parent, copy);
         }
-
-        xmlUnsetProp(xml, tmp->name);
+        return copy;
     }
 
-    child = __xml_first_child(xml);
-    while ( child != NULL ) {
-        xmlNode *tmp = child;
+    copy = xmlDocCopyNode(xml, doc, (readable? 2 : 0));
+    if (parent) {
+        xmlAddChild(parent, copy);
+    } else {
+        xmlDocSetRootElement(doc, copy);
+    }
+    if (!readable) {
+        crm_xml_add(copy, XML_ATTR_ID, ID(xml));
+    }
 
-        child = __xml_next(child);
-        readable_children |= __xml_purge_attributes(tmp);
+    for (xmlNode *child = __xml_first_child(xml); child != NULL;
+         child = __xml_next(child)) {
+        if (acl_filter_node(doc, copy, child, modes, readable)) {
+            readable_children = TRUE;
+        }
     }
 
-    if (readable_children == FALSE) {
-        free_xml(xml); /* Nothing readable under here, purge completely */
+    if (!readable && !readable_children) {
+        free_xml(copy); /* Nothing readable under here, purge completely */
+        return NULL;
     }
-    return readable_children;
+    return copy;
 }
 
 /*!
@@ -437,10 +635,8 @@ bool
 xml_acl_filtered_copy(const char *user, xmlNode *acl_source, xmlNode *xml,
                       xmlNode **result)
 {
-    GListPtr aIter = NULL;
-    xmlNode *target = NULL;
-    xml_private_t *p = NULL;
-    xml_private_t *doc = NULL;
+    GList *acls = NULL;
+    GHashTable *modes = NULL;
 
     *result = NULL;
     if (xml == NULL || pcmk_acl_required(user) == FALSE) {
@@ -450,66 +646,45 @@ xml_acl_filtered_copy(const char *user, xmlNode *acl_source, xmlNode *xml,
     }
 
     crm_trace("Filtering XML copy using user '%s' ACLs", user);
-    target = copy_xml(xml);
-    if (target == NULL) {
+    acls = acls_for_user(acl_source, user);
+    if (acls == NULL) {
+        crm_trace("User '%s' without ACLs denied access to entire XML document",
+                  user);
         return TRUE;
     }
 
-    pcmk__unpack_acl(acl_source, target, user);
-    pcmk__set_xml_flag(target, xpf_acl_enabled);
-    pcmk__apply_acl(target);
-
-    doc = target->doc->_private;
-    for(aIter = doc->acls; aIter != NULL && target; aIter = aIter->next) {
-        int max = 0;
+    /* Rather than copying everything and then purging what is denied, record
+     * which elements each ACL matches, then copy only what is readable.
+     */
+    modes = g_hash_table_new(g_direct_hash, g_direct_equal);
+    for (GList *aIter = acls; aIter != NULL; aIter = aIter->next) {
         xml_acl_t *acl = aIter->data;
+        xmlXPathObjectPtr xpathObj = acl_xpath_search(acl, xml);
+        int max = numXpathResults(xpathObj);
 
-        if (acl->mode != xpf_acl_deny) {
-            /* Nothing to do */
-
-        } else if (acl->xpath) {
-            int lpc = 0;
-            xmlXPathObjectPtr xpathObj = xpath_search(target, acl->xpath);
-
-            max = numXpathResults(xpathObj);
-            for(lpc = 0; lpc < max; lpc++) {
-                xmlNode *match = getXpathResult(xpathObj, lpc);
+        for (int lpc = 0; lpc < max; lpc++) {
+            xmlNode *match = getXpathResult(xpathObj, lpc);
+            uint32_t mode = GPOINTER_TO_UINT(g_hash_table_lookup(modes, match));
 
-                if (__xml_purge_attributes(match) == FALSE && match == target) {
-                    crm_trace("ACLs deny user '%s' access to entire XML document",
-                              user);
-                    freeXpathObject(xpathObj);
-                    return TRUE;
-                }
+            if ((match != NULL) && acl_applies(acl, match, mode)) {
+                g_hash_table_insert(modes, match,
+                                    GUINT_TO_POINTER(mode | acl->mode));
             }
-            crm_trace("ACLs deny user '%s' access to %s (%d match%s)",
-                      user, acl->xpath, max, ((max == 1)? "" : "es"));
-            freeXpathObject(xpathObj);
         }
+        crm_trace("ACLs give user '%s' %s access to %s (%d match%s)",
+                  user, __xml_acl_to_text(acl->mode), acl->xpath, max,
+                  ((max == 1)? "" : "es"));
+        freeXpathObject(xpathObj);
     }
 
-    p = target->_private;
-    if (is_set(p->flags, xpf_acl_deny)
-        && (__xml_purge_attributes(target) == FALSE)) {
-        crm_trace("ACLs deny user '%s' access to entire XML document", user);
-        return TRUE;
-    }
-
-    if (doc->acls) {
-        g_list_free_full(doc->acls, __xml_acl_free);
-        doc->acls = NULL;
-
-    } else {
-        crm_trace("User '%s' without ACLs denied access to entire XML document",
-                  user);
-        free_xml(target);
-        target = NULL;
-    }
+    *result = acl_filter_node(xmlNewDoc((pcmkXmlStr) "1.0"), NULL, xml, modes,
+                              FALSE);
+    g_hash_table_destroy(modes);
+    pcmk__free_acls(acls);
 
-    if (target) {
-        *result = target;
+    if (*result == NULL) {
+        crm_trace("ACLs deny user '%s' access to entire XML document", user);
     }
-
     return TRUE;
 }
 
@@ -57,6 +57,9 @@ int pcmk__element_xpath(const char *prefix, xmlNode *xml, char *buffer,
 G_GNUC_INTERNAL
 void pcmk__free_acls(GList *acls);
 
+G_GNUC_INTERNAL
+void pcmk__free_acl_cache(void);
+
 G_GNUC_INTERNAL
 void pcmk__unpack_acl(xmlNode *source, xmlNode *target, const char *user);
 
@@ -78,6 +78,31 @@ calculate_xml_digest_v1(xmlNode * input, gboolean sort, gboolean ignored)
     return digest;
 }
 
+/*!
+ * \internal
+ * \brief Serialize XML as it is for a v2 digest
+ *
+ * This lets the (comparatively expensive) MD5 calculation be done separately,
+ * for example in a worker thread with pcmk__md5sum(), while giving the same
+ * result as calculate_xml_versioned_digest().
+ *
+ * \param[in] input      Root of XML to digest
+ * \param[in] do_filter  Whether to filter certain XML attributes
+ *
+ * \return Newly allocated string to calculate digest of
+ */
+char *
+pcmk__digest_input(xmlNode *input, bool do_filter)
+{
+    char *buffer = NULL;
+    int offset = 0;
+    int max = 0;
+
+    crm_xml_dump(input, (do_filter? xml_log_option_filtered : 0), &buffer,
+                 &offset, &max, 0);
+    return buffer;
+}
+
 /*!
  * \brief Calculate and return v2 digest of XML tree
  *
@@ -91,7 +116,6 @@ calculate_xml_digest_v2(xmlNode * source, gboolean do_filter)
 {
     char *digest = NULL;
     char *buffer = NULL;
-    int offset, max;
 
     static struct qb_log_callsite *digest_cs = NULL;
 
@@ -110,7 +134,7 @@ calculate_xml_digest_v2(xmlNode * source, gboolean do_filter)
          */
 
     } else {
-        crm_xml_dump(source, do_filter ? xml_log_option_filtered : 0, &buffer, &offset, &max, 0);
+        buffer = pcmk__digest_input(source, do_filter);
     }
 
     CRM_ASSERT(buffer != NULL);
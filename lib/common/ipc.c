@@ -39,10 +39,24 @@
 
 #include <crm/common/ipc_internal.h>  /* PCMK__SPECIAL_PID* */
 
-#define PCMK_IPC_VERSION 1
+/* Version 2 added multipart messages. Messages that fit in a single IPC
+ * buffer are still sent as version 1, so that older peers can process them.
+ */
+#define PCMK_IPC_VERSION 2
+#define PCMK_IPC_VERSION_SINGLE 1
+#define PCMK_IPC_VERSION_MULTIPART 2
+
+/* How often to retry sending queued message parts (in milliseconds) */
+#define PCMK_IPC_RESPONSE_RETRY_MS 10
 
 /* Evict clients whose event queue grows this large (by default) */
 #define PCMK_IPC_DEFAULT_QUEUE_MAX 500
+#define PCMK_IPC_DEFAULT_QUEUE_BYTES (32 * 1024 * 1024)
+
+/* Once a client's event queue grows past this fraction of its eviction
+ * threshold, coalescible events it's waiting for are replaced by newer ones
+ */
+#define PCMK_IPC_COALESCE_DIVISOR 4
 
 struct crm_ipc_response_header {
     struct qb_ipc_response_header qb;
@@ -186,6 +200,9 @@ create_reply_adv(xmlNode * original_request, xmlNode * xml_response_data, const
 
 static GHashTable *client_connections = NULL;
 
+/* Event queue statistics for all of this daemon's clients */
+static pcmk__ipc_queue_stats_t queue_stats = { 0, };
+
 /*!
  * \internal
  * \brief Count IPC clients
@@ -294,6 +311,8 @@ pcmk__client_type_str(enum pcmk__client_type client_type)
     }
 }
 
+static void clear_split_cache(void);
+
 void
 pcmk__client_cleanup(void)
 {
@@ -306,6 +325,16 @@ pcmk__client_cleanup(void)
         }
         g_hash_table_destroy(client_connections); client_connections = NULL;
     }
+    clear_split_cache();
+    if (queue_stats.events > 0) {
+        crm_info("IPC event queues: %llu events (%llu bytes) queued, "
+                 "%llu coalesced, %llu client%s evicted, "
+                 "deepest %u events (%llu bytes)",
+                 queue_stats.events, queue_stats.bytes, queue_stats.coalesced,
+                 queue_stats.evictions, pcmk__plural_s(queue_stats.evictions),
+                 queue_stats.max_depth,
+                 (unsigned long long) queue_stats.max_bytes);
+    }
 }
 
 void
@@ -455,6 +484,102 @@ pcmk__new_ipc_event()
     return iov;
 }
 
+/* An event sent to many clients is queued for each of them with its own
+ * header, but they all share a single copy of the (usually much larger) body.
+ * This tracks how many events use each shared body. Each tracked body also
+ * gets a generation number that is never reused, so that a body can be told
+ * apart from an earlier one that was freed at the same address.
+ */
+typedef struct shared_body_s {
+    guint users;            // Number of events using body
+    guint64 generation;     // Unique identifier for body while tracked
+} shared_body_t;
+
+static GHashTable *shared_bodies = NULL;    // Body -> shared_body_t
+static guint64 last_generation = 0;
+
+/* The parts of the last multipart event split for sending, so that the parts
+ * can be shared in the same way when the event is sent to more clients
+ *
+ * Neither this nor shared_bodies is locked, so events may be prepared, queued,
+ * and freed only by the main loop thread, never by a pcmk__offload() worker.
+ */
+static struct {
+    guint64 source;     // Generation of body of event that was split
+    GList *parts;       // Bodies of parts (as struct iovec, each holding a use)
+} split_cache = { 0, NULL };
+
+/*!
+ * \internal
+ * \brief Get the sharing information for an event body, tracking it if needed
+ *
+ * \param[in] body  Event body to check
+ *
+ * \return Sharing information for \p body
+ */
+static shared_body_t *
+get_shared_body(void *body)
+{
+    shared_body_t *shared = NULL;
+
+    if (shared_bodies == NULL) {
+        shared_bodies = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                              NULL, free);
+    } else {
+        shared = g_hash_table_lookup(shared_bodies, body);
+    }
+    if (shared == NULL) {
+        shared = calloc(1, sizeof(shared_body_t));
+        CRM_ASSERT(shared != NULL);
+        shared->users = 1;  // Not shared yet, so only its creator uses it
+        shared->generation = ++last_generation;
+        g_hash_table_insert(shared_bodies, body, shared);
+    }
+    return shared;
+}
+
+/*!
+ * \internal
+ * \brief Add a user of an event body
+ *
+ * \param[in] body  Event body to share
+ *
+ * \return \p body
+ */
+static void *
+share_body(void *body)
+{
+    get_shared_body(body)->users++;
+    return body;
+}
+
+/*!
+ * \internal
+ * \brief Remove a user of an event body, freeing it if it was the last
+ *
+ * \param[in] body  Event body to release
+ */
+static void
+release_body(void *body)
+{
+    if ((body != NULL) && (shared_bodies != NULL)) {
+        shared_body_t *shared = g_hash_table_lookup(shared_bodies, body);
+
+        if (shared != NULL) {
+            if (shared->users > 1) {
+                shared->users--;
+                return;
+            }
+            if (shared->generation == split_cache.source) {
+                // Nothing else can be sent with the cached parts
+                clear_split_cache();
+            }
+            g_hash_table_remove(shared_bodies, body);
+        }
+    }
+    free(body);
+}
+
 /*!
  * \brief Free an I/O vector created by pcmk__ipc_prepare_iov()
  *
@@ -465,7 +590,7 @@ pcmk_free_ipc_event(struct iovec *event)
 {
     if (event != NULL) {
         free(event[0].iov_base);
-        free(event[1].iov_base);
+        release_body(event[1].iov_base);
         free(event);
     }
 }
@@ -476,6 +601,148 @@ free_event(gpointer data)
     pcmk_free_ipc_event((struct iovec *) data);
 }
 
+/*!
+ * \internal
+ * \brief Copy an event's header, sharing its body
+ *
+ * \param[in] iov  Event to copy
+ *
+ * \return Newly allocated event (free with pcmk_free_ipc_event())
+ */
+static struct iovec *
+copy_event(struct iovec *iov)
+{
+    struct iovec *iov_copy = pcmk__new_ipc_event();
+
+    iov_copy[0].iov_len = iov[0].iov_len;
+    iov_copy[0].iov_base = malloc(iov[0].iov_len);
+    CRM_ASSERT(iov_copy[0].iov_base != NULL);
+    memcpy(iov_copy[0].iov_base, iov[0].iov_base, iov[0].iov_len);
+
+    iov_copy[1].iov_len = iov[1].iov_len;
+    iov_copy[1].iov_base = share_body(iov[1].iov_base);
+    return iov_copy;
+}
+
+static void
+clear_split_cache(void)
+{
+    GList *parts = split_cache.parts;
+
+    // Clear first, since freeing the parts re-enters release_body()
+    split_cache.source = 0;
+    split_cache.parts = NULL;
+    g_list_free_full(parts, free_event);
+}
+
+/*!
+ * \internal
+ * \brief Split a message prepared as multipart into IPC-buffer-sized parts
+ *
+ * \param[in] iov  I/O vector created by pcmk__ipc_prepare_iov()
+ *
+ * \return List of newly allocated I/O vectors, one per part, in order
+ * \note Each part repeats the original header (and thus its ID and flags),
+ *       with the size fields describing only that part. The last part also
+ *       has crm_ipc_multipart_end set.
+ */
+static GList *
+split_event(struct iovec *iov)
+{
+    GList *parts = NULL;
+    GList *cached = NULL;
+    size_t offset = 0;
+    size_t max_part = ipc_buffer_max - hdr_offset - 1;
+    guint64 generation = get_shared_body(iov[1].iov_base)->generation;
+
+    if (generation != split_cache.source) {
+        // Split the body once, no matter how many clients it goes to
+        clear_split_cache();
+        while (offset < iov[1].iov_len) {
+            size_t len = QB_MIN(max_part, iov[1].iov_len - offset);
+            struct iovec *part = pcmk__new_ipc_event();
+
+            part[1].iov_base = malloc(len);
+            CRM_ASSERT(part[1].iov_base != NULL);
+            memcpy(part[1].iov_base, (char *) iov[1].iov_base + offset, len);
+            part[1].iov_len = len;
+
+            split_cache.parts = g_list_prepend(split_cache.parts, part);
+            offset += len;
+        }
+        split_cache.parts = g_list_reverse(split_cache.parts);
+        split_cache.source = generation;
+    }
+
+    for (cached = split_cache.parts; cached != NULL; cached = cached->next) {
+        struct iovec *body = cached->data;
+        struct iovec *part = pcmk__new_ipc_event();
+        struct crm_ipc_response_header *header = malloc(hdr_offset);
+
+        CRM_ASSERT(header != NULL);
+        memcpy(header, iov[0].iov_base, hdr_offset);
+        header->size_uncompressed = body[1].iov_len;
+        header->qb.size = hdr_offset + body[1].iov_len;
+        if (cached->next == NULL) {
+            header->flags |= crm_ipc_multipart_end;
+        }
+        part[0].iov_base = header;
+        part[0].iov_len = hdr_offset;
+
+        part[1].iov_base = share_body(body[1].iov_base);
+        part[1].iov_len = body[1].iov_len;
+
+        parts = g_list_prepend(parts, part);
+    }
+    return g_list_reverse(parts);
+}
+
+/*!
+ * \internal
+ * \brief Get event queue statistics for this daemon's IPC clients
+ *
+ * \return Statistics accumulated since the daemon started
+ */
+const pcmk__ipc_queue_stats_t *
+pcmk__ipc_queue_stats(void)
+{
+    return &queue_stats;
+}
+
+static inline size_t
+event_size(struct iovec *iov)
+{
+    return iov[0].iov_len + iov[1].iov_len;
+}
+
+static inline uint32_t
+event_flags(struct iovec *iov)
+{
+    return ((struct crm_ipc_response_header *) iov[0].iov_base)->flags;
+}
+
+/* Whether an event is a whole message, or the last part of one */
+static inline bool
+event_ends_message(struct iovec *iov)
+{
+    uint32_t flags = event_flags(iov);
+
+    return is_not_set(flags, crm_ipc_multipart)
+           || is_set(flags, crm_ipc_multipart_end);
+}
+
+static inline unsigned int
+client_queue_max(pcmk__client_t *c)
+{
+    return QB_MAX(c->queue_max, PCMK_IPC_DEFAULT_QUEUE_MAX);
+}
+
+static inline size_t
+client_queue_max_bytes(pcmk__client_t *c)
+{
+    return QB_MAX(c->queue_max_bytes, PCMK_IPC_DEFAULT_QUEUE_BYTES);
+}
+
 static void
 add_event(pcmk__client_t *c, struct iovec *iov)
 {
@@ -483,6 +750,141 @@ add_event(pcmk__client_t *c, struct iovec *iov)
         c->event_queue = g_queue_new();
     }
     g_queue_push_tail(c->event_queue, iov);
+    c->queue_bytes += event_size(iov);
+
+    /* The parts of a message are queued together, so count the message once
+     * its last part is queued
+     */
+    if (event_ends_message(iov)) {
+        c->queue_messages++;
+        queue_stats.events++;
+    }
+    queue_stats.bytes += event_size(iov);
+    queue_stats.max_depth = QB_MAX(queue_stats.max_depth, c->queue_messages);
+    queue_stats.max_bytes = QB_MAX(queue_stats.max_bytes, c->queue_bytes);
+}
+
+static struct iovec *
+pop_event(pcmk__client_t *c)
+{
+    struct iovec *iov = g_queue_pop_head(c->event_queue);
+
+    if (iov != NULL) {
+        c->queue_bytes -= QB_MIN(c->queue_bytes, event_size(iov));
+        if (event_ends_message(iov) && (c->queue_messages > 0)) {
+            c->queue_messages--;
+        }
+    }
+    return iov;
+}
+
+static inline bool
+client_is_behind(pcmk__client_t *c)
+{
+    return (c->event_queue != NULL)
+           && ((c->queue_messages
+                > (client_queue_max(c) / PCMK_IPC_COALESCE_DIVISOR))
+               || (c->queue_bytes
+                   > (client_queue_max_bytes(c) / PCMK_IPC_COALESCE_DIVISOR)));
+}
+
+/*!
+ * \internal
+ * \brief Drop queued coalescible events, because a newer one is being queued
+ *
+ * \param[in,out] c  Client whose event queue should be pruned
+ *
+ * \note The message at the head of the queue is always kept, because some of
+ *       its parts may already have been sent.
+ */
+static void
+coalesce_events(pcmk__client_t *c)
+{
+    GList *iter = c->event_queue->head;
+    unsigned int dropped = 0;
+    size_t dropped_bytes = 0;
+
+    // Skip every part of the message at the head of the queue
+    for (; iter != NULL; iter = iter->next) {
+        if (event_ends_message(iter->data)) {
+            iter = iter->next;
+            break;
+        }
+    }
+
+    while (iter != NULL) {
+        GList *next = iter->next;
+        struct iovec *event = iter->data;
+
+        // Every part of a coalescible message is flagged as coalescible
+        if (is_set(event_flags(event), crm_ipc_server_coalesce)) {
+            if (event_ends_message(event)) {
+                dropped++;
+            }
+            dropped_bytes += event_size(event);
+            g_queue_delete_link(c->event_queue, iter);
+            pcmk_free_ipc_event(event);
+        }
+        iter = next;
+    }
+
+    if (dropped > 0) {
+        c->queue_bytes -= QB_MIN(c->queue_bytes, dropped_bytes);
+        c->queue_messages -= QB_MIN(c->queue_messages, dropped);
+        queue_stats.coalesced += dropped;
+        crm_debug("Dropped %u superseded event%s (%llu bytes) queued for "
+                  "client with process ID %u " CRM_XS " %p", dropped,
+                  pcmk__plural_s(dropped), (unsigned long long) dropped_bytes,
+                  c->pid, c->ipcs);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Add an event (split into parts if needed) to a client's queue
+ *
+ * \param[in,out] c      Client to queue event for
+ * \param[in]     iov    Event to queue
+ * \param[in]     flags  Group of crm_ipc_flags (only crm_ipc_server_free and
+ *                       crm_ipc_server_coalesce matter here)
+ */
+static void
+queue_event(pcmk__client_t *c, struct iovec *iov, uint32_t flags)
+{
+    GList *parts = NULL;
+    bool coalesce = is_set(flags, crm_ipc_server_coalesce);
+
+    if (coalesce && client_is_behind(c)) {
+        coalesce_events(c);
+    }
+
+    if (is_set(event_flags(iov), crm_ipc_multipart)) {
+        parts = split_event(iov);
+        crm_trace("Sending %d parts to %p[%d]",
+                  g_list_length(parts), c->ipcs, c->pid);
+        if (flags & crm_ipc_server_free) {
+            pcmk_free_ipc_event(iov);
+        }
+
+    } else if (flags & crm_ipc_server_free) {
+        crm_trace("Sending the original to %p[%d]", c->ipcs, c->pid);
+        parts = g_list_append(NULL, iov);
+
+    } else {
+        crm_trace("Sending a copy to %p[%d]", c->ipcs, c->pid);
+        parts = g_list_append(NULL, copy_event(iov));
+    }
+
+    for (GList *iter = parts; iter != NULL; iter = iter->next) {
+        struct iovec *event = iter->data;
+
+        if (coalesce) {
+            ((struct crm_ipc_response_header *) event[0].iov_base)->flags
+                |= crm_ipc_server_coalesce;
+        }
+        add_event(c, event);
+    }
+    g_list_free(parts);
 }
 
 void
@@ -514,6 +916,20 @@ pcmk__free_client(pcmk__client_t *c)
         g_queue_free_full(c->event_queue, free_event);
     }
 
+    if (c->response_timer) {
+        g_source_remove(c->response_timer);
+    }
+
+    if (c->response_queue) {
+        crm_debug("Destroying %d unsent responses",
+                  g_queue_get_length(c->response_queue));
+        g_queue_free_full(c->response_queue, free_event);
+    }
+
+    if (c->async_requests) {
+        g_hash_table_destroy(c->async_requests);
+    }
+
     free(c->id);
     free(c->name);
     free(c->user);
@@ -546,6 +962,9 @@ pcmk__set_client_queue_max(pcmk__client_t *client, const char *qmax)
         qmax_int = crm_parse_ll(qmax, NULL);
         if ((errno == 0) && (qmax_int > 0)) {
             client->queue_max = (unsigned int) qmax_int;
+            client->queue_max_bytes = (size_t) qmax_int
+                                      * (PCMK_IPC_DEFAULT_QUEUE_BYTES
+                                         / PCMK_IPC_DEFAULT_QUEUE_MAX);
             return TRUE;
         }
     }
@@ -564,22 +983,19 @@ pcmk__client_pid(qb_ipcs_connection_t *c)
 
 /*!
  * \internal
- * \brief Retrieve message XML from data read from client IPC
+ * \brief Process the header of data read from client IPC
  *
  * \param[in]  c       IPC client connection
  * \param[in]  data    Data read from client connection
  * \param[out] id      Where to store message ID from libqb header
  * \param[out] flags   Where to store flags from libqb header
  *
- * \return Message XML on success, NULL otherwise
+ * \return Message header if message is acceptable, NULL otherwise
  */
-xmlNode *
-pcmk__client_data2xml(pcmk__client_t *c, void *data, uint32_t *id,
-                      uint32_t *flags)
+static struct crm_ipc_response_header *
+client_data_header(pcmk__client_t *c, void *data, uint32_t *id,
+                   uint32_t *flags)
 {
-    xmlNode *xml = NULL;
-    char *uncompressed = NULL;
-    char *text = ((char *)data) + sizeof(struct crm_ipc_response_header);
     struct crm_ipc_response_header *header = data;
 
     if (id) {
@@ -597,11 +1013,65 @@ pcmk__client_data2xml(pcmk__client_t *c, void *data, uint32_t *id,
         c->flags |= pcmk__client_proxied;
     }
 
+    if (is_set(header->flags, crm_ipc_client_async)
+        && is_set(header->flags, crm_ipc_client_response)) {
+        /* The client has other requests in flight and can't wait on the
+         * response channel, so remember to send the response as an event
+         */
+        if (c->async_requests == NULL) {
+            c->async_requests = g_hash_table_new(g_direct_hash, g_direct_equal);
+        }
+        g_hash_table_insert(c->async_requests, GUINT_TO_POINTER(header->qb.id),
+                            GUINT_TO_POINTER(header->qb.id));
+    }
+
     if(header->version > PCMK_IPC_VERSION) {
         crm_err("Filtering incompatible v%d IPC message, we only support versions <= %d",
                 header->version, PCMK_IPC_VERSION);
         return NULL;
     }
+    return header;
+}
+
+/*!
+ * \internal
+ * \brief Stop tracking an asynchronous request that won't be responded to
+ *
+ * \param[in] c   Client that sent request
+ * \param[in] id  ID of IPC request
+ */
+void
+pcmk__client_forget_async(pcmk__client_t *c, uint32_t id)
+{
+    if ((c != NULL) && (c->async_requests != NULL)) {
+        g_hash_table_remove(c->async_requests, GUINT_TO_POINTER(id));
+    }
+}
+
+/*!
+ * \internal
+ * \brief Retrieve message XML from data read from client IPC
+ *
+ * \param[in]  c       IPC client connection
+ * \param[in]  data    Data read from client connection
+ * \param[out] id      Where to store message ID from libqb header
+ * \param[out] flags   Where to store flags from libqb header
+ *
+ * \return Message XML on success, NULL otherwise
+ */
+xmlNode *
+pcmk__client_data2xml(pcmk__client_t *c, void *data, uint32_t *id,
+                      uint32_t *flags)
+{
+    xmlNode *xml = NULL;
+    char *uncompressed = NULL;
+    char *text = ((char *)data) + sizeof(struct crm_ipc_response_header);
+    struct crm_ipc_response_header *header = NULL;
+
+    header = client_data_header(c, data, id, flags);
+    if (header == NULL) {
+        return NULL;
+    }
 
     if (header->size_compressed) {
         int rc = 0;
@@ -631,6 +1101,126 @@ pcmk__client_data2xml(pcmk__client_t *c, void *data, uint32_t *id,
     return xml;
 }
 
+/*!
+ * \internal
+ * \brief Copy message text from data read from client IPC, without parsing it
+ *
+ * This allows the (possibly expensive) decompression and parsing of a message
+ * to be deferred until after libqb's buffer has been released, for example to
+ * decompress in a worker thread with pcmk__ipc_raw_decompress().
+ *
+ * \param[in]  c       IPC client connection
+ * \param[in]  data    Data read from client connection
+ * \param[out] id      Where to store message ID from libqb header
+ * \param[out] flags   Where to store flags from libqb header
+ *
+ * \return Newly allocated message text on success, NULL otherwise
+ * \note The caller is responsible for freeing the result with
+ *       pcmk__free_ipc_raw().
+ */
+pcmk__ipc_raw_t *
+pcmk__client_data2raw(pcmk__client_t *c, void *data, uint32_t *id,
+                      uint32_t *flags)
+{
+    pcmk__ipc_raw_t *raw = NULL;
+    const char *text = ((char *)data) + sizeof(struct crm_ipc_response_header);
+    struct crm_ipc_response_header *header = NULL;
+    unsigned int size = 0;
+
+    header = client_data_header(c, data, id, flags);
+    if (header == NULL) {
+        return NULL;
+    }
+
+    raw = calloc(1, sizeof(pcmk__ipc_raw_t));
+    CRM_ASSERT(raw != NULL);
+    raw->size_compressed = header->size_compressed;
+    raw->size_uncompressed = header->size_uncompressed;
+
+    size = raw->size_compressed? raw->size_compressed : raw->size_uncompressed;
+    raw->text = malloc(size);
+    CRM_ASSERT(raw->text != NULL);
+    memcpy(raw->text, text, size);
+    return raw;
+}
+
+/*!
+ * \internal
+ * \brief Decompress raw IPC message text in place, if it is compressed
+ *
+ * \param[in,out] raw  Message text from pcmk__client_data2raw()
+ *
+ * \return Standard Pacemaker return code
+ * \note This neither logs nor touches any global state, so it is safe to call
+ *       from a worker thread (see pcmk__offload()).
+ */
+int
+pcmk__ipc_raw_decompress(pcmk__ipc_raw_t *raw)
+{
+    int rc = BZ_OK;
+    char *uncompressed = NULL;
+    unsigned int size_u = 0;
+
+    if (raw->size_compressed == 0) {
+        return pcmk_rc_ok;
+    }
+
+    size_u = 1 + raw->size_uncompressed;
+    uncompressed = calloc(1, size_u);
+    if (uncompressed == NULL) {
+        return ENOMEM;
+    }
+
+    rc = BZ2_bzBuffToBuffDecompress(uncompressed, &size_u, raw->text,
+                                    raw->size_compressed, 1, 0);
+    if (rc != BZ_OK) {
+        free(uncompressed);
+        return (rc == BZ_MEM_ERROR)? ENOMEM : EBADMSG;
+    }
+
+    free(raw->text);
+    raw->text = uncompressed;
+    raw->size_compressed = 0;
+    return pcmk_rc_ok;
+}
+
+/*!
+ * \internal
+ * \brief Parse raw IPC message text (decompressing it first if needed)
+ *
+ * \param[in,out] raw  Message text from pcmk__client_data2raw()
+ *
+ * \return Message XML on success, NULL otherwise
+ */
+xmlNode *
+pcmk__ipc_raw2xml(pcmk__ipc_raw_t *raw)
+{
+    xmlNode *xml = NULL;
+    int rc = pcmk__ipc_raw_decompress(raw);
+
+    if (rc != pcmk_rc_ok) {
+        crm_err("Decompression failed: %s " CRM_XS " rc=%d",
+                pcmk_rc_str(rc), rc);
+        return NULL;
+    }
+
+    CRM_CHECK((raw->size_uncompressed > 0)
+              && (raw->text[raw->size_uncompressed - 1] == 0), return NULL);
+
+    xml = string2xml(raw->text);
+    crm_log_xml_trace(xml, "[IPC received]");
+    return xml;
+}
+
+void
+pcmk__free_ipc_raw(pcmk__ipc_raw_t *raw)
+{
+    if (raw != NULL) {
+        free(raw->text);
+        free(raw);
+    }
+}
+
 static int crm_ipcs_flush_events(pcmk__client_t *c);
 
 static gboolean
@@ -655,6 +1245,14 @@ delay_next_flush(pcmk__client_t *c, unsigned int queue_len)
 {
     /* Delay a maximum of 1.5 seconds */
     guint delay = (queue_len < 5)? (1000 + 100 * queue_len) : 1500;
+    struct iovec *event = g_queue_peek_head(c->event_queue);
+
+    if ((event != NULL)
+        && is_set(((struct crm_ipc_response_header *) event[0].iov_base)->flags,
+                  crm_ipc_multipart)) {
+        /* The client is most likely just busy reading the previous part */
+        delay = PCMK_IPC_RESPONSE_RETRY_MS;
+    }
 
     c->event_timer = g_timeout_add(delay, crm_ipcs_flush_events_cb, c);
 }
@@ -684,9 +1282,6 @@ crm_ipcs_flush_events(pcmk__client_t *c)
         return rc;
     }
 
-    if (c->event_queue) {
-        queue_len = g_queue_get_length(c->event_queue);
-    }
     while (sent < 100) {
         struct crm_ipc_response_header *header = NULL;
         struct iovec *event = NULL;
@@ -704,7 +1299,7 @@ crm_ipcs_flush_events(pcmk__client_t *c)
             rc = (int) -qb_rc;
             break;
         }
-        event = g_queue_pop_head(c->event_queue);
+        event = pop_event(c);
 
         sent++;
         header = event[0].iov_base;
@@ -719,9 +1314,12 @@ crm_ipcs_flush_events(pcmk__client_t *c)
         pcmk_free_ipc_event(event);
     }
 
-    queue_len -= sent;
+    /* A message sent in parts counts as one message here, so that clients
+     * aren't evicted sooner for receiving large messages
+     */
+    queue_len = c->queue_messages;
     if (sent > 0 || queue_len) {
-        crm_trace("Sent %d events (%d remaining) for %p[%d]: %s (%lld)",
+        crm_trace("Sent %d events (%d messages remaining) for %p[%d]: %s (%lld)",
                   sent, queue_len, c->ipcs, c->pid,
                   pcmk_rc_str(rc), (long long) qb_rc);
     }
@@ -732,28 +1330,93 @@ crm_ipcs_flush_events(pcmk__client_t *c)
          * but drop completely unresponsive clients so the connection doesn't
          * consume resources indefinitely.
          */
-        if (queue_len > QB_MAX(c->queue_max, PCMK_IPC_DEFAULT_QUEUE_MAX)) {
+        if ((queue_len > client_queue_max(c))
+            || (c->queue_bytes > client_queue_max_bytes(c))) {
             if ((c->queue_backlog <= 1) || (queue_len < c->queue_backlog)) {
                 /* Don't evict for a new or shrinking backlog */
                 crm_warn("Client with process ID %u has a backlog of %u messages "
-                         CRM_XS " %p", c->pid, queue_len, c->ipcs);
+                         "(%llu bytes) " CRM_XS " %p", c->pid, queue_len,
+                         (unsigned long long) c->queue_bytes, c->ipcs);
             } else {
                 crm_err("Evicting client with process ID %u due to backlog of %u messages "
-                         CRM_XS " %p", c->pid, queue_len, c->ipcs);
+                        "(%llu bytes) " CRM_XS " %p", c->pid, queue_len,
+                        (unsigned long long) c->queue_bytes, c->ipcs);
                 c->queue_backlog = 0;
+                queue_stats.evictions++;
                 qb_ipcs_disconnect(c->ipcs);
                 return rc;
             }
         }
 
-        c->queue_backlog = queue_len;
-        delay_next_flush(c, queue_len);
-
-    } else {
-        /* Event queue is empty, there is no backlog */
-        c->queue_backlog = 0;
+        c->queue_backlog = queue_len;
+        delay_next_flush(c, queue_len);
+
+    } else {
+        /* Event queue is empty, there is no backlog */
+        c->queue_backlog = 0;
+    }
+
+    return rc;
+}
+
+static int crm_ipcs_flush_responses(pcmk__client_t *c);
+
+static gboolean
+crm_ipcs_flush_responses_cb(gpointer data)
+{
+    pcmk__client_t *c = data;
+
+    c->response_timer = 0;
+    crm_ipcs_flush_responses(c);
+    return FALSE;
+}
+
+/*!
+ * \internal
+ * \brief Send client any queued responses that its buffer can now hold
+ *
+ * \param[in]  c  Client to flush
+ *
+ * \return Standard Pacemaker return code
+ */
+static int
+crm_ipcs_flush_responses(pcmk__client_t *c)
+{
+    int rc = pcmk_rc_ok;
+
+    while ((c->response_queue != NULL)
+           && !g_queue_is_empty(c->response_queue)) {
+        struct iovec *iov = g_queue_peek_head(c->response_queue);
+        struct crm_ipc_response_header *header = iov[0].iov_base;
+        ssize_t qb_rc = qb_ipcs_response_sendv(c->ipcs, iov, 2);
+
+        if (qb_rc == -EAGAIN) {
+            /* The client hasn't read the previous part yet */
+            if (c->response_timer == 0) {
+                c->response_timer = g_timeout_add(PCMK_IPC_RESPONSE_RETRY_MS,
+                                                  crm_ipcs_flush_responses_cb,
+                                                  c);
+            }
+            break;
+
+        } else if (qb_rc < header->qb.size) {
+            rc = (qb_rc < 0)? (int) -qb_rc : EIO;
+            crm_notice("Response %d to pid %d failed: %s "
+                       CRM_XS " bytes=%u rc=%lld ipcs=%p",
+                       header->qb.id, c->pid, pcmk_rc_str(rc),
+                       header->qb.size, (long long) qb_rc, c->ipcs);
+
+            /* The rest of the message is useless without this part */
+            g_queue_free_full(c->response_queue, free_event);
+            c->response_queue = NULL;
+            break;
+        }
+
+        crm_trace("Response %d%s sent, %lld bytes to %p[%d]", header->qb.id,
+                  (is_set(header->flags, crm_ipc_multipart)? " part" : ""),
+                  (long long) qb_rc, c->ipcs, c->pid);
+        pcmk_free_ipc_event(g_queue_pop_head(c->response_queue));
     }
-
     return rc;
 }
 
@@ -764,15 +1427,17 @@ crm_ipcs_flush_events(pcmk__client_t *c)
  * \param[in]  request        Identifier for libqb response header
  * \param[in]  message        XML message to send
  * \param[in]  max_send_size  If 0, default IPC buffer size is used
+ * \param[in]  multipart      If message is too big for one IPC buffer even
+ *                            when compressed, mark it to be sent in parts
+ *                            (rather than failing)
  * \param[out] result         Where to store prepared I/O vector
  * \param[out] bytes          Size of prepared data in bytes
  *
  * \return Standard Pacemaker return code
  */
-int
-pcmk__ipc_prepare_iov(uint32_t request, xmlNode *message,
-                      uint32_t max_send_size, struct iovec **result,
-                      ssize_t *bytes)
+static int
+prepare_iov(uint32_t request, xmlNode *message, uint32_t max_send_size,
+            bool multipart, struct iovec **result, ssize_t *bytes)
 {
     static unsigned int biggest = 0;
     struct iovec *iov;
@@ -803,7 +1468,7 @@ pcmk__ipc_prepare_iov(uint32_t request, xmlNode *message,
     iov[0].iov_len = hdr_offset;
     iov[0].iov_base = header;
 
-    header->version = PCMK_IPC_VERSION;
+    header->version = PCMK_IPC_VERSION_SINGLE;
     header->size_uncompressed = 1 + strlen(buffer);
     total = iov[0].iov_len + header->size_uncompressed;
 
@@ -814,6 +1479,10 @@ pcmk__ipc_prepare_iov(uint32_t request, xmlNode *message,
     } else {
         unsigned int new_size = 0;
 
+        /* A compressed message is still a single (version 1) message, which
+         * any peer can handle and which needs less buffer space and fewer
+         * sends than a multipart one, so prefer that when possible
+         */
         if (pcmk__compress(buffer, (unsigned int) header->size_uncompressed,
                            (unsigned int) max_send_size, &compressed,
                            &new_size) == pcmk_rc_ok) {
@@ -828,6 +1497,17 @@ pcmk__ipc_prepare_iov(uint32_t request, xmlNode *message,
 
             biggest = QB_MAX(header->size_compressed, biggest);
 
+        } else if (multipart) {
+            /* pcmk__ipc_send_iov() will split this into parts as it sends it,
+             * so neither end needs a buffer big enough for the whole message
+             */
+            crm_trace("Sending %u-byte message in parts of less than %u bytes",
+                      header->size_uncompressed, max_send_size);
+            header->version = PCMK_IPC_VERSION_MULTIPART;
+            header->flags |= crm_ipc_multipart;
+            iov[1].iov_base = buffer;
+            iov[1].iov_len = header->size_uncompressed;
+
         } else {
             crm_log_xml_trace(message, "EMSGSIZE");
             biggest = QB_MAX(header->size_uncompressed, biggest);
@@ -855,6 +1535,29 @@ pcmk__ipc_prepare_iov(uint32_t request, xmlNode *message,
     return pcmk_rc_ok;
 }
 
+/*!
+ * \internal
+ * \brief Create an I/O vector for sending an IPC XML message to a client
+ *
+ * \param[in]  request        Identifier for libqb response header
+ * \param[in]  message        XML message to send
+ * \param[in]  max_send_size  If 0, default IPC buffer size is used
+ * \param[out] result         Where to store prepared I/O vector
+ * \param[out] bytes          Size of prepared data in bytes
+ *
+ * \return Standard Pacemaker return code
+ * \note Messages too large for max_send_size are compressed, or if still too
+ *       large, prepared as multipart messages, which pcmk__ipc_send_iov()
+ *       sends one part at a time.
+ */
+int
+pcmk__ipc_prepare_iov(uint32_t request, xmlNode *message,
+                      uint32_t max_send_size, struct iovec **result,
+                      ssize_t *bytes)
+{
+    return prepare_iov(request, message, max_send_size, TRUE, result, bytes);
+}
+
 int
 pcmk__ipc_send_iov(pcmk__client_t *c, struct iovec *iov, uint32_t flags)
 {
@@ -870,30 +1573,57 @@ pcmk__ipc_send_iov(pcmk__client_t *c, struct iovec *iov, uint32_t flags)
              * even though we're sending it over the event channel. */
             flags |= crm_ipc_proxied_relay_response;
         }
+
+    } else if (is_not_set(flags, crm_ipc_server_event)
+               && (c->async_requests != NULL)
+               && g_hash_table_remove(c->async_requests,
+                                      GUINT_TO_POINTER(header->qb.id))) {
+        /* Responses to asynchronous requests are sent as events that keep the
+         * request ID, so the client can match them to the request
+         */
+        flags |= crm_ipc_server_event|crm_ipc_client_async;
     }
 
-    header->flags |= flags;
+    /* The same event may be sent to many clients, and not all of them may
+     * have it coalesced, so that flag is set only on the queued copy
+     */
+    header->flags |= (flags & ~crm_ipc_server_coalesce);
     if (flags & crm_ipc_server_event) {
-        header->qb.id = id++;   /* We don't really use it, but doesn't hurt to set one */
+        if (is_not_set(flags, crm_ipc_client_async)) {
+            header->qb.id = id++;   /* We don't really use it, but doesn't hurt to set one */
+        }
 
-        if (flags & crm_ipc_server_free) {
-            crm_trace("Sending the original to %p[%d]", c->ipcs, c->pid);
-            add_event(c, iov);
+        queue_event(c, iov, flags);
 
-        } else {
-            struct iovec *iov_copy = pcmk__new_ipc_event();
+    } else if (is_set(header->flags, crm_ipc_multipart)
+               || ((c->response_queue != NULL)
+                   && !g_queue_is_empty(c->response_queue))) {
+        /* Only one buffer's worth of response fits at a time, so queue the
+         * parts (and any responses after them) until the client reads them
+         */
+        CRM_LOG_ASSERT(header->qb.id != 0);     /* Replying to a specific request */
+
+        if (c->response_queue == NULL) {
+            c->response_queue = g_queue_new();
+        }
+        if (is_set(header->flags, crm_ipc_multipart)) {
+            GList *parts = split_event(iov);
 
-            crm_trace("Sending a copy to %p[%d]", c->ipcs, c->pid);
-            iov_copy[0].iov_len = iov[0].iov_len;
-            iov_copy[0].iov_base = malloc(iov[0].iov_len);
-            memcpy(iov_copy[0].iov_base, iov[0].iov_base, iov[0].iov_len);
+            for (GList *iter = parts; iter != NULL; iter = iter->next) {
+                g_queue_push_tail(c->response_queue, iter->data);
+            }
+            g_list_free(parts);
+            if (flags & crm_ipc_server_free) {
+                pcmk_free_ipc_event(iov);
+            }
 
-            iov_copy[1].iov_len = iov[1].iov_len;
-            iov_copy[1].iov_base = malloc(iov[1].iov_len);
-            memcpy(iov_copy[1].iov_base, iov[1].iov_base, iov[1].iov_len);
+        } else if (flags & crm_ipc_server_free) {
+            g_queue_push_tail(c->response_queue, iov);
 
-            add_event(c, iov_copy);
+        } else {
+            g_queue_push_tail(c->response_queue, copy_event(iov));
         }
+        rc = crm_ipcs_flush_responses(c);
 
     } else {
         ssize_t qb_rc;
@@ -975,6 +1705,31 @@ pcmk__ipc_send_ack_as(const char *function, int line, pcmk__client_t *c,
 #define MIN_MSG_SIZE    12336   /* sizeof(struct qb_ipc_connection_response) */
 #define MAX_MSG_SIZE    128*1024 /* 128k default */
 
+/* Longest to back off between attempts to send to a busy server (in ms) */
+#define PCMK_IPC_SEND_BACKOFF_MAX_MS 64
+
+/* IPC server name -> pcmk__ipc_latency_t for synchronous requests to it */
+static GHashTable *ipc_latency = NULL;
+
+/* A multipart message being reassembled */
+struct ipc_multipart_s {
+    char *data;
+    unsigned int size;
+};
+
+/* An asynchronous request awaiting its response */
+struct ipc_async_request_s {
+    pcmk__ipc_reply_fn_t callback;
+    void *user_data;
+    gint64 sent;
+    gint64 expires;
+};
+
+/* ID of the most recent request sent by any client connection */
+static uint32_t ipc_request_id = 0;
+
+static void record_latency(const char *server, gint64 elapsed_us, bool ok);
+
 struct crm_ipc_s {
     struct pollfd pfd;
 
@@ -989,6 +1744,14 @@ struct crm_ipc_s {
 
     qb_ipcc_connection_t *ipc;
 
+    /* Events and replies arrive on separate channels, so they're reassembled
+     * separately
+     */
+    struct ipc_multipart_s event_parts;
+    struct ipc_multipart_s reply_parts;
+
+    GHashTable *async_requests; // Request ID -> struct ipc_async_request_s
+    gint64 next_expiry;         // Earliest expiration of an async request
 };
 
 static unsigned int
@@ -1109,6 +1872,84 @@ crm_ipc_connect(crm_ipc_t * client)
     return TRUE;
 }
 
+/*!
+ * \internal
+ * \brief Call the callback of every asynchronous request still in flight
+ *
+ * \param[in,out] client  IPC connection
+ * \param[in]     rc      Standard Pacemaker return code to pass to callbacks
+ */
+static void
+fail_async_requests(crm_ipc_t *client, int rc)
+{
+    GHashTableIter iter;
+    gpointer id = NULL;
+    struct ipc_async_request_s *request = NULL;
+    GHashTable *requests = client->async_requests;
+
+    if (requests == NULL) {
+        return;
+    }
+
+    // Callbacks may send new requests, which will go to a new table
+    client->async_requests = NULL;
+
+    g_hash_table_iter_init(&iter, requests);
+    while (g_hash_table_iter_next(&iter, &id, (gpointer *) &request)) {
+        crm_debug("Abandoning %s IPC request %u: %s",
+                  client->name, GPOINTER_TO_UINT(id), pcmk_rc_str(rc));
+        record_latency(client->name, g_get_monotonic_time() - request->sent,
+                       FALSE);
+        request->callback(client, GPOINTER_TO_UINT(id), rc, NULL,
+                          request->user_data);
+    }
+    g_hash_table_destroy(requests);
+}
+
+/*!
+ * \internal
+ * \brief Time out any asynchronous requests whose timeout has passed
+ *
+ * \param[in,out] client  IPC connection
+ */
+static void
+expire_async_requests(crm_ipc_t *client)
+{
+    GHashTableIter iter;
+    gpointer id = NULL;
+    struct ipc_async_request_s *request = NULL;
+    GList *expired = NULL;
+    gint64 now = g_get_monotonic_time();
+
+    if ((client->async_requests == NULL) || (now < client->next_expiry)) {
+        return;
+    }
+
+    client->next_expiry = G_MAXINT64;
+    g_hash_table_iter_init(&iter, client->async_requests);
+    while (g_hash_table_iter_next(&iter, &id, (gpointer *) &request)) {
+        if (request->expires <= now) {
+            expired = g_list_prepend(expired, id);
+        } else {
+            client->next_expiry = QB_MIN(client->next_expiry,
+                                         request->expires);
+        }
+    }
+
+    // Callbacks may send new requests, so don't call them while iterating
+    for (GList *item = expired; item != NULL; item = item->next) {
+        request = g_hash_table_lookup(client->async_requests, item->data);
+        g_hash_table_steal(client->async_requests, item->data);
+        crm_info("%s IPC request %u timed out", client->name,
+                 GPOINTER_TO_UINT(item->data));
+        record_latency(client->name, now - request->sent, FALSE);
+        request->callback(client, GPOINTER_TO_UINT(item->data), ETIMEDOUT,
+                          NULL, request->user_data);
+        free(request);
+    }
+    g_list_free(expired);
+}
+
 void
 crm_ipc_close(crm_ipc_t * client)
 {
@@ -1121,6 +1962,7 @@ crm_ipc_close(crm_ipc_t * client)
             client->ipc = NULL;
             qb_ipcc_disconnect(ipc);
         }
+        fail_async_requests(client, ENOTCONN);
     }
 }
 
@@ -1141,6 +1983,9 @@ crm_ipc_destroy(crm_ipc_t * client)
             /* crm_ipc_close(client); */
         }
         crm_trace("Destroying IPC connection to %s: %p", client->name, client);
+        fail_async_requests(client, ENOTCONN);
+        free(client->event_parts.data);
+        free(client->reply_parts.data);
         free(client->buffer);
         free(client->name);
         free(client);
@@ -1257,6 +2102,76 @@ crm_ipc_decompress(crm_ipc_t * client)
     return pcmk_rc_ok;
 }
 
+/*!
+ * \internal
+ * \brief Collect a received message that may be part of a multipart message
+ *
+ * \param[in,out] client  IPC connection with message in its buffer
+ * \param[in,out] parts   Reassembly state for the channel it arrived on
+ *
+ * \return Standard Pacemaker return code (EAGAIN if more parts are needed)
+ * \note Once the last part arrives, the client buffer is replaced with the
+ *       complete message (as if it had been sent in one piece).
+ */
+static int
+crm_ipc_collect_part(crm_ipc_t *client, struct ipc_multipart_s *parts)
+{
+    struct crm_ipc_response_header *header = (struct crm_ipc_response_header *)(void*)client->buffer;
+    unsigned int total = 0;
+    char *buffer = NULL;
+
+    if (is_not_set(header->flags, crm_ipc_multipart)) {
+        if (parts->data != NULL) {
+            crm_warn("Discarding incomplete %u-byte multipart message from %s",
+                     parts->size, client->name);
+            free(parts->data);
+            parts->data = NULL;
+            parts->size = 0;
+        }
+        return pcmk_rc_ok;
+    }
+
+    buffer = realloc(parts->data, parts->size + header->size_uncompressed);
+    if (buffer == NULL) {
+        return ENOMEM;
+    }
+    memcpy(buffer + parts->size, client->buffer + hdr_offset,
+           header->size_uncompressed);
+    parts->data = buffer;
+    parts->size += header->size_uncompressed;
+
+    if (is_not_set(header->flags, crm_ipc_multipart_end)) {
+        crm_trace("Received %u bytes of multipart %s message %d so far",
+                  parts->size, client->name, header->qb.id);
+        return EAGAIN;
+    }
+
+    total = hdr_offset + parts->size;
+    buffer = malloc(QB_MAX(total, client->max_buf_size));
+    if (buffer == NULL) {
+        return ENOMEM;
+    }
+    memcpy(buffer, client->buffer, hdr_offset);   /* Preserve the header */
+    memcpy(buffer + hdr_offset, parts->data, parts->size);
+
+    header = (struct crm_ipc_response_header *)(void*)buffer;
+    header->size_uncompressed = parts->size;
+    header->qb.size = total;
+    header->flags &= ~(crm_ipc_multipart|crm_ipc_multipart_end);
+
+    crm_trace("Reassembled %u-byte multipart %s message %d",
+              parts->size, client->name, header->qb.id);
+
+    free(client->buffer);
+    client->buffer = buffer;
+    client->buf_size = QB_MAX(total, client->max_buf_size);
+
+    free(parts->data);
+    parts->data = NULL;
+    parts->size = 0;
+    return pcmk_rc_ok;
+}
+
 long
 crm_ipc_read(crm_ipc_t * client)
 {
@@ -1272,9 +2187,13 @@ crm_ipc_read(crm_ipc_t * client)
     client->msg_size = qb_ipcc_event_recv(client->ipc, client->buffer,
                                           client->buf_size, 0);
     if (client->msg_size >= 0) {
-        int rc = crm_ipc_decompress(client);
+        int rc = crm_ipc_collect_part(client, &(client->event_parts));
 
+        if (rc == pcmk_rc_ok) {
+            rc = crm_ipc_decompress(client);
+        }
         if (rc != pcmk_rc_ok) {
+            // -EAGAIN just means the whole message hasn't arrived yet
             return pcmk_rc2legacy(rc);
         }
 
@@ -1332,12 +2251,162 @@ crm_ipc_name(crm_ipc_t * client)
     return client->name;
 }
 
+/*!
+ * \internal
+ * \brief Get milliseconds remaining until a monotonic deadline
+ *
+ * \param[in] deadline  Deadline (as returned by g_get_monotonic_time())
+ *
+ * \return Milliseconds remaining (rounded up), or 0 if deadline has passed
+ */
+static inline int
+ms_until(gint64 deadline)
+{
+    gint64 remaining = deadline - g_get_monotonic_time();
+
+    return (remaining <= 0)? 0 : (int) ((remaining + 999) / 1000);
+}
+
+/*!
+ * \internal
+ * \brief Record how long a synchronous IPC request took
+ *
+ * \param[in] server      Name of IPC server request was sent to
+ * \param[in] elapsed_us  Microseconds between sending and getting reply
+ * \param[in] ok          Whether a reply was received
+ */
+static void
+record_latency(const char *server, gint64 elapsed_us, bool ok)
+{
+    pcmk__ipc_latency_t *latency = NULL;
+    gint64 elapsed_ms = elapsed_us / 1000;
+    int bucket = 0;
+
+    if (ipc_latency == NULL) {
+        ipc_latency = g_hash_table_new_full(crm_str_hash, g_str_equal, free,
+                                            free);
+    }
+    latency = g_hash_table_lookup(ipc_latency, server);
+    if (latency == NULL) {
+        latency = calloc(1, sizeof(pcmk__ipc_latency_t));
+        CRM_ASSERT(latency != NULL);
+        g_hash_table_insert(ipc_latency, strdup(server), latency);
+    }
+
+    latency->count++;
+    if (!ok) {
+        latency->failed++;
+    }
+    latency->total_us += elapsed_us;
+    latency->max_us = QB_MAX(latency->max_us, (unsigned long long) elapsed_us);
+
+    while ((bucket < (PCMK__IPC_LATENCY_BUCKETS - 1))
+           && (elapsed_ms >= (1LL << bucket))) {
+        bucket++;
+    }
+    latency->buckets[bucket]++;
+}
+
+/*!
+ * \internal
+ * \brief Build an XML summary of synchronous IPC request latency
+ *
+ * \param[in,out] parent  XML to add summary to
+ *
+ * \return Newly added XML element
+ */
+xmlNode *
+pcmk__ipc_latency_xml(xmlNode *parent)
+{
+    xmlNode *xml = create_xml_node(parent, "ipc-latency");
+    GHashTableIter iter;
+    const char *server = NULL;
+    pcmk__ipc_latency_t *latency = NULL;
+
+    if (ipc_latency == NULL) {
+        return xml;
+    }
+    g_hash_table_iter_init(&iter, ipc_latency);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &server,
+                                  (gpointer *) &latency)) {
+        xmlNode *child = create_xml_node(xml, "server");
+
+        crm_xml_add(child, XML_ATTR_ID, server);
+        crm_xml_add_ll(child, "count", (long long) latency->count);
+        crm_xml_add_ll(child, "failed", (long long) latency->failed);
+        crm_xml_add_ll(child, "total-us", (long long) latency->total_us);
+        crm_xml_add_ll(child, "max-us", (long long) latency->max_us);
+
+        for (int lpc = 0; lpc < PCMK__IPC_LATENCY_BUCKETS; lpc++) {
+            xmlNode *bucket = NULL;
+
+            if (latency->buckets[lpc] == 0) {
+                continue;
+            }
+            bucket = create_xml_node(child, "bucket");
+            if (lpc < (PCMK__IPC_LATENCY_BUCKETS - 1)) {
+                crm_xml_add_ll(bucket, "below-ms", 1LL << lpc);
+            } else {
+                // The last bucket also counts anything slower
+                crm_xml_add_ll(bucket, "at-least-ms", 1LL << (lpc - 1));
+            }
+            crm_xml_add_ll(bucket, "count", (long long) latency->buckets[lpc]);
+        }
+    }
+    return xml;
+}
+
+/*!
+ * \internal
+ * \brief Log IPC request latency statistics, then free them
+ *
+ * \param[in] log_level  Priority at which to log statistics
+ */
+void
+pcmk__ipc_latency_cleanup(int log_level)
+{
+    GHashTableIter iter;
+    const char *server = NULL;
+    pcmk__ipc_latency_t *latency = NULL;
+
+    if (ipc_latency == NULL) {
+        return;
+    }
+
+    g_hash_table_iter_init(&iter, ipc_latency);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &server,
+                                  (gpointer *) &latency)) {
+        char *histogram = NULL;
+        int last = PCMK__IPC_LATENCY_BUCKETS - 1;
+
+        while ((last > 0) && (latency->buckets[last] == 0)) {
+            last--;
+        }
+        for (int lpc = 0; lpc <= last; lpc++) {
+            char *old = histogram;
+
+            histogram = crm_strdup_printf("%s%s<%lldms:%llu",
+                                          (old? old : ""), (old? " " : ""),
+                                          (1LL << lpc), latency->buckets[lpc]);
+            free(old);
+        }
+        do_crm_log(log_level, "IPC requests to %s: %llu (%llu failed), "
+                   "average %lldus, max %lldus, histogram %s",
+                   server, latency->count, latency->failed,
+                   (long long) (latency->total_us / latency->count),
+                   (long long) latency->max_us, histogram);
+        free(histogram);
+    }
+    g_hash_table_destroy(ipc_latency);
+    ipc_latency = NULL;
+}
+
 // \return Standard Pacemaker return code
 static int
 internal_ipc_get_reply(crm_ipc_t *client, int request_id, int ms_timeout,
                        ssize_t *bytes)
 {
-    time_t timeout = time(NULL) + 1 + (ms_timeout / 1000);
+    gint64 deadline = g_get_monotonic_time() + (ms_timeout * 1000LL);
     int rc = pcmk_rc_ok;
 
     crm_ipc_init();
@@ -1345,17 +2414,26 @@ internal_ipc_get_reply(crm_ipc_t *client, int request_id, int ms_timeout,
     /* get the reply */
     crm_trace("client %s waiting on reply to msg id %d", client->name, request_id);
     do {
-
-        *bytes = qb_ipcc_recv(client->ipc, client->buffer, client->buf_size, 1000);
+        /* Wake at least once a second to check the connection is still up */
+        *bytes = qb_ipcc_recv(client->ipc, client->buffer, client->buf_size,
+                              QB_MIN(ms_until(deadline), 1000));
         if (*bytes > 0) {
             struct crm_ipc_response_header *hdr = NULL;
 
-            rc = crm_ipc_decompress(client);
+            rc = crm_ipc_collect_part(client, &(client->reply_parts));
+            if (rc == EAGAIN) {
+                rc = pcmk_rc_ok;
+                continue;
+            }
+            if (rc == pcmk_rc_ok) {
+                rc = crm_ipc_decompress(client);
+            }
             if (rc != pcmk_rc_ok) {
                 return rc;
             }
 
             hdr = (struct crm_ipc_response_header *)(void*)client->buffer;
+            *bytes = hdr->qb.size;
             if (hdr->qb.id == request_id) {
                 /* Got it */
                 break;
@@ -1378,10 +2456,16 @@ internal_ipc_get_reply(crm_ipc_t *client, int request_id, int ms_timeout,
             break;
         }
 
-    } while (time(NULL) < timeout);
+    } while (ms_until(deadline) > 0);
 
     if (*bytes < 0) {
         rc = (int) -*bytes; // System errno
+
+    } else if (client->reply_parts.data != NULL) {
+        crm_err("Timed out with only %u bytes of reply %d from %s",
+                client->reply_parts.size, request_id, client->name);
+        *bytes = -ETIMEDOUT;
+        rc = ETIMEDOUT;
     }
     return rc;
 }
@@ -1407,9 +2491,9 @@ crm_ipc_send(crm_ipc_t * client, xmlNode * message, enum crm_ipc_flags flags, in
     ssize_t qb_rc = 0;
     ssize_t bytes = 0;
     struct iovec *iov;
-    static uint32_t id = 0;
     static int factor = 8;
     struct crm_ipc_response_header *header;
+    gint64 started = 0;
 
     crm_ipc_init();
 
@@ -1443,9 +2527,12 @@ crm_ipc_send(crm_ipc_t * client, xmlNode * message, enum crm_ipc_flags flags, in
         }
     }
 
-    id++;
-    CRM_LOG_ASSERT(id != 0); /* Crude wrap-around detection */
-    rc = pcmk__ipc_prepare_iov(id, message, client->max_buf_size, &iov, &bytes);
+    ipc_request_id++;
+    CRM_LOG_ASSERT(ipc_request_id != 0); /* Crude wrap-around detection */
+    /* Servers can't reassemble multipart requests, so large requests are
+     * still compressed
+     */
+    rc = prepare_iov(ipc_request_id, message, client->max_buf_size, FALSE, &iov, &bytes);
     if (rc != pcmk_rc_ok) {
         crm_warn("Couldn't prepare IPC request to %s: %s " CRM_XS " rc=%d",
                  client->name, pcmk_rc_str(rc), rc);
@@ -1455,7 +2542,7 @@ crm_ipc_send(crm_ipc_t * client, xmlNode * message, enum crm_ipc_flags flags, in
     header = iov[0].iov_base;
     header->flags |= flags;
 
-    if(is_set(flags, crm_ipc_proxied)) {
+    if (is_set(flags, crm_ipc_proxied) || is_set(flags, crm_ipc_client_async)) {
         /* Don't look for a synchronous response */
         clear_bit(flags, crm_ipc_client_response);
     }
@@ -1473,11 +2560,14 @@ crm_ipc_send(crm_ipc_t * client, xmlNode * message, enum crm_ipc_flags flags, in
     crm_trace("Sending %s IPC request %d of %u bytes using %dms timeout",
               client->name, header->qb.id, header->qb.size, ms_timeout);
 
+    started = g_get_monotonic_time();
     if (ms_timeout > 0 || is_not_set(flags, crm_ipc_client_response)) {
 
-        time_t timeout = time(NULL) + 1 + (ms_timeout / 1000);
+        // Without a timeout, still give a busy server a second to catch up
+        gint64 deadline = started + ((ms_timeout > 0)? ms_timeout : 1000) * 1000LL;
+        int backoff_ms = 1;
 
-        do {
+        while (TRUE) {
             /* @TODO Is this check really needed? Won't qb_ipcc_sendv() return
              * an error if it's not connected?
              */
@@ -1486,7 +2576,16 @@ crm_ipc_send(crm_ipc_t * client, xmlNode * message, enum crm_ipc_flags flags, in
             }
 
             qb_rc = qb_ipcc_sendv(client->ipc, iov, 2);
-        } while ((qb_rc == -EAGAIN) && (time(NULL) < timeout));
+            if ((qb_rc != -EAGAIN) || (ms_until(deadline) == 0)) {
+                break;
+            }
+
+            /* The server's request queue is full. There's nothing to poll for
+             * until it drains, so back off instead of spinning.
+             */
+            poll(NULL, 0, QB_MIN(backoff_ms, ms_until(deadline)));
+            backoff_ms = QB_MIN(2 * backoff_ms, PCMK_IPC_SEND_BACKOFF_MAX_MS);
+        }
 
         rc = (int) qb_rc; // Negative of system errno, or bytes sent
         if (qb_rc <= 0) {
@@ -1498,7 +2597,11 @@ crm_ipc_send(crm_ipc_t * client, xmlNode * message, enum crm_ipc_flags flags, in
             goto send_cleanup;
         }
 
-        rc = internal_ipc_get_reply(client, header->qb.id, ms_timeout, &bytes);
+        rc = internal_ipc_get_reply(client, header->qb.id,
+                                    ms_until(started + ms_timeout * 1000LL),
+                                    &bytes);
+        record_latency(client->name, g_get_monotonic_time() - started,
+                       (rc == pcmk_rc_ok) && (bytes > 0));
         if (rc != pcmk_rc_ok) {
             /* We didn't get the reply in time, so disable future sends for now.
              * The only alternative would be to close the connection since we
@@ -1516,7 +2619,24 @@ crm_ipc_send(crm_ipc_t * client, xmlNode * message, enum crm_ipc_flags flags, in
             qb_rc = qb_ipcc_sendv_recv(client->ipc, iov, 2, client->buffer,
                                        client->buf_size, -1);
         } while ((qb_rc == -EAGAIN) && crm_ipc_connected(client));
+
+        // Collect the rest of the reply if it was sent in parts
+        while (qb_rc > 0) {
+            int part_rc = crm_ipc_collect_part(client, &(client->reply_parts));
+
+            if (part_rc == pcmk_rc_ok) {
+                qb_rc = ((struct crm_ipc_response_header *)(void*)client->buffer)->qb.size;
+                break;
+
+            } else if (part_rc != EAGAIN) {
+                qb_rc = -part_rc;
+                break;
+            }
+            qb_rc = qb_ipcc_recv(client->ipc, client->buffer, client->buf_size,
+                                 -1);
+        }
         rc = (int) qb_rc; // Negative system errno, or size of reply received
+        record_latency(client->name, g_get_monotonic_time() - started, rc > 0);
     }
 
     if (rc > 0) {
@@ -1556,6 +2676,156 @@ crm_ipc_send(crm_ipc_t * client, xmlNode * message, enum crm_ipc_flags flags, in
     return rc;
 }
 
+/*!
+ * \internal
+ * \brief Send an IPC request without waiting for its response
+ *
+ * Any number of asynchronous requests may be in flight on a connection at
+ * once. The server sends each response as an event tagged with the request
+ * ID, and pcmk__ipc_dispatch_async_reply() passes it to the request's
+ * callback (the main loop does this for connections added with
+ * mainloop_add_ipc_client()).
+ *
+ * \param[in]  client      Connection to IPC server
+ * \param[in]  message     XML message to send
+ * \param[in]  flags       Bitmask of crm_ipc_flags
+ * \param[in]  ms_timeout  How long to wait for the request to be sent and
+ *                         answered (0 for the default of 5 seconds)
+ * \param[in]  callback    Function to call with the response
+ * \param[in]  user_data   Data to pass to \p callback
+ * \param[out] request_id  If not NULL, where to store ID of request
+ *
+ * \return Standard Pacemaker return code
+ * \note If this returns pcmk_rc_ok, \p callback will be called exactly once,
+ *       either with the response, with ETIMEDOUT if \p ms_timeout passes
+ *       first (checked whenever a request is sent or a response received on
+ *       the connection), or with ENOTCONN if the connection is closed first.
+ *       The response XML is freed after the callback returns.
+ */
+int
+pcmk__ipc_send_async(crm_ipc_t *client, xmlNode *message, uint32_t flags,
+                     int ms_timeout, pcmk__ipc_reply_fn_t callback,
+                     void *user_data, uint32_t *request_id)
+{
+    struct ipc_async_request_s *request = NULL;
+    gint64 sent = g_get_monotonic_time();
+    int rc = 0;
+
+    CRM_CHECK(callback != NULL, return EINVAL);
+
+    if (ms_timeout <= 0) {
+        ms_timeout = 5000;
+    }
+    if (client != NULL) {
+        expire_async_requests(client);
+    }
+
+    rc = crm_ipc_send(client, message,
+                      flags|crm_ipc_client_response|crm_ipc_client_async,
+                      ms_timeout, NULL);
+    if (rc < 0) {
+        return pcmk_legacy2rc(rc);
+    } else if (rc == 0) {
+        return pcmk_rc_error;
+    }
+
+    request = calloc(1, sizeof(struct ipc_async_request_s));
+    if (request == NULL) {
+        return ENOMEM;
+    }
+    request->callback = callback;
+    request->user_data = user_data;
+    request->sent = sent;
+    request->expires = sent + ms_timeout * 1000LL;
+
+    if (client->async_requests == NULL) {
+        client->async_requests = g_hash_table_new_full(g_direct_hash,
+                                                       g_direct_equal, NULL,
+                                                       free);
+        client->next_expiry = request->expires;
+    } else {
+        client->next_expiry = QB_MIN(client->next_expiry, request->expires);
+    }
+    g_hash_table_insert(client->async_requests,
+                        GUINT_TO_POINTER(ipc_request_id), request);
+
+    crm_trace("Sent %s IPC request %u (%u in flight)", client->name,
+              ipc_request_id, g_hash_table_size(client->async_requests));
+    if (request_id != NULL) {
+        *request_id = ipc_request_id;
+    }
+    return pcmk_rc_ok;
+}
+
+/*!
+ * \internal
+ * \brief Pass a response to an asynchronous request to the request's callback
+ *
+ * \param[in] client  IPC connection with message just read by crm_ipc_read()
+ *
+ * \return true if the message was a response to a pending asynchronous
+ *         request (in which case it has been handled), otherwise false
+ */
+bool
+pcmk__ipc_dispatch_async_reply(crm_ipc_t *client)
+{
+    struct crm_ipc_response_header *header = NULL;
+    struct ipc_async_request_s *request = NULL;
+    gpointer id = NULL;
+    xmlNode *reply = NULL;
+
+    CRM_ASSERT(client != NULL);
+
+    header = (struct crm_ipc_response_header *)(void*)client->buffer;
+    if (is_not_set(header->flags, crm_ipc_client_async)) {
+        return false;
+    }
+
+    id = GUINT_TO_POINTER(header->qb.id);
+    if (client->async_requests != NULL) {
+        request = g_hash_table_lookup(client->async_requests, id);
+    }
+    if (request == NULL) {
+        /* The request already expired (and its callback was told so), but the
+         * caller's own dispatch may still be able to use a late reply
+         */
+        crm_debug("Dispatching late %s IPC response %u normally",
+                  client->name, header->qb.id);
+        return false;
+    }
+    g_hash_table_steal(client->async_requests, id);
+
+    record_latency(client->name, g_get_monotonic_time() - request->sent, TRUE);
+    reply = string2xml(crm_ipc_buffer(client));
+    crm_trace("Received %s IPC response %u", client->name, header->qb.id);
+
+    request->callback(client, header->qb.id,
+                      ((reply == NULL)? EBADMSG : pcmk_rc_ok), reply,
+                      request->user_data);
+    free_xml(reply);
+    free(request);
+    expire_async_requests(client);
+    return true;
+}
+
+/*!
+ * \internal
+ * \brief Get the number of asynchronous requests awaiting a response
+ *
+ * \param[in] client  IPC connection
+ *
+ * \return Number of requests sent with pcmk__ipc_send_async() whose callbacks
+ *         have not been called yet
+ */
+guint
+pcmk__ipc_async_pending(crm_ipc_t *client)
+{
+    if ((client == NULL) || (client->async_requests == NULL)) {
+        return 0;
+    }
+    return g_hash_table_size(client->async_requests);
+}
+
 int
 crm_ipc_is_authentic_process(int sock, uid_t refuid, gid_t refgid,
                              pid_t *gotpid, uid_t *gotuid, gid_t *gotgid) {
@@ -110,6 +110,19 @@ crm_trigger_blackbox(int nsig)
     crm_write_blackbox(nsig, NULL);
 }
 
+/*!
+ * \internal
+ * \brief Log main loop statistics and write out a blackbox
+ *
+ * \param[in] nsig  Signal number that was received
+ */
+static void
+crm_dump_diagnostics(int nsig)
+{
+    pcmk__mainloop_stats_log();
+    crm_trigger_blackbox(nsig);
+}
+
 void
 crm_log_deinit(void)
 {
@@ -867,7 +880,7 @@ crm_log_init(const char *entity, uint8_t level, gboolean daemon, gboolean to_std
          */
         mainloop_add_signal(SIGUSR1, crm_enable_blackbox);
         mainloop_add_signal(SIGUSR2, crm_disable_blackbox);
-        mainloop_add_signal(SIGTRAP, crm_trigger_blackbox);
+        mainloop_add_signal(SIGTRAP, crm_dump_diagnostics);
     }
 
     return TRUE;
@@ -21,9 +21,11 @@
 #include <sys/wait.h>
 
 #include <crm/crm.h>
+#include <crm/msg_xml.h>
 #include <crm/common/xml.h>
 #include <crm/common/mainloop.h>
 #include <crm/common/ipcs_internal.h>
+#include <crm/common/ipc_internal.h>
 
 #include <qb/qbarray.h>
 
@@ -47,8 +49,191 @@ struct trigger_s {
     void *user_data;
     guint id;
 
+    char *name;                     // For dispatch statistics
+    struct mainloop_stats_s *stats; // Dispatch statistics (if enabled)
+    gint64 set_us;                  // When trigger was last set (if enabled)
 };
 
+/*
+ * Optional dispatch statistics
+ *
+ * If PCMK_mainloop_stats is enabled for a daemon, every dispatch of a
+ * mainloop source (triggers, signals, file descriptors, IPC server
+ * connections, and timers) is timed, and aggregated by source name. The wait
+ * time is how long the source was ready before being dispatched: since the
+ * trigger was set, or since poll() returned for other sources. A source that
+ * runs for a long time will show up as wait time for the others.
+ */
+
+typedef struct mainloop_stats_s {
+    unsigned long long dispatches;
+    gint64 run_us;          // Time spent in the source's callback
+    gint64 run_max_us;
+    gint64 wait_us;         // Time from source becoming ready to dispatch
+    gint64 wait_max_us;
+} mainloop_stats_t;
+
+static int stats_enabled = -1;          // -1 until first checked
+static GHashTable *source_stats = NULL; // Source name -> mainloop_stats_t
+static gint64 last_poll_us = 0;         // When poll() last returned
+
+static gint
+stats_poll(GPollFD *ufds, guint nfds, gint timeout)
+{
+    gint rc = g_poll(ufds, nfds, timeout);
+
+    last_poll_us = g_get_monotonic_time();
+    return rc;
+}
+
+/*!
+ * \internal
+ * \brief Check whether dispatch statistics are enabled, and start timing
+ *
+ * \return Current time if statistics are enabled, otherwise 0
+ */
+static gint64
+stats_start(void)
+{
+    if (stats_enabled < 0) {
+        stats_enabled = (crm_system_name != NULL)
+                        && pcmk__env_option_enabled(crm_system_name,
+                                                    "mainloop_stats");
+        if (stats_enabled) {
+            crm_info("Collecting main loop dispatch statistics");
+            g_main_context_set_poll_func(NULL, stats_poll);
+        }
+    }
+    return (stats_enabled > 0)? g_get_monotonic_time() : 0;
+}
+
+/*!
+ * \internal
+ * \brief Get the statistics entry for a mainloop source (creating if needed)
+ *
+ * \param[in,out] cached  Where source caches its entry
+ * \param[in]     name    Name of source
+ *
+ * \return Statistics entry for \p name
+ * \note Entries outlive their sources, so that short-lived sources with the
+ *       same name are aggregated.
+ */
+static mainloop_stats_t *
+stats_lookup(mainloop_stats_t **cached, const char *name)
+{
+    if (*cached == NULL) {
+        if (source_stats == NULL) {
+            source_stats = g_hash_table_new_full(crm_str_hash, g_str_equal,
+                                                 free, free);
+        }
+        *cached = g_hash_table_lookup(source_stats, name);
+        if (*cached == NULL) {
+            *cached = calloc(1, sizeof(mainloop_stats_t));
+            CRM_ASSERT(*cached != NULL);
+            g_hash_table_insert(source_stats, strdup(name), *cached);
+        }
+    }
+    return *cached;
+}
+
+/*!
+ * \internal
+ * \brief Record the dispatch of a mainloop source
+ *
+ * \param[in,out] stats     Source's statistics entry (or NULL if disabled)
+ * \param[in]     ready_us  When source became ready (or 0 if unknown)
+ * \param[in]     start_us  When dispatch started (as from stats_start())
+ *
+ * \note The entry must be looked up before dispatch, because the callback
+ *       might free the source.
+ */
+static void
+stats_record(mainloop_stats_t *stats, gint64 ready_us, gint64 start_us)
+{
+    gint64 run_us = 0;
+    gint64 wait_us = 0;
+
+    if (stats == NULL) {
+        return;
+    }
+
+    run_us = g_get_monotonic_time() - start_us;
+    if (ready_us == 0) {
+        ready_us = last_poll_us;
+    }
+    if ((ready_us > 0) && (ready_us < start_us)) {
+        wait_us = start_us - ready_us;
+    }
+
+    stats->dispatches++;
+    stats->run_us += run_us;
+    stats->run_max_us = QB_MAX(stats->run_max_us, run_us);
+    stats->wait_us += wait_us;
+    stats->wait_max_us = QB_MAX(stats->wait_max_us, wait_us);
+}
+
+/*!
+ * \internal
+ * \brief Log all main loop dispatch statistics collected so far
+ */
+void
+pcmk__mainloop_stats_log(void)
+{
+    GHashTableIter iter;
+    const char *name = NULL;
+    mainloop_stats_t *stats = NULL;
+
+    if (source_stats == NULL) {
+        return;
+    }
+    g_hash_table_iter_init(&iter, source_stats);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &name,
+                                  (gpointer *) &stats)) {
+        crm_info("Main loop source %s: %llu dispatches, %lldms running "
+                 "(max %lldms), %lldms waiting (max %lldms)",
+                 name, stats->dispatches, (long long) (stats->run_us / 1000),
+                 (long long) (stats->run_max_us / 1000),
+                 (long long) (stats->wait_us / 1000),
+                 (long long) (stats->wait_max_us / 1000));
+    }
+}
+
+/*!
+ * \internal
+ * \brief Build an XML summary of main loop dispatch statistics
+ *
+ * \param[in,out] parent  XML to add summary to
+ *
+ * \return Newly added XML element
+ */
+xmlNode *
+pcmk__mainloop_stats_xml(xmlNode *parent)
+{
+    xmlNode *xml = create_xml_node(parent, "mainloop");
+    GHashTableIter iter;
+    const char *name = NULL;
+    mainloop_stats_t *stats = NULL;
+
+    crm_xml_add(xml, "enabled", (stats_enabled > 0)? XML_BOOLEAN_TRUE
+                                                   : XML_BOOLEAN_FALSE);
+    if (source_stats == NULL) {
+        return xml;
+    }
+    g_hash_table_iter_init(&iter, source_stats);
+    while (g_hash_table_iter_next(&iter, (gpointer *) &name,
+                                  (gpointer *) &stats)) {
+        xmlNode *child = create_xml_node(xml, "source");
+
+        crm_xml_add(child, XML_ATTR_ID, name);
+        crm_xml_add_ll(child, "dispatches", (long long) stats->dispatches);
+        crm_xml_add_ll(child, "run-us", (long long) stats->run_us);
+        crm_xml_add_ll(child, "run-max-us", (long long) stats->run_max_us);
+        crm_xml_add_ll(child, "wait-us", (long long) stats->wait_us);
+        crm_xml_add_ll(child, "wait-max-us", (long long) stats->wait_max_us);
+    }
+    return xml;
+}
+
 static gboolean
 crm_trigger_prepare(GSource * source, gint * timeout)
 {
@@ -89,6 +274,8 @@ crm_trigger_dispatch(GSource * source, GSourceFunc callback, gpointer userdata)
 {
     int rc = TRUE;
     crm_trigger_t *trig = (crm_trigger_t *) source;
+    gint64 start_us = 0;
+    mainloop_stats_t *stats = NULL;
 
     if (trig->running) {
         /* Wait until the existing job is complete before starting the next one */
@@ -97,12 +284,22 @@ crm_trigger_dispatch(GSource * source, GSourceFunc callback, gpointer userdata)
     trig->trigger = FALSE;
 
     if (callback) {
+        start_us = stats_start();
+        if (start_us != 0) {
+            if (trig->name == NULL) {
+                trig->name = crm_strdup_printf("trigger-%p",
+                                               (void *) callback);
+            }
+            stats = stats_lookup(&(trig->stats), trig->name);
+        }
+
         rc = callback(trig->user_data);
         if (rc < 0) {
             crm_trace("Trigger handler %p not yet complete", trig);
             trig->running = TRUE;
             rc = TRUE;
         }
+        stats_record(stats, trig->set_us, start_us);
     }
     return rc;
 }
@@ -111,6 +308,7 @@ static void
 crm_trigger_finalize(GSource * source)
 {
     crm_trace("Trigger %p destroyed", source);
+    free(((crm_trigger_t *) source)->name);
 }
 
 static GSourceFuncs crm_trigger_funcs = {
@@ -171,10 +369,31 @@ void
 mainloop_set_trigger(crm_trigger_t * source)
 {
     if(source) {
+        // This may be called from a signal handler, so keep it async-safe
+        if ((stats_enabled > 0) && !(source->trigger)) {
+            source->set_us = g_get_monotonic_time();
+        }
         source->trigger = TRUE;
     }
 }
 
+/*!
+ * \internal
+ * \brief Set the name that a trigger's dispatch statistics are recorded under
+ *
+ * \param[in] trigger  Trigger to name
+ * \param[in] name     Name to use (default: address of dispatch function)
+ */
+void
+pcmk__mainloop_trigger_set_name(crm_trigger_t *trigger, const char *name)
+{
+    if (trigger != NULL) {
+        free(trigger->name);
+        trigger->name = crm_strdup_printf("trigger-%s", name);
+        trigger->stats = NULL;
+    }
+}
+
 gboolean
 mainloop_destroy_trigger(crm_trigger_t * source)
 {
@@ -225,6 +444,8 @@ static gboolean
 crm_signal_dispatch(GSource * source, GSourceFunc callback, gpointer userdata)
 {
     crm_signal_t *sig = (crm_signal_t *) source;
+    gint64 start_us = 0;
+    mainloop_stats_t *stats = NULL;
 
     if(sig->signal != SIGCHLD) {
         crm_notice("Caught '%s' signal "CRM_XS" %d (%s handler)",
@@ -234,7 +455,12 @@ crm_signal_dispatch(GSource * source, GSourceFunc callback, gpointer userdata)
 
     sig->trigger.trigger = FALSE;
     if (sig->handler) {
+        start_us = stats_start();
+        if (start_us != 0) {
+            stats = stats_lookup(&(sig->trigger.stats), sig->trigger.name);
+        }
         sig->handler(sig->signal);
+        stats_record(stats, sig->trigger.set_us, start_us);
     }
     return TRUE;
 }
@@ -369,6 +595,7 @@ mainloop_add_signal(int sig, void (*dispatch) (int sig))
 
     crm_signals[sig]->handler = dispatch;
     crm_signals[sig]->signal = sig;
+    crm_signals[sig]->trigger.name = crm_strdup_printf("signal-%d", sig);
 
     if (crm_signal_handler(sig, mainloop_signal_handler) == SIG_ERR) {
         mainloop_destroy_signal_entry(sig);
@@ -408,6 +635,8 @@ mainloop_destroy_signal(int sig)
 
 static qb_array_t *gio_map = NULL;
 
+static void offload_cleanup(void);
+
 void
 mainloop_cleanup(void) 
 {
@@ -415,6 +644,15 @@ mainloop_cleanup(void)
         qb_array_free(gio_map);
     }
 
+    offload_cleanup();
+
+    if (source_stats != NULL) {
+        // Sources may still point to entries, so stop collecting altogether
+        stats_enabled = 0;
+        g_hash_table_destroy(source_stats);
+        source_stats = NULL;
+    }
+
     for (int sig = 0; sig < NSIG; ++sig) {
         mainloop_destroy_signal_entry(sig);
     }
@@ -435,8 +673,13 @@ struct gio_to_qb_poll {
 static gboolean
 gio_read_socket(GIOChannel * gio, GIOCondition condition, gpointer data)
 {
+    static mainloop_stats_t *ipcs_stats = NULL;
+
     struct gio_to_qb_poll *adaptor = (struct gio_to_qb_poll *)data;
     gint fd = g_io_channel_unix_get_fd(gio);
+    gint64 start_us = stats_start();
+    mainloop_stats_t *stats = NULL;
+    gboolean keep = TRUE;
 
     crm_trace("%p.%d %d", data, fd, condition);
 
@@ -444,7 +687,13 @@ gio_read_socket(GIOChannel * gio, GIOCondition condition, gpointer data)
      * when we destroy a fd and when mainloop actually gives it up */
     CRM_ASSERT(adaptor->is_used > 0);
 
-    return (adaptor->fn(fd, condition, adaptor->data) == 0);
+    if (start_us != 0) {
+        // libqb doesn't tell us which server a connection belongs to
+        stats = stats_lookup(&ipcs_stats, "ipc-server");
+    }
+    keep = (adaptor->fn(fd, condition, adaptor->data) == 0);
+    stats_record(stats, 0, start_us);
+    return keep;
 }
 
 static void
@@ -716,6 +965,7 @@ struct mainloop_io_s {
     int (*dispatch_fn_io) (gpointer userdata);
     void (*destroy_fn) (gpointer userdata);
 
+    mainloop_stats_t *stats;
 };
 
 static gboolean
@@ -723,9 +973,15 @@ mainloop_gio_callback(GIOChannel * gio, GIOCondition condition, gpointer data)
 {
     gboolean keep = TRUE;
     mainloop_io_t *client = data;
+    gint64 start_us = stats_start();
+    mainloop_stats_t *stats = NULL;
 
     CRM_ASSERT(client->fd == g_io_channel_unix_get_fd(gio));
 
+    if (start_us != 0) {
+        stats = stats_lookup(&(client->stats), client->name);
+    }
+
     if (condition & G_IO_IN) {
         if (client->ipc) {
             long rc = 0;
@@ -737,6 +993,10 @@ mainloop_gio_callback(GIOChannel * gio, GIOCondition condition, gpointer data)
                     crm_trace("Message acquisition from %s[%p] failed: %s (%ld)",
                               client->name, client, pcmk_strerror(rc), rc);
 
+                } else if (pcmk__ipc_dispatch_async_reply(client->ipc)) {
+                    crm_trace("Response from %s[%p] handled by request callback",
+                              client->name, client);
+
                 } else if (client->dispatch_fn_ipc) {
                     const char *buffer = crm_ipc_buffer(client->ipc);
 
@@ -801,6 +1061,8 @@ mainloop_gio_callback(GIOChannel * gio, GIOCondition condition, gpointer data)
         crm_err("Strange condition: %d", condition);
     }
 
+    stats_record(stats, 0, start_us);
+
     /* keep == FALSE results in mainloop_gio_destroy() being called
      * just before the source is removed from mainloop
      */
@@ -1231,6 +1493,7 @@ struct mainloop_timer_s {
         char *name;
         GSourceFunc cb;
         void *userdata;
+        struct mainloop_stats_s *stats;
 };
 
 static gboolean
@@ -1248,12 +1511,20 @@ mainloop_timer_cb(gpointer user_data)
                 */
 
     if(t->cb) {
+        gint64 start_us = stats_start();
+        mainloop_stats_t *stats = NULL;
+
+        if (start_us != 0) {
+            stats = stats_lookup(&(t->stats), t->name);
+        }
+
         crm_trace("Invoking callbacks for timer %s", t->name);
         repeat = t->repeat;
         if(t->cb(t->userdata) == FALSE) {
             crm_trace("Timer %s complete", t->name);
             repeat = FALSE;
         }
+        stats_record(stats, 0, start_us);
     }
 
     if(repeat) {
@@ -1341,6 +1612,198 @@ mainloop_timer_del(mainloop_timer_t *t)
     }
 }
 
+/*
+ * Offloading work to worker threads
+ *
+ * Daemons are single-threaded around their main loop, so CPU-heavy work such
+ * as digest calculation or decompression delays everything else. Such work
+ * can be handed to a pool of worker threads, with the result delivered back
+ * to the main loop.
+ */
+
+// Default maximum number of worker threads
+#define OFFLOAD_THREADS_DEFAULT 4
+
+typedef struct offload_job_s {
+    char *name;
+    void (*work)(gpointer data);
+    void (*done)(gpointer data);
+    gpointer data;
+} offload_job_t;
+
+static int offload_threads = -1;            // -1 until first checked
+static GThreadPool *offload_pool = NULL;
+static GAsyncQueue *offload_results = NULL; // Finished jobs awaiting done()
+static crm_trigger_t *offload_trigger = NULL;
+
+static void
+free_offload_job(offload_job_t *job)
+{
+    free(job->name);
+    free(job);
+}
+
+// Runs in a worker thread
+static void
+offload_worker(gpointer data, gpointer user_data)
+{
+    offload_job_t *job = data;
+
+    job->work(job->data);
+    g_async_queue_push(offload_results, job);
+
+    // Make sure the main loop notices, even if it is blocked in poll()
+    mainloop_set_trigger(offload_trigger);
+    g_main_context_wakeup(NULL);
+}
+
+// Runs in the main loop
+static int
+offload_dispatch(gpointer user_data)
+{
+    offload_job_t *job = NULL;
+
+    while ((job = g_async_queue_try_pop(offload_results)) != NULL) {
+        crm_trace("Offloaded job %s complete", job->name);
+        job->done(job->data);
+        free_offload_job(job);
+    }
+    return TRUE;
+}
+
+/*!
+ * \internal
+ * \brief Create the worker thread pool if not already done
+ *
+ * \return true if jobs can be offloaded, otherwise false
+ */
+static bool
+offload_init(void)
+{
+    GError *error = NULL;
+    const char *value = NULL;
+
+    if (offload_threads >= 0) {
+        return (offload_pool != NULL);
+    }
+
+    value = pcmk__env_option("worker_threads");
+    if (value != NULL) {
+        offload_threads = crm_parse_int(value, "0");
+    } else {
+        offload_threads = QB_MIN(pcmk__procfs_num_cores(),
+                                 OFFLOAD_THREADS_DEFAULT);
+    }
+    if (offload_threads <= 0) {
+        offload_threads = 0;
+        crm_info("Worker threads disabled, so offloaded work will be done "
+                 "in the main loop");
+        return false;
+    }
+
+#if !GLIB_CHECK_VERSION(2, 32, 0)
+    if (!g_thread_supported()) {
+        g_thread_init(NULL);
+    }
+#endif
+
+    offload_pool = g_thread_pool_new(offload_worker, NULL, offload_threads,
+                                     FALSE, &error);
+    if (offload_pool == NULL) {
+        crm_warn("Offloaded work will be done in the main loop: "
+                 "Could not create worker threads (%s)",
+                 ((error == NULL)? "unknown error" : error->message));
+        if (error != NULL) {
+            g_error_free(error);
+        }
+        return false;
+    }
+
+    offload_results = g_async_queue_new();
+    offload_trigger = mainloop_add_trigger(G_PRIORITY_DEFAULT,
+                                           offload_dispatch, NULL);
+    pcmk__mainloop_trigger_set_name(offload_trigger, "offload");
+    crm_debug("Using up to %d worker thread%s for offloaded work",
+              offload_threads, pcmk__plural_s(offload_threads));
+    return true;
+}
+
+/*!
+ * \internal
+ * \brief Run a job in a worker thread, then call a function in the main loop
+ *
+ * \param[in] name  Description of job (for logging)
+ * \param[in] work  Function to call in a worker thread
+ * \param[in] done  Function to call in the main loop once \p work returns
+ * \param[in] data  Data to pass to \p work and \p done
+ *
+ * \note \p data belongs to the job from the time this is called until \p done
+ *       is called, and the main loop must not access it in between. Jobs may
+ *       run concurrently with each other and finish in any order.
+ * \note \p work must not access anything else that the main loop might (such
+ *       as daemon globals or the peer caches), and should not log.
+ * \note Any XML in \p data must be a separate document (for example, from
+ *       copy_xml()) that nothing else refers to. \p work may read it but must
+ *       not create, modify, or free any XML, because libxml2 keeps the hooks
+ *       that Pacemaker uses to track XML changes per thread. Free the XML in
+ *       \p done or later.
+ * \note If worker threads are unavailable (or PCMK_worker_threads is 0), both
+ *       functions are called before this returns, so callers must be prepared
+ *       for \p done to run immediately.
+ */
+void
+pcmk__offload(const char *name, void (*work)(gpointer data),
+              void (*done)(gpointer data), gpointer data)
+{
+    offload_job_t *job = NULL;
+
+    CRM_CHECK((work != NULL) && (done != NULL), return);
+
+    if (!offload_init()) {
+        work(data);
+        done(data);
+        return;
+    }
+
+    job = calloc(1, sizeof(offload_job_t));
+    CRM_ASSERT(job != NULL);
+    job->name = strdup(name);
+    job->work = work;
+    job->done = done;
+    job->data = data;
+
+    crm_trace("Offloading job %s", job->name);
+    g_thread_pool_push(offload_pool, job, NULL);
+}
+
+/*!
+ * \internal
+ * \brief Wait for running offloaded jobs, and discard any others
+ *
+ * \note The done function is not called for any job, so their data is not
+ *       freed. This is intended to be called only when exiting.
+ */
+static void
+offload_cleanup(void)
+{
+    offload_job_t *job = NULL;
+
+    if (offload_pool != NULL) {
+        g_thread_pool_free(offload_pool, TRUE, TRUE);
+        offload_pool = NULL;
+
+        while ((job = g_async_queue_try_pop(offload_results)) != NULL) {
+            free_offload_job(job);
+        }
+        g_async_queue_unref(offload_results);
+        offload_results = NULL;
+
+        mainloop_destroy_trigger(offload_trigger);
+        offload_trigger = NULL;
+    }
+    offload_threads = -1;
+}
+
 /*
  * Helpers to make sure certain events aren't lost at shutdown
  */
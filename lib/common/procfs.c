@@ -20,6 +20,7 @@
 #include <sys/types.h>
 #include <dirent.h>
 #include <ctype.h>
+#include <limits.h>
 
 /*!
  * \internal
@@ -163,3 +164,135 @@ pcmk__procfs_num_cores(void)
     }
     return cores? cores : 1;
 }
+
+/*!
+ * \internal
+ * \brief Get the recent stall percentage from a pressure stall information file
+ *
+ * \param[in]  path   Pressure stall information file (such as
+ *                    /proc/pressure/cpu, or cpu.pressure in a cgroup)
+ * \param[out] avg10  Where to store percentage of the last 10 seconds during
+ *                    which at least one task was stalled on the resource
+ *
+ * \return Standard Pacemaker return code
+ * \note This should be called only on Linux systems (4.20 or later).
+ */
+int
+pcmk__procfs_pressure(const char *path, float *avg10)
+{
+    int rc = pcmk_rc_unknown_format;
+    FILE *stream = NULL;
+    char buffer[256];
+
+    CRM_CHECK((path != NULL) && (avg10 != NULL), return EINVAL);
+
+    stream = fopen(path, "r");
+    if (stream == NULL) {
+        return errno;
+    }
+
+    /* The file has a "some" line, and (except for system-wide CPU pressure on
+     * older kernels) a "full" line, each like:
+     *
+     *     some avg10=0.00 avg60=0.00 avg300=0.00 total=0
+     */
+    while (fgets(buffer, sizeof(buffer), stream)) {
+        if (pcmk__starts_with(buffer, "some ")) {
+            char *avg = strstr(buffer, "avg10=");
+
+            if (avg != NULL) {
+                *avg10 = strtof(avg + 6, NULL);
+                rc = pcmk_rc_ok;
+            }
+            break;
+        }
+    }
+    fclose(stream);
+    return rc;
+}
+
+/*!
+ * \internal
+ * \brief Get the path of the calling process's cgroup v2 directory
+ *
+ * \return Newly allocated path on success, NULL otherwise (caller must free)
+ */
+static char *
+procfs_cgroup_dir(void)
+{
+    char *dir = NULL;
+    char buffer[PATH_MAX + 8];
+    FILE *stream = fopen("/proc/self/cgroup", "r");
+
+    if (stream == NULL) {
+        return NULL;
+    }
+
+    // The cgroup v2 (unified) hierarchy is the line with ID 0 and no controllers
+    while (fgets(buffer, sizeof(buffer), stream)) {
+        if (pcmk__starts_with(buffer, "0::")) {
+            buffer[strcspn(buffer, "\n")] = '\0';
+            dir = crm_strdup_printf("/sys/fs/cgroup%s", buffer + 3);
+            break;
+        }
+    }
+    fclose(stream);
+    return dir;
+}
+
+/*!
+ * \internal
+ * \brief Get CPU statistics for the calling process's cgroup v2
+ *
+ * \param[out] usage_us      Where to store microseconds of CPU time used by
+ *                           all processes in the cgroup
+ * \param[out] throttled_us  Where to store microseconds that the cgroup's
+ *                           processes were held back by its CPU limit
+ *
+ * \return Standard Pacemaker return code
+ * \note Because Pacemaker's daemons normally all run in the same (service)
+ *       cgroup, this covers the whole of Pacemaker, not just the caller.
+ *       \p throttled_us is available only if the cgroup's CPU controller is
+ *       enabled; ENOENT is returned otherwise.
+ */
+int
+pcmk__procfs_cgroup_cpu_stat(unsigned long long *usage_us,
+                             unsigned long long *throttled_us)
+{
+    int rc = pcmk_rc_ok;
+    bool have_usage = false;
+    bool have_throttled = false;
+    char *dir = procfs_cgroup_dir();
+    char *path = NULL;
+    FILE *stream = NULL;
+    char buffer[256];
+
+    CRM_CHECK((usage_us != NULL) && (throttled_us != NULL), return EINVAL);
+
+    if (dir == NULL) {
+        return ENOENT;
+    }
+    path = crm_strdup_printf("%s/cpu.stat", dir);
+    free(dir);
+
+    stream = fopen(path, "r");
+    if (stream == NULL) {
+        rc = errno;
+        free(path);
+        return rc;
+    }
+    free(path);
+
+    while (fgets(buffer, sizeof(buffer), stream)) {
+        if (pcmk__starts_with(buffer, "usage_usec ")) {
+            *usage_us = strtoull(buffer + 11, NULL, 10);
+            have_usage = true;
+
+        } else if (pcmk__starts_with(buffer, "throttled_usec ")) {
+            *throttled_us = strtoull(buffer + 15, NULL, 10);
+            have_throttled = true;
+        }
+    }
+    fclose(stream);
+    return (have_usage && have_throttled)? pcmk_rc_ok : ENOENT;
+}
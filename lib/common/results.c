@@ -19,6 +19,7 @@
 #include <string.h>
 #include <qb/qbdefs.h>
 
+#include <crm/common/ipc_internal.h>
 #include <crm/common/mainloop.h>
 #include <crm/common/xml.h>
 
@@ -745,6 +746,7 @@ crm_exit(crm_exit_t rc)
         rc = CRM_EX_ERROR;
     }
 
+    pcmk__ipc_latency_cleanup(LOG_DEBUG);
     mainloop_cleanup();
     crm_xml_cleanup();
 
@@ -735,6 +735,49 @@ validate_xml(xmlNode *xml_blob, const char *validation, gboolean to_logs)
     return FALSE;
 }
 
+/*!
+ * \internal
+ * \brief Validate a CIB without walking its status section
+ *
+ * Every CIB schema declares the status section as optional and places no
+ * restrictions on its contents, so validating a CIB with the status section
+ * detached gives the same result as validating the whole thing, at a fraction
+ * of the cost on large clusters.
+ *
+ * \param[in,out] cib      CIB to validate (status is reattached afterward)
+ * \param[in]     to_logs  Whether to log validation errors
+ *
+ * \return TRUE if \p cib is valid according to its schema, otherwise FALSE
+ */
+gboolean
+pcmk__validate_cib_without_status(xmlNode *cib, gboolean to_logs)
+{
+    gboolean valid = FALSE;
+    xmlNode *status = NULL;
+    xmlNode *next = NULL;
+
+    CRM_CHECK(cib != NULL, return FALSE);
+
+    if (safe_str_eq(crm_element_name(cib), XML_TAG_CIB)) {
+        status = first_named_child(cib, XML_CIB_TAG_STATUS);
+    }
+    if (status == NULL) {
+        return validate_xml(cib, NULL, to_logs);
+    }
+
+    next = status->next;
+    xmlUnlinkNode(status);
+
+    valid = validate_xml(cib, NULL, to_logs);
+
+    if (next) {
+        xmlAddPrevSibling(next, status);
+    } else {
+        xmlAddChild(cib, status);
+    }
+    return valid;
+}
+
 #if HAVE_LIBXSLT
 
 static void
@@ -0,0 +1,282 @@
+#include <glib.h>
+
+#include <crm_internal.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+
+/* alice may read everything but cluster options, and bob only meta-attributes.
+ * No whitespace between elements, so results can be compared as strings.
+ */
+#define TEST_CIB                                                            \
+    "<cib epoch='1' num_updates='0' admin_epoch='0'>"                       \
+    "<configuration>"                                                       \
+    "<crm_config><cluster_property_set id='opts'>"                          \
+    "<nvpair id='opts-secret' name='secret' value='hidden'/>"               \
+    "</cluster_property_set></crm_config>"                                  \
+    "<nodes/>"                                                              \
+    "<resources>"                                                           \
+    "<primitive id='dummy' class='ocf' provider='pacemaker' type='Dummy'>"  \
+    "<meta_attributes id='dummy-meta'>"                                     \
+    "<nvpair id='dummy-role' name='target-role' value='Started'/>"          \
+    "</meta_attributes></primitive>"                                        \
+    "</resources>"                                                          \
+    "<constraints/>"                                                        \
+    "<acls>"                                                                \
+    "<acl_target id='alice'><role id='viewer'/></acl_target>"               \
+    "<acl_target id='bob'><role id='meta-only'/></acl_target>"              \
+    "<acl_role id='viewer'>"                                                \
+    "<acl_permission id='viewer-read' kind='read' xpath='/cib'/>"           \
+    "<acl_permission id='viewer-deny' kind='deny' xpath='//crm_config'/>"   \
+    "</acl_role>"                                                           \
+    "<acl_role id='meta-only'>"                                             \
+    "<acl_permission id='meta-read' kind='read' xpath='//meta_attributes'/>" \
+    "</acl_role>"                                                           \
+    "</acls>"                                                               \
+    "</configuration>"                                                      \
+    "<status/>"                                                             \
+    "</cib>"
+
+/* What bob should see (given the target-role value): unreadable ancestors of
+ * readable elements are kept with only their IDs
+ */
+#define BOB_VIEW                                                            \
+    "<cib><configuration><resources><primitive id='dummy'>"                 \
+    "<meta_attributes id='dummy-meta'>"                                     \
+    "<nvpair id='dummy-role' name='target-role' value='%s'/>"               \
+    "</meta_attributes></primitive></resources></configuration></cib>"
+
+static xmlNode *
+find_by_id(xmlNode *cib, const char *id)
+{
+    char *xpath = crm_strdup_printf("//*[@id='%s']", id);
+    xmlNode *match = get_xpath_object(xpath, cib, LOG_NEVER);
+
+    g_assert(match != NULL);
+    free(xpath);
+    return match;
+}
+
+// Record a configuration change, as the CIB manager would
+static void
+bump_epoch(xmlNode *cib)
+{
+    int epoch = 0;
+
+    crm_element_value_int(cib, XML_ATTR_GENERATION, &epoch);
+    crm_xml_add_int(cib, XML_ATTR_GENERATION, epoch + 1);
+}
+
+// Return the unformatted text of what a user may read of a CIB (or NULL)
+static char *
+filtered(const char *user, xmlNode *cib)
+{
+    xmlNode *result = NULL;
+    char *text = NULL;
+
+    g_assert(xml_acl_filtered_copy(user, cib, cib, &result));
+    if (result != NULL) {
+        text = dump_xml_unformatted(result);
+        free_xml(result);
+    }
+    return text;
+}
+
+// Return the unformatted text of what bob should see
+static char *
+bob_view(const char *role)
+{
+    char *xml_string = crm_strdup_printf(BOB_VIEW, role);
+    xmlNode *xml = string2xml(xml_string);
+    char *text = NULL;
+
+    g_assert(xml != NULL);
+    text = dump_xml_unformatted(xml);
+    free_xml(xml);
+    free(xml_string);
+    return text;
+}
+
+// Return the unformatted text of a CIB without up to two configuration sections
+static char *
+cib_without(xmlNode *cib, const char *section1, const char *section2)
+{
+    xmlNode *copy = copy_xml(cib);
+    xmlNode *config = first_named_child(copy, XML_CIB_TAG_CONFIGURATION);
+    char *text = NULL;
+
+    free_xml(first_named_child(config, section1));
+    if (section2 != NULL) {
+        free_xml(first_named_child(config, section2));
+    }
+    text = dump_xml_unformatted(copy);
+    free_xml(copy);
+    return text;
+}
+
+// Return what alice should see: everything except cluster options
+static char *
+alice_view(xmlNode *cib)
+{
+    return cib_without(cib, XML_CIB_TAG_CRMCONFIG, NULL);
+}
+
+static void
+assert_view(const char *user, xmlNode *cib, const char *expected)
+{
+    char *actual = filtered(user, cib);
+
+    g_assert_cmpstr(actual, ==, expected);
+    free(actual);
+}
+
+static void
+unrestricted_users(void)
+{
+    xmlNode *cib = string2xml(TEST_CIB);
+    xmlNode *result = NULL;
+
+    g_assert(!xml_acl_filtered_copy("root", cib, cib, &result));
+    g_assert(result == NULL);
+    g_assert(!xml_acl_filtered_copy(CRM_DAEMON_USER, cib, cib, &result));
+    g_assert(result == NULL);
+    g_assert(!xml_acl_filtered_copy(NULL, cib, cib, &result));
+    g_assert(result == NULL);
+
+    free_xml(cib);
+}
+
+static void
+filtered_read(void)
+{
+    xmlNode *cib = string2xml(TEST_CIB);
+    char *alice = alice_view(cib);
+    char *bob = bob_view("Started");
+
+    assert_view("alice", cib, alice);
+    assert_view("bob", cib, bob);
+
+    // Users not in the ACLs section may read nothing
+    assert_view("mallory", cib, NULL);
+
+    free(alice);
+    free(bob);
+    free_xml(cib);
+}
+
+static void
+cache_hits(void)
+{
+    xmlNode *cib = string2xml(TEST_CIB);
+    char *alice = alice_view(cib);
+    char *bob = bob_view("Started");
+    char *bob_stopped = bob_view("Stopped");
+    xmlNode *other = NULL;
+
+    // Cached entries must stay separate per user
+    for (int lpc = 0; lpc < 3; lpc++) {
+        assert_view("alice", cib, alice);
+        assert_view("bob", cib, bob);
+        assert_view("mallory", cib, NULL);
+    }
+
+    /* Changes outside the ACLs section keep the cached ACLs, but the output
+     * must still reflect the current CIB
+     */
+    crm_xml_add(find_by_id(cib, "dummy-role"), XML_NVPAIR_ATTR_VALUE,
+                "Stopped");
+    free(alice);
+    alice = alice_view(cib);
+    assert_view("alice", cib, alice);
+    assert_view("bob", cib, bob_stopped);
+
+    // A different document with the same ACLs gets the same results
+    other = string2xml(TEST_CIB);
+    assert_view("bob", other, bob);
+    free_xml(other);
+
+    free(alice);
+    free(bob);
+    free(bob_stopped);
+    free_xml(cib);
+}
+
+static void
+invalidated_by_permission_change(void)
+{
+    xmlNode *cib = string2xml(TEST_CIB);
+    char *alice = alice_view(cib);
+    char *bob = bob_view("Started");
+    char *expected = NULL;
+    xmlNode *deny = NULL;
+
+    assert_view("alice", cib, alice);
+    assert_view("bob", cib, bob);
+
+    // Widen bob's role
+    crm_xml_add(find_by_id(cib, "meta-read"), XML_ACL_ATTR_XPATH, "/cib");
+    bump_epoch(cib);
+    expected = dump_xml_unformatted(cib);
+    assert_view("bob", cib, expected);
+    free(expected);
+
+    // Deny alice the resources section directly in her entry
+    deny = create_xml_node(find_by_id(cib, "alice"), XML_ACL_TAG_PERMISSION);
+    crm_xml_add(deny, XML_ATTR_ID, "alice-deny");
+    crm_xml_add(deny, XML_ACL_ATTR_KIND, XML_ACL_TAG_DENY);
+    crm_xml_add(deny, XML_ACL_ATTR_XPATH, "//" XML_CIB_TAG_RESOURCES);
+    bump_epoch(cib);
+    expected = cib_without(cib, XML_CIB_TAG_CRMCONFIG, XML_CIB_TAG_RESOURCES);
+    assert_view("alice", cib, expected);
+    free(expected);
+
+    free(alice);
+    free(bob);
+    free_xml(cib);
+}
+
+static void
+invalidated_by_role_change(void)
+{
+    xmlNode *cib = string2xml(TEST_CIB);
+    char *alice = NULL;
+    char *bob = bob_view("Started");
+
+    assert_view("bob", cib, bob);
+
+    // Give bob alice's role instead of his own
+    crm_xml_add(first_named_child(find_by_id(cib, "bob"),
+                                  XML_ACL_TAG_ROLE_REF),
+                XML_ATTR_ID, "viewer");
+    bump_epoch(cib);
+    alice = alice_view(cib);
+    assert_view("bob", cib, alice);
+    assert_view("alice", cib, alice);
+
+    // Removing a user's entry takes away all access
+    free_xml(find_by_id(cib, "alice"));
+    bump_epoch(cib);
+    free(alice);
+    alice = alice_view(cib);
+    assert_view("alice", cib, NULL);
+    assert_view("bob", cib, alice);
+
+    free(alice);
+    free(bob);
+    free_xml(cib);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/common/acl/filtered_copy/unrestricted_users",
+                    unrestricted_users);
+    g_test_add_func("/common/acl/filtered_copy/filtered_read", filtered_read);
+    g_test_add_func("/common/acl/filtered_copy/cache_hits", cache_hits);
+    g_test_add_func("/common/acl/filtered_copy/permission_change",
+                    invalidated_by_permission_change);
+    g_test_add_func("/common/acl/filtered_copy/role_change",
+                    invalidated_by_role_change);
+
+    return g_test_run();
+}
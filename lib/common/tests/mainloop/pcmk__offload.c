@@ -0,0 +1,149 @@
+#include <glib.h>
+#include <stdlib.h>
+
+#include <crm_internal.h>
+#include <crm/common/mainloop.h>
+
+#define NUM_JOBS 8
+
+typedef struct test_job_s {
+    int input;
+    int output;
+    GThread *work_thread;   // Thread that work function ran in
+    GThread *done_thread;   // Thread that done function ran in
+    bool done;
+} test_job_t;
+
+static GMainLoop *loop = NULL;
+static int jobs_done = 0;
+static GThread *main_thread = NULL;
+static gint slow_work_started = 0;
+
+static void
+work(gpointer data)
+{
+    test_job_t *job = data;
+
+    job->work_thread = g_thread_self();
+    job->output = job->input * 2;
+}
+
+static void
+slow_work(gpointer data)
+{
+    g_atomic_int_set(&slow_work_started, 1);
+    g_usleep(G_USEC_PER_SEC / 10);
+    work(data);
+}
+
+static void
+done(gpointer data)
+{
+    test_job_t *job = data;
+
+    job->done_thread = g_thread_self();
+    job->done = true;
+    if ((++jobs_done == NUM_JOBS) && (loop != NULL)) {
+        g_main_loop_quit(loop);
+    }
+}
+
+static gboolean
+timed_out(gpointer data)
+{
+    g_assert_not_reached();
+    return FALSE;
+}
+
+static void
+use_threads(const char *threads)
+{
+    // Pick up the new setting the next time a job is offloaded
+    mainloop_cleanup();
+    setenv("PCMK_worker_threads", threads, 1);
+    jobs_done = 0;
+}
+
+static void
+completion(void)
+{
+    test_job_t jobs[NUM_JOBS] = { { 0, }, };
+    guint timer = 0;
+
+    use_threads("2");
+    for (int lpc = 0; lpc < NUM_JOBS; lpc++) {
+        jobs[lpc].input = lpc;
+        pcmk__offload("test", work, done, &jobs[lpc]);
+    }
+
+    loop = g_main_loop_new(NULL, FALSE);
+    timer = g_timeout_add_seconds(10, timed_out, NULL);
+    g_main_loop_run(loop);
+    g_source_remove(timer);
+    g_main_loop_unref(loop);
+    loop = NULL;
+
+    // Every job finished, with work in a worker and done in the main loop
+    for (int lpc = 0; lpc < NUM_JOBS; lpc++) {
+        g_assert(jobs[lpc].done);
+        g_assert_cmpint(jobs[lpc].output, ==, lpc * 2);
+        g_assert(jobs[lpc].work_thread != NULL);
+        g_assert(jobs[lpc].work_thread != main_thread);
+        g_assert(jobs[lpc].done_thread == main_thread);
+    }
+}
+
+static void
+without_threads(void)
+{
+    test_job_t job = { 21, };
+
+    use_threads("0");
+    pcmk__offload("test", work, done, &job);
+
+    // Both functions must have been called before returning
+    g_assert(job.done);
+    g_assert_cmpint(job.output, ==, 42);
+    g_assert(job.work_thread == main_thread);
+    g_assert(job.done_thread == main_thread);
+}
+
+static void
+cleanup(void)
+{
+    test_job_t job = { 1, };
+
+    use_threads("1");
+    pcmk__offload("test", slow_work, done, &job);
+    while (!g_atomic_int_get(&slow_work_started)) {
+        g_usleep(1000);
+    }
+
+    // Cleanup waits for the running job, but does not call its done function
+    mainloop_cleanup();
+    g_assert_cmpint(job.output, ==, 2);
+    g_assert(job.work_thread != main_thread);
+    g_assert(!job.done);
+
+    // Main loop iterations after cleanup must not deliver the result
+    while (g_main_context_iteration(NULL, FALSE));
+    g_assert(!job.done);
+}
+
+int main(int argc, char **argv)
+{
+    int rc = 0;
+
+    g_test_init(&argc, &argv, NULL);
+    main_thread = g_thread_self();
+
+    g_test_add_func("/common/mainloop/offload/completion", completion);
+    g_test_add_func("/common/mainloop/offload/without_threads",
+                    without_threads);
+    g_test_add_func("/common/mainloop/offload/cleanup", cleanup);
+
+    rc = g_test_run();
+
+    mainloop_cleanup();
+    return rc;
+}
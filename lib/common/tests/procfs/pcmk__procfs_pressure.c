@@ -0,0 +1,70 @@
+#include <glib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <crm_internal.h>
+
+static char *
+write_file(const char *contents)
+{
+    char *path = strdup("/tmp/pcmk__procfs_pressure.XXXXXX");
+    int fd = mkstemp(path);
+
+    g_assert(fd >= 0);
+    g_assert_cmpint(write(fd, contents, strlen(contents)), ==, strlen(contents));
+    close(fd);
+    return path;
+}
+
+static void
+some_and_full(void) {
+    float avg10 = 0.0;
+    char *path = write_file("some avg10=12.50 avg60=3.20 avg300=0.80 total=1234\n"
+                            "full avg10=1.00 avg60=0.50 avg300=0.10 total=99\n");
+
+    g_assert_cmpint(pcmk__procfs_pressure(path, &avg10), ==, pcmk_rc_ok);
+    g_assert_cmpfloat(avg10, ==, 12.5);
+    unlink(path);
+    free(path);
+}
+
+static void
+some_only(void) {
+    float avg10 = 0.0;
+    char *path = write_file("some avg10=0.00 avg60=0.00 avg300=0.00 total=0\n");
+
+    g_assert_cmpint(pcmk__procfs_pressure(path, &avg10), ==, pcmk_rc_ok);
+    g_assert_cmpfloat(avg10, ==, 0.0);
+    unlink(path);
+    free(path);
+}
+
+static void
+bad_format(void) {
+    float avg10 = 0.0;
+    char *path = write_file("full avg10=1.00 avg60=0.50 avg300=0.10 total=99\n");
+
+    g_assert_cmpint(pcmk__procfs_pressure(path, &avg10), ==,
+                    pcmk_rc_unknown_format);
+    unlink(path);
+    free(path);
+}
+
+static void
+no_file(void) {
+    float avg10 = 0.0;
+
+    g_assert_cmpint(pcmk__procfs_pressure("/nonexistent/pressure", &avg10), ==,
+                    ENOENT);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/common/procfs/pressure/some_and_full", some_and_full);
+    g_test_add_func("/common/procfs/pressure/some_only", some_only);
+    g_test_add_func("/common/procfs/pressure/bad_format", bad_format);
+    g_test_add_func("/common/procfs/pressure/no_file", no_file);
+
+    return g_test_run();
+}
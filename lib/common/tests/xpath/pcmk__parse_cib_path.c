@@ -0,0 +1,142 @@
+#include <glib.h>
+
+#include <crm_internal.h>
+#include <crm/common/xml_internal.h>
+
+#define STATE "/cib/status/node_state[@id='1']"
+#define HISTORY STATE "/lrm[@id='1']/lrm_resources"
+
+static void
+not_cib_path(void) {
+    pcmk__cib_path_t path;
+
+    g_assert_cmpint(pcmk__parse_cib_path(NULL, &path), ==, EINVAL);
+    g_assert_cmpint(path.type, ==, pcmk__cib_path_other);
+    pcmk__free_cib_path(&path);
+
+    g_assert_cmpint(pcmk__parse_cib_path("cib/status", &path), ==, EINVAL);
+    pcmk__free_cib_path(&path);
+
+    g_assert_cmpint(pcmk__parse_cib_path("/configuration", &path), ==, EINVAL);
+    g_assert_cmpint(path.type, ==, pcmk__cib_path_other);
+    pcmk__free_cib_path(&path);
+}
+
+static void
+sections(void) {
+    pcmk__cib_path_t path;
+
+    g_assert_cmpint(pcmk__parse_cib_path("/cib", &path), ==, pcmk_rc_ok);
+    g_assert_cmpint(path.type, ==, pcmk__cib_path_cib);
+    pcmk__free_cib_path(&path);
+
+    g_assert_cmpint(pcmk__parse_cib_path("/cib/configuration/resources/"
+                                         "primitive[@id='rsc1']", &path),
+                    ==, pcmk_rc_ok);
+    g_assert_cmpint(path.type, ==, pcmk__cib_path_configuration);
+    g_assert(path.rsc == NULL);
+    pcmk__free_cib_path(&path);
+
+    g_assert_cmpint(pcmk__parse_cib_path("/cib/status/tickets/"
+                                         "ticket_state[@id='t1']", &path),
+                    ==, pcmk_rc_ok);
+    g_assert_cmpint(path.type, ==, pcmk__cib_path_tickets);
+    pcmk__free_cib_path(&path);
+
+    g_assert_cmpint(pcmk__parse_cib_path("/cib/status", &path), ==, pcmk_rc_ok);
+    g_assert_cmpint(path.type, ==, pcmk__cib_path_status);
+    pcmk__free_cib_path(&path);
+}
+
+static void
+node_state(void) {
+    pcmk__cib_path_t path;
+
+    g_assert_cmpint(pcmk__parse_cib_path(STATE, &path), ==, pcmk_rc_ok);
+    g_assert_cmpint(path.type, ==, pcmk__cib_path_node_state);
+    g_assert_cmpstr(path.node, ==, "1");
+    pcmk__free_cib_path(&path);
+
+    g_assert_cmpint(pcmk__parse_cib_path(STATE "/transient_attributes[@id='1']"
+                                         "/instance_attributes[@id='status-1']",
+                                         &path), ==, pcmk_rc_ok);
+    g_assert_cmpint(path.type, ==, pcmk__cib_path_transient);
+    g_assert_cmpstr(path.node, ==, "1");
+    pcmk__free_cib_path(&path);
+
+    // Unknown children leave the deepest known element
+    g_assert_cmpint(pcmk__parse_cib_path(STATE "/unknown/lrm[@id='1']", &path),
+                    ==, pcmk_rc_ok);
+    g_assert_cmpint(path.type, ==, pcmk__cib_path_node_state);
+    pcmk__free_cib_path(&path);
+}
+
+static void
+history(void) {
+    pcmk__cib_path_t path;
+
+    g_assert_cmpint(pcmk__parse_cib_path(HISTORY, &path), ==, pcmk_rc_ok);
+    g_assert_cmpint(path.type, ==, pcmk__cib_path_lrm_resources);
+    g_assert_cmpstr(path.node, ==, "1");
+    g_assert(path.rsc == NULL);
+    pcmk__free_cib_path(&path);
+
+    g_assert_cmpint(pcmk__parse_cib_path(HISTORY "/lrm_resource[@id='rsc1']",
+                                         &path), ==, pcmk_rc_ok);
+    g_assert_cmpint(path.type, ==, pcmk__cib_path_lrm_resource);
+    g_assert_cmpstr(path.rsc, ==, "rsc1");
+    g_assert(path.op == NULL);
+    pcmk__free_cib_path(&path);
+
+    g_assert_cmpint(pcmk__parse_cib_path(HISTORY "/lrm_resource[@id='rsc1']"
+                                         "/lrm_rsc_op[@id='rsc1_monitor_10000']",
+                                         &path), ==, pcmk_rc_ok);
+    g_assert_cmpint(path.type, ==, pcmk__cib_path_lrm_rsc_op);
+    g_assert_cmpstr(path.node, ==, "1");
+    g_assert_cmpstr(path.rsc, ==, "rsc1");
+    g_assert_cmpstr(path.op, ==, "rsc1_monitor_10000");
+    pcmk__free_cib_path(&path);
+
+    // The lrm ID is used if there is no node_state ID
+    g_assert_cmpint(pcmk__parse_cib_path("/cib/status/node_state/lrm[@id='2']",
+                                         &path), ==, pcmk_rc_ok);
+    g_assert_cmpint(path.type, ==, pcmk__cib_path_lrm);
+    g_assert_cmpstr(path.node, ==, "2");
+    pcmk__free_cib_path(&path);
+}
+
+static void
+malformed(void) {
+    pcmk__cib_path_t path;
+
+    g_assert_cmpint(pcmk__parse_cib_path(STATE "/lrm[@id='1", &path),
+                    ==, EINVAL);
+    g_assert_cmpint(path.type, ==, pcmk__cib_path_node_state);
+    g_assert_cmpstr(path.node, ==, "1");
+    pcmk__free_cib_path(&path);
+
+    g_assert_cmpint(pcmk__parse_cib_path(STATE "/lrm[1", &path), ==, EINVAL);
+    pcmk__free_cib_path(&path);
+
+    g_assert_cmpint(pcmk__parse_cib_path(STATE "[1]x", &path), ==, EINVAL);
+    pcmk__free_cib_path(&path);
+
+    // Other predicates are skipped
+    g_assert_cmpint(pcmk__parse_cib_path("/cib/status/node_state[1]", &path),
+                    ==, pcmk_rc_ok);
+    g_assert_cmpint(path.type, ==, pcmk__cib_path_node_state);
+    g_assert(path.node == NULL);
+    pcmk__free_cib_path(&path);
+}
+
+int main(int argc, char **argv) {
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/common/xpath/cib_path/not_cib_path", not_cib_path);
+    g_test_add_func("/common/xpath/cib_path/sections", sections);
+    g_test_add_func("/common/xpath/cib_path/node_state", node_state);
+    g_test_add_func("/common/xpath/cib_path/history", history);
+    g_test_add_func("/common/xpath/cib_path/malformed", malformed);
+
+    return g_test_run();
+}
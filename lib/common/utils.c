@@ -659,26 +659,46 @@ crm_is_daemon_name(const char *name)
 
 #include <md5.h>
 
+/*!
+ * \internal
+ * \brief Calculate the MD5 digest of a string, without logging
+ *
+ * \param[in] buffer  String to digest (NULL is treated as empty)
+ *
+ * \return Newly allocated hexadecimal digest, or NULL on allocation failure
+ * \note Unlike crm_md5sum(), this is safe to call from a worker thread.
+ */
 char *
-crm_md5sum(const char *buffer)
+pcmk__md5sum(const char *buffer)
 {
-    int lpc = 0, len = 0;
+    int lpc = 0;
     char *digest = NULL;
     unsigned char raw_digest[MD5_DIGEST_SIZE];
 
     if (buffer == NULL) {
         buffer = "";
     }
-    len = strlen(buffer);
 
-    crm_trace("Beginning digest of %d bytes", len);
     digest = malloc(2 * MD5_DIGEST_SIZE + 1);
     if(digest) {
-        md5_buffer(buffer, len, raw_digest);
+        md5_buffer(buffer, strlen(buffer), raw_digest);
         for (lpc = 0; lpc < MD5_DIGEST_SIZE; lpc++) {
             sprintf(digest + (2 * lpc), "%02x", raw_digest[lpc]);
         }
         digest[(2 * MD5_DIGEST_SIZE)] = 0;
+    }
+    return digest;
+}
+
+char *
+crm_md5sum(const char *buffer)
+{
+    char *digest = NULL;
+
+    crm_trace("Beginning digest of %d bytes",
+              (int) ((buffer == NULL)? 0 : strlen(buffer)));
+    digest = pcmk__md5sum(buffer);
+    if(digest) {
         crm_trace("Digest %s.", digest);
 
     } else {
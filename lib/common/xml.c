@@ -4458,6 +4458,7 @@ void
 crm_xml_cleanup(void)
 {
     crm_info("Cleaning up memory from libxml2");
+    pcmk__free_acl_cache();
     crm_schema_cleanup();
     xmlCleanupParser();
 }
@@ -10,6 +10,8 @@
 #include <crm_internal.h>
 #include <stdio.h>
 #include <string.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml_internal.h>
 
 /*
  * From xpath2.c
@@ -261,3 +263,176 @@ get_xpath_object(const char *xpath, xmlNode * xml_obj, int error_level)
 
     return result;
 }
+
+/*!
+ * \internal
+ * \brief Classify a CIB element name by its expected parent
+ *
+ * \param[in]     name  Element name from XPath
+ * \param[in]     id    Element ID from XPath (or NULL if none)
+ * \param[in,out] path  Parse result so far (will be updated)
+ *
+ * \return true if element was recognized, otherwise false
+ */
+static bool
+classify_cib_element(const char *name, const char *id, pcmk__cib_path_t *path)
+{
+    if (strcmp(name, XML_CIB_TAG_TICKETS) == 0) {
+        path->type = pcmk__cib_path_tickets;
+        return false; // Nothing below tickets is of further interest
+    }
+
+    switch (path->type) {
+        case pcmk__cib_path_cib:
+            if (strcmp(name, XML_CIB_TAG_CONFIGURATION) == 0) {
+                path->type = pcmk__cib_path_configuration;
+                return false;
+
+            } else if (strcmp(name, XML_CIB_TAG_STATUS) == 0) {
+                path->type = pcmk__cib_path_status;
+                return true;
+            }
+            break;
+
+        case pcmk__cib_path_status:
+            if (strcmp(name, XML_CIB_TAG_STATE) == 0) {
+                path->type = pcmk__cib_path_node_state;
+                path->node = id;
+                return true;
+            }
+            break;
+
+        case pcmk__cib_path_node_state:
+            if (strcmp(name, XML_TAG_TRANSIENT_NODEATTRS) == 0) {
+                path->type = pcmk__cib_path_transient;
+                return false;
+
+            } else if (strcmp(name, XML_CIB_TAG_LRM) == 0) {
+                path->type = pcmk__cib_path_lrm;
+                if (path->node == NULL) {
+                    path->node = id;
+                }
+                return true;
+            }
+            break;
+
+        case pcmk__cib_path_lrm:
+            if (strcmp(name, XML_LRM_TAG_RESOURCES) == 0) {
+                path->type = pcmk__cib_path_lrm_resources;
+                return true;
+            }
+            break;
+
+        case pcmk__cib_path_lrm_resources:
+            if (strcmp(name, XML_LRM_TAG_RESOURCE) == 0) {
+                path->type = pcmk__cib_path_lrm_resource;
+                path->rsc = id;
+                return true;
+            }
+            break;
+
+        case pcmk__cib_path_lrm_resource:
+            if (strcmp(name, XML_LRM_TAG_RSC_OP) == 0) {
+                path->type = pcmk__cib_path_lrm_rsc_op;
+                path->op = id;
+                return false;
+            }
+            break;
+
+        default:
+            break;
+    }
+    return false;
+}
+
+/*!
+ * \internal
+ * \brief Parse an XPath to a CIB element, without evaluating it
+ *
+ * Parse an XPath of the form used in v2 patchsets, such as
+ * "/cib/status/node_state[@id='1']/lrm[@id='1']/lrm_resources", in a single
+ * pass, finding the deepest element of interest along with the node,
+ * resource, and operation IDs along the way. This is much cheaper than
+ * searching for each kind of element separately.
+ *
+ * \param[in]  xpath  XPath to parse
+ * \param[out] path   Where to store result (which must be freed with
+ *                    pcmk__free_cib_path() even on error)
+ *
+ * \return Standard Pacemaker return code (EINVAL if \p xpath does not start
+ *         with the CIB root element or is malformed)
+ * \note On error, \p path will have whatever was parsed before the problem.
+ */
+int
+pcmk__parse_cib_path(const char *xpath, pcmk__cib_path_t *path)
+{
+    char *pos = NULL;
+
+    CRM_CHECK(path != NULL, return EINVAL);
+    memset(path, 0, sizeof(pcmk__cib_path_t));
+
+    if ((xpath == NULL) || (xpath[0] != '/')) {
+        return EINVAL;
+    }
+    path->buf = strdup(xpath);
+    CRM_ASSERT(path->buf != NULL);
+
+    for (pos = path->buf; pos != NULL; ) {
+        char *name = pos + 1;
+        char *id = NULL;
+        size_t name_len = strcspn(name, "/[");
+        char *end = name + name_len;
+
+        if (*end == '[') {
+            if (strncmp(end, "[@" XML_ATTR_ID "='", 6) == 0) {
+                char *quote = strstr(end + 6, "']");
+
+                if (quote == NULL) {
+                    return EINVAL;
+                }
+                id = end + 6;
+                *quote = '\0';
+                end = quote + 2;
+
+            } else {
+                // Some other predicate, which we can skip
+                end = strchr(end, ']');
+                if (end == NULL) {
+                    return EINVAL;
+                }
+                ++end;
+            }
+        }
+        if ((*end != '/') && (*end != '\0')) {
+            return EINVAL;
+        }
+        pos = (*end == '/')? end : NULL;
+        name[name_len] = '\0';
+
+        if (path->type == pcmk__cib_path_other) {
+            if (strcmp(name, XML_TAG_CIB) != 0) {
+                return EINVAL;
+            }
+            path->type = pcmk__cib_path_cib;
+
+        } else if (!classify_cib_element(name, id, path)) {
+            break;
+        }
+    }
+    return pcmk_rc_ok;
+}
+
+/*!
+ * \internal
+ * \brief Free memory used by a parsed CIB XPath
+ *
+ * \param[in] path  Result of pcmk__parse_cib_path()
+ */
+void
+pcmk__free_cib_path(pcmk__cib_path_t *path)
+{
+    if (path != NULL) {
+        free(path->buf);
+        memset(path, 0, sizeof(pcmk__cib_path_t));
+    }
+}
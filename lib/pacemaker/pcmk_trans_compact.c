@@ -0,0 +1,592 @@
+/*
+ * Copyright 2020 the Pacemaker project contributors
+ *
+ * The version control history for this file may have further details.
+ *
+ * This source code is licensed under the GNU Lesser General Public License
+ * version 2.1 or later (LGPLv2.1+) WITHOUT ANY WARRANTY.
+ */
+
+#include <crm_internal.h>
+
+#include <string.h>
+#include <glib.h>
+
+#include <crm/crm.h>
+#include <crm/msg_xml.h>
+#include <crm/common/xml.h>
+#include <pacemaker-internal.h>
+
+/* Compact transition graph encoding
+ *
+ * The scheduler can hand the controller a transition graph in a compact form
+ * rather than as XML. Graphs list the same element and attribute names (and
+ * many of the same values) over and over, and an action that is an input to
+ * several synapses is repeated in full for each of them. The compact form
+ * stores each distinct string once, each distinct input action once, and
+ * refers to them by index.
+ *
+ * All integers are unsigned LEB128 (7 bits per byte, least significant
+ * first, high bit set on all but the last byte). The layout is:
+ *
+ *   magic         "PCMKTG1" (not NUL-terminated)
+ *   string pool   count, then for each string: length, bytes
+ *   graph         element (transition_graph attributes, no children)
+ *   action table  count, then that many elements
+ *   input table   count, then that many elements
+ *   synapses      count, then for each synapse:
+ *                 id, zigzag-encoded priority,
+ *                 action count, action table indexes,
+ *                 input count, input table indexes
+ *
+ * where an element is: name (pool index), attribute count, that many
+ * name/value pool index pairs, child count, that many child elements.
+ *
+ * The whole is base64-encoded so it can travel as an XML attribute value over
+ * IPC. pe-input and graph dumps remain XML; this is only a wire format.
+ */
+
+#define COMPACT_MAGIC       "PCMKTG1"
+#define COMPACT_MAGIC_LEN   (sizeof(COMPACT_MAGIC) - 1)
+
+// Deepest element nesting the decoder will accept (action XML is shallow)
+#define COMPACT_MAX_DEPTH   16
+
+struct compact_encoder_s {
+    GHashTable *string_index;   // string -> pool index + 1
+    GPtrArray *pool;            // strings in pool order (not owned)
+};
+
+struct compact_decoder_s {
+    const guint8 *pos;
+    const guint8 *end;
+    char **pool;
+    guint64 pool_len;
+};
+
+static void
+put_uint(GByteArray *buf, guint64 value)
+{
+    guint8 byte = 0;
+
+    do {
+        byte = value & 0x7f;
+        value >>= 7;
+        if (value != 0) {
+            byte |= 0x80;
+        }
+        g_byte_array_append(buf, &byte, 1);
+    } while (value != 0);
+}
+
+// Map signed values to unsigned ones so small magnitudes stay small
+static guint64
+zigzag_encode(int value)
+{
+    return (value < 0)? ((((guint64) -(gint64) value) << 1) - 1)
+                      : (((guint64) value) << 1);
+}
+
+static int
+zigzag_decode(guint64 value)
+{
+    return (value & 1)? -(int) ((value + 1) >> 1) : (int) (value >> 1);
+}
+
+static void
+put_string(struct compact_encoder_s *enc, GByteArray *buf, const char *s)
+{
+    gpointer index = NULL;
+
+    if (s == NULL) {
+        s = "";
+    }
+    index = g_hash_table_lookup(enc->string_index, s);
+    if (index == NULL) {
+        g_ptr_array_add(enc->pool, (gpointer) s);
+        index = GUINT_TO_POINTER(enc->pool->len);
+        g_hash_table_insert(enc->string_index, (gpointer) s, index);
+    }
+    put_uint(buf, GPOINTER_TO_UINT(index) - 1);
+}
+
+static void
+put_element(struct compact_encoder_s *enc, GByteArray *buf, xmlNode *xml,
+            bool with_children)
+{
+    xmlAttrPtr xIter = NULL;
+    xmlNode *child = NULL;
+    guint count = 0;
+
+    put_string(enc, buf, crm_element_name(xml));
+
+    for (xIter = xml->properties; xIter != NULL; xIter = xIter->next) {
+        count++;
+    }
+    put_uint(buf, count);
+    for (xIter = xml->properties; xIter != NULL; xIter = xIter->next) {
+        put_string(enc, buf, (const char *) xIter->name);
+        put_string(enc, buf, (xIter->children == NULL)? NULL
+                             : (const char *) xIter->children->content);
+    }
+
+    count = 0;
+    if (with_children) {
+        for (child = __xml_first_child_element(xml); child != NULL;
+             child = __xml_next_element(child)) {
+            count++;
+        }
+    }
+    put_uint(buf, count);
+    for (child = (count? __xml_first_child_element(xml) : NULL);
+         child != NULL; child = __xml_next_element(child)) {
+        put_element(enc, buf, child, true);
+    }
+}
+
+/*!
+ * \internal
+ * \brief Encode a transition graph in the compact wire format
+ *
+ * \param[in] xml_graph  Transition graph XML
+ *
+ * \return Newly allocated base64 string (the caller must free it with
+ *         g_free()), or NULL if \p xml_graph is NULL
+ */
+char *
+pcmk__graph_compact_encode(xmlNode *xml_graph)
+{
+    struct compact_encoder_s enc;
+    GByteArray *graph = NULL;
+    GByteArray *actions = NULL;
+    GByteArray *inputs = NULL;
+    GByteArray *synapses = NULL;
+    GByteArray *out = NULL;
+    GHashTable *input_index = NULL;
+    guint num_actions = 0;
+    guint num_synapses = 0;
+    char *encoded = NULL;
+
+    CRM_CHECK(xml_graph != NULL, return NULL);
+
+    enc.string_index = g_hash_table_new(crm_str_hash, g_str_equal);
+    enc.pool = g_ptr_array_new();
+    graph = g_byte_array_new();
+    actions = g_byte_array_new();
+    inputs = g_byte_array_new();
+    synapses = g_byte_array_new();
+
+    // Input action ID -> input table index + 1
+    input_index = g_hash_table_new(crm_str_hash, g_str_equal);
+
+    put_element(&enc, graph, xml_graph, false);
+
+    for (xmlNode *synapse = first_named_child(xml_graph, "synapse");
+         synapse != NULL; synapse = crm_next_same_xml(synapse)) {
+
+        xmlNode *action_set = first_named_child(synapse, "action_set");
+        xmlNode *trigger_set = first_named_child(synapse, "inputs");
+        int id = crm_parse_int(ID(synapse), "-1");
+        int priority = 0;
+        guint count = 0;
+
+        if (id < 0) {
+            continue; // unpack_graph() would drop it, too
+        }
+        crm_element_value_int(synapse, XML_CIB_ATTR_PRIORITY, &priority);
+        put_uint(synapses, id);
+        put_uint(synapses, zigzag_encode(priority));
+
+        for (xmlNode *action = __xml_first_child_element(action_set);
+             action != NULL; action = __xml_next_element(action)) {
+            count++;
+        }
+        put_uint(synapses, count);
+        for (xmlNode *action = __xml_first_child_element(action_set);
+             action != NULL; action = __xml_next_element(action)) {
+            put_element(&enc, actions, action, true);
+            put_uint(synapses, num_actions++);
+        }
+
+        count = 0;
+        for (xmlNode *trigger = first_named_child(trigger_set, "trigger");
+             trigger != NULL; trigger = crm_next_same_xml(trigger)) {
+            for (xmlNode *input = __xml_first_child_element(trigger);
+                 input != NULL; input = __xml_next_element(input)) {
+                if (ID(input) != NULL) {
+                    count++;
+                }
+            }
+        }
+        put_uint(synapses, count);
+        for (xmlNode *trigger = first_named_child(trigger_set, "trigger");
+             trigger != NULL; trigger = crm_next_same_xml(trigger)) {
+
+            for (xmlNode *input = __xml_first_child_element(trigger);
+                 input != NULL; input = __xml_next_element(input)) {
+
+                const char *input_id = ID(input);
+                guint index = 0;
+
+                if (input_id == NULL) {
+                    continue; // unpack_graph() would drop it, too
+                }
+                index = GPOINTER_TO_UINT(g_hash_table_lookup(input_index,
+                                                             input_id));
+                if (index == 0) {
+                    put_element(&enc, inputs, input, true);
+                    index = g_hash_table_size(input_index) + 1;
+                    g_hash_table_insert(input_index, (gpointer) input_id,
+                                        GUINT_TO_POINTER(index));
+                }
+                put_uint(synapses, index - 1);
+            }
+        }
+        num_synapses++;
+    }
+
+    out = g_byte_array_sized_new(COMPACT_MAGIC_LEN + graph->len + actions->len
+                                 + inputs->len + synapses->len + 64);
+    g_byte_array_append(out, (const guint8 *) COMPACT_MAGIC, COMPACT_MAGIC_LEN);
+    put_uint(out, enc.pool->len);
+    for (guint lpc = 0; lpc < enc.pool->len; lpc++) {
+        const char *s = g_ptr_array_index(enc.pool, lpc);
+        size_t len = strlen(s);
+
+        put_uint(out, len);
+        g_byte_array_append(out, (const guint8 *) s, len);
+    }
+    g_byte_array_append(out, graph->data, graph->len);
+    put_uint(out, num_actions);
+    g_byte_array_append(out, actions->data, actions->len);
+    put_uint(out, g_hash_table_size(input_index));
+    g_byte_array_append(out, inputs->data, inputs->len);
+    put_uint(out, num_synapses);
+    g_byte_array_append(out, synapses->data, synapses->len);
+
+    encoded = g_base64_encode(out->data, out->len);
+
+    crm_debug("Encoded transition graph (%u actions in %u synapses, "
+              "%u distinct input%s, %u string%s) in %u bytes",
+              num_actions, num_synapses,
+              g_hash_table_size(input_index),
+              pcmk__plural_s(g_hash_table_size(input_index)),
+              enc.pool->len, pcmk__plural_s(enc.pool->len), out->len);
+
+    g_hash_table_destroy(input_index);
+    g_hash_table_destroy(enc.string_index);
+    g_ptr_array_free(enc.pool, TRUE);
+    g_byte_array_free(graph, TRUE);
+    g_byte_array_free(actions, TRUE);
+    g_byte_array_free(inputs, TRUE);
+    g_byte_array_free(synapses, TRUE);
+    g_byte_array_free(out, TRUE);
+    return encoded;
+}
+
+static bool
+get_uint(struct compact_decoder_s *dec, guint64 *value)
+{
+    *value = 0;
+    for (int shift = 0; (shift < 64) && (dec->pos < dec->end); shift += 7) {
+        guint8 byte = *(dec->pos)++;
+
+        *value |= ((guint64) (byte & 0x7f)) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Read a count that cannot exceed the number of bytes left
+static bool
+get_count(struct compact_decoder_s *dec, guint64 *value)
+{
+    return get_uint(dec, value) && (*value <= (guint64) (dec->end - dec->pos));
+}
+
+static const char *
+get_string(struct compact_decoder_s *dec)
+{
+    guint64 index = 0;
+
+    if (!get_uint(dec, &index) || (index >= dec->pool_len)) {
+        return NULL;
+    }
+    return dec->pool[index];
+}
+
+/*!
+ * \internal
+ * \brief Decode one element (and its children) from compact form
+ *
+ * \param[in,out] dec     Decoder state
+ * \param[in,out] parent  Where to add the new element (or NULL for none)
+ * \param[in]     depth   Nesting depth of the new element
+ *
+ * \return New element, or NULL if input is invalid
+ * \note If \p parent is NULL, the caller must free the result with free_xml().
+ *       On error, a partially decoded element is freed only if it has no
+ *       parent.
+ */
+static xmlNode *
+get_element(struct compact_decoder_s *dec, xmlNode *parent, int depth)
+{
+    const char *name = get_string(dec);
+    xmlNode *xml = NULL;
+    guint64 count = 0;
+
+    if ((name == NULL) || (*name == '\0') || (depth > COMPACT_MAX_DEPTH)) {
+        return NULL;
+    }
+    xml = create_xml_node(parent, name);
+    if (xml == NULL) {
+        return NULL;
+    }
+
+    if (!get_count(dec, &count)) {
+        goto bail;
+    }
+    for (guint64 lpc = 0; lpc < count; lpc++) {
+        const char *attr = get_string(dec);
+        const char *value = get_string(dec);
+
+        if ((attr == NULL) || (*attr == '\0') || (value == NULL)) {
+            goto bail;
+        }
+        crm_xml_add(xml, attr, value);
+    }
+
+    if (!get_count(dec, &count)) {
+        goto bail;
+    }
+    for (guint64 lpc = 0; lpc < count; lpc++) {
+        if (get_element(dec, xml, depth + 1) == NULL) {
+            goto bail;
+        }
+    }
+    return xml;
+
+bail:
+    if (parent == NULL) {
+        free_xml(xml);
+    }
+    return NULL;
+}
+
+// Decode a table of count-prefixed elements into a newly allocated array
+static xmlNode **
+get_element_table(struct compact_decoder_s *dec, guint64 *count)
+{
+    xmlNode **table = NULL;
+
+    if (!get_count(dec, count)) {
+        return NULL;
+    }
+    table = calloc(*count + 1, sizeof(xmlNode *));
+    CRM_ASSERT(table != NULL);
+
+    for (guint64 lpc = 0; lpc < *count; lpc++) {
+        table[lpc] = get_element(dec, NULL, 1);
+        if (table[lpc] == NULL) {
+            for (guint64 i = 0; i < lpc; i++) {
+                free_xml(table[i]);
+            }
+            free(table);
+            return NULL;
+        }
+    }
+    return table;
+}
+
+static void
+free_element_table(xmlNode **table, guint64 count)
+{
+    if (table != NULL) {
+        for (guint64 lpc = 0; lpc < count; lpc++) {
+            free_xml(table[lpc]);
+        }
+        free(table);
+    }
+}
+
+static bool
+get_synapses(struct compact_decoder_s *dec, crm_graph_t *graph,
+             xmlNode **actions, guint64 num_actions,
+             xmlNode **inputs, guint64 num_inputs)
+{
+    guint64 num_synapses = 0;
+
+    if (!get_count(dec, &num_synapses)) {
+        return false;
+    }
+
+    for (guint64 lpc = 0; lpc < num_synapses; lpc++) {
+        synapse_t *synapse = NULL;
+        guint64 id = 0;
+        guint64 priority = 0;
+        guint64 count = 0;
+
+        if (!get_uint(dec, &id) || (id > G_MAXINT)
+            || !get_uint(dec, &priority) || (priority > G_MAXUINT32)) {
+            return false;
+        }
+
+        synapse = pcmk__new_synapse(graph, (int) id, zigzag_decode(priority));
+        if (synapse == NULL) {
+            return false;
+        }
+        graph->synapses = g_list_prepend(graph->synapses, synapse);
+
+        if (!get_count(dec, &count)) {
+            return false;
+        }
+        for (guint64 i = 0; i < count; i++) {
+            guint64 index = 0;
+            xmlNode *xml = NULL;
+
+            if (!get_uint(dec, &index) || (index >= num_actions)) {
+                return false;
+            }
+
+            // Each action belongs to exactly one synapse, so hand it over
+            xml = actions[index];
+            actions[index] = NULL;
+            if ((xml == NULL)
+                || (pcmk__add_synapse_action(graph, synapse, xml) == NULL)) {
+                return false;
+            }
+        }
+
+        if (!get_count(dec, &count)) {
+            return false;
+        }
+        for (guint64 i = 0; i < count; i++) {
+            guint64 index = 0;
+
+            if (!get_uint(dec, &index) || (index >= num_inputs)) {
+                return false;
+            }
+            if (pcmk__add_synapse_input(graph, synapse,
+                                        copy_xml(inputs[index])) == NULL) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*!
+ * \internal
+ * \brief Unpack a transition graph from the compact wire format
+ *
+ * \param[in]  encoded      Graph as encoded by pcmk__graph_compact_encode()
+ * \param[in]  reference    Graph source (as for unpack_graph())
+ * \param[out] graph_attrs  If not NULL, where to store an attribute-only
+ *                          transition_graph element on success (the caller
+ *                          must free it with free_xml())
+ *
+ * \return Newly allocated graph, or NULL if \p encoded is invalid
+ */
+crm_graph_t *
+pcmk__unpack_compact_graph(const char *encoded, const char *reference,
+                           xmlNode **graph_attrs)
+{
+    struct compact_decoder_s dec = { NULL, };
+    guint8 *raw = NULL;
+    gsize raw_len = 0;
+    xmlNode *attrs = NULL;
+    xmlNode **actions = NULL;
+    xmlNode **inputs = NULL;
+    guint64 num_actions = 0;
+    guint64 num_inputs = 0;
+    crm_graph_t *graph = NULL;
+    bool ok = false;
+
+    CRM_CHECK(encoded != NULL, return NULL);
+
+    raw = g_base64_decode(encoded, &raw_len);
+    if ((raw == NULL) || (raw_len < COMPACT_MAGIC_LEN)
+        || (memcmp(raw, COMPACT_MAGIC, COMPACT_MAGIC_LEN) != 0)) {
+        crm_err("Transition graph %s is not in a known compact format",
+                crm_str(reference));
+        g_free(raw);
+        return NULL;
+    }
+    dec.pos = raw + COMPACT_MAGIC_LEN;
+    dec.end = raw + raw_len;
+
+    if (!get_count(&dec, &dec.pool_len)) {
+        goto done;
+    }
+    dec.pool = calloc(dec.pool_len + 1, sizeof(char *));
+    CRM_ASSERT(dec.pool != NULL);
+    for (guint64 lpc = 0; lpc < dec.pool_len; lpc++) {
+        guint64 len = 0;
+
+        if (!get_count(&dec, &len)) {
+            dec.pool_len = lpc; // Only free what was allocated
+            goto done;
+        }
+        dec.pool[lpc] = g_strndup((const char *) dec.pos, len);
+        dec.pos += len;
+    }
+
+    attrs = get_element(&dec, NULL, 0);
+    if ((attrs == NULL) || !crm_str_eq(crm_element_name(attrs),
+                                       XML_TAG_GRAPH, TRUE)) {
+        goto done;
+    }
+
+    actions = get_element_table(&dec, &num_actions);
+    if (actions == NULL) {
+        goto done;
+    }
+    inputs = get_element_table(&dec, &num_inputs);
+    if (inputs == NULL) {
+        goto done;
+    }
+
+    graph = unpack_graph(attrs, reference);
+    if (graph == NULL) {
+        goto done;
+    }
+
+    ok = get_synapses(&dec, graph, actions, num_actions, inputs, num_inputs)
+         && (dec.pos == dec.end);
+
+    graph->synapses = g_list_reverse(graph->synapses);
+    g_list_free(graph->active_synapses);
+    graph->active_synapses = g_list_copy(graph->synapses);
+
+    if (ok) {
+        crm_debug("Unpacked compact transition %d: %d actions in %d synapses",
+                  graph->id, graph->num_actions, graph->num_synapses);
+    }
+
+done:
+    if (!ok) {
+        crm_err("Could not unpack compact transition graph %s: "
+                "invalid or truncated data", crm_str(reference));
+        if (graph != NULL) {
+            destroy_graph(graph);
+            graph = NULL;
+        }
+    }
+    if (ok && (graph_attrs != NULL)) {
+        *graph_attrs = attrs;
+    } else {
+        free_xml(attrs);
+    }
+    free_element_table(actions, num_actions);
+    free_element_table(inputs, num_inputs);
+    if (dec.pool != NULL) {
+        for (guint64 lpc = 0; lpc < dec.pool_len; lpc++) {
+            g_free(dec.pool[lpc]);
+        }
+        free(dec.pool);
+    }
+    g_free(raw);
+    return graph;
+}
@@ -93,8 +93,21 @@ update_graph(crm_graph_t * graph, crm_action_t * action)
     gboolean rc = FALSE;
     gboolean updates = FALSE;
     GListPtr lpc = NULL;
+    GQueue *dependents = NULL;
+    synapse_t *owner = action->synapse;
+
+    /* Only the synapse containing the action, and those that have it as an
+     * input, can be affected
+     */
+    if ((owner != NULL) && owner->executed
+        && !owner->confirmed && !owner->failed) {
+        updates = update_synapse_confirmed(owner, action->id);
+    }
 
-    for (lpc = graph->synapses; lpc != NULL; lpc = lpc->next) {
+    dependents = g_hash_table_lookup(graph->dependents,
+                                     GINT_TO_POINTER(action->id));
+    lpc = (dependents == NULL)? NULL : dependents->head;
+    for (; lpc != NULL; lpc = lpc->next) {
         synapse_t *synapse = (synapse_t *) lpc->data;
 
         if (synapse->confirmed || synapse->failed) {
@@ -255,22 +268,37 @@ run_graph(crm_graph_t * graph)
     graph->incomplete = 0;
     crm_trace("Entering graph %d callback", graph->id);
 
-    /* Pre-calculate the number of completed and in-flight operations */
-    for (lpc = graph->synapses; lpc != NULL; lpc = lpc->next) {
+    /* Pre-calculate the number of completed and in-flight operations, dropping
+     * newly completed synapses from the list of those still to be checked
+     */
+    lpc = graph->active_synapses;
+    while (lpc != NULL) {
+        GList *next = lpc->next;
         synapse_t *synapse = (synapse_t *) lpc->data;
 
         if (synapse->confirmed) {
             crm_trace("Synapse %d complete", synapse->id);
-            graph->completed++;
+            graph->pruned++;
+            if (synapse->failed) {
+                graph->pruned_failed++;
+            }
+            graph->active_synapses = g_list_delete_link(graph->active_synapses,
+                                                        lpc);
 
         } else if (synapse->failed == FALSE && synapse->executed) {
             crm_trace("Synapse %d: confirmation pending", synapse->id);
             graph->pending++;
         }
+        lpc = next;
     }
-
-    /* Now check if there is work to do */
-    for (lpc = graph->synapses; lpc != NULL; lpc = lpc->next) {
+    graph->completed = graph->pruned;
+    graph->skipped = graph->pruned_failed;
+
+    /* Now check if there is work to do (in list order, which may have been
+     * sorted by pcmk__sort_graph_critical_path() so that, when limits allow
+     * only some ready synapses to fire, the most critical ones go first)
+     */
+    for (lpc = graph->active_synapses; lpc != NULL; lpc = lpc->next) {
         synapse_t *synapse = (synapse_t *) lpc->data;
 
         if (graph->batch_limit > 0 && graph->pending >= graph->batch_limit) {
@@ -17,6 +17,7 @@
 #include <crm/common/xml.h>
 #include <pacemaker-internal.h>
 
+// xml_action will be owned by the new action (or freed on error)
 static crm_action_t *
 unpack_action(synapse_t * parent, xmlNode * xml_action)
 {
@@ -26,6 +27,7 @@ unpack_action(synapse_t * parent, xmlNode * xml_action)
     if (value == NULL) {
         crm_err("Actions must have an id!");
         crm_log_xml_trace(xml_action, "Action with missing id");
+        free_xml(xml_action);
         return NULL;
     }
 
@@ -33,12 +35,13 @@ unpack_action(synapse_t * parent, xmlNode * xml_action)
     if (action == NULL) {
         crm_perror(LOG_CRIT, "Cannot unpack action");
         crm_log_xml_trace(xml_action, "Lost action");
+        free_xml(xml_action);
         return NULL;
     }
 
     action->id = crm_parse_int(value, NULL);
     action->type = action_type_rsc;
-    action->xml = copy_xml(xml_action);
+    action->xml = xml_action;
     action->synapse = parent;
 
     if (safe_str_eq(crm_element_name(action->xml), XML_GRAPH_TAG_RSC_OP)) {
@@ -80,6 +83,136 @@ unpack_action(synapse_t * parent, xmlNode * xml_action)
     return action;
 }
 
+// Append to an index entry, keeping graph order (for first-match lookups)
+static void
+index_list_add(GHashTable *index, gpointer key, gpointer value)
+{
+    GQueue *queue = g_hash_table_lookup(index, key);
+
+    if (queue == NULL) {
+        queue = g_queue_new();
+        g_hash_table_insert(index, key, queue);
+    }
+    g_queue_push_tail(queue, value);
+}
+
+/*!
+ * \internal
+ * \brief Add an action to a graph's lookup indexes
+ *
+ * \param[in,out] graph   Graph being unpacked
+ * \param[in]     action  Action to index (not an input)
+ */
+static void
+index_action(crm_graph_t *graph, crm_action_t *action)
+{
+    const char *task = crm_element_value(action->xml, XML_LRM_ATTR_TASK);
+    xmlNode *downed = first_named_child(action->xml, XML_GRAPH_TAG_DOWNED);
+
+    g_hash_table_insert(graph->actions, GINT_TO_POINTER(action->id), action);
+
+    if (safe_str_eq(task, CRMD_ACTION_CANCEL)) {
+        const char *key = crm_element_value(action->xml, XML_LRM_ATTR_TASK_KEY);
+
+        if (key != NULL) {
+            index_list_add(graph->cancels, (gpointer) key, action);
+        }
+    }
+
+    if (downed != NULL) {
+        for (xmlNode *node = first_named_child(downed, XML_CIB_TAG_NODE);
+             node != NULL; node = crm_next_same_xml(node)) {
+
+            const char *uuid = crm_element_value(node, XML_ATTR_UUID);
+
+            if (uuid != NULL) {
+                index_list_add(graph->downed, (gpointer) uuid, action);
+            }
+        }
+    }
+}
+
+/*!
+ * \internal
+ * \brief Create a new synapse for a graph being unpacked
+ *
+ * \param[in,out] graph     Graph that synapse will be part of
+ * \param[in]     id        Synapse ID
+ * \param[in]     priority  Synapse priority
+ *
+ * \return Newly allocated synapse, or NULL if \p id is invalid
+ * \note The caller is responsible for adding the result to the graph's
+ *       synapse list.
+ */
+synapse_t *
+pcmk__new_synapse(crm_graph_t *graph, int id, int priority)
+{
+    synapse_t *new_synapse = NULL;
+
+    CRM_CHECK(id >= 0, return NULL);
+
+    new_synapse = calloc(1, sizeof(synapse_t));
+    CRM_ASSERT(new_synapse != NULL);
+    new_synapse->id = id;
+    new_synapse->priority = priority;
+    graph->num_synapses++;
+    return new_synapse;
+}
+
+/*!
+ * \internal
+ * \brief Add an action to a synapse being unpacked
+ *
+ * \param[in,out] graph    Graph containing synapse
+ * \param[in,out] synapse  Synapse to add action to
+ * \param[in]     xml      Action XML (the action takes ownership of this)
+ *
+ * \return Newly added action, or NULL if \p xml is not a valid action
+ */
+crm_action_t *
+pcmk__add_synapse_action(crm_graph_t *graph, synapse_t *synapse, xmlNode *xml)
+{
+    crm_action_t *new_action = unpack_action(synapse, xml);
+
+    if (new_action == NULL) {
+        return NULL;
+    }
+
+    graph->num_actions++;
+
+    crm_trace("Adding action %d to synapse %d", new_action->id, synapse->id);
+
+    synapse->actions = g_list_append(synapse->actions, new_action);
+    index_action(graph, new_action);
+    return new_action;
+}
+
+/*!
+ * \internal
+ * \brief Add an input to a synapse being unpacked
+ *
+ * \param[in,out] graph    Graph containing synapse
+ * \param[in,out] synapse  Synapse to add input to
+ * \param[in]     xml      Input action XML (the input takes ownership of this)
+ *
+ * \return Newly added input, or NULL if \p xml is not a valid action
+ */
+crm_action_t *
+pcmk__add_synapse_input(crm_graph_t *graph, synapse_t *synapse, xmlNode *xml)
+{
+    crm_action_t *new_input = unpack_action(synapse, xml);
+
+    if (new_input == NULL) {
+        return NULL;
+    }
+
+    crm_trace("Adding input %d to synapse %d", new_input->id, synapse->id);
+
+    synapse->inputs = g_list_append(synapse->inputs, new_input);
+    index_list_add(graph->dependents, GINT_TO_POINTER(new_input->id), synapse);
+    return new_input;
+}
+
 static synapse_t *
 unpack_synapse(crm_graph_t * new_graph, xmlNode * xml_synapse)
 {
@@ -87,22 +220,22 @@ unpack_synapse(crm_graph_t * new_graph, xmlNode * xml_synapse)
     xmlNode *inputs = NULL;
     xmlNode *action_set = NULL;
     synapse_t *new_synapse = NULL;
+    int priority = 0;
 
     CRM_CHECK(xml_synapse != NULL, return NULL);
     crm_trace("looking in synapse %s", ID(xml_synapse));
 
-    new_synapse = calloc(1, sizeof(synapse_t));
-    new_synapse->id = crm_parse_int(ID(xml_synapse), NULL);
-
     value = crm_element_value(xml_synapse, XML_CIB_ATTR_PRIORITY);
     if (value != NULL) {
-        new_synapse->priority = crm_parse_int(value, NULL);
+        priority = crm_parse_int(value, NULL);
     }
 
-    CRM_CHECK(new_synapse->id >= 0, free(new_synapse);
-              return NULL);
-
-    new_graph->num_synapses++;
+    new_synapse = pcmk__new_synapse(new_graph,
+                                    crm_parse_int(ID(xml_synapse), NULL),
+                                    priority);
+    if (new_synapse == NULL) {
+        return NULL;
+    }
 
     crm_trace("look for actions in synapse %s", crm_element_value(xml_synapse, XML_ATTR_ID));
 
@@ -113,17 +246,8 @@ unpack_synapse(crm_graph_t * new_graph, xmlNode * xml_synapse)
 
             for (action = __xml_first_child(action_set); action != NULL;
                  action = __xml_next(action)) {
-                crm_action_t *new_action = unpack_action(new_synapse, action);
-
-                if (new_action == NULL) {
-                    continue;
-                }
-
-                new_graph->num_actions++;
-
-                crm_trace("Adding action %d to synapse %d", new_action->id, new_synapse->id);
-
-                new_synapse->actions = g_list_append(new_synapse->actions, new_action);
+                pcmk__add_synapse_action(new_graph, new_synapse,
+                                         copy_xml(action));
             }
         }
     }
@@ -139,15 +263,8 @@ unpack_synapse(crm_graph_t * new_graph, xmlNode * xml_synapse)
                 xmlNode *input = NULL;
 
                 for (input = __xml_first_child(trigger); input != NULL; input = __xml_next(input)) {
-                    crm_action_t *new_input = unpack_action(new_synapse, input);
-
-                    if (new_input == NULL) {
-                        continue;
-                    }
-
-                    crm_trace("Adding input %d to synapse %d", new_input->id, new_synapse->id);
-
-                    new_synapse->inputs = g_list_append(new_synapse->inputs, new_input);
+                    pcmk__add_synapse_input(new_graph, new_synapse,
+                                            copy_xml(input));
                 }
             }
         }
@@ -184,6 +301,20 @@ unpack_graph(xmlNode * xml_graph, const char *reference)
     new_graph->stonith_timeout = 0;
     new_graph->completion_action = tg_done;
 
+    /* Keys of the cancels and downed indexes point into action XML, which
+     * lives as long as the graph
+     */
+    new_graph->actions = g_hash_table_new(g_direct_hash, g_direct_equal);
+    new_graph->dependents = g_hash_table_new_full(g_direct_hash,
+                                                  g_direct_equal, NULL,
+                                                  (GDestroyNotify) g_queue_free);
+    new_graph->cancels = g_hash_table_new_full(crm_str_hash, g_str_equal,
+                                               NULL,
+                                               (GDestroyNotify) g_queue_free);
+    new_graph->downed = g_hash_table_new_full(crm_str_hash, g_str_equal,
+                                              NULL,
+                                              (GDestroyNotify) g_queue_free);
+
     if (reference) {
         new_graph->source = strdup(reference);
     } else {
@@ -192,12 +323,12 @@ unpack_graph(xmlNode * xml_graph, const char *reference)
 
     if (xml_graph != NULL) {
         t_id = crm_element_value(xml_graph, "transition_id");
-        CRM_CHECK(t_id != NULL, free(new_graph);
+        CRM_CHECK(t_id != NULL, destroy_graph(new_graph);
                   return NULL);
         new_graph->id = crm_parse_int(t_id, "-1");
 
         time = crm_element_value(xml_graph, "cluster-delay");
-        CRM_CHECK(time != NULL, free(new_graph);
+        CRM_CHECK(time != NULL, destroy_graph(new_graph);
                   return NULL);
         new_graph->network_delay = crm_parse_interval_spec(time);
 
@@ -220,10 +351,13 @@ unpack_graph(xmlNode * xml_graph, const char *reference)
             synapse_t *new_synapse = unpack_synapse(new_graph, synapse);
 
             if (new_synapse != NULL) {
-                new_graph->synapses = g_list_append(new_graph->synapses, new_synapse);
+                new_graph->synapses = g_list_prepend(new_graph->synapses,
+                                                     new_synapse);
             }
         }
     }
+    new_graph->synapses = g_list_reverse(new_graph->synapses);
+    new_graph->active_synapses = g_list_copy(new_graph->synapses);
 
     crm_debug("Unpacked transition %d: %d actions in %d synapses",
               new_graph->id, new_graph->num_actions, new_graph->num_synapses);
@@ -231,6 +365,132 @@ unpack_graph(xmlNode * xml_graph, const char *reference)
     return new_graph;
 }
 
+// Index of the synapse containing an input action, or -1 if none
+static int
+producer_index(GHashTable *producers, crm_action_t *input)
+{
+    return GPOINTER_TO_INT(g_hash_table_lookup(producers,
+                                               GINT_TO_POINTER(input->id))) - 1;
+}
+
+static gint
+compare_synapse_depth(gconstpointer a, gconstpointer b)
+{
+    const synapse_t *synapse_a = a;
+    const synapse_t *synapse_b = b;
+
+    return synapse_b->depth - synapse_a->depth;
+}
+
+/*!
+ * \internal
+ * \brief Order a graph's synapses so that the longest chains start first
+ *
+ * Calculate each synapse's critical path depth (the number of synapses with
+ * real actions in the longest chain of synapses that depend on it, including
+ * itself), then stably sort the graph's synapses by decreasing depth. Because
+ * run_graph() fires ready synapses in list order, when job limits prevent
+ * firing all of them, those heading long chains (such as fencing followed by
+ * stops, starts, and promotes) will be fired before unrelated actions such as
+ * probes, shortening the transition as a whole.
+ *
+ * \param[in,out] graph  Graph to order
+ */
+void
+pcmk__sort_graph_critical_path(crm_graph_t *graph)
+{
+    int n = g_list_length(graph->synapses);
+    int lpc = 0;
+    synapse_t **synapses = NULL;
+    int *remaining = NULL;          // Dependents of each synapse not yet seen
+    GHashTable *producers = NULL;   // Action ID -> index of its synapse + 1
+    GQueue *ready = NULL;
+
+    if (n < 2) {
+        return;
+    }
+
+    synapses = calloc(n, sizeof(synapse_t *));
+    remaining = calloc(n, sizeof(int));
+    CRM_ASSERT((synapses != NULL) && (remaining != NULL));
+    producers = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    lpc = 0;
+    for (GList *iter = graph->synapses; iter != NULL; iter = iter->next) {
+        synapse_t *synapse = iter->data;
+
+        synapse->depth = 0;
+        synapses[lpc] = synapse;
+        for (GList *a = synapse->actions; a != NULL; a = a->next) {
+            g_hash_table_insert(producers,
+                                GINT_TO_POINTER(((crm_action_t *) a->data)->id),
+                                GINT_TO_POINTER(lpc + 1));
+        }
+        lpc++;
+    }
+
+    for (lpc = 0; lpc < n; lpc++) {
+        for (GList *i = synapses[lpc]->inputs; i != NULL; i = i->next) {
+            int p = producer_index(producers, i->data);
+
+            if ((p >= 0) && (p != lpc)) {
+                remaining[p]++;
+            }
+        }
+    }
+
+    // Walk the graph backward, from synapses that nothing depends on
+    ready = g_queue_new();
+    for (lpc = 0; lpc < n; lpc++) {
+        if (remaining[lpc] == 0) {
+            g_queue_push_tail(ready, GINT_TO_POINTER(lpc));
+        }
+    }
+    while (!g_queue_is_empty(ready)) {
+        int s = GPOINTER_TO_INT(g_queue_pop_head(ready));
+        synapse_t *synapse = synapses[s];
+        crm_action_t *first = synapse->actions? synapse->actions->data : NULL;
+
+        // Pseudo-actions take no time, so they don't lengthen a chain
+        if ((first != NULL) && (first->type != action_type_pseudo)) {
+            synapse->depth++;
+        }
+
+        for (GList *i = synapse->inputs; i != NULL; i = i->next) {
+            int p = producer_index(producers, i->data);
+
+            if ((p < 0) || (p == s)) {
+                continue;
+            }
+            synapses[p]->depth = QB_MAX(synapses[p]->depth, synapse->depth);
+            if (--remaining[p] == 0) {
+                g_queue_push_tail(ready, GINT_TO_POINTER(p));
+            }
+        }
+    }
+    g_queue_free(ready);
+
+    for (lpc = 0; lpc < n; lpc++) {
+        if (remaining[lpc] > 0) {
+            crm_warn("Synapse %d of transition %d is part of a dependency loop",
+                     synapses[lpc]->id, graph->id);
+        }
+    }
+
+    graph->synapses = g_list_sort(graph->synapses, compare_synapse_depth);
+    g_list_free(graph->active_synapses);
+    graph->active_synapses = g_list_copy(graph->synapses);
+    graph->pruned = 0;
+    graph->pruned_failed = 0;
+    lpc = ((synapse_t *) graph->synapses->data)->depth;
+    crm_debug("Longest chain in transition %d is %d synapse%s",
+              graph->id, lpc, pcmk__plural_s(lpc));
+
+    g_hash_table_destroy(producers);
+    free(remaining);
+    free(synapses);
+}
+
 static void
 destroy_action(crm_action_t * action)
 {
@@ -271,12 +531,14 @@ destroy_graph(crm_graph_t * graph)
     if (graph == NULL) {
         return;
     }
-    while (graph->synapses != NULL) {
-        synapse_t *synapse = g_list_nth_data(graph->synapses, 0);
-
-        graph->synapses = g_list_remove(graph->synapses, synapse);
-        destroy_synapse(synapse);
-    }
+    // Destroy indexes first, since their keys point into actions
+    g_hash_table_destroy(graph->actions);
+    g_hash_table_destroy(graph->dependents);
+    g_hash_table_destroy(graph->cancels);
+    g_hash_table_destroy(graph->downed);
+    g_list_free(graph->active_synapses);
+
+    g_list_free_full(graph->synapses, (GDestroyNotify) destroy_synapse);
 
     free(graph->source);
     free(graph);
@@ -104,28 +104,22 @@ actiontype2text(action_type_e type)
     return "invalid";
 }
 
-static crm_action_t *
-find_action(crm_graph_t * graph, int id)
+/*!
+ * \internal
+ * \brief Find a graph action by ID
+ *
+ * \param[in] graph  Graph to search
+ * \param[in] id     Action ID to search for
+ *
+ * \return Action in \p graph with \p id, or NULL if none
+ */
+crm_action_t *
+pcmk__find_graph_action(crm_graph_t *graph, int id)
 {
-    GListPtr sIter = NULL;
-
-    if (graph == NULL) {
+    if ((graph == NULL) || (graph->actions == NULL)) {
         return NULL;
     }
-
-    for (sIter = graph->synapses; sIter != NULL; sIter = sIter->next) {
-        GListPtr aIter = NULL;
-        synapse_t *synapse = (synapse_t *) sIter->data;
-
-        for (aIter = synapse->actions; aIter != NULL; aIter = aIter->next) {
-            crm_action_t *action = (crm_action_t *) aIter->data;
-
-            if (action->id == id) {
-                return action;
-            }
-        }
-    }
-    return NULL;
+    return g_hash_table_lookup(graph->actions, GINT_TO_POINTER(id));
 }
 
 static const char *
@@ -161,7 +155,7 @@ synapse_pending_inputs(crm_graph_t *graph, synapse_t *synapse)
         } else if (input->confirmed) {
             // Confirmed successful inputs are not pending
 
-        } else if (find_action(graph, input->id) != NULL) {
+        } else if (pcmk__find_graph_action(graph, input->id) != NULL) {
             // In-flight or pending
             pending = pcmk__add_word(pending, ID(input->xml));
         }
@@ -182,7 +176,7 @@ log_unresolved_inputs(unsigned int log_level, crm_graph_t *graph,
         const char *key = crm_element_value(input->xml, XML_LRM_ATTR_TASK_KEY);
         const char *host = crm_element_value(input->xml, XML_LRM_ATTR_TARGET);
 
-        if (find_action(graph, input->id) == NULL) {
+        if (pcmk__find_graph_action(graph, input->id) == NULL) {
             do_crm_log(log_level,
                        " * [Input %2d]: Unresolved dependency %s op %s%s%s",
                        input->id, actiontype2text(input->type), key,
@@ -0,0 +1,117 @@
+#include <glib.h>
+
+#include <crm_internal.h>
+#include <pacemaker-internal.h>
+
+#define RSC_OP(id, op, node)                                                \
+    "<rsc_op id='" id "' operation='" op "' operation_key='rsc_" op "_0' "  \
+    "on_node='" node "' on_node_uuid='" node "'>"                           \
+    "<primitive id='rsc' class='ocf' provider='pacemaker' type='Dummy'/>"   \
+    "<attributes CRM_meta_timeout='20000'/></rsc_op>"
+
+#define INPUT(id)   "<inputs><trigger><rsc_op id='" id "'/></trigger></inputs>"
+
+/* Two probes, then a stop -> (pseudo) -> start -> promote chain listed in
+ * reverse, so that sorting has to move the chain ahead of the probes
+ */
+#define CHAIN_GRAPH                                                         \
+    "<transition_graph cluster-delay='60s' transition_id='1'>"              \
+    "<synapse id='0'><action_set>" RSC_OP("1", "monitor", "node1")          \
+    "</action_set><inputs/></synapse>"                                      \
+    "<synapse id='1'><action_set>" RSC_OP("2", "monitor", "node2")          \
+    "</action_set><inputs/></synapse>"                                      \
+    "<synapse id='2'><action_set>" RSC_OP("6", "promote", "node2")          \
+    "</action_set>" INPUT("5") "</synapse>"                                 \
+    "<synapse id='3'><action_set>" RSC_OP("5", "start", "node2")            \
+    "</action_set>" INPUT("4") "</synapse>"                                 \
+    "<synapse id='4'><action_set>"                                          \
+    "<pseudo_event id='4' operation='stopped' operation_key='rsc_stopped_0'>" \
+    "<attributes CRM_meta_timeout='20000'/></pseudo_event>"                 \
+    "</action_set>" INPUT("3") "</synapse>"                                 \
+    "<synapse id='5'><action_set>" RSC_OP("3", "stop", "node1")             \
+    "</action_set><inputs/></synapse>"                                      \
+    "</transition_graph>"
+
+#define LOOP_GRAPH                                                          \
+    "<transition_graph cluster-delay='60s' transition_id='2'>"              \
+    "<synapse id='0'><action_set>" RSC_OP("1", "start", "node1")            \
+    "</action_set>" INPUT("2") "</synapse>"                                 \
+    "<synapse id='1'><action_set>" RSC_OP("2", "stop", "node1")             \
+    "</action_set>" INPUT("1") "</synapse>"                                 \
+    "</transition_graph>"
+
+static crm_graph_t *
+sorted_graph(const char *xml_string)
+{
+    xmlNode *xml = string2xml(xml_string);
+    crm_graph_t *graph = NULL;
+
+    g_assert(xml != NULL);
+    graph = unpack_graph(xml, "test");
+    g_assert(graph != NULL);
+    free_xml(xml);
+
+    pcmk__sort_graph_critical_path(graph);
+    return graph;
+}
+
+static void
+assert_synapse_order(crm_graph_t *graph, const int *ids, const int *depths,
+                     int n)
+{
+    GList *iter = graph->synapses;
+    GList *active = graph->active_synapses;
+
+    g_assert_cmpint(g_list_length(graph->synapses), ==, n);
+    g_assert_cmpint(g_list_length(graph->active_synapses), ==, n);
+
+    for (int lpc = 0; lpc < n; lpc++) {
+        synapse_t *synapse = iter->data;
+
+        g_assert_cmpint(synapse->id, ==, ids[lpc]);
+        g_assert_cmpint(synapse->depth, ==, depths[lpc]);
+        g_assert(active->data == synapse);
+        iter = iter->next;
+        active = active->next;
+    }
+}
+
+static void
+chain_before_probes(void)
+{
+    crm_graph_t *graph = sorted_graph(CHAIN_GRAPH);
+
+    /* The stop heads a chain of three real actions (the pseudo-action between
+     * it and the start doesn't count), and ties keep their original order
+     */
+    const int ids[] = { 5, 3, 4, 0, 1, 2 };
+    const int depths[] = { 3, 2, 2, 1, 1, 1 };
+
+    assert_synapse_order(graph, ids, depths, DIMOF(ids));
+    destroy_graph(graph);
+}
+
+static void
+dependency_loop(void)
+{
+    crm_graph_t *graph = sorted_graph(LOOP_GRAPH);
+
+    // Synapses in a loop get no depth and stay where they were
+    const int ids[] = { 0, 1 };
+    const int depths[] = { 0, 0 };
+
+    assert_synapse_order(graph, ids, depths, DIMOF(ids));
+    destroy_graph(graph);
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_func("/pacemaker/transition/critical_path/chain_before_probes",
+                    chain_before_probes);
+    g_test_add_func("/pacemaker/transition/critical_path/dependency_loop",
+                    dependency_loop);
+
+    return g_test_run();
+}
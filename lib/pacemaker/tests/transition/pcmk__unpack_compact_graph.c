@@ -0,0 +1,406 @@
+#include <glib.h>
+#include <string.h>
+
+#include <crm_internal.h>
+#include <crm/msg_xml.h>
+#include <pacemaker-internal.h>
+
+// Must match COMPACT_MAGIC and COMPACT_MAX_DEPTH in pcmk_trans_compact.c
+#define MAGIC       "PCMKTG1"
+#define MAX_DEPTH   16
+
+/* String pool used by hand-built graphs. The indexes are used directly in the
+ * tests below, so keep them in sync.
+ */
+static const char *pool[] = {
+    XML_TAG_GRAPH,              // 0
+    "transition_id",            // 1
+    "1",                        // 2
+    XML_GRAPH_TAG_PSEUDO_EVENT, // 3
+    XML_ATTR_ID,                // 4
+};
+
+/*
+ * Helpers
+ */
+
+static void
+put_uint(GByteArray *buf, guint64 value)
+{
+    do {
+        guint8 byte = value & 0x7f;
+
+        value >>= 7;
+        if (value != 0) {
+            byte |= 0x80;
+        }
+        g_byte_array_append(buf, &byte, 1);
+    } while (value != 0);
+}
+
+// Add magic, string pool, and a transition_graph element with only an ID
+static GByteArray *
+new_graph_buffer(void)
+{
+    GByteArray *buf = g_byte_array_new();
+
+    g_byte_array_append(buf, (const guint8 *) MAGIC, strlen(MAGIC));
+    put_uint(buf, DIMOF(pool));
+    for (size_t i = 0; i < DIMOF(pool); i++) {
+        put_uint(buf, strlen(pool[i]));
+        g_byte_array_append(buf, (const guint8 *) pool[i], strlen(pool[i]));
+    }
+
+    put_uint(buf, 0);   // transition_graph
+    put_uint(buf, 1);   // one attribute
+    put_uint(buf, 1);   // transition_id
+    put_uint(buf, 2);   // "1"
+    put_uint(buf, 0);   // no children
+    return buf;
+}
+
+// Add a pseudo-event with the given total nesting depth (including itself)
+static void
+put_pseudo_event(GByteArray *buf, int levels)
+{
+    put_uint(buf, 3);   // pseudo_event
+    put_uint(buf, 1);   // one attribute
+    put_uint(buf, 4);   // id
+    put_uint(buf, 2);   // "1"
+    for (int i = 1; i < levels; i++) {
+        put_uint(buf, 1);   // one child
+        put_uint(buf, 3);   // pseudo_event
+        put_uint(buf, 0);   // no attributes
+    }
+    put_uint(buf, 0);   // no children
+}
+
+// Add an action table with one action, an empty input table, and one synapse
+static void
+put_one_synapse(GByteArray *buf, int levels)
+{
+    put_uint(buf, 1);   // one action
+    put_pseudo_event(buf, levels);
+    put_uint(buf, 0);   // no inputs
+
+    put_uint(buf, 1);   // one synapse
+    put_uint(buf, 0);   // id
+    put_uint(buf, 0);   // priority
+    put_uint(buf, 1);   // one action
+    put_uint(buf, 0);   // action table index
+    put_uint(buf, 0);   // no inputs
+}
+
+static crm_graph_t *
+unpack_raw(const guint8 *data, gsize len)
+{
+    char *encoded = g_base64_encode(data, len);
+    crm_graph_t *graph = pcmk__unpack_compact_graph(encoded, "test", NULL);
+
+    g_free(encoded);
+    return graph;
+}
+
+static bool
+unpack_buffer_ok(GByteArray *buf)
+{
+    crm_graph_t *graph = unpack_raw(buf->data, buf->len);
+
+    g_byte_array_free(buf, TRUE);
+    if (graph == NULL) {
+        return false;
+    }
+    destroy_graph(graph);
+    return true;
+}
+
+static void
+assert_same_actions(GList *expected, GList *actual, bool compare_xml)
+{
+    g_assert_cmpint(g_list_length(actual), ==, g_list_length(expected));
+
+    for (; expected != NULL; expected = expected->next, actual = actual->next) {
+        crm_action_t *e = expected->data;
+        crm_action_t *a = actual->data;
+
+        g_assert_cmpint(a->id, ==, e->id);
+        g_assert_cmpint(a->type, ==, e->type);
+        g_assert_cmpint(a->timeout, ==, e->timeout);
+        g_assert_cmpuint(a->interval_ms, ==, e->interval_ms);
+        g_assert_cmpint(a->can_fail, ==, e->can_fail);
+
+        if (compare_xml) {
+            char *e_xml = dump_xml_unformatted(e->xml);
+            char *a_xml = dump_xml_unformatted(a->xml);
+
+            g_assert_cmpstr(a_xml, ==, e_xml);
+            free(e_xml);
+            free(a_xml);
+        }
+    }
+}
+
+static void
+assert_same_graph(crm_graph_t *expected, crm_graph_t *actual)
+{
+    GList *e_iter = expected->synapses;
+    GList *a_iter = actual->synapses;
+
+    g_assert_cmpint(actual->id, ==, expected->id);
+    g_assert_cmpint(actual->num_actions, ==, expected->num_actions);
+    g_assert_cmpint(actual->num_synapses, ==, expected->num_synapses);
+    g_assert_cmpint(actual->batch_limit, ==, expected->batch_limit);
+    g_assert_cmpuint(actual->network_delay, ==, expected->network_delay);
+    g_assert_cmpuint(actual->stonith_timeout, ==, expected->stonith_timeout);
+    g_assert_cmpint(actual->migration_limit, ==, expected->migration_limit);
+
+    g_assert_cmpuint(g_hash_table_size(actual->actions), ==,
+                     g_hash_table_size(expected->actions));
+    g_assert_cmpuint(g_hash_table_size(actual->dependents), ==,
+                     g_hash_table_size(expected->dependents));
+    g_assert_cmpuint(g_hash_table_size(actual->cancels), ==,
+                     g_hash_table_size(expected->cancels));
+    g_assert_cmpuint(g_hash_table_size(actual->downed), ==,
+                     g_hash_table_size(expected->downed));
+
+    g_assert_cmpint(g_list_length(actual->synapses), ==,
+                    g_list_length(expected->synapses));
+    for (; e_iter != NULL; e_iter = e_iter->next, a_iter = a_iter->next) {
+        synapse_t *e = e_iter->data;
+        synapse_t *a = a_iter->data;
+
+        g_assert_cmpint(a->id, ==, e->id);
+        g_assert_cmpint(a->priority, ==, e->priority);
+        assert_same_actions(e->actions, a->actions, true);
+
+        /* An input repeated across synapses is stored once, so only the
+         * unpacked fields (not the XML of each copy) have to match.
+         */
+        assert_same_actions(e->inputs, a->inputs, false);
+    }
+}
+
+static xmlNode *
+load_scheduler_graph(const char *name)
+{
+    char *file = crm_strdup_printf("%s.exp", name);
+    gchar *path = g_test_build_filename(G_TEST_DIST, "..", "..", "..", "..",
+                                        "cts", "scheduler", file, NULL);
+    xmlNode *xml = filename2xml(path);
+
+    g_assert(xml != NULL);
+    g_free(path);
+    free(file);
+    return xml;
+}
+
+/*
+ * Tests
+ */
+
+static void
+round_trip_one(gconstpointer data)
+{
+    xmlNode *xml = load_scheduler_graph((const char *) data);
+    char *encoded = pcmk__graph_compact_encode(xml);
+    crm_graph_t *expected = unpack_graph(xml, "xml");
+    crm_graph_t *actual = NULL;
+    xmlNode *attrs = NULL;
+
+    g_assert(encoded != NULL);
+    g_assert(expected != NULL);
+
+    actual = pcmk__unpack_compact_graph(encoded, "compact", &attrs);
+    g_assert(actual != NULL);
+    g_assert(attrs != NULL);
+    g_assert_cmpstr(crm_element_name(attrs), ==, XML_TAG_GRAPH);
+    g_assert(__xml_first_child_element(attrs) == NULL);
+
+    assert_same_graph(expected, actual);
+
+    free_xml(attrs);
+    destroy_graph(actual);
+    destroy_graph(expected);
+    g_free(encoded);
+    free_xml(xml);
+}
+
+static void
+minimal_graph(void)
+{
+    GByteArray *buf = new_graph_buffer();
+
+    put_one_synapse(buf, 1);
+    g_assert(unpack_buffer_ok(buf));
+}
+
+static void
+truncated_input(void)
+{
+    xmlNode *xml = load_scheduler_graph("master-notify");
+    char *encoded = pcmk__graph_compact_encode(xml);
+    gsize raw_len = 0;
+    guint8 *raw = g_base64_decode(encoded, &raw_len);
+
+    g_assert_cmpuint(raw_len, >, strlen(MAGIC));
+
+    // Every proper prefix (including ones shorter than the magic) is invalid
+    for (gsize len = 0; len < raw_len; len++) {
+        crm_graph_t *graph = unpack_raw(raw, len);
+
+        if (graph != NULL) {
+            destroy_graph(graph);
+            g_test_message("Prefix of %" G_GSIZE_FORMAT " bytes was accepted",
+                           len);
+            g_assert_not_reached();
+        }
+    }
+
+    g_free(raw);
+    g_free(encoded);
+    free_xml(xml);
+}
+
+static void
+corrupt_input(void)
+{
+    GByteArray *buf = NULL;
+
+    g_assert(pcmk__unpack_compact_graph("", "test", NULL) == NULL);
+    g_assert(pcmk__unpack_compact_graph("<transition_graph/>", "test",
+                                        NULL) == NULL);
+
+    // Wrong magic
+    buf = new_graph_buffer();
+    put_one_synapse(buf, 1);
+    buf->data[strlen(MAGIC) - 1] = '2';
+    g_assert(!unpack_buffer_ok(buf));
+
+    // Trailing data after the last synapse
+    buf = new_graph_buffer();
+    put_one_synapse(buf, 1);
+    put_uint(buf, 0);
+    g_assert(!unpack_buffer_ok(buf));
+
+    // String pool count larger than the remaining data
+    buf = g_byte_array_new();
+    g_byte_array_append(buf, (const guint8 *) MAGIC, strlen(MAGIC));
+    put_uint(buf, G_GUINT64_CONSTANT(1) << 40);
+    g_assert(!unpack_buffer_ok(buf));
+
+    // Unterminated integer
+    buf = new_graph_buffer();
+    put_uint(buf, 1);
+    g_byte_array_append(buf, (const guint8 *) "\xff\xff", 2);
+    g_assert(!unpack_buffer_ok(buf));
+}
+
+static void
+bad_pool_index(void)
+{
+    GByteArray *buf = NULL;
+
+    // Element name
+    buf = new_graph_buffer();
+    put_uint(buf, 1);           // one action
+    put_uint(buf, DIMOF(pool)); // name
+    put_uint(buf, 0);
+    put_uint(buf, 0);
+    g_assert(!unpack_buffer_ok(buf));
+
+    // Attribute value
+    buf = new_graph_buffer();
+    put_uint(buf, 1);           // one action
+    put_uint(buf, 3);           // pseudo_event
+    put_uint(buf, 1);           // one attribute
+    put_uint(buf, 4);           // id
+    put_uint(buf, 1000);        // value
+    put_uint(buf, 0);
+    g_assert(!unpack_buffer_ok(buf));
+}
+
+static void
+bad_table_index(void)
+{
+    GByteArray *buf = NULL;
+
+    // Action index past the end of the action table
+    buf = new_graph_buffer();
+    put_uint(buf, 1);
+    put_pseudo_event(buf, 1);
+    put_uint(buf, 0);
+    put_uint(buf, 1);   // one synapse
+    put_uint(buf, 0);
+    put_uint(buf, 0);
+    put_uint(buf, 1);
+    put_uint(buf, 1);   // action table index
+    put_uint(buf, 0);
+    g_assert(!unpack_buffer_ok(buf));
+
+    // The same action used twice
+    buf = new_graph_buffer();
+    put_uint(buf, 1);
+    put_pseudo_event(buf, 1);
+    put_uint(buf, 0);
+    put_uint(buf, 1);   // one synapse
+    put_uint(buf, 0);
+    put_uint(buf, 0);
+    put_uint(buf, 2);
+    put_uint(buf, 0);   // action table index
+    put_uint(buf, 0);   // action table index
+    put_uint(buf, 0);
+    g_assert(!unpack_buffer_ok(buf));
+
+    // Input index into an empty input table
+    buf = new_graph_buffer();
+    put_uint(buf, 1);
+    put_pseudo_event(buf, 1);
+    put_uint(buf, 0);
+    put_uint(buf, 1);   // one synapse
+    put_uint(buf, 0);
+    put_uint(buf, 0);
+    put_uint(buf, 1);
+    put_uint(buf, 0);
+    put_uint(buf, 1);
+    put_uint(buf, 0);   // input table index
+    g_assert(!unpack_buffer_ok(buf));
+}
+
+static void
+nesting_depth(void)
+{
+    GByteArray *buf = NULL;
+
+    buf = new_graph_buffer();
+    put_one_synapse(buf, MAX_DEPTH);
+    g_assert(unpack_buffer_ok(buf));
+
+    buf = new_graph_buffer();
+    put_one_synapse(buf, MAX_DEPTH + 1);
+    g_assert(!unpack_buffer_ok(buf));
+}
+
+int main(int argc, char **argv)
+{
+    g_test_init(&argc, &argv, NULL);
+
+    g_test_add_data_func("/pacemaker/transition/compact/round_trip/simple",
+                         "1-a-then-bm-move-b", round_trip_one);
+    g_test_add_data_func("/pacemaker/transition/compact/round_trip/notify",
+                         "master-notify", round_trip_one);
+    g_test_add_data_func("/pacemaker/transition/compact/round_trip/fencing",
+                         "stonith-0", round_trip_one);
+    g_test_add_data_func("/pacemaker/transition/compact/round_trip/bundle",
+                         "bundle-nested-colocation", round_trip_one);
+    g_test_add_func("/pacemaker/transition/compact/minimal", minimal_graph);
+    g_test_add_func("/pacemaker/transition/compact/truncated", truncated_input);
+    g_test_add_func("/pacemaker/transition/compact/corrupt", corrupt_input);
+    g_test_add_func("/pacemaker/transition/compact/bad_pool_index",
+                    bad_pool_index);
+    g_test_add_func("/pacemaker/transition/compact/bad_table_index",
+                    bad_table_index);
+    g_test_add_func("/pacemaker/transition/compact/nesting_depth",
+                    nesting_depth);
+
+    return g_test_run();
+}
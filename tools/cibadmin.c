@@ -112,6 +112,11 @@ static pcmk__cli_option_t long_options[] = {
         "empty", no_argument, NULL, 'a',
         "\tOutput an empty CIB", pcmk__option_default
     },
+    {
+        "stats", no_argument, NULL, 'S',
+        "\tShow the CIB manager's per-operation and per-client statistics",
+        pcmk__option_default
+    },
     {
         "md5-sum", no_argument, NULL, '5',
         "\tCalculate the on-disk CIB digest", pcmk__option_default
@@ -463,6 +468,9 @@ main(int argc, char **argv)
             case 'D':
                 cib_action = CIB_OP_DELETE;
                 break;
+            case 'S':
+                cib_action = CIB_OP_STATS;
+                break;
             case '5':
                 cib_action = "md5-sum";
                 break;
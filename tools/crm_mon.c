@@ -809,6 +809,11 @@ cib_connect(gboolean full)
                 rc = cib->cmds->add_notify_callback(cib, T_CIB_DIFF_NOTIFY, crm_diff_update);
             }
 
+            if (rc == pcmk_ok) {
+                // crm_diff_update() catches up on any diffs it misses
+                cib->cmds->register_notification(cib, T_CIB_CATCH_UP, 1);
+            }
+
             if (rc != pcmk_ok) {
                 out->err(out, "Notification setup failed, could not monitor CIB actions");
                 if (output_format == mon_output_console) {
@@ -1822,6 +1827,21 @@ crm_diff_update(const char *event, xmlNode * msg)
     if (current_cib != NULL) {
         rc = xml_apply_patchset(current_cib, diff, TRUE);
 
+        if (rc == -pcmk_err_diff_resync) {
+            /* We missed some updates, so try to catch up from the CIB
+             * manager's patchset history before resorting to a full query
+             */
+            rc = cib_catch_up(cib, current_cib, cib_scope_local);
+            if (rc == pcmk_ok) {
+                crm_debug("[%s] Caught up with missed updates", event);
+            }
+
+        } else if (rc == -pcmk_err_old_data) {
+            crm_trace("[%s] Masking error, we already have the supplied update",
+                      event);
+            rc = pcmk_ok;
+        }
+
         switch (rc) {
             case -pcmk_err_diff_resync:
             case -pcmk_err_diff_failed: